@@ -30,5 +30,173 @@ namespace fuziqtests
 
 			Assert::AreEqual(ret, 0);
 		}
+
+		TEST_METHOD(fuzzer_prng)
+		{
+			int ret = fuzzer_prng_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_scheduler)
+		{
+			int ret = fuzzer_scheduler_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_profile)
+		{
+			int ret = fuzzer_profile_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_trial)
+		{
+			int ret = fuzzer_trial_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_rate)
+		{
+			int ret = fuzzer_rate_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_log)
+		{
+			int ret = fuzzer_log_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_triage)
+		{
+			int ret = fuzzer_triage_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_supervisor_log)
+		{
+			int ret = fuzzer_supervisor_log_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_event)
+		{
+			int ret = fuzzer_event_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_capture)
+		{
+			int ret = fuzzer_capture_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_memory)
+		{
+			int ret = fuzzer_memory_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_varint)
+		{
+			int ret = fuzzer_varint_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_schema)
+		{
+			int ret = fuzzer_schema_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_app_frame)
+		{
+			int ret = fuzzer_app_frame_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_h3_mutate)
+		{
+			int ret = fuzzer_h3_mutate_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_blaster)
+		{
+			int ret = fuzi_q_blaster_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzzer_tls_mutate)
+		{
+			int ret = fuzzer_tls_mutate_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_stateless)
+		{
+			int ret = fuzi_q_stateless_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_migration_plan)
+		{
+			int ret = fuzi_q_migration_plan_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_key_update_plan)
+		{
+			int ret = fuzi_q_key_update_plan_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_multipath)
+		{
+			int ret = fuzi_q_multipath_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_scenario)
+		{
+			int ret = fuzi_q_scenario_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_many_clients)
+		{
+			int ret = fuzi_q_many_clients_test();
+
+			Assert::AreEqual(ret, 0);
+		}
+
+		TEST_METHOD(fuzi_q_wake_up)
+		{
+			int ret = fuzi_q_wake_up_test();
+
+			Assert::AreEqual(ret, 0);
+		}
 	};
 }
@@ -23,6 +23,7 @@
 #define FUZI_Q_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <picoquic.h>
 #include <picosplay.h>
 #include <quicperf.h>
@@ -30,12 +31,15 @@
 #include <democlient.h>
 #include <demoserver.h>
 #include <picoquic_config.h>
+#include <picoquic_packet_loop.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define FUZI_Q_MAX_SILENCE 3000000
+#define FUZI_Q_PROBE_INTERVAL_DEFAULT 100000 /* 100 ms, used by triage if -N is not set */
+#define FUZI_Q_PROBE_RTT_MIN 10000 /* Floor of the RTT used for probe timeouts */
 
 /* Operation modes for the fuzzer
  */
@@ -44,7 +48,10 @@ typedef enum {
     fuzi_q_mode_server,
     fuzi_q_mode_client,
     fuzi_q_mode_clean,
-    fuzi_q_mode_clean_server
+    fuzi_q_mode_clean_server,
+    fuzi_q_mode_triage,
+    fuzi_q_mode_supervise,
+    fuzi_q_mode_blast
 } fuzi_q_mode_enum;
 
 /* Fuzzing context per connection. The goals are:
@@ -68,6 +75,94 @@ typedef enum {
     fuzzer_cnx_state_max
 } fuzzer_cnx_state_enum;
 
+/* The scheduler tracks coverage per target state and per wait depth.
+ * Wait depths are grouped in logarithmic buckets: bucket 0 for wait 0,
+ * bucket b for waits in [2^(b-1), 2^b), the last bucket for all larger waits.
+ */
+#define FUZZER_NB_WAIT_BUCKETS 8
+#define FUZZER_SCHEDULER_CANDIDATES 4
+#define FUZZER_SCHEDULER_MISS_WEIGHT 2
+
+/* Ring of the last packet events of a connection, kept in memory and
+ * written to disk in qlog format only for the connections of interest.
+ */
+#define FUZZER_EVENT_RING_SIZE 128
+#define FUZI_Q_EVENT_LOG_OFF -1
+
+typedef struct st_fuzzer_event_t {
+    uint64_t time;
+    uint64_t packet_rank;
+    uint32_t trial_rank;
+    uint16_t length;
+    uint16_t fuzzed_length;
+    uint8_t first_byte;
+    uint8_t state;
+    uint8_t fuzzed;
+} fuzzer_event_t;
+
+/* Capture of the packet images of a connection before encryption, with
+ * their original bytes when fuzzed. The rings are allocated in a pool when
+ * the capture is enabled, and attached to the connections as they start,
+ * so that no memory is allocated when packets are captured. The rings
+ * are written in pcapng format when the connection ends abnormally.
+ */
+#define FUZZER_CAPTURE_RING_SIZE 8
+#define FUZZER_CAPTURE_SECRETS_MAX 0x100000
+
+typedef struct st_fuzzer_capture_packet_t {
+    uint64_t time;
+    uint64_t packet_rank;
+    uint32_t trial_rank;
+    uint16_t length;
+    uint16_t fuzzed_length; /* 0 if the packet was not fuzzed */
+    uint8_t original[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t fuzzed[PICOQUIC_MAX_PACKET_SIZE];
+} fuzzer_capture_packet_t;
+
+typedef struct st_fuzzer_capture_t {
+    struct st_fuzzer_capture_t* next_free;
+    size_t nb_packets;
+    fuzzer_capture_packet_t packets[FUZZER_CAPTURE_RING_SIZE];
+} fuzzer_capture_t;
+
+/* Observations made on the frames sent by a connection, before fuzzing.
+ * Frame fuzzers query them to produce mutations that are almost valid,
+ * e.g., an offset just past the data sent on a stream in use, which get
+ * past the early checks of the peer more often than random values.
+ */
+#define FUZZER_MEMORY_NB_STREAMS 8
+#define FUZZER_MEMORY_TOKEN_MAX 32
+#define FUZZER_MEMORY_NB_PATHS 8
+
+typedef enum {
+    fuzzer_memory_max_data = 0,
+    fuzzer_memory_max_stream_data,
+    fuzzer_memory_max_streams_bidir,
+    fuzzer_memory_max_streams_unidir,
+    fuzzer_memory_cid_sequence,
+    fuzzer_memory_retire_prior_to,
+    fuzzer_memory_path_id,
+    fuzzer_memory_crypto_offset,
+    fuzzer_memory_max
+} fuzzer_memory_field_enum;
+
+typedef struct st_fuzzer_memory_stream_t {
+    uint64_t stream_id;
+    uint64_t offset; /* End of the data sent so far */
+} fuzzer_memory_stream_t;
+
+typedef struct st_fuzzer_cnx_memory_t {
+    uint64_t value[fuzzer_memory_max];
+    uint32_t known; /* One bit per field observed */
+    size_t nb_streams; /* Streams observed, the table keeps the most recently used */
+    fuzzer_memory_stream_t streams[FUZZER_MEMORY_NB_STREAMS];
+    uint8_t token_length;
+    uint8_t token[FUZZER_MEMORY_TOKEN_MAX];
+    int handshake_done_sent;
+    size_t nb_path_ids; /* Live paths of a multipath connection */
+    uint64_t path_ids[FUZZER_MEMORY_NB_PATHS];
+} fuzzer_cnx_memory_t;
+
 typedef struct st_fuzzer_icid_ctx_t {
     picosplay_node_t icid_node;
     struct st_fuzzer_icid_ctx_t* icid_before;
@@ -77,23 +172,70 @@ typedef struct st_fuzzer_icid_ctx_t {
     uint64_t random_context;
     fuzzer_cnx_state_enum target_state;
     int target_wait;
+    int target_bucket;
+    uint64_t trial_rank;
+    uint64_t packet_rank;
     int wait_count[fuzzer_cnx_state_max];
     int already_fuzzed;
-    /* For MAX_DATA stateful fuzzing */
-    uint64_t last_sent_max_data;
-    int has_sent_max_data; 
-    /* For NEW_CONNECTION_ID / RETIRE_CONNECTION_ID stateful fuzzing */
-    uint64_t last_new_cid_seq_no_sent;
-    int new_cid_seq_no_available; /* Boolean flag */
-    /* For Handshake Completion/Interruption fuzzing */
-    int handshake_done_sent_by_server;
+    /* Observations for stateful fuzzing */
+    fuzzer_cnx_memory_t memory;
+    /* A NEW_CONNECTION_ID was fuzzed, its sequence number can be retired */
+    int new_cid_seq_no_available;
     int client_handshake_confirmed; /* New field for client handshake status */
+    /* Packet events, allocated when the event log is enabled */
+    fuzzer_event_t* events;
+    size_t nb_events;
+    /* Packet capture, attached from the pool when the capture is enabled */
+    fuzzer_capture_t* capture;
+    /* The connection migrated, path validation and CID frames are fuzzed first */
+    int migrated;
+    /* Packets left after a key update in which the key phase may be flipped */
+    int key_phase_flips;
 } fuzzer_icid_ctx_t;
 
+/* Log of the recently fuzzed packets, kept in a ring buffer so that
+ * the connections fuzzed just before the server went down can be listed.
+ */
+#define FUZZER_LOG_SIZE 256
+
+typedef struct st_fuzzer_log_entry_t {
+    uint64_t first_time;
+    uint64_t last_time;
+    picoquic_connection_id_t icid;
+    uint64_t trial_rank;
+    fuzzer_cnx_state_enum state;
+    fuzzer_cnx_state_enum target_state;
+    int target_wait;
+    uint32_t nb_packets;
+} fuzzer_log_entry_t;
+
+/* Replay of previously fuzzed connections, used for crash triage.
+ * Each target identifies a fuzzed trial by its ICID and trial rank, and
+ * if known the target state and wait that were scheduled for it, so
+ * the replay does not depend on the coverage state of the scheduler.
+ * Only the packets whose rank is within [first_packet, last_packet]
+ * are fuzzed, and the trials not listed are not fuzzed at all.
+ */
+typedef struct st_fuzzer_replay_target_t {
+    picoquic_connection_id_t icid;
+    uint64_t trial_rank;
+    int target_state; /* -1 if unknown, then the scheduler picks the target */
+    int target_wait;
+} fuzzer_replay_target_t;
+
+typedef struct st_fuzi_q_replay_t {
+    fuzzer_replay_target_t* targets;
+    size_t nb_targets;
+    uint64_t first_packet;
+    uint64_t last_packet;
+    int server_is_down;
+} fuzi_q_replay_t;
+
 typedef struct st_fuzzer_ctx_t {
     picosplay_tree_t icid_tree;
     fuzzer_icid_ctx_t* icid_mru;
     fuzzer_icid_ctx_t* icid_lru;
+    size_t nb_icid_evicted; /* contexts removed after 2*FUZI_Q_MAX_SILENCE without packets */
     struct st_fuzi_q_ctx_t* parent;
     picoquic_connection_id_t next_cid;
     size_t nb_cnx_tried[fuzzer_cnx_state_max];
@@ -102,13 +244,149 @@ typedef struct st_fuzzer_ctx_t {
     size_t nb_packets_state[fuzzer_cnx_state_max];
     int wait_max[fuzzer_cnx_state_max];
     int waited_max[fuzzer_cnx_state_max];
+    /* Coverage of (target state, wait bucket) cells, used by the scheduler */
+    size_t cell_assigned[fuzzer_cnx_state_max][FUZZER_NB_WAIT_BUCKETS];
+    size_t cell_fuzzed[fuzzer_cnx_state_max][FUZZER_NB_WAIT_BUCKETS];
+    /* Packet statistics of previous campaigns, loaded from the profile */
+    uint64_t profile_packets_state[fuzzer_cnx_state_max];
+    uint64_t profile_packets_fuzzed[fuzzer_cnx_state_max];
+    fuzzer_log_entry_t fuzz_log[FUZZER_LOG_SIZE];
+    size_t fuzz_log_nb;
+    size_t fuzz_log_packets;
+    fuzi_q_replay_t* replay;
+    /* Event log: sample one connection in event_sample, 0 for only the abnormal ones */
+    int event_log_enabled;
+    size_t event_sample;
+    char const* event_dir;
+    size_t nb_event_files;
+    /* Packet capture */
+    fuzzer_capture_t* capture_pool;
+    fuzzer_capture_t* capture_free;
+    size_t nb_capture_files;
     uint32_t nb_packets;
     uint32_t nb_fuzzed;
     uint32_t nb_fuzzed_length;
     uint32_t nb_header_fuzzed;
+    uint32_t nb_key_phase_flipped;
 } fuzzer_ctx_t;
 
 fuzzer_icid_ctx_t* fuzzer_get_icid_ctx(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid, uint64_t current_time);
+uint64_t fuzzer_icid_random_seed(const picoquic_connection_id_t* icid, uint64_t trial_rank);
+int fuzzer_wait_bucket(int wait);
+void fuzzer_schedule_target(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, fuzzer_cnx_state_enum min_state);
+fuzzer_icid_ctx_t* fuzzer_start_trial(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid, uint64_t trial_rank, uint64_t current_time);
+void fuzzer_log_fuzzed(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, fuzzer_cnx_state_enum state, uint64_t current_time);
+size_t fuzzer_log_dump(fuzzer_ctx_t* ctx, FILE* F, uint64_t since_time);
+
+void fuzzer_event_record(fuzzer_icid_ctx_t* icid_ctx, uint64_t current_time, fuzzer_cnx_state_enum state,
+    uint8_t first_byte, size_t length, size_t fuzzed_length, int fuzzed);
+int fuzzer_event_is_sampled(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx);
+int fuzzer_event_flush(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, char const* reason, int is_client);
+void fuzzer_event_release(fuzzer_icid_ctx_t* icid_ctx);
+
+int fuzzer_capture_init(fuzzer_ctx_t* ctx, size_t nb_rings);
+void fuzzer_capture_release(fuzzer_ctx_t* ctx);
+void fuzzer_capture_attach(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx);
+void fuzzer_capture_detach(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx);
+fuzzer_capture_packet_t* fuzzer_capture_original(fuzzer_icid_ctx_t* icid_ctx, uint64_t current_time,
+    uint8_t* bytes, size_t length);
+void fuzzer_capture_fuzzed(fuzzer_capture_packet_t* packet, uint8_t* bytes, size_t fuzzed_length, int fuzzed);
+int fuzzer_capture_write(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, char const* reason);
+
+/* Per packet pseudo random stream used by all fuzzing decisions.
+ * The stream is seeded from the ICID random context for each packet,
+ * so the sequence of mutations only depends on the ICID and on the
+ * packet rank, and can be replayed. The generator is xoshiro256**.
+ */
+typedef struct st_fuzzer_prng_t {
+    uint64_t s[4];
+} fuzzer_prng_t;
+
+void fuzzer_prng_seed(fuzzer_prng_t* prng, uint64_t seed);
+uint64_t fuzzer_prng_next(fuzzer_prng_t* prng);
+/* Returns a value in [0, range), without modulo bias. Returns 0 if range is 0. */
+uint64_t fuzzer_prng_uniform(fuzzer_prng_t* prng, uint64_t range);
+
+void fuzzer_memory_observe(fuzzer_cnx_memory_t* memory, const uint8_t* bytes, const uint8_t* bytes_max, int is_client);
+int fuzzer_memory_get(const fuzzer_cnx_memory_t* memory, fuzzer_memory_field_enum field, uint64_t* value);
+uint64_t fuzzer_memory_near(fuzzer_prng_t* prng, uint64_t value);
+int fuzzer_memory_plausible(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng, fuzzer_memory_field_enum field, uint64_t* value);
+int fuzzer_memory_pick_stream(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng, fuzzer_memory_stream_t* stream);
+void fuzzer_memory_observe_paths(fuzzer_cnx_memory_t* memory, const picoquic_cnx_t* cnx);
+int fuzzer_memory_pick_path_id(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng, uint64_t* path_id);
+
+/* Varint field mutations, shared by the frame fuzzers.
+ * Values are drawn from the boundaries of the 1, 2, 4 and 8 bytes
+ * encodings, or derived from the current value or from a limit, such
+ * as the flow control credit or the bytes left in the frame. Fields are
+ * rewritten in place with the same encoding length, using non minimal
+ * encodings if needed, or resized by shifting the rest of the packet.
+ */
+#define FUZZER_VARINT_MAX 0x3FFFFFFFFFFFFFFFull
+#define FUZZER_VARINT_NO_LIMIT UINT64_MAX
+
+size_t fuzzer_varint_length(uint64_t value);
+int fuzzer_varint_encode(uint8_t* bytes, size_t length, uint64_t value);
+uint64_t fuzzer_varint_boundary(fuzzer_prng_t* prng, size_t length);
+uint64_t fuzzer_varint_relative(fuzzer_prng_t* prng, uint64_t value, uint64_t limit);
+int fuzzer_varint_overwrite(uint8_t* field, uint8_t* field_end, uint64_t value);
+uint8_t* fuzzer_varint_mutate(fuzzer_prng_t* prng, uint8_t* field, uint8_t* bytes_max, uint64_t limit);
+size_t fuzzer_varint_resize(fuzzer_prng_t* prng, uint8_t* bytes, size_t length, size_t bytes_max, size_t field_offset);
+
+/* Frame schemas.
+ * Each frame type is described by the list of its fields. A field can be
+ * present only for some values of the frame type, e.g., the offset and
+ * length of stream frames. Bytes fields extend over the value of the
+ * preceding length field, or to the end of the frame if there is none.
+ * Repeated fields, e.g., ACK ranges, are repeated as many times as the
+ * value of the preceding count field.
+ */
+#define FUZZER_SCHEMA_MAX_FIELDS 8
+#define FUZZER_SCHEMA_MAX_PARSED 32
+
+typedef enum {
+    fuzzer_field_varint = 0,
+    fuzzer_field_length, /* varint, length of the next bytes field */
+    fuzzer_field_length8, /* single byte, length of the next bytes field */
+    fuzzer_field_count, /* varint, number of repetitions of the next field */
+    fuzzer_field_repeat, /* size varints, repeated count times */
+    fuzzer_field_fixed, /* size bytes */
+    fuzzer_field_bytes
+} fuzzer_field_type_enum;
+
+typedef struct st_fuzzer_field_schema_t {
+    fuzzer_field_type_enum type;
+    uint8_t size;
+    uint8_t type_mask; /* If not zero, field only present if frame_type & type_mask */
+} fuzzer_field_schema_t;
+
+typedef struct st_fuzzer_frame_schema_t {
+    char const* name;
+    uint64_t frame_type_min;
+    uint64_t frame_type_max;
+    size_t nb_fields;
+    fuzzer_field_schema_t fields[FUZZER_SCHEMA_MAX_FIELDS];
+} fuzzer_frame_schema_t;
+
+typedef struct st_fuzzer_parsed_field_t {
+    fuzzer_field_type_enum type;
+    uint8_t* start;
+    uint8_t* end;
+    uint64_t value;
+} fuzzer_parsed_field_t;
+
+typedef struct st_fuzzer_parsed_frame_t {
+    const fuzzer_frame_schema_t* schema;
+    uint64_t frame_type;
+    uint8_t* frame_start;
+    uint8_t* frame_max;
+    size_t nb_fields;
+    fuzzer_parsed_field_t fields[FUZZER_SCHEMA_MAX_PARSED];
+} fuzzer_parsed_frame_t;
+
+const fuzzer_frame_schema_t* fuzzer_schema_find(uint64_t frame_type);
+int fuzzer_schema_parse(uint8_t* bytes, uint8_t* bytes_max, fuzzer_parsed_frame_t* parsed);
+int fuzzer_schema_mutate(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max);
 
 /* Test frames for use in fuzzing.
  */
@@ -121,6 +399,60 @@ typedef struct st_fuzi_q_frames_t {
 extern fuzi_q_frames_t fuzi_q_frame_list[];
 extern size_t nb_fuzi_q_frame_list;
 
+#define FUZZER_NB_ELEMENTS(x) (sizeof(x) / sizeof(x[0]))
+
+/* HTTP/3 stream and frame types, shared by the injection of application
+ * layer entries and by the HTTP/3 aware mutation of stream data.
+ */
+#define FUZZER_H3_STREAM_CONTROL 0x00
+#define FUZZER_H3_STREAM_PUSH 0x01
+#define FUZZER_H3_STREAM_QPACK_ENCODER 0x02
+#define FUZZER_H3_STREAM_QPACK_DECODER 0x03
+
+#define FUZZER_H3_FRAME_DATA 0x00
+#define FUZZER_H3_FRAME_HEADERS 0x01
+#define FUZZER_H3_FRAME_CANCEL_PUSH 0x03
+#define FUZZER_H3_FRAME_SETTINGS 0x04
+#define FUZZER_H3_FRAME_PUSH_PROMISE 0x05
+#define FUZZER_H3_FRAME_GOAWAY 0x07
+#define FUZZER_H3_FRAME_ORIGIN 0x0c
+#define FUZZER_H3_FRAME_MAX_PUSH_ID 0x0d
+#define FUZZER_H3_FRAME_PRIORITY_UPDATE_REQUEST 0xf0700
+#define FUZZER_H3_FRAME_PRIORITY_UPDATE_PUSH 0xf0701
+
+/* The frame list also contains HTTP/3, QPACK, HPACK and WebSocket
+ * entries. These are not QUIC frames: they are injected inside a STREAM
+ * frame, on the stream where the application would carry them.
+ */
+typedef enum {
+    fuzi_q_layer_quic = 0,
+    fuzi_q_layer_h3_request, /* HTTP/3 frames sent on request streams */
+    fuzi_q_layer_h3_control, /* HTTP/3 frames sent on the control stream */
+    fuzi_q_layer_qpack_encoder,
+    fuzi_q_layer_qpack_decoder,
+    fuzi_q_layer_hpack, /* carried as field section of an HTTP/3 HEADERS frame */
+    fuzi_q_layer_websocket /* carried in an HTTP/3 DATA frame */
+} fuzi_q_layer_enum;
+
+fuzi_q_layer_enum fuzi_q_frame_layer(const fuzi_q_frames_t* frame);
+size_t fuzzer_app_frame_wrap(fuzzer_prng_t* prng, const fuzzer_cnx_memory_t* memory, int is_client,
+    const fuzi_q_frames_t* frame, uint8_t* bytes, size_t bytes_max);
+
+/* HTTP/3 aware mutation of the data of a STREAM frame: HTTP/3 frames,
+ * settings, field sections and QPACK instructions are mutated in place,
+ * keeping the length of the data unchanged.
+ */
+int fuzzer_h3_stream_mutate(fuzzer_prng_t* prng, uint64_t stream_id, uint64_t offset, uint8_t* data, uint8_t* data_max);
+
+/* Structure aware mutation of the TLS handshake messages carried in CRYPTO
+ * frames. The extensions of a ClientHello, ServerHello or EncryptedExtensions
+ * message are parsed, and the transport parameters, ALPN, key shares or the
+ * list of extensions are mutated before rebuilding the message lengths.
+ * The data must start with the message. Returns the new length of the data,
+ * at most data_max, or 0 if the data was not mutated.
+ */
+size_t fuzzer_tls_mutate(fuzzer_prng_t* prng, uint8_t* data, size_t length, size_t data_max);
+
 /*
 * Fuzz test, merge of basic fuzzer and initial fuzzer from picoquic tests
 */
@@ -131,6 +463,289 @@ void fuzzer_random_cid(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid);
 void fuzi_q_fuzzer_init(fuzzer_ctx_t* fuzz_ctx, picoquic_connection_id_t* init_cid, picoquic_quic_t* quic);
 void fuzi_q_fuzzer_release(fuzzer_ctx_t* fuzz_ctx);
 
+/* Fuzzing profiles.
+ * The wait_max and waited_max values learned during a campaign, and the
+ * per state packet statistics, are saved at exit and reloaded at startup,
+ * so a new campaign against the same server and ALPN can fuzz at full depth
+ * immediately. A profile file can hold the profiles of several targets,
+ * each identified by a key such as "server:port/alpn".
+ */
+#define FUZI_Q_PROFILE_KEY_MAX 256
+int fuzi_q_profile_key(char* key, size_t key_max, char const* server_name, int server_port, char const* alpn);
+int fuzi_q_profile_load(fuzzer_ctx_t* fuzz_ctx, char const* profile_file, char const* key);
+int fuzi_q_profile_save(fuzzer_ctx_t* fuzz_ctx, char const* profile_file, char const* key);
+
+/* Connection rate controller.
+ * The client adapts the number of active connections and the interval
+ * between connection starts to the capacity of the server, using additive
+ * increase and multiplicative decrease. The pool starts at half the number
+ * of connections configured with "-n" and never exceeds it. Only the
+ * connections that were not fuzzed are evidence of overload: the failures
+ * of fuzzed connections are counted separately. A zeroed controller is disabled.
+ */
+#define FUZI_Q_RATE_ABANDON_RATIO 4 /* overload if more than 1/4 of connections abandoned */
+#define FUZI_Q_RATE_SUCCESS_RATIO 4 /* overload if fewer than 1/4 of connections complete the handshake */
+#define FUZI_Q_RATE_RTT_MARGIN 10000 /* ignore RTT increases below 10 ms */
+#define FUZI_Q_RATE_INTERVAL_MIN 1000 /* 1 ms */
+#define FUZI_Q_RATE_INTERVAL_MAX 1000000 /* 1 s */
+
+typedef struct st_fuzi_q_rate_ctl_t {
+    size_t pool_min;
+    size_t pool_max;
+    size_t pool_size;
+    uint64_t start_interval;
+    uint64_t next_start_time;
+    uint64_t rtt_min;
+    size_t epoch_closed;
+    size_t epoch_unfuzzed;
+    size_t epoch_abandoned;
+    size_t epoch_success;
+    uint64_t epoch_rtt_sum;
+    size_t epoch_nb_rtt;
+    size_t nb_increase;
+    size_t nb_decrease;
+    size_t nb_fuzzed_abandoned;
+} fuzi_q_rate_ctl_t;
+
+void fuzi_q_rate_init(fuzi_q_rate_ctl_t* rate_ctl, size_t pool_max, uint64_t current_time);
+int fuzi_q_rate_can_start(fuzi_q_rate_ctl_t* rate_ctl, size_t nb_active, uint64_t current_time);
+void fuzi_q_rate_on_start(fuzi_q_rate_ctl_t* rate_ctl, uint64_t current_time);
+void fuzi_q_rate_on_close(fuzi_q_rate_ctl_t* rate_ctl, int was_fuzzed, int handshake_done, int abandoned, uint64_t rtt);
+
+/* Outcome of a client run, used by the supervisor to continue the campaign
+ * after restarting the target.
+ */
+typedef struct st_fuzi_q_run_report_t {
+    FILE* crash_log;
+    size_t nb_cnx_tried;
+    int server_is_down;
+    picoquic_connection_id_t next_cid;
+} fuzi_q_run_report_t;
+
+/* Options of a client run. The replay and report are optional. The
+ * event sample is FUZI_Q_EVENT_LOG_OFF when no events are logged.
+ */
+typedef struct st_fuzi_q_client_options_t {
+    fuzi_q_mode_enum fuzz_mode;
+    const char* ip_address_text;
+    int server_port;
+    picoquic_quic_config_t* config;
+    size_t nb_cnx_required;
+    uint64_t duration_max;
+    picoquic_connection_id_t* init_cid;
+    char const* client_scenario_text;
+    char const* profile_file;
+    size_t trials_per_cnx;
+    uint64_t probe_interval;
+    int event_sample;
+    int capture_packets;
+    size_t nb_paths;
+    fuzi_q_replay_t* replay;
+    fuzi_q_run_report_t* report;
+} fuzi_q_client_options_t;
+
+/* Supervision of a local target.
+ * The target command runs as a child process, with its output appended
+ * to a log file. The supervisor detects the exit of the child and the
+ * sanitizer reports in the log, records each crash with the suspect
+ * connections, restarts the target and continues the campaign.
+ */
+#define FUZI_Q_SUPERVISOR_TARGET_LOG "fuzi_q_target.log"
+#define FUZI_Q_SUPERVISOR_CRASH_LOG "fuzi_q_crashes.txt"
+#define FUZI_Q_SUPERVISOR_STARTUP_DELAY 1000000 /* 1 second */
+#define FUZI_Q_SUPERVISOR_STOP_DELAY 2000000 /* 2 seconds, before SIGKILL */
+#define FUZI_Q_SUPERVISOR_REPORT_MAX 256
+
+typedef struct st_fuzi_q_supervisor_t {
+    char const* target_cmd;
+    char const* target_log;
+    long pid;
+    long log_offset;
+    int has_exited;
+    int exit_status;
+    int exit_signal;
+    int sanitizer_found;
+    char sanitizer_report[FUZI_Q_SUPERVISOR_REPORT_MAX];
+    size_t nb_starts;
+    size_t nb_crashes;
+} fuzi_q_supervisor_t;
+
+int fuzi_q_supervisor_scan_log(char const* log_file, long* offset, char* report, size_t report_max);
+#ifndef _WINDOWS
+/* Child processes are managed with fork and waitpid, POSIX only */
+int fuzi_q_supervisor_start(fuzi_q_supervisor_t* supervisor);
+int fuzi_q_supervisor_poll(fuzi_q_supervisor_t* supervisor);
+void fuzi_q_supervisor_stop(fuzi_q_supervisor_t* supervisor);
+int fuzi_q_supervise(char const* target_cmd, const fuzi_q_client_options_t* options);
+#endif
+
+/* Crash triage.
+ * The oracle replays a set of trials against a freshly restarted target
+ * and returns 1 if the target crashed, 0 if it did not, -1 on error.
+ * Bisection narrows the replay targets down to the smallest contiguous
+ * subset that still crashes the target, ideally a single trial, then
+ * minimization narrows the window of fuzzed packets for that subset.
+ */
+typedef int (*fuzi_q_triage_oracle_fn)(void* oracle_ctx, fuzi_q_replay_t* replay);
+
+#define FUZI_Q_TRIAGE_MAX_PACKETS 1024
+
+int fuzi_q_triage_read_targets(char const* file_name, fuzzer_replay_target_t** targets, size_t* nb_targets);
+int fuzi_q_triage_bisect(fuzi_q_triage_oracle_fn oracle, void* oracle_ctx, fuzi_q_replay_t* replay, size_t* nb_runs);
+int fuzi_q_triage_minimize(fuzi_q_triage_oracle_fn oracle, void* oracle_ctx, fuzi_q_replay_t* replay, size_t* nb_runs);
+int fuzi_q_triage(char const* target_file, char const* restart_cmd, const char* ip_address_text, int server_port,
+    picoquic_quic_config_t* config, uint64_t duration_max, char const* client_scenario_text, uint64_t probe_interval);
+
+#define FUZI_Q_QUIC_V2_VERSION 0x6b3343cf /* QUIC version 2, RFC 9369 */
+
+/* Stateless Initial blaster.
+ * A single template connection produces the ClientHello and derives the
+ * Initial keys of each DCID. The Initial packets are built, mutated,
+ * protected and sent directly on a socket, without creating connections.
+ * Replies are classified by the type of their first packet, and the first
+ * ICID that elicited each type is kept, so that it can be reproduced.
+ */
+#define FUZI_Q_BLAST_BURST 64 /* Initials sent between checks for replies */
+#define FUZI_Q_BLAST_DRAIN_DELAY 1000000 /* 1 second, wait for late replies */
+#define FUZI_Q_BLAST_INITIAL_MIN 1200
+
+typedef enum {
+    fuzi_q_reply_initial = 0,
+    fuzi_q_reply_zero_rtt,
+    fuzi_q_reply_handshake,
+    fuzi_q_reply_retry,
+    fuzi_q_reply_version_negotiation,
+    fuzi_q_reply_short_header, /* 1-RTT packet or stateless reset */
+    fuzi_q_reply_other,
+    fuzi_q_reply_max
+} fuzi_q_reply_enum;
+
+typedef struct st_fuzi_q_blaster_t {
+    picoquic_quic_t* quic;
+    picoquic_cnx_t* cnx; /* Template connection */
+    fuzzer_ctx_t fuzz_ctx;
+    struct sockaddr_storage server_address;
+    uint32_t version;
+    uint8_t chello[PICOQUIC_MAX_PACKET_SIZE]; /* Frames of the first Initial, in clear text */
+    size_t chello_length;
+    uint64_t nb_sent;
+    uint64_t nb_send_errors;
+    uint64_t nb_received;
+    uint64_t nb_replies[fuzi_q_reply_max];
+    picoquic_connection_id_t first_icid[fuzi_q_reply_max];
+} fuzi_q_blaster_t;
+
+fuzi_q_reply_enum fuzi_q_blaster_classify(const uint8_t* bytes, size_t length, uint8_t short_cid_length,
+    picoquic_connection_id_t* dcid);
+int fuzi_q_blaster_mutate(fuzzer_prng_t* prng, uint8_t* frames, size_t length);
+size_t fuzi_q_blaster_packet(fuzi_q_blaster_t* blaster, picoquic_connection_id_t* icid, fuzzer_prng_t* prng,
+    uint8_t* bytes, size_t bytes_max);
+int fuzi_q_blast(const char* ip_address_text, int server_port, picoquic_quic_config_t* config,
+    size_t nb_initials, uint64_t duration_max, picoquic_connection_id_t* init_cid);
+
+/* Stateless responses in server mode.
+ * One client Initial out of ratio is answered with a synthesized Version
+ * Negotiation or Retry packet, which is then mutated, and the Initial is
+ * dropped without creating a connection. The choice depends only on the
+ * DCID of the Initial, so retransmissions get the same response.
+ */
+#define FUZI_Q_STATELESS_TOKEN_MAX 48
+#define FUZI_Q_STATELESS_NB_VERSIONS 8
+
+typedef struct st_fuzi_q_stateless_t {
+    uint32_t ratio; /* 0 if disabled */
+    void* retry_aead[FUZI_Q_STATELESS_NB_VERSIONS]; /* Retry integrity contexts, per version index */
+    uint64_t nb_initials;
+    uint64_t nb_vn;
+    uint64_t nb_retry;
+} fuzi_q_stateless_t;
+
+size_t version_negotiation_packet_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, size_t vn_header_len, size_t current_length, size_t bytes_max);
+size_t retry_packet_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, size_t current_length, size_t bytes_max);
+size_t fuzi_q_stateless_vn(fuzzer_prng_t* prng, uint32_t version, const picoquic_connection_id_t* dcid,
+    const picoquic_connection_id_t* scid, uint8_t* bytes, size_t bytes_max);
+size_t fuzi_q_stateless_retry(fuzzer_prng_t* prng, void* retry_aead, uint32_t version, const picoquic_connection_id_t* dcid,
+    const picoquic_connection_id_t* scid, uint8_t* bytes, size_t bytes_max);
+size_t fuzi_q_stateless_response(fuzi_q_stateless_t* stateless, const uint8_t* bytes, size_t length,
+    uint8_t* response, size_t response_max);
+void fuzi_q_stateless_release(fuzi_q_stateless_t* stateless);
+
+/* Migration trials.
+ * The plan of each client connection is derived from its ICID: no
+ * migration, a NAT rebinding of the local port, or the probe of a new
+ * path from a new local port, at some delay after the handshake. The
+ * packet loop moves the socket, so a rebinding also applies to the other
+ * connections of the client.
+ */
+#define FUZI_Q_MIGRATION_DELAY_MAX 200000 /* 200 ms after the handshake */
+
+typedef enum {
+    fuzi_q_migration_none = 0,
+    fuzi_q_migration_nat, /* New local port, as after a NAT rebinding */
+    fuzi_q_migration_probe, /* Probe a new path from a new local port */
+    fuzi_q_migration_done
+} fuzi_q_migration_enum;
+
+void fuzi_q_migration_plan(const picoquic_connection_id_t* icid, fuzi_q_migration_enum* mode, uint64_t* delay);
+
+/* Multipath trials.
+ * When more than one path is requested, the client negotiates multipath
+ * and opens the additional paths from other loopback addresses, with the
+ * same local port. It then marks the last path as backup, as available
+ * again, and finally abandons it, so that the PATH_BACKUP, PATH_AVAILABLE
+ * and PATH_ABANDON frames can be fuzzed with the IDs of live paths.
+ */
+#define FUZI_Q_MULTIPATH_NB_PATHS_MAX 8
+#define FUZI_Q_MULTIPATH_STEP_DELAY 50000 /* 50 ms between path status changes */
+
+typedef enum {
+    fuzi_q_multipath_open = 0,
+    fuzi_q_multipath_backup,
+    fuzi_q_multipath_available,
+    fuzi_q_multipath_abandon,
+    fuzi_q_multipath_done
+} fuzi_q_multipath_enum;
+
+int fuzi_q_multipath_local_address(const struct sockaddr* first_local, size_t rank, struct sockaddr_storage* local_addr);
+
+/* Key update trials.
+ * The plan is also derived from the ICID: no update, a single update,
+ * a burst of updates started as soon as the previous one completes, or
+ * an update while packets are being lost. After each update, the key
+ * phase bit of the next short header packets may be flipped, so that
+ * the peer tries the other keys before discarding them.
+ */
+#define FUZI_Q_KEY_UPDATE_DELAY_MAX 200000 /* 200 ms after the handshake */
+#define FUZI_Q_KEY_UPDATE_BURST 4
+#define FUZZER_KEY_PHASE_FLIP_PACKETS 4
+
+typedef enum {
+    fuzi_q_key_update_none = 0,
+    fuzi_q_key_update_single,
+    fuzi_q_key_update_burst,
+    fuzi_q_key_update_loss, /* Update when packets are retransmitted or fuzzed */
+    fuzi_q_key_update_max
+} fuzi_q_key_update_enum;
+
+void fuzi_q_key_update_plan(const picoquic_connection_id_t* icid, fuzi_q_key_update_enum* mode, uint64_t* delay);
+
+/* Client scenarios generated from the ICID, used when no scenario is
+ * specified. Each connection gets its own set of streams.
+ */
+#define FUZI_Q_SCENARIO_STREAMS_MAX 12
+#define FUZI_Q_SCENARIO_REPEAT_MAX 3
+#define FUZI_Q_SCENARIO_SIZE_LOG_MAX 20 /* Documents and posts below 1MB */
+#define FUZI_Q_SCENARIO_NAME_MAX 16
+
+typedef struct st_fuzi_q_scenario_t {
+    size_t nb_streams;
+    picoquic_demo_stream_desc_t streams[FUZI_Q_SCENARIO_STREAMS_MAX];
+    char doc_name[FUZI_Q_SCENARIO_STREAMS_MAX][FUZI_Q_SCENARIO_NAME_MAX];
+    char f_name[FUZI_Q_SCENARIO_STREAMS_MAX][FUZI_Q_SCENARIO_NAME_MAX];
+} fuzi_q_scenario_t;
+
+int fuzi_q_scenario_generate(const picoquic_connection_id_t* icid, fuzi_q_scenario_t* scenario);
+
 /* Unification of initial and basic fuzzer
  * TODO: merge the two mechanisms in a single state
  */
@@ -145,6 +760,26 @@ typedef struct st_fuzi_q_cnx_ctx_t {
     int zero_rtt_available;
     int success_observed;
     int was_fuzzed;
+    /* Additional fuzz trials hosted by the connection after the handshake */
+    size_t nb_trials;
+    /* Buffers kept by the slot from one connection to the next: the copy
+     * of the scenario shifted for the trials, and the generated scenario */
+    picoquic_demo_stream_desc_t* trial_sc;
+    size_t trial_sc_max;
+    fuzi_q_scenario_t* scenario;
+    /* Migration planned from the ICID, the time is set when the handshake completes */
+    fuzi_q_migration_enum migration_mode;
+    uint64_t migration_delay;
+    uint64_t migration_time;
+    /* Key updates planned from the ICID */
+    fuzi_q_key_update_enum key_update_mode;
+    uint64_t key_update_delay;
+    uint64_t key_update_time;
+    int nb_key_updates_left;
+    /* Progress of the multipath trial */
+    fuzi_q_multipath_enum multipath_step;
+    uint64_t multipath_time;
+    size_t nb_paths_opened;
 } fuzi_q_cnx_ctx_t;
 
 typedef struct st_fuzi_q_ctx_t {
@@ -161,6 +796,7 @@ typedef struct st_fuzi_q_ctx_t {
     char const* client_scenario_text;
     size_t client_sc_nb;
     picoquic_demo_stream_desc_t* client_sc;
+    int generate_scenario;
     uint64_t end_of_time;
     uint64_t up_time_interval;
     uint64_t next_success_time;
@@ -168,6 +804,7 @@ typedef struct st_fuzi_q_ctx_t {
     size_t nb_cnx_ctx;
     size_t nb_cnx_tried;
     size_t nb_cnx_required;
+    size_t trials_per_cnx;
     uint32_t proposed_version;
     uint32_t desired_version;
     int is_quicperf;
@@ -175,17 +812,40 @@ typedef struct st_fuzi_q_ctx_t {
     uint64_t cnx_duration_min;
     uint64_t cnx_duration_max;
     picoquic_connection_id_t icid_duration_max;
+    fuzi_q_rate_ctl_t rate_ctl;
+    /* Liveness probe: an unfuzzed connection kept alive with PINGs.
+     * Its CIDs come from a separate generator, so that the restarts of
+     * the probe do not shift the sequence of fuzzed ICIDs */
+    uint64_t probe_interval;
+    fuzi_q_cnx_ctx_t probe_ctx;
+    fuzzer_prng_t probe_prng;
+    uint64_t server_down_time;
+    /* Replay of selected connections, for triage */
+    size_t replay_next;
+    /* Connection waiting for the new local address to probe a new path */
+    fuzi_q_cnx_ctx_t* migration_cnx;
+    size_t nb_key_updates;
+    /* Number of paths of each connection, multipath is negotiated if more than 1 */
+    size_t nb_paths;
+    size_t nb_paths_added;
+    /* If set, the suspect connections are also listed there when the server goes down */
+    FILE* crash_log;
+    /* Persistence of the fuzzing profile */
+    char const* profile_file;
+    char profile_key[FUZI_Q_PROFILE_KEY_MAX];
+    /* Stateless VN and Retry responses, in server mode */
+    fuzi_q_stateless_t stateless;
     /* Management of fuzzing. */
     fuzzer_ctx_t fuzz_ctx;
 } fuzi_q_ctx_t;
 
-int fuzi_q_server(fuzi_q_mode_enum fuzz_mode, picoquic_quic_config_t* config, uint64_t duration_max);
-int fuzi_q_client(fuzi_q_mode_enum fuzz_mode, const char* ip_address_text, int server_port,
-    picoquic_quic_config_t* config, size_t nb_cnx_required, uint64_t duration_max,
-    picoquic_connection_id_t* init_cid, char const* client_scenario_text);
+int fuzi_q_server(fuzi_q_mode_enum fuzz_mode, picoquic_quic_config_t* config, uint64_t duration_max,
+    char const* profile_file, uint32_t stateless_ratio);
+int fuzi_q_client(const fuzi_q_client_options_t* options);
 void fuzi_q_release_client_context(fuzi_q_ctx_t* fuzi_q_ctx);
 void fuzi_q_mark_active(fuzi_q_ctx_t* fuzi_q_ctx, picoquic_connection_id_t* icid, uint64_t current_time, int was_fuzzed);
 uint64_t fuzi_q_next_time(fuzi_q_ctx_t* fuzi_q_ctx);
+void fuzi_q_check_time(fuzi_q_ctx_t* fuzi_q_ctx, packet_loop_time_check_arg_t* time_check_arg);
 int fuzi_q_loop_check_cnx(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time, int * is_active);
 void fuzzer_random_cid(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid);
 
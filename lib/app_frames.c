@@ -0,0 +1,206 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include <picoquic_internal.h>
+#include "fuzi_q.h"
+
+/* Injection of application layer entries.
+ *
+ * The entries are wrapped in a STREAM frame, either on a stream already
+ * used by the connection, at the offset where the sender stopped, or on
+ * the next stream of the expected type. New unidirectional streams start
+ * with the HTTP/3 stream type. HTTP/3 clients open the control stream
+ * first, then the QPACK encoder and decoder streams, which is how the
+ * unidirectional streams of a connection are mapped to their role.
+ */
+
+fuzi_q_layer_enum fuzi_q_frame_layer(const fuzi_q_frames_t* frame)
+{
+    char const* name = frame->name;
+    fuzi_q_layer_enum layer = fuzi_q_layer_quic;
+
+    if (strncmp(name, "test_", 5) == 0) {
+        name += 5;
+    }
+    if (strncmp(name, "h3_", 3) == 0) {
+        uint64_t h3_frame_type = 0;
+
+        layer = fuzi_q_layer_h3_request;
+        if (picoquic_frames_varint_decode(frame->val, frame->val + frame->len, &h3_frame_type) != NULL) {
+            switch (h3_frame_type) {
+            case FUZZER_H3_FRAME_CANCEL_PUSH:
+            case FUZZER_H3_FRAME_SETTINGS:
+            case FUZZER_H3_FRAME_GOAWAY:
+            case FUZZER_H3_FRAME_ORIGIN:
+            case FUZZER_H3_FRAME_MAX_PUSH_ID:
+            case FUZZER_H3_FRAME_PRIORITY_UPDATE_REQUEST:
+            case FUZZER_H3_FRAME_PRIORITY_UPDATE_PUSH:
+                layer = fuzi_q_layer_h3_control;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    else if (strncmp(name, "qpack_enc", 9) == 0) {
+        layer = fuzi_q_layer_qpack_encoder;
+    }
+    else if (strncmp(name, "qpack_dec", 9) == 0) {
+        layer = fuzi_q_layer_qpack_decoder;
+    }
+    else if (strncmp(name, "hpack_", 6) == 0) {
+        layer = fuzi_q_layer_hpack;
+    }
+    else if (strncmp(name, "ws_", 3) == 0) {
+        layer = fuzi_q_layer_websocket;
+    }
+    return layer;
+}
+
+/* Find the unidirectional stream of rank uni_rank opened by the local
+ * endpoint, or the stream that the endpoint would open for that rank.
+ */
+static void fuzzer_app_uni_stream(const fuzzer_cnx_memory_t* memory, int is_client, size_t uni_rank, fuzzer_memory_stream_t* stream)
+{
+    uint64_t stream_type_bits = (is_client) ? 2 : 3;
+    size_t nb_stored = (memory->nb_streams < FUZZER_MEMORY_NB_STREAMS) ? memory->nb_streams : FUZZER_MEMORY_NB_STREAMS;
+
+    stream->stream_id = stream_type_bits + 4 * uni_rank;
+    stream->offset = 0;
+    for (size_t i = 0; i < nb_stored; i++) {
+        if (memory->streams[i].stream_id == stream->stream_id) {
+            stream->offset = memory->streams[i].offset;
+            break;
+        }
+    }
+}
+
+/* Pick a bidirectional stream in use, or the next one the endpoint would open */
+static void fuzzer_app_request_stream(fuzzer_prng_t* prng, const fuzzer_cnx_memory_t* memory, int is_client, fuzzer_memory_stream_t* stream)
+{
+    size_t nb_stored = (memory->nb_streams < FUZZER_MEMORY_NB_STREAMS) ? memory->nb_streams : FUZZER_MEMORY_NB_STREAMS;
+    uint64_t next_local = (is_client) ? 0 : 1;
+    size_t nb_bidir = 0;
+    size_t bidir[FUZZER_MEMORY_NB_STREAMS];
+
+    for (size_t i = 0; i < nb_stored; i++) {
+        uint64_t stream_id = memory->streams[i].stream_id;
+
+        if ((stream_id & 2) == 0) {
+            bidir[nb_bidir++] = i;
+            if ((stream_id & 3) == (next_local & 3) && stream_id >= next_local) {
+                next_local = stream_id + 4;
+            }
+        }
+    }
+    if (nb_bidir > 0 && fuzzer_prng_uniform(prng, 4) != 0) {
+        *stream = memory->streams[bidir[fuzzer_prng_uniform(prng, nb_bidir)]];
+    }
+    else {
+        stream->stream_id = next_local;
+        stream->offset = 0;
+    }
+}
+
+/* Write the entry in a STREAM frame, with the framing that the
+ * application layer expects. Returns the length of the STREAM frame,
+ * or 0 if it does not fit in bytes_max.
+ */
+size_t fuzzer_app_frame_wrap(fuzzer_prng_t* prng, const fuzzer_cnx_memory_t* memory, int is_client,
+    const fuzi_q_frames_t* frame, uint8_t* bytes, size_t bytes_max)
+{
+    fuzzer_memory_stream_t stream;
+    fuzzer_cnx_memory_t empty_memory;
+    uint8_t prefix[16];
+    uint8_t* prefix_end = prefix;
+    uint8_t* prefix_max = prefix + sizeof(prefix);
+    uint8_t* p = bytes;
+    uint8_t* p_max = bytes + bytes_max;
+    int stream_type = -1;
+    size_t payload_length;
+
+    if (memory == NULL) {
+        memset(&empty_memory, 0, sizeof(empty_memory));
+        memory = &empty_memory;
+    }
+
+    switch (fuzi_q_frame_layer(frame)) {
+    case fuzi_q_layer_h3_control:
+        fuzzer_app_uni_stream(memory, is_client, 0, &stream);
+        stream_type = FUZZER_H3_STREAM_CONTROL;
+        break;
+    case fuzi_q_layer_qpack_encoder:
+        fuzzer_app_uni_stream(memory, is_client, 1, &stream);
+        stream_type = FUZZER_H3_STREAM_QPACK_ENCODER;
+        break;
+    case fuzi_q_layer_qpack_decoder:
+        fuzzer_app_uni_stream(memory, is_client, 2, &stream);
+        stream_type = FUZZER_H3_STREAM_QPACK_DECODER;
+        break;
+    case fuzi_q_layer_hpack:
+        /* HEADERS frame, with an empty QPACK prefix: required insert count and base 0 */
+        fuzzer_app_request_stream(prng, memory, is_client, &stream);
+        prefix_end = picoquic_frames_varint_encode(prefix_end, prefix_max, FUZZER_H3_FRAME_HEADERS);
+        prefix_end = picoquic_frames_varint_encode(prefix_end, prefix_max, frame->len + 2);
+        if (prefix_end != NULL && prefix_end + 2 <= prefix_max) {
+            *prefix_end++ = 0;
+            *prefix_end++ = 0;
+        }
+        break;
+    case fuzi_q_layer_websocket:
+        fuzzer_app_request_stream(prng, memory, is_client, &stream);
+        prefix_end = picoquic_frames_varint_encode(prefix_end, prefix_max, FUZZER_H3_FRAME_DATA);
+        prefix_end = picoquic_frames_varint_encode(prefix_end, prefix_max, frame->len);
+        break;
+    default:
+        fuzzer_app_request_stream(prng, memory, is_client, &stream);
+        break;
+    }
+    if (stream_type >= 0 && stream.offset == 0) {
+        /* New unidirectional stream, starts with the stream type */
+        *prefix_end++ = (uint8_t)stream_type;
+    }
+    if (prefix_end == NULL) {
+        return 0;
+    }
+    payload_length = (prefix_end - prefix) + frame->len;
+
+    if (p < p_max) {
+        *p++ = picoquic_frame_type_stream_range_min | 4 | 2; /* Offset and length present */
+    }
+    p = picoquic_frames_varint_encode(p, p_max, stream.stream_id);
+    p = picoquic_frames_varint_encode(p, p_max, stream.offset);
+    p = picoquic_frames_varint_encode(p, p_max, payload_length);
+    if (p == NULL || p + payload_length > p_max) {
+        return 0;
+    }
+    memcpy(p, prefix, prefix_end - prefix);
+    p += prefix_end - prefix;
+    memcpy(p, frame->val, frame->len);
+    p += frame->len;
+
+    return p - bytes;
+}
@@ -0,0 +1,363 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <picoquic.h>
+#include <picoquic_internal.h>
+#include <picoquic_utils.h>
+#include <picosocks.h>
+#include <tls_api.h>
+#include "fuzi_q.h"
+
+/* Stateless Initial blaster.
+ *
+ * Creating a connection for each handshake trial costs a connection
+ * context, a TLS state and timers. In blast mode, the fuzzer creates a
+ * single template connection, captures the frames of its first Initial
+ * packet, and then for each ICID of the fuzzer sequence:
+ * - derives the Initial keys from the ICID, using the template,
+ * - mutates a copy of the ClientHello frames, with a PRNG seeded by the ICID,
+ * - builds and protects the Initial packet, and sends it.
+ * The ICID is used as both DCID and SCID, so the DCID of the replies
+ * identifies the Initial that elicited them.
+ */
+
+static char const* fuzi_q_reply_names[] = {
+    "initial", "0rtt", "handshake", "retry", "version_negotiation", "short_header", "other"
+};
+
+/* Capture the frames of the first Initial packet of the template */
+static uint32_t fuzi_q_blaster_capture(void* fuzz_ctx, picoquic_cnx_t* cnx,
+    uint8_t* bytes, size_t bytes_max, size_t length, size_t header_length)
+{
+    fuzi_q_blaster_t* blaster = (fuzi_q_blaster_t*)fuzz_ctx;
+
+    if (blaster->chello_length == 0 && (bytes[0] & 0x80) != 0 && length > header_length &&
+        length - header_length <= sizeof(blaster->chello)) {
+        blaster->chello_length = length - header_length;
+        memcpy(blaster->chello, bytes + header_length, blaster->chello_length);
+    }
+    return (uint32_t)length;
+}
+
+/* Classify a reply by the type of its first packet, and return its DCID */
+fuzi_q_reply_enum fuzi_q_blaster_classify(const uint8_t* bytes, size_t length, uint8_t short_cid_length,
+    picoquic_connection_id_t* dcid)
+{
+    fuzi_q_reply_enum reply = fuzi_q_reply_other;
+
+    memset(dcid, 0, sizeof(picoquic_connection_id_t));
+    if (length == 0) {
+        return reply;
+    }
+    if ((bytes[0] & 0x80) == 0) {
+        if (length >= (size_t)1 + short_cid_length && short_cid_length <= PICOQUIC_CONNECTION_ID_MAX_SIZE) {
+            memcpy(dcid->id, bytes + 1, short_cid_length);
+            dcid->id_len = short_cid_length;
+        }
+        reply = fuzi_q_reply_short_header;
+    }
+    else if (length >= 6 && bytes[5] <= PICOQUIC_CONNECTION_ID_MAX_SIZE && (size_t)6 + bytes[5] <= length) {
+        uint32_t version = PICOPARSE_32(bytes + 1);
+        int packet_type = (bytes[0] >> 4) & 3;
+
+        memcpy(dcid->id, bytes + 6, bytes[5]);
+        dcid->id_len = bytes[5];
+        if (version == 0) {
+            reply = fuzi_q_reply_version_negotiation;
+        }
+        else {
+            if (version == FUZI_Q_QUIC_V2_VERSION) {
+                /* QUIC v2 rotates the long header types by one */
+                packet_type = (packet_type + 3) & 3;
+            }
+            switch (packet_type) {
+            case 0:
+                reply = fuzi_q_reply_initial;
+                break;
+            case 1:
+                reply = fuzi_q_reply_zero_rtt;
+                break;
+            case 2:
+                reply = fuzi_q_reply_handshake;
+                break;
+            default:
+                reply = fuzi_q_reply_retry;
+                break;
+            }
+        }
+    }
+    return reply;
+}
+
+/* Mutate the ClientHello frames in place. Some Initials are sent intact,
+ * as a reference for the replies. The others see either a structural
+ * mutation of the CRYPTO frame, or a few bytes of the TLS message flipped.
+ * Returns 1 if the frames were modified.
+ */
+int fuzi_q_blaster_mutate(fuzzer_prng_t* prng, uint8_t* frames, size_t length)
+{
+    uint8_t* bytes = frames;
+    uint8_t* bytes_max = frames + length;
+    uint64_t data_length = 0;
+    uint64_t choice = fuzzer_prng_uniform(prng, 8);
+
+    /* Skip the padding and PING frames that may precede the CRYPTO frame */
+    while (bytes < bytes_max && (*bytes == picoquic_frame_type_padding || *bytes == picoquic_frame_type_ping)) {
+        bytes++;
+    }
+    if (choice == 0 || bytes >= bytes_max) {
+        return 0;
+    }
+    if (choice < 4 && *bytes == picoquic_frame_type_crypto_hs) {
+        return fuzzer_schema_mutate(prng, bytes, bytes_max);
+    }
+    if (*bytes == picoquic_frame_type_crypto_hs) {
+        bytes = (uint8_t*)picoquic_frames_varint_skip(bytes + 1, bytes_max);
+        bytes = (uint8_t*)picoquic_frames_varint_decode(bytes, bytes_max, &data_length);
+        if (bytes != NULL && data_length <= (uint64_t)(bytes_max - bytes)) {
+            bytes_max = bytes + data_length;
+        }
+    }
+    if (bytes == NULL || bytes >= bytes_max) {
+        return 0;
+    }
+    for (uint64_t i = 1 + fuzzer_prng_uniform(prng, 4); i > 0; i--) {
+        bytes[fuzzer_prng_uniform(prng, bytes_max - bytes)] ^= (uint8_t)(1 + fuzzer_prng_uniform(prng, 255));
+    }
+    return 1;
+}
+
+/* Build the protected Initial packet for the ICID. Returns the packet
+ * length, or 0 if the keys cannot be derived or the packet does not fit.
+ */
+size_t fuzi_q_blaster_packet(fuzi_q_blaster_t* blaster, picoquic_connection_id_t* icid, fuzzer_prng_t* prng,
+    uint8_t* bytes, size_t bytes_max)
+{
+    uint8_t frames[PICOQUIC_MAX_PACKET_SIZE];
+    picoquic_crypto_context_t* crypto = &blaster->cnx->crypto_context[picoquic_epoch_initial];
+    size_t frames_length = blaster->chello_length;
+    size_t checksum_length;
+    size_t header_length;
+    size_t pn_offset;
+    uint8_t mask[5] = { 0, 0, 0, 0, 0 };
+    uint8_t* p = bytes;
+
+    /* Derive the Initial keys from the DCID */
+    blaster->cnx->initial_cnxid = *icid;
+    picoquic_crypto_context_free(crypto);
+    if (picoquic_setup_initial_traffic_keys(blaster->cnx) != 0 || crypto->aead_encrypt == NULL || crypto->pn_enc == NULL) {
+        return 0;
+    }
+    checksum_length = picoquic_aead_get_checksum_length(crypto->aead_encrypt);
+    header_length = 1 + 4 + 1 + icid->id_len + 1 + icid->id_len + 1 + 2 + 4;
+    if (header_length + frames_length + checksum_length < FUZI_Q_BLAST_INITIAL_MIN) {
+        frames_length = FUZI_Q_BLAST_INITIAL_MIN - header_length - checksum_length;
+    }
+    if (frames_length > sizeof(frames) || header_length + frames_length + checksum_length > bytes_max) {
+        return 0;
+    }
+    memcpy(frames, blaster->chello, blaster->chello_length);
+    memset(frames + blaster->chello_length, 0, frames_length - blaster->chello_length);
+    (void)fuzi_q_blaster_mutate(prng, frames, frames_length);
+
+    /* Long header, Initial, 4 bytes packet number, no token */
+    *p++ = (blaster->version == FUZI_Q_QUIC_V2_VERSION) ? 0xd3 : 0xc3;
+    picoformat_32(p, blaster->version);
+    p += 4;
+    *p++ = icid->id_len;
+    memcpy(p, icid->id, icid->id_len);
+    p += icid->id_len;
+    *p++ = icid->id_len;
+    memcpy(p, icid->id, icid->id_len);
+    p += icid->id_len;
+    *p++ = 0;
+    picoformat_16(p, (uint16_t)(0x4000 | (4 + frames_length + checksum_length)));
+    p += 2;
+    pn_offset = p - bytes;
+    picoformat_32(p, 0);
+
+    /* Encrypt the frames, then protect the header with a sample taken 4 bytes after the packet number */
+    (void)picoquic_aead_encrypt_generic(bytes + header_length, frames, frames_length, 0, bytes, header_length, crypto->aead_encrypt);
+    picoquic_pn_encrypt(crypto->pn_enc, bytes + pn_offset + 4, mask, mask, 5);
+    bytes[0] ^= mask[0] & 0x0f;
+    for (size_t i = 0; i < 4; i++) {
+        bytes[pn_offset + i] ^= mask[1 + i];
+    }
+
+    return header_length + frames_length + checksum_length;
+}
+
+/* Read and classify the replies. The first read waits at most delta_t,
+ * the following ones do not wait. Returns the number of replies read.
+ */
+static size_t fuzi_q_blaster_receive(fuzi_q_blaster_t* blaster, SOCKET_TYPE fd, int64_t delta_t)
+{
+    size_t nb_read = 0;
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    struct sockaddr_storage addr_from;
+    struct sockaddr_storage addr_dest;
+    int dest_if = 0;
+    unsigned char received_ecn = 0;
+    uint64_t current_time = 0;
+    int bytes_recv;
+
+    while ((bytes_recv = picoquic_select(&fd, 1, &addr_from, &addr_dest, &dest_if, &received_ecn,
+        buffer, sizeof(buffer), delta_t, &current_time)) > 0) {
+        picoquic_connection_id_t dcid;
+        fuzi_q_reply_enum reply = fuzi_q_blaster_classify(buffer, (size_t)bytes_recv, blaster->fuzz_ctx.next_cid.id_len, &dcid);
+
+        if (blaster->nb_replies[reply]++ == 0) {
+            blaster->first_icid[reply] = dcid;
+        }
+        blaster->nb_received++;
+        nb_read++;
+        delta_t = 0;
+    }
+    return nb_read;
+}
+
+/* Start the template connection and capture its ClientHello */
+static int fuzi_q_blaster_init(fuzi_q_blaster_t* blaster, picoquic_quic_config_t* config, char const* sni, uint64_t current_time)
+{
+    int ret = 0;
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    size_t length = 0;
+    struct sockaddr_storage addr_to;
+    struct sockaddr_storage addr_from;
+    int if_index = 0;
+
+    picoquic_set_fuzz(blaster->quic, fuzi_q_blaster_capture, blaster);
+    blaster->cnx = picoquic_create_cnx(blaster->quic, picoquic_null_connection_id, picoquic_null_connection_id,
+        (struct sockaddr*)&blaster->server_address, current_time, config->proposed_version,
+        (sni == NULL) ? PICOQUIC_TEST_SNI : sni, config->alpn, 1);
+    if (blaster->cnx == NULL) {
+        ret = -1;
+    }
+    else if ((ret = picoquic_start_client_cnx(blaster->cnx)) == 0) {
+        ret = picoquic_prepare_packet(blaster->cnx, current_time, buffer, sizeof(buffer), &length,
+            &addr_to, &addr_from, &if_index);
+    }
+    if (ret == 0 && blaster->chello_length == 0) {
+        fprintf(stdout, "Could not obtain the ClientHello of the template connection.\n");
+        ret = -1;
+    }
+    if (ret == 0) {
+        blaster->version = picoquic_supported_versions[blaster->cnx->version_index].version;
+    }
+    return ret;
+}
+
+int fuzi_q_blast(const char* ip_address_text, int server_port, picoquic_quic_config_t* config,
+    size_t nb_initials, uint64_t duration_max, picoquic_connection_id_t* init_cid)
+{
+    int ret = 0;
+    uint64_t current_time = picoquic_current_time();
+    uint64_t start_time = current_time;
+    uint64_t end_of_time = (duration_max == 0) ? UINT64_MAX : current_time + duration_max * 1000000;
+    uint64_t nb_required = (nb_initials == 0) ? UINT64_MAX : (uint64_t)nb_initials;
+    fuzi_q_blaster_t* blaster = (fuzi_q_blaster_t*)malloc(sizeof(fuzi_q_blaster_t));
+    SOCKET_TYPE fd = INVALID_SOCKET;
+    int is_name = 0;
+
+    if (blaster == NULL) {
+        return -1;
+    }
+    memset(blaster, 0, sizeof(fuzi_q_blaster_t));
+
+    ret = picoquic_get_server_address(ip_address_text, server_port, &blaster->server_address, &is_name);
+    if (ret == 0) {
+        char const* sni = (config->sni == NULL && is_name != 0) ? ip_address_text : config->sni;
+
+        if ((blaster->quic = picoquic_create_and_configure(config, NULL, NULL, current_time, NULL)) == NULL) {
+            ret = -1;
+        }
+        else {
+            fuzi_q_fuzzer_init(&blaster->fuzz_ctx, init_cid, blaster->quic);
+            ret = fuzi_q_blaster_init(blaster, config, sni, current_time);
+        }
+    }
+    if (ret == 0 && (fd = picoquic_open_client_socket(blaster->server_address.ss_family)) == INVALID_SOCKET) {
+        fprintf(stdout, "Cannot open the blaster socket.\n");
+        ret = -1;
+    }
+
+    while (ret == 0 && blaster->nb_sent < nb_required && current_time < end_of_time) {
+        uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+        struct sockaddr_storage addr_from = { 0 };
+
+        for (int i = 0; ret == 0 && i < FUZI_Q_BLAST_BURST && blaster->nb_sent < nb_required; i++) {
+            picoquic_connection_id_t icid;
+            fuzzer_prng_t prng;
+            size_t length;
+            int sock_err = 0;
+
+            fuzzer_random_cid(&blaster->fuzz_ctx, &icid);
+            fuzzer_prng_seed(&prng, fuzzer_icid_random_seed(&icid, 0));
+            if ((length = fuzi_q_blaster_packet(blaster, &icid, &prng, buffer, sizeof(buffer))) == 0) {
+                fprintf(stdout, "Cannot build the Initial packet.\n");
+                ret = -1;
+            }
+            else if (picoquic_send_through_socket(fd, (struct sockaddr*)&blaster->server_address,
+                (struct sockaddr*)&addr_from, 0, (const char*)buffer, (int)length, &sock_err) <= 0) {
+                blaster->nb_send_errors++;
+            }
+            blaster->nb_sent++;
+        }
+        (void)fuzi_q_blaster_receive(blaster, fd, 0);
+        current_time = picoquic_current_time();
+    }
+
+    if (fd != INVALID_SOCKET) {
+        /* Collect the late replies */
+        uint64_t drain_time = picoquic_current_time() + FUZI_Q_BLAST_DRAIN_DELAY;
+
+        current_time = picoquic_current_time();
+        while (current_time < drain_time && fuzi_q_blaster_receive(blaster, fd, (int64_t)(drain_time - current_time)) > 0) {
+            current_time = picoquic_current_time();
+        }
+        SOCKET_CLOSE(fd);
+    }
+
+    fprintf(stdout, "Sent %" PRIu64 " Initials in %fs, %" PRIu64 " send errors, %" PRIu64 " replies.\n",
+        blaster->nb_sent, ((double)(current_time - start_time)) / 1000000.0, blaster->nb_send_errors, blaster->nb_received);
+    for (int i = 0; i < fuzi_q_reply_max; i++) {
+        if (blaster->nb_replies[i] > 0) {
+            fprintf(stdout, "    %s: %" PRIu64 ", first ICID: ", fuzi_q_reply_names[i], blaster->nb_replies[i]);
+            for (uint8_t x = 0; x < blaster->first_icid[i].id_len; x++) {
+                fprintf(stdout, "%02x", blaster->first_icid[i].id[x]);
+            }
+            fprintf(stdout, "\n");
+        }
+    }
+
+    if (blaster->quic != NULL) {
+        picoquic_free(blaster->quic);
+        fuzi_q_fuzzer_release(&blaster->fuzz_ctx);
+    }
+    free(blaster);
+
+    return ret;
+}
@@ -0,0 +1,285 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Capture of the packets of fuzzed connections.
+ *
+ * The fuzzer sees the packets after they are formatted and before they
+ * are encrypted. The capture keeps the last packets of each connection,
+ * both as formatted and as fuzzed, in a ring taken from a pool that is
+ * allocated when the capture is enabled. Capturing a packet is a copy to
+ * the next slot of the ring: there is no allocation and no lock, since
+ * the fuzzer runs in the network thread.
+ *
+ * When a connection ends abnormally, its ring is written in pcapng format,
+ * one block per packet image with a comment giving the trial, the packet
+ * rank and whether this is the original or the fuzzed image. The images
+ * are not encrypted, so they use the "user 0" link type. If the key log
+ * named by SSLKEYLOGFILE is available, it is added as a decryption secrets
+ * block, so the file can be correlated with an encrypted capture.
+ */
+
+#define FUZZER_PCAPNG_SHB 0x0A0D0D0Au
+#define FUZZER_PCAPNG_IDB 0x00000001u
+#define FUZZER_PCAPNG_EPB 0x00000006u
+#define FUZZER_PCAPNG_DSB 0x0000000Au
+#define FUZZER_PCAPNG_BYTE_ORDER 0x1A2B3C4Du
+#define FUZZER_PCAPNG_LINKTYPE_USER0 147
+#define FUZZER_PCAPNG_TLS_KEY_LOG 0x544c534bu
+#define FUZZER_PCAPNG_OPT_COMMENT 1
+
+int fuzzer_capture_init(fuzzer_ctx_t* ctx, size_t nb_rings)
+{
+    int ret = 0;
+
+    ctx->capture_pool = (fuzzer_capture_t*)malloc(sizeof(fuzzer_capture_t) * nb_rings);
+    if (ctx->capture_pool == NULL) {
+        ret = -1;
+    }
+    else {
+        ctx->capture_free = NULL;
+        for (size_t i = nb_rings; i > 0; i--) {
+            ctx->capture_pool[i - 1].next_free = ctx->capture_free;
+            ctx->capture_free = &ctx->capture_pool[i - 1];
+        }
+    }
+    return ret;
+}
+
+void fuzzer_capture_release(fuzzer_ctx_t* ctx)
+{
+    if (ctx->capture_pool != NULL) {
+        free(ctx->capture_pool);
+        ctx->capture_pool = NULL;
+    }
+    ctx->capture_free = NULL;
+}
+
+/* If the pool is exhausted, the connection is simply not captured */
+void fuzzer_capture_attach(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx)
+{
+    if (icid_ctx->capture == NULL && ctx->capture_free != NULL) {
+        icid_ctx->capture = ctx->capture_free;
+        ctx->capture_free = icid_ctx->capture->next_free;
+        icid_ctx->capture->next_free = NULL;
+        icid_ctx->capture->nb_packets = 0;
+    }
+}
+
+void fuzzer_capture_detach(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx)
+{
+    if (icid_ctx->capture != NULL) {
+        icid_ctx->capture->next_free = ctx->capture_free;
+        ctx->capture_free = icid_ctx->capture;
+        icid_ctx->capture = NULL;
+    }
+}
+
+fuzzer_capture_packet_t* fuzzer_capture_original(fuzzer_icid_ctx_t* icid_ctx, uint64_t current_time,
+    uint8_t* bytes, size_t length)
+{
+    fuzzer_capture_t* capture = icid_ctx->capture;
+    fuzzer_capture_packet_t* packet = &capture->packets[capture->nb_packets % FUZZER_CAPTURE_RING_SIZE];
+
+    if (length > PICOQUIC_MAX_PACKET_SIZE) {
+        length = PICOQUIC_MAX_PACKET_SIZE;
+    }
+    packet->time = current_time;
+    packet->packet_rank = icid_ctx->packet_rank;
+    packet->trial_rank = (uint32_t)icid_ctx->trial_rank;
+    packet->length = (uint16_t)length;
+    packet->fuzzed_length = 0;
+    memcpy(packet->original, bytes, length);
+    capture->nb_packets++;
+
+    return packet;
+}
+
+void fuzzer_capture_fuzzed(fuzzer_capture_packet_t* packet, uint8_t* bytes, size_t fuzzed_length, int fuzzed)
+{
+    if (fuzzed) {
+        if (fuzzed_length > PICOQUIC_MAX_PACKET_SIZE) {
+            fuzzed_length = PICOQUIC_MAX_PACKET_SIZE;
+        }
+        packet->fuzzed_length = (uint16_t)fuzzed_length;
+        memcpy(packet->fuzzed, bytes, fuzzed_length);
+    }
+}
+
+/* Blocks are written in host byte order, as announced by the byte order
+ * magic of the section header.
+ */
+static int fuzzer_pcapng_write_u32(FILE* F, uint32_t v)
+{
+    return (fwrite(&v, sizeof(v), 1, F) == 1) ? 0 : -1;
+}
+
+static int fuzzer_pcapng_write_padded(FILE* F, uint8_t const* data, size_t length)
+{
+    uint8_t zeroes[4] = { 0 };
+    size_t padding = (4 - (length & 3)) & 3;
+
+    return ((length == 0 || fwrite(data, 1, length, F) == length) &&
+        (padding == 0 || fwrite(zeroes, 1, padding, F) == padding)) ? 0 : -1;
+}
+
+static size_t fuzzer_pcapng_padded_length(size_t length)
+{
+    return (length + 3) & ~((size_t)3);
+}
+
+static int fuzzer_pcapng_write_headers(FILE* F)
+{
+    uint16_t version[2] = { 1, 0 };
+    uint16_t link_type[2] = { FUZZER_PCAPNG_LINKTYPE_USER0, 0 };
+    int64_t section_length = -1;
+    int ret = 0;
+
+    /* Section header block */
+    ret |= fuzzer_pcapng_write_u32(F, FUZZER_PCAPNG_SHB);
+    ret |= fuzzer_pcapng_write_u32(F, 28);
+    ret |= fuzzer_pcapng_write_u32(F, FUZZER_PCAPNG_BYTE_ORDER);
+    ret |= (fwrite(version, sizeof(version), 1, F) == 1) ? 0 : -1;
+    ret |= (fwrite(&section_length, sizeof(section_length), 1, F) == 1) ? 0 : -1;
+    ret |= fuzzer_pcapng_write_u32(F, 28);
+    /* Interface description block, microsecond timestamps by default */
+    ret |= fuzzer_pcapng_write_u32(F, FUZZER_PCAPNG_IDB);
+    ret |= fuzzer_pcapng_write_u32(F, 20);
+    ret |= (fwrite(link_type, sizeof(link_type), 1, F) == 1) ? 0 : -1;
+    ret |= fuzzer_pcapng_write_u32(F, 0);
+    ret |= fuzzer_pcapng_write_u32(F, 20);
+
+    return ret;
+}
+
+/* Add the content of the key log file, if there is one */
+static int fuzzer_pcapng_write_secrets(FILE* F)
+{
+    int ret = 0;
+    char const* key_log_file = getenv("SSLKEYLOGFILE");
+    FILE* K = (key_log_file == NULL) ? NULL : picoquic_file_open(key_log_file, "r");
+
+    if (K != NULL) {
+        uint8_t* secrets = (uint8_t*)malloc(FUZZER_CAPTURE_SECRETS_MAX);
+
+        if (secrets != NULL) {
+            size_t length = fread(secrets, 1, FUZZER_CAPTURE_SECRETS_MAX, K);
+
+            if (length > 0) {
+                uint32_t block_length = (uint32_t)(20 + fuzzer_pcapng_padded_length(length));
+
+                ret |= fuzzer_pcapng_write_u32(F, FUZZER_PCAPNG_DSB);
+                ret |= fuzzer_pcapng_write_u32(F, block_length);
+                ret |= fuzzer_pcapng_write_u32(F, FUZZER_PCAPNG_TLS_KEY_LOG);
+                ret |= fuzzer_pcapng_write_u32(F, (uint32_t)length);
+                ret |= fuzzer_pcapng_write_padded(F, secrets, length);
+                ret |= fuzzer_pcapng_write_u32(F, block_length);
+            }
+            free(secrets);
+        }
+        (void)picoquic_file_close(K);
+    }
+    return ret;
+}
+
+static int fuzzer_pcapng_write_packet(FILE* F, uint64_t time, uint8_t const* bytes, size_t length, char const* comment)
+{
+    int ret = 0;
+    size_t comment_length = strlen(comment);
+    uint16_t comment_option[2] = { FUZZER_PCAPNG_OPT_COMMENT, (uint16_t)comment_length };
+    uint32_t end_of_options = 0;
+    uint32_t block_length = (uint32_t)(32 + fuzzer_pcapng_padded_length(length) +
+        4 + fuzzer_pcapng_padded_length(comment_length) + 4);
+
+    ret |= fuzzer_pcapng_write_u32(F, FUZZER_PCAPNG_EPB);
+    ret |= fuzzer_pcapng_write_u32(F, block_length);
+    ret |= fuzzer_pcapng_write_u32(F, 0);
+    ret |= fuzzer_pcapng_write_u32(F, (uint32_t)(time >> 32));
+    ret |= fuzzer_pcapng_write_u32(F, (uint32_t)time);
+    ret |= fuzzer_pcapng_write_u32(F, (uint32_t)length);
+    ret |= fuzzer_pcapng_write_u32(F, (uint32_t)length);
+    ret |= fuzzer_pcapng_write_padded(F, bytes, length);
+    ret |= (fwrite(comment_option, sizeof(comment_option), 1, F) == 1) ? 0 : -1;
+    ret |= fuzzer_pcapng_write_padded(F, (uint8_t const*)comment, comment_length);
+    ret |= fuzzer_pcapng_write_u32(F, end_of_options);
+    ret |= fuzzer_pcapng_write_u32(F, block_length);
+
+    return ret;
+}
+
+int fuzzer_capture_write(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, char const* reason)
+{
+    int ret = 0;
+    fuzzer_capture_t* capture = icid_ctx->capture;
+    char icid_text[2 * PICOQUIC_CONNECTION_ID_MAX_SIZE + 1];
+    char file_name[512];
+    char comment[256];
+    FILE* F = NULL;
+
+    if (capture == NULL || capture->nb_packets == 0) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < icid_ctx->icid.id_len; i++) {
+        (void)picoquic_sprintf(icid_text + 2 * i, 3, NULL, "%02x", icid_ctx->icid.id[i]);
+    }
+    icid_text[2 * icid_ctx->icid.id_len] = 0;
+
+    if (picoquic_sprintf(file_name, sizeof(file_name), NULL, "%s%s%s.fuzi.pcapng",
+        (ctx->event_dir == NULL) ? "" : ctx->event_dir, (ctx->event_dir == NULL) ? "" : PICOQUIC_FILE_SEPARATOR,
+        icid_text) != 0 || (F = picoquic_file_open(file_name, "wb")) == NULL) {
+        ret = -1;
+    }
+    else {
+        size_t first = (capture->nb_packets > FUZZER_CAPTURE_RING_SIZE) ? capture->nb_packets - FUZZER_CAPTURE_RING_SIZE : 0;
+
+        ret = fuzzer_pcapng_write_headers(F);
+        if (ret == 0) {
+            ret = fuzzer_pcapng_write_secrets(F);
+        }
+        for (size_t i = first; ret == 0 && i < capture->nb_packets; i++) {
+            fuzzer_capture_packet_t* packet = &capture->packets[i % FUZZER_CAPTURE_RING_SIZE];
+
+            (void)picoquic_sprintf(comment, sizeof(comment), NULL, "%s trial %u packet %llu original (%s)",
+                icid_text, packet->trial_rank, (unsigned long long)packet->packet_rank, reason);
+            ret = fuzzer_pcapng_write_packet(F, packet->time, packet->original, packet->length, comment);
+            if (ret == 0 && packet->fuzzed_length > 0) {
+                (void)picoquic_sprintf(comment, sizeof(comment), NULL, "%s trial %u packet %llu fuzzed (%s)",
+                    icid_text, packet->trial_rank, (unsigned long long)packet->packet_rank, reason);
+                ret = fuzzer_pcapng_write_packet(F, packet->time, packet->fuzzed, packet->fuzzed_length, comment);
+            }
+        }
+        (void)picoquic_file_close(F);
+        ctx->nb_capture_files++;
+        /* Do not write the same packets twice */
+        capture->nb_packets = 0;
+    }
+
+    return ret;
+}
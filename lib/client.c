@@ -53,9 +53,15 @@
  * when the client is created.
  */
 
-/* Clear a connection context */
+/* Clear a connection context. The buffers of the slot are kept for the
+ * next connection, they are only freed by fuzi_q_delete_connection_slot.
+ */
 void fuzi_q_release_connection(fuzi_q_cnx_ctx_t* cnx_ctx)
 {
+    picoquic_demo_stream_desc_t* trial_sc = cnx_ctx->trial_sc;
+    size_t trial_sc_max = cnx_ctx->trial_sc_max;
+    fuzi_q_scenario_t* scenario = cnx_ctx->scenario;
+
     if (cnx_ctx->quicperf_ctx != NULL) {
         quicperf_delete_ctx(cnx_ctx->quicperf_ctx);
     }
@@ -64,6 +70,36 @@ void fuzi_q_release_connection(fuzi_q_cnx_ctx_t* cnx_ctx)
         picoquic_delete_cnx(cnx_ctx->cnx_client);
     }
     memset(cnx_ctx, 0, sizeof(fuzi_q_cnx_ctx_t));
+    cnx_ctx->trial_sc = trial_sc;
+    cnx_ctx->trial_sc_max = trial_sc_max;
+    cnx_ctx->scenario = scenario;
+}
+
+static void fuzi_q_delete_connection_slot(fuzi_q_cnx_ctx_t* cnx_ctx)
+{
+    fuzi_q_release_connection(cnx_ctx);
+    if (cnx_ctx->trial_sc != NULL) {
+        /* The trial scenario is a shallow copy, the strings belong to the main scenario */
+        free(cnx_ctx->trial_sc);
+    }
+    if (cnx_ctx->scenario != NULL) {
+        free(cnx_ctx->scenario);
+    }
+    memset(cnx_ctx, 0, sizeof(fuzi_q_cnx_ctx_t));
+}
+
+/* Prepare the callback context of a connection, of a trial or of the probe */
+static int fuzi_q_init_callback_ctx(fuzi_q_ctx_t* fuzi_q_ctx, picoquic_demo_callback_ctx_t* callback_ctx,
+    picoquic_demo_stream_desc_t const* sc, size_t sc_nb, uint64_t current_time)
+{
+    int ret = picoquic_demo_client_initialize_context(callback_ctx, sc, sc_nb, NULL, 1, 0);
+
+    if (ret == 0) {
+        callback_ctx->out_dir = fuzi_q_ctx->out_dir;
+        callback_ctx->no_print = 1;
+        callback_ctx->last_interaction_time = current_time;
+    }
+    return ret;
 }
 
 /* Mark connection active */
@@ -88,8 +124,13 @@ int fuzi_q_start_connection(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx,
     uint32_t proposed_version = fuzi_q_ctx->proposed_version;
     char const* ticket_alpn = NULL;
     uint32_t ticket_version = 0;
-    /* Create a predictable and random ICID */
-    fuzzer_random_cid(&fuzi_q_ctx->fuzz_ctx, &cnx_ctx->icid);
+    /* Create a predictable and random ICID, or use the next ICID to replay */
+    if (fuzi_q_ctx->fuzz_ctx.replay != NULL) {
+        cnx_ctx->icid = fuzi_q_ctx->fuzz_ctx.replay->targets[fuzi_q_ctx->replay_next++].icid;
+    }
+    else {
+        fuzzer_random_cid(&fuzi_q_ctx->fuzz_ctx, &cnx_ctx->icid);
+    }
     /* Try pick the ALPN and version from tickets if there are any */
 
     if (picoquic_demo_client_get_alpn_and_version_from_tickets(fuzi_q_ctx->quic, PICOQUIC_TEST_SNI, alpn,
@@ -111,6 +152,9 @@ int fuzi_q_start_connection(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx,
     }
     else {
         if (fuzi_q_ctx->is_quicperf) {
+            /* The quicperf context keeps the parsed scenario with the state of
+             * the connection, and cannot be copied or reset: it is created,
+             * and the scenario parsed, for each connection. */
             cnx_ctx->quicperf_ctx = quicperf_create_ctx(fuzi_q_ctx->client_scenario_text, stderr);
             if (cnx_ctx->quicperf_ctx != NULL) {
                 picoquic_set_callback(cnx_ctx->cnx_client, quicperf_callback, cnx_ctx->quicperf_ctx);
@@ -120,12 +164,25 @@ int fuzi_q_start_connection(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx,
             }
         }
         else {
-            ret = picoquic_demo_client_initialize_context(&cnx_ctx->callback_ctx, fuzi_q_ctx->client_sc, fuzi_q_ctx->client_sc_nb,
-                NULL, 1, 0);
+            picoquic_demo_stream_desc_t const* sc = fuzi_q_ctx->client_sc;
+            size_t sc_nb = fuzi_q_ctx->client_sc_nb;
+
+            if (fuzi_q_ctx->generate_scenario) {
+                /* The generated scenario is stored in the slot, allocated for the first connection */
+                if (cnx_ctx->scenario == NULL &&
+                    (cnx_ctx->scenario = (fuzi_q_scenario_t*)malloc(sizeof(fuzi_q_scenario_t))) == NULL) {
+                    ret = -1;
+                }
+                else {
+                    ret = fuzi_q_scenario_generate(&cnx_ctx->icid, cnx_ctx->scenario);
+                    sc = cnx_ctx->scenario->streams;
+                    sc_nb = cnx_ctx->scenario->nb_streams;
+                }
+            }
+            if (ret == 0) {
+                ret = fuzi_q_init_callback_ctx(fuzi_q_ctx, &cnx_ctx->callback_ctx, sc, sc_nb, current_time);
+            }
             if (ret == 0) {
-                cnx_ctx->callback_ctx.out_dir = fuzi_q_ctx->out_dir;
-                cnx_ctx->callback_ctx.last_interaction_time = current_time;
-                cnx_ctx->callback_ctx.no_print = 1;
                 picoquic_set_callback(cnx_ctx->cnx_client, picoquic_demo_client_callback, &cnx_ctx->callback_ctx);
 
                 /* Requires TP grease and enable options for interop tests */
@@ -151,6 +208,17 @@ int fuzi_q_start_connection(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx,
             }
         }
 
+        if (ret == 0 && fuzi_q_ctx->fuzz_mode == fuzi_q_mode_client) {
+            fuzi_q_migration_plan(&cnx_ctx->icid, &cnx_ctx->migration_mode, &cnx_ctx->migration_delay);
+            if (fuzi_q_ctx->nb_paths > 1) {
+                /* The additional paths share the local port, which a migration would change */
+                cnx_ctx->migration_mode = fuzi_q_migration_none;
+            }
+            fuzi_q_key_update_plan(&cnx_ctx->icid, &cnx_ctx->key_update_mode, &cnx_ctx->key_update_delay);
+            cnx_ctx->nb_key_updates_left = (cnx_ctx->key_update_mode == fuzi_q_key_update_burst) ? FUZI_Q_KEY_UPDATE_BURST :
+                ((cnx_ctx->key_update_mode == fuzi_q_key_update_none) ? 0 : 1);
+        }
+
         if (ret == 0) {
             cnx_ctx->next_time = current_time + FUZI_Q_MAX_SILENCE;
             ret = picoquic_start_client_cnx(cnx_ctx->cnx_client);
@@ -167,7 +235,303 @@ int fuzi_q_start_connection(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx,
     return ret;
 }
 
-static const char* test_scenario_default = "0:index.html;4:test.html;8:/1234567;12:main.jpg;16:war-and-peace.txt;20:en/latest/;24:/file-123K";
+/* Plan the migration of a connection. The plan only depends on the ICID,
+ * so it is the same when the connection is replayed. Half of the
+ * connections do not migrate, the others either rebind their local port
+ * or probe a new path.
+ */
+void fuzi_q_migration_plan(const picoquic_connection_id_t* icid, fuzi_q_migration_enum* mode, uint64_t* delay)
+{
+    uint8_t migration_hash_seed[] = { 'm', 'i', 'g', 'r', 'a', 't', 'i', 'o', 'n', 0, 1, 2, 3, 4, 5, 6 };
+    fuzzer_prng_t prng;
+
+    fuzzer_prng_seed(&prng, picoquic_connection_id_hash(icid, migration_hash_seed));
+    switch (fuzzer_prng_uniform(&prng, 4)) {
+    case 0:
+        *mode = fuzi_q_migration_nat;
+        break;
+    case 1:
+        *mode = fuzi_q_migration_probe;
+        break;
+    default:
+        *mode = fuzi_q_migration_none;
+        break;
+    }
+    *delay = fuzzer_prng_uniform(&prng, FUZI_Q_MIGRATION_DELAY_MAX);
+}
+
+/* Plan the key updates of a connection, from the ICID as for migrations */
+void fuzi_q_key_update_plan(const picoquic_connection_id_t* icid, fuzi_q_key_update_enum* mode, uint64_t* delay)
+{
+    uint8_t key_update_hash_seed[] = { 'k', 'e', 'y', '_', 'u', 'p', 'd', 'a', 't', 'e', 0, 1, 2, 3, 4, 5 };
+    fuzzer_prng_t prng;
+
+    fuzzer_prng_seed(&prng, picoquic_connection_id_hash(icid, key_update_hash_seed));
+    switch (fuzzer_prng_uniform(&prng, 8)) {
+    case 0:
+    case 1:
+        *mode = fuzi_q_key_update_single;
+        break;
+    case 2:
+        *mode = fuzi_q_key_update_burst;
+        break;
+    case 3:
+        *mode = fuzi_q_key_update_loss;
+        break;
+    default:
+        *mode = fuzi_q_key_update_none;
+        break;
+    }
+    *delay = fuzzer_prng_uniform(&prng, FUZI_Q_KEY_UPDATE_DELAY_MAX);
+}
+
+/* Local address of the additional path of the specified rank. Only the
+ * IPv4 loopback network provides several local addresses without any
+ * configuration, so the function fails for other addresses.
+ */
+int fuzi_q_multipath_local_address(const struct sockaddr* first_local, size_t rank, struct sockaddr_storage* local_addr)
+{
+    int ret = -1;
+
+    if (first_local->sa_family == AF_INET && rank > 0 && rank < FUZI_Q_MULTIPATH_NB_PATHS_MAX) {
+        const struct sockaddr_in* first_local4 = (const struct sockaddr_in*)first_local;
+        uint32_t addr = ntohl(first_local4->sin_addr.s_addr);
+
+        if ((addr >> 24) == 127 && ((addr + (uint32_t)rank) >> 24) == 127) {
+            struct sockaddr_in* local4 = (struct sockaddr_in*)local_addr;
+
+            memset(local_addr, 0, sizeof(struct sockaddr_storage));
+            local4->sin_family = AF_INET;
+            local4->sin_port = first_local4->sin_port;
+            local4->sin_addr.s_addr = htonl(addr + (uint32_t)rank);
+            ret = 0;
+        }
+    }
+    return ret;
+}
+
+/* Find the next ICID to replay, skipping the targets that are other
+ * trials of an ICID already replayed. Returns 0 when the list is exhausted.
+ */
+static int fuzi_q_replay_has_next(fuzi_q_ctx_t* fuzi_q_ctx)
+{
+    fuzi_q_replay_t* replay = fuzi_q_ctx->fuzz_ctx.replay;
+
+    while (fuzi_q_ctx->replay_next < replay->nb_targets) {
+        int is_new = 1;
+
+        for (size_t i = 0; is_new && i < fuzi_q_ctx->replay_next; i++) {
+            if (picoquic_compare_connection_id(&replay->targets[i].icid,
+                &replay->targets[fuzi_q_ctx->replay_next].icid) == 0) {
+                is_new = 0;
+            }
+        }
+        if (is_new) {
+            break;
+        }
+        fuzi_q_ctx->replay_next++;
+    }
+    return fuzi_q_ctx->replay_next < replay->nb_targets;
+}
+
+/* Start the liveness probe.
+ * The probe is a connection that is never fuzzed and does not run the
+ * scenario. It is kept alive by sending PING frames every probe interval,
+ * so that a server crash is detected when the PINGs stop being acknowledged.
+ */
+int fuzi_q_probe_start(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time)
+{
+    int ret = 0;
+    fuzi_q_cnx_ctx_t* probe_ctx = &fuzi_q_ctx->probe_ctx;
+
+    /* Draw the probe ICID from its own generator, so runs remain repeatable */
+    picoformat_64(probe_ctx->icid.id, fuzzer_prng_next(&fuzi_q_ctx->probe_prng));
+    probe_ctx->icid.id_len = 8;
+    probe_ctx->cnx_client = picoquic_create_cnx(fuzi_q_ctx->quic, probe_ctx->icid, picoquic_null_connection_id,
+        (struct sockaddr*)&fuzi_q_ctx->server_address, current_time,
+        fuzi_q_ctx->proposed_version, PICOQUIC_TEST_SNI, fuzi_q_ctx->alpn, 1);
+
+    if (probe_ctx->cnx_client == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = fuzi_q_init_callback_ctx(fuzi_q_ctx, &probe_ctx->callback_ctx, NULL, 0, current_time);
+        if (ret == 0) {
+            picoquic_set_callback(probe_ctx->cnx_client, picoquic_demo_client_callback, &probe_ctx->callback_ctx);
+            picoquic_enable_keep_alive(probe_ctx->cnx_client, fuzi_q_ctx->probe_interval);
+            probe_ctx->next_time = current_time + FUZI_Q_MAX_SILENCE;
+            ret = picoquic_start_client_cnx(probe_ctx->cnx_client);
+        }
+    }
+
+    return ret;
+}
+
+/* Report that the server is down, listing the connections fuzzed
+ * since the server was last known to be alive.
+ */
+static void fuzi_q_report_down(fuzi_q_ctx_t* fuzi_q_ctx, FILE* F, uint64_t current_time, uint64_t last_alive_time)
+{
+    fuzi_q_ctx->server_down_time = current_time;
+    fprintf(F, "Server down at %" PRIu64 ", last seen alive at %" PRIu64 ".\n",
+        current_time, last_alive_time);
+    fprintf(F, "Connections fuzzed since then:\n");
+    if (fuzzer_log_dump(&fuzi_q_ctx->fuzz_ctx, F, last_alive_time) == 0) {
+        fprintf(F, "    none.\n");
+    }
+    fflush(F);
+}
+
+/* Delay after which a silent probe means that the server is down:
+ * one probe interval for the next PING, plus a couple of RTT for the ACK.
+ */
+static uint64_t fuzi_q_probe_timeout(fuzi_q_ctx_t* fuzi_q_ctx)
+{
+    uint64_t rtt = fuzi_q_ctx->probe_ctx.cnx_client->path[0]->smoothed_rtt;
+
+    if (rtt < FUZI_Q_PROBE_RTT_MIN) {
+        rtt = FUZI_Q_PROBE_RTT_MIN;
+    }
+    return fuzi_q_ctx->probe_interval + 3 * rtt;
+}
+
+/* Check the liveness probe. Returns 1 if the server is down.
+ * Before the probe handshake completes, the probe is restarted after a
+ * silence; the general success timer covers servers that never answer.
+ * Once the probe is ready, the server is declared down if the probe stays
+ * silent for longer than the probe timeout, or if the probe is disconnected.
+ */
+int fuzi_q_probe_check(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time)
+{
+    int is_down = 0;
+    fuzi_q_cnx_ctx_t* probe_ctx = &fuzi_q_ctx->probe_ctx;
+
+    if (probe_ctx->cnx_client != NULL) {
+        picoquic_state_enum cnx_state = picoquic_get_cnx_state(probe_ctx->cnx_client);
+        uint64_t last_receive_time = probe_ctx->cnx_client->latest_receive_time;
+
+        if (cnx_state == picoquic_state_ready) {
+            probe_ctx->success_observed = 1;
+        }
+        if (probe_ctx->success_observed) {
+            if (cnx_state >= picoquic_state_disconnecting ||
+                current_time > last_receive_time + fuzi_q_probe_timeout(fuzi_q_ctx)) {
+                is_down = 1;
+                fuzi_q_report_down(fuzi_q_ctx, stdout, current_time, last_receive_time);
+                if (fuzi_q_ctx->crash_log != NULL) {
+                    fuzi_q_report_down(fuzi_q_ctx, fuzi_q_ctx->crash_log, current_time, last_receive_time);
+                }
+            }
+        }
+        else if (cnx_state == picoquic_state_disconnected || current_time >= probe_ctx->next_time) {
+            fuzi_q_release_connection(probe_ctx);
+        }
+    }
+    if (probe_ctx->cnx_client == NULL && !is_down && fuzi_q_ctx->probe_interval > 0) {
+        if (fuzi_q_probe_start(fuzi_q_ctx, current_time) != 0) {
+            DBG_PRINTF("%s", "Cannot start the liveness probe");
+            fuzi_q_release_connection(probe_ctx);
+        }
+    }
+    return is_down;
+}
+
+/* Write the events of a client connection to the event directory,
+ * and if this is an anomaly the captured packets.
+ */
+static void fuzi_q_event_flush(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx, char const* reason,
+    int is_anomaly, uint64_t current_time)
+{
+    fuzzer_icid_ctx_t* icid_ctx = fuzzer_get_icid_ctx(&fuzi_q_ctx->fuzz_ctx, &cnx_ctx->cnx_client->initial_cnxid, current_time);
+
+    if (icid_ctx != NULL) {
+        if (fuzi_q_ctx->fuzz_ctx.event_log_enabled && fuzzer_event_flush(&fuzi_q_ctx->fuzz_ctx, icid_ctx, reason, 1) != 0) {
+            DBG_PRINTF("Cannot write the events of connection %02x%02x...", cnx_ctx->icid.id[0], cnx_ctx->icid.id[1]);
+        }
+        if (is_anomaly && fuzzer_capture_write(&fuzi_q_ctx->fuzz_ctx, icid_ctx, reason) != 0) {
+            DBG_PRINTF("Cannot write the packets of connection %02x%02x...", cnx_ctx->icid.id[0], cnx_ctx->icid.id[1]);
+        }
+    }
+}
+
+/* When a connection closes, keep its events if it was sampled, and its
+ * events and packets if it was fuzzed and ended abnormally, then release
+ * the event ring and return the capture ring to the pool.
+ */
+static void fuzi_q_event_close(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx, int should_abandon, uint64_t current_time)
+{
+    picoquic_cnx_t* cnx = cnx_ctx->cnx_client;
+    fuzzer_icid_ctx_t* icid_ctx = fuzzer_get_icid_ctx(&fuzi_q_ctx->fuzz_ctx, &cnx->initial_cnxid, current_time);
+
+    if (icid_ctx != NULL) {
+        if (cnx_ctx->was_fuzzed &&
+            (should_abandon || picoquic_get_local_error(cnx) != 0 || picoquic_get_remote_error(cnx) != 0)) {
+            fuzi_q_event_flush(fuzi_q_ctx, cnx_ctx, "abnormal", 1, current_time);
+        }
+        else if (fuzzer_event_is_sampled(&fuzi_q_ctx->fuzz_ctx, icid_ctx)) {
+            fuzi_q_event_flush(fuzi_q_ctx, cnx_ctx, "sampled", 0, current_time);
+        }
+        fuzzer_event_release(icid_ctx);
+        fuzzer_capture_detach(&fuzi_q_ctx->fuzz_ctx, icid_ctx);
+    }
+}
+
+/* Start an additional fuzz trial on a ready connection.
+ * The trial replays the client scenario on new streams, using a copy
+ * of the scenario in which all stream IDs are shifted past those used
+ * by the previous trials. The fuzzer context for the ICID is reseeded
+ * for the trial, so the fuzz decisions are keyed per trial.
+ */
+int fuzi_q_start_trial(fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_cnx_ctx_t* cnx_ctx, uint64_t current_time)
+{
+    int ret = 0;
+    uint64_t stride = 0;
+    uint64_t shift;
+    picoquic_demo_stream_desc_t const* sc = (cnx_ctx->scenario != NULL) ? cnx_ctx->scenario->streams : fuzi_q_ctx->client_sc;
+    size_t sc_nb = (cnx_ctx->scenario != NULL) ? cnx_ctx->scenario->nb_streams : fuzi_q_ctx->client_sc_nb;
+
+    for (size_t i = 0; i < sc_nb; i++) {
+        uint64_t last_id = sc[i].stream_id + 4 * sc[i].repeat_count;
+        if (last_id >= stride) {
+            stride = (last_id & ~(uint64_t)3) + 4;
+        }
+    }
+    shift = stride * (cnx_ctx->nb_trials + 1);
+
+    /* The previous trial is over, its callback context and buffer can be reused */
+    picoquic_demo_client_delete_context(&cnx_ctx->callback_ctx);
+    if (sc_nb > cnx_ctx->trial_sc_max) {
+        picoquic_demo_stream_desc_t* trial_sc = (picoquic_demo_stream_desc_t*)realloc(cnx_ctx->trial_sc,
+            sizeof(picoquic_demo_stream_desc_t) * sc_nb);
+        if (trial_sc == NULL) {
+            ret = -1;
+        }
+        else {
+            cnx_ctx->trial_sc = trial_sc;
+            cnx_ctx->trial_sc_max = sc_nb;
+        }
+    }
+    if (ret == 0) {
+        memcpy(cnx_ctx->trial_sc, sc, sizeof(picoquic_demo_stream_desc_t) * sc_nb);
+        for (size_t i = 0; i < sc_nb; i++) {
+            cnx_ctx->trial_sc[i].stream_id += shift;
+            if (cnx_ctx->trial_sc[i].previous_stream_id != PICOQUIC_DEMO_STREAM_ID_INITIAL) {
+                cnx_ctx->trial_sc[i].previous_stream_id += shift;
+            }
+        }
+        cnx_ctx->nb_trials++;
+
+        ret = fuzi_q_init_callback_ctx(fuzi_q_ctx, &cnx_ctx->callback_ctx, cnx_ctx->trial_sc, sc_nb, current_time);
+        if (ret == 0) {
+            picoquic_set_callback(cnx_ctx->cnx_client, picoquic_demo_client_callback, &cnx_ctx->callback_ctx);
+            (void)fuzzer_start_trial(&fuzi_q_ctx->fuzz_ctx, &cnx_ctx->icid, cnx_ctx->nb_trials, current_time);
+            cnx_ctx->next_time = current_time + FUZI_Q_MAX_SILENCE;
+            ret = picoquic_demo_client_start_streams(cnx_ctx->cnx_client, &cnx_ctx->callback_ctx, PICOQUIC_DEMO_STREAM_ID_INITIAL);
+        }
+    }
+
+    return ret;
+}
 
 /* Set quic context for client run.
  * 
@@ -204,13 +568,16 @@ int fuzi_q_set_client_context(fuzi_q_mode_enum fuzz_mode, fuzi_q_ctx_t* fuzi_q_c
     }
     else {
         if (client_scenario_text == NULL) {
-            client_scenario_text = test_scenario_default;
+            /* Each connection runs its own scenario, generated from its ICID */
+            fuzi_q_ctx->generate_scenario = 1;
+            fprintf(stdout, "Testing scenarios generated for each connection.\n");
         }
-
-        fprintf(stdout, "Testing scenario: <%s>\n", client_scenario_text);
-        ret = demo_client_parse_scenario_desc(client_scenario_text, &fuzi_q_ctx->client_sc_nb, &fuzi_q_ctx->client_sc);
-        if (ret != 0) {
-            fprintf(stdout, "Cannot parse the specified scenario.\n");
+        else {
+            fprintf(stdout, "Testing scenario: <%s>\n", client_scenario_text);
+            ret = demo_client_parse_scenario_desc(client_scenario_text, &fuzi_q_ctx->client_sc_nb, &fuzi_q_ctx->client_sc);
+            if (ret != 0) {
+                fprintf(stdout, "Cannot parse the specified scenario.\n");
+            }
         }
     }
 
@@ -260,6 +627,7 @@ int fuzi_q_set_client_context(fuzi_q_mode_enum fuzz_mode, fuzi_q_ctx_t* fuzi_q_c
         else {
             memset(fuzi_q_ctx->cnx_ctx, 0, sizeof(fuzi_q_cnx_ctx_t) * nb_cnx_ctx);
             fuzi_q_ctx->nb_cnx_ctx = nb_cnx_ctx;
+            fuzi_q_rate_init(&fuzi_q_ctx->rate_ctl, nb_cnx_ctx, current_time);
         }
     }
 
@@ -270,13 +638,17 @@ void fuzi_q_release_client_context(fuzi_q_ctx_t* fuzi_q_ctx)
 {
     if (fuzi_q_ctx->cnx_ctx != NULL) {
         for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx; i++) {
-            fuzi_q_release_connection(&fuzi_q_ctx->cnx_ctx[i]);
+            fuzi_q_delete_connection_slot(&fuzi_q_ctx->cnx_ctx[i]);
         }
         free(fuzi_q_ctx->cnx_ctx);
         fuzi_q_ctx->cnx_ctx = NULL;
     }
     fuzi_q_ctx->nb_cnx_ctx = 0;
 
+    if (fuzi_q_ctx->probe_ctx.cnx_client != NULL) {
+        fuzi_q_release_connection(&fuzi_q_ctx->probe_ctx);
+    }
+
     if (fuzi_q_ctx->quic != NULL) {
         picoquic_free(fuzi_q_ctx->quic);
         fuzi_q_ctx->quic = NULL;
@@ -287,6 +659,7 @@ void fuzi_q_release_client_context(fuzi_q_ctx_t* fuzi_q_ctx)
         fuzi_q_ctx->client_sc = NULL;
     }
     fuzi_q_ctx->client_sc_nb = 0;
+    fuzzer_capture_release(&fuzi_q_ctx->fuzz_ctx);
 }
 
 /* Fuzi Q, client loop.
@@ -296,12 +669,18 @@ void fuzi_q_release_client_context(fuzi_q_ctx_t* fuzi_q_ctx)
  * Need to check that some connections are succeeding. This will have to be 
  * coordinated with the fuzzer logic, e.g., do not fuzz before handshake
  * has succeeded for at least some connections. 
- * TODO: consider migration trials, key update trials.
  */
 int fuzi_q_loop_check_cnx(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time, int * is_active)
 {
     int ret = 0;
     int nb_active = 0;
+    size_t nb_running = 0;
+
+    for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx; i++) {
+        if (fuzi_q_ctx->cnx_ctx[i].cnx_client != NULL) {
+            nb_running++;
+        }
+    }
 
     for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx && ret == 0; i++) {
         fuzi_q_cnx_ctx_t* cnx_ctx = &fuzi_q_ctx->cnx_ctx[i];
@@ -317,6 +696,9 @@ int fuzi_q_loop_check_cnx(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time, int *
                 if (!cnx_ctx->success_observed) {
                     fuzi_q_ctx->next_success_time = current_time + fuzi_q_ctx->up_time_interval;
                     cnx_ctx->success_observed = 1;
+                    cnx_ctx->migration_time = current_time + cnx_ctx->migration_delay;
+                    cnx_ctx->key_update_time = current_time + cnx_ctx->key_update_delay;
+                    cnx_ctx->multipath_time = current_time;
                     if (ret == 0 && !cnx_ctx->zero_rtt_available) {
                         if (!fuzi_q_ctx->is_quicperf) {
                             /* Start the download scenario */
@@ -326,7 +708,15 @@ int fuzi_q_loop_check_cnx(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time, int *
                     }
                 }
                 else if (cnx_ctx->callback_ctx.nb_open_streams == 0) {
-                    ret = picoquic_close(cnx_ctx->cnx_client, 0);
+                    if (!fuzi_q_ctx->is_quicperf && cnx_ctx->nb_trials + 1 < fuzi_q_ctx->trials_per_cnx &&
+                        fuzi_q_ctx->nb_cnx_tried < fuzi_q_ctx->nb_cnx_required && current_time < fuzi_q_ctx->end_of_time) {
+                        /* Host the next trial on the same connection, without a new handshake */
+                        fuzi_q_ctx->nb_cnx_tried++;
+                        ret = fuzi_q_start_trial(fuzi_q_ctx, cnx_ctx, current_time);
+                    }
+                    else {
+                        ret = picoquic_close(cnx_ctx->cnx_client, 0);
+                    }
                     *is_active = 1;
                 }
             }
@@ -346,18 +736,34 @@ int fuzi_q_loop_check_cnx(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time, int *
                 if (fuzi_q_ctx->fuzz_mode == fuzi_q_mode_client && !cnx_ctx->was_fuzzed) {
                     DBG_PRINTF("Connection stopped without being fuzzed: %02x%02x...", cnx_ctx->icid.id[0], cnx_ctx->icid.id[1]);
                 }
+                fuzi_q_rate_on_close(&fuzi_q_ctx->rate_ctl, cnx_ctx->was_fuzzed, cnx_ctx->success_observed, should_abandon,
+                    cnx_ctx->cnx_client->path[0]->smoothed_rtt);
+                if (fuzi_q_ctx->fuzz_ctx.event_log_enabled || fuzi_q_ctx->fuzz_ctx.capture_pool != NULL) {
+                    fuzi_q_event_close(fuzi_q_ctx, cnx_ctx, should_abandon, current_time);
+                }
+                if (fuzi_q_ctx->migration_cnx == cnx_ctx) {
+                    fuzi_q_ctx->migration_cnx = NULL;
+                }
                 fuzi_q_release_connection(cnx_ctx);
+                nb_running--;
                 *is_active = 1;
             }
         }
         if (cnx_ctx->cnx_client == NULL){
             if (current_time >= fuzi_q_ctx->end_of_time) {
                 DBG_PRINTF("Abandon fuzz at time = %" PRIu64, current_time);
-            } else if (fuzi_q_ctx->nb_cnx_tried < fuzi_q_ctx->nb_cnx_required) {
-                /* If the required number of trials is not done, try starting a new connection. */
-                fuzi_q_ctx->nb_cnx_tried++;
-                ret = fuzi_q_start_connection(fuzi_q_ctx, cnx_ctx, current_time);
-                *is_active = 1;
+            } else if (fuzi_q_ctx->nb_cnx_tried < fuzi_q_ctx->nb_cnx_required &&
+                (fuzi_q_ctx->fuzz_ctx.replay == NULL || fuzi_q_replay_has_next(fuzi_q_ctx))) {
+                /* If the required number of trials is not done, try starting a new connection,
+                 * unless the rate controller asks to wait. */
+                if (fuzi_q_rate_can_start(&fuzi_q_ctx->rate_ctl, nb_running, current_time)) {
+                    fuzi_q_ctx->nb_cnx_tried++;
+                    ret = fuzi_q_start_connection(fuzi_q_ctx, cnx_ctx, current_time);
+                    fuzi_q_rate_on_start(&fuzi_q_ctx->rate_ctl, current_time);
+                    nb_running++;
+                    *is_active = 1;
+                }
+                /* Count the pending start as active, so the loop does not terminate */
                 nb_active++;
             }
         }
@@ -369,14 +775,158 @@ int fuzi_q_loop_check_cnx(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time, int *
     if (ret == 0 && nb_active == 0) {
             ret = PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP;
     }
+    else if (ret == 0 && fuzi_q_ctx->probe_interval > 0 && fuzi_q_probe_check(fuzi_q_ctx, current_time)) {
+        fuzi_q_ctx->server_is_down = 1;
+        ret = PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP;
+    }
     else if (current_time > fuzi_q_ctx->next_success_time) {
         fuzi_q_ctx->server_is_down = 1;
+        if (fuzi_q_ctx->crash_log != NULL) {
+            fuzi_q_report_down(fuzi_q_ctx, fuzi_q_ctx->crash_log, current_time,
+                fuzi_q_ctx->next_success_time - fuzi_q_ctx->up_time_interval);
+        }
         ret = PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP;
     }
 
+    if (fuzi_q_ctx->server_is_down && (fuzi_q_ctx->fuzz_ctx.event_log_enabled || fuzi_q_ctx->fuzz_ctx.capture_pool != NULL)) {
+        /* Keep the events and packets of all the connections in flight when the server went down */
+        for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx; i++) {
+            if (fuzi_q_ctx->cnx_ctx[i].cnx_client != NULL) {
+                fuzi_q_event_flush(fuzi_q_ctx, &fuzi_q_ctx->cnx_ctx[i], "server_down", 1, current_time);
+            }
+        }
+    }
+
     return ret;
 }
 
+/* Start the migration of the first ready connection whose planned time
+ * has come. The packet loop executes the migration when the callback
+ * returns PICOQUIC_NO_ERROR_SIMULATE_NAT, by rebinding the socket to a
+ * new port, or PICOQUIC_NO_ERROR_SIMULATE_MIGRATION, by opening a new
+ * socket and reporting its address with a port update, at which point the
+ * new path is probed. Path validation and CID frames of the migrating
+ * connection are then fuzzed first.
+ */
+static int fuzi_q_migration_check(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time)
+{
+    int ret = 0;
+
+    for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx && ret == 0 && fuzi_q_ctx->migration_cnx == NULL; i++) {
+        fuzi_q_cnx_ctx_t* cnx_ctx = &fuzi_q_ctx->cnx_ctx[i];
+
+        if (cnx_ctx->cnx_client != NULL && cnx_ctx->success_observed && current_time >= cnx_ctx->migration_time &&
+            (cnx_ctx->migration_mode == fuzi_q_migration_nat || cnx_ctx->migration_mode == fuzi_q_migration_probe) &&
+            picoquic_get_cnx_state(cnx_ctx->cnx_client) == picoquic_state_ready) {
+            fuzzer_icid_ctx_t* icid_ctx = fuzzer_get_icid_ctx(&fuzi_q_ctx->fuzz_ctx, &cnx_ctx->icid, current_time);
+
+            if (icid_ctx != NULL) {
+                icid_ctx->migrated = 1;
+            }
+            if (cnx_ctx->migration_mode == fuzi_q_migration_nat) {
+                ret = PICOQUIC_NO_ERROR_SIMULATE_NAT;
+            }
+            else {
+                fuzi_q_ctx->migration_cnx = cnx_ctx;
+                ret = PICOQUIC_NO_ERROR_SIMULATE_MIGRATION;
+            }
+            cnx_ctx->migration_mode = fuzi_q_migration_done;
+        }
+    }
+    return ret;
+}
+
+/* Start the planned key updates. Picoquic refuses a new update until the
+ * previous one is acknowledged, so the updates of a burst are retried at
+ * each check until they are all started. After an update, the fuzzer may
+ * flip the key phase of the next short header packets.
+ */
+static void fuzi_q_key_update_check(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time)
+{
+    for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx; i++) {
+        fuzi_q_cnx_ctx_t* cnx_ctx = &fuzi_q_ctx->cnx_ctx[i];
+
+        if (cnx_ctx->cnx_client != NULL && cnx_ctx->success_observed && cnx_ctx->nb_key_updates_left > 0 &&
+            current_time >= cnx_ctx->key_update_time &&
+            picoquic_get_cnx_state(cnx_ctx->cnx_client) == picoquic_state_ready) {
+            fuzzer_icid_ctx_t* icid_ctx = fuzzer_get_icid_ctx(&fuzi_q_ctx->fuzz_ctx, &cnx_ctx->icid, current_time);
+
+            if (cnx_ctx->key_update_mode == fuzi_q_key_update_loss && cnx_ctx->cnx_client->path[0]->nb_retransmit == 0 &&
+                (icid_ctx == NULL || !icid_ctx->already_fuzzed)) {
+                /* Wait until packets are lost, or dropped by the peer after fuzzing */
+                continue;
+            }
+            if (picoquic_start_key_rotation(cnx_ctx->cnx_client) == 0) {
+                cnx_ctx->nb_key_updates_left--;
+                fuzi_q_ctx->nb_key_updates++;
+                if (icid_ctx != NULL) {
+                    icid_ctx->key_phase_flips = FUZZER_KEY_PHASE_FLIP_PACKETS;
+                }
+            }
+        }
+    }
+}
+
+/* Progress the multipath trial of the ready connections. The additional
+ * paths are opened once multipath is negotiated, then the status of the
+ * last path changes at each step, each change sending a path frame. An
+ * error, e.g., if the peer refuses the new path, ends the trial of the
+ * connection.
+ */
+static void fuzi_q_multipath_check(fuzi_q_ctx_t* fuzi_q_ctx, uint64_t current_time)
+{
+    for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx; i++) {
+        fuzi_q_cnx_ctx_t* cnx_ctx = &fuzi_q_ctx->cnx_ctx[i];
+        picoquic_cnx_t* cnx = cnx_ctx->cnx_client;
+        int step_ret = 0;
+
+        if (cnx == NULL || !cnx_ctx->success_observed || !cnx->is_multipath_enabled ||
+            cnx_ctx->multipath_step == fuzi_q_multipath_done || current_time < cnx_ctx->multipath_time ||
+            picoquic_get_cnx_state(cnx) != picoquic_state_ready) {
+            continue;
+        }
+        if (cnx_ctx->multipath_step == fuzi_q_multipath_open) {
+            struct sockaddr_storage local_addr;
+
+            if (cnx_ctx->nb_paths_opened + 1 >= fuzi_q_ctx->nb_paths) {
+                cnx_ctx->multipath_step = fuzi_q_multipath_backup;
+            }
+            else if ((step_ret = fuzi_q_multipath_local_address((struct sockaddr*)&cnx->path[0]->local_addr,
+                cnx_ctx->nb_paths_opened + 1, &local_addr)) == 0 &&
+                (step_ret = picoquic_probe_new_path_ex(cnx, (struct sockaddr*)&cnx->path[0]->peer_addr,
+                    (struct sockaddr*)&local_addr, 0, current_time, 0)) == 0) {
+                cnx_ctx->nb_paths_opened++;
+                fuzi_q_ctx->nb_paths_added++;
+            }
+        }
+        else if (cnx->nb_paths < 2) {
+            step_ret = -1;
+        }
+        else {
+            uint64_t path_id = cnx->path[cnx->nb_paths - 1]->unique_path_id;
+
+            switch (cnx_ctx->multipath_step) {
+            case fuzi_q_multipath_backup:
+                step_ret = picoquic_set_path_status(cnx, path_id, picoquic_path_status_backup);
+                cnx_ctx->multipath_step = fuzi_q_multipath_available;
+                break;
+            case fuzi_q_multipath_available:
+                step_ret = picoquic_set_path_status(cnx, path_id, picoquic_path_status_available);
+                cnx_ctx->multipath_step = fuzi_q_multipath_abandon;
+                break;
+            default:
+                step_ret = picoquic_abandon_path(cnx, path_id, 0, "fuzz", current_time);
+                cnx_ctx->multipath_step = fuzi_q_multipath_done;
+                break;
+            }
+        }
+        if (step_ret != 0) {
+            cnx_ctx->multipath_step = fuzi_q_multipath_done;
+        }
+        cnx_ctx->multipath_time = current_time + FUZI_Q_MULTIPATH_STEP_DELAY;
+    }
+}
+
 uint64_t fuzi_q_next_time(fuzi_q_ctx_t* fuzi_q_ctx)
 {
     uint64_t next_event_time = UINT64_MAX;
@@ -386,24 +936,40 @@ uint64_t fuzi_q_next_time(fuzi_q_ctx_t* fuzi_q_ctx)
         if (next_event_time > fuzi_q_ctx->next_success_time) {
             next_event_time = fuzi_q_ctx->next_success_time;
         }
+        if (fuzi_q_ctx->rate_ctl.start_interval > 0 && fuzi_q_ctx->nb_cnx_tried < fuzi_q_ctx->nb_cnx_required &&
+            next_event_time > fuzi_q_ctx->rate_ctl.next_start_time) {
+            next_event_time = fuzi_q_ctx->rate_ctl.next_start_time;
+        }
         for (size_t i = 0; i < fuzi_q_ctx->nb_cnx_ctx; i++) {
             if (fuzi_q_ctx->cnx_ctx[i].cnx_client != NULL &&
                 fuzi_q_ctx->cnx_ctx[i].next_time < next_event_time) {
                 next_event_time = fuzi_q_ctx->cnx_ctx[i].next_time;
             }
         }
+        if (fuzi_q_ctx->probe_ctx.cnx_client != NULL) {
+            uint64_t probe_time = (fuzi_q_ctx->probe_ctx.success_observed) ?
+                fuzi_q_ctx->probe_ctx.cnx_client->latest_receive_time + fuzi_q_probe_timeout(fuzi_q_ctx) :
+                fuzi_q_ctx->probe_ctx.next_time;
+            if (probe_time < next_event_time) {
+                next_event_time = probe_time;
+            }
+        }
     }
 
     return next_event_time;
 }
 
+/* Wake up the packet loop at the next fuzi_q event if it comes before the
+ * next QUIC event, e.g., a probe timeout or a paced connection start.
+ */
 void fuzi_q_check_time(fuzi_q_ctx_t* fuzi_q_ctx, packet_loop_time_check_arg_t* time_check_arg)
 {
     uint64_t next_time = time_check_arg->current_time + time_check_arg->delta_t;
     uint64_t next_event_time = fuzi_q_next_time(fuzi_q_ctx);
 
     if (next_event_time < next_time) {
-        time_check_arg->delta_t = next_time - time_check_arg->current_time;
+        time_check_arg->delta_t = (next_event_time > time_check_arg->current_time) ?
+            (int64_t)(next_event_time - time_check_arg->current_time) : 0;
     }
 }
 
@@ -428,8 +994,11 @@ int fuzi_q_client_loop_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb
             break;
         case picoquic_packet_loop_after_receive:
             /* Post receive callback */
-            /* TODO: consider migration trials */
-            /* TODO: consider key update trials */
+            fuzi_q_key_update_check(fuzi_q_ctx, picoquic_get_quic_time(fuzi_q_ctx->quic));
+            if (fuzi_q_ctx->nb_paths > 1) {
+                fuzi_q_multipath_check(fuzi_q_ctx, picoquic_get_quic_time(fuzi_q_ctx->quic));
+            }
+            ret = fuzi_q_migration_check(fuzi_q_ctx, picoquic_get_quic_time(fuzi_q_ctx->quic));
             break;
         case picoquic_packet_loop_after_send:
             /* check whether some connections were closed. */
@@ -437,6 +1006,13 @@ int fuzi_q_client_loop_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb
             ret = fuzi_q_loop_check_cnx(fuzi_q_ctx, picoquic_get_quic_time(fuzi_q_ctx->quic), &is_active);
             break;
         case picoquic_packet_loop_port_update:
+            /* The argument is the new local address */
+            if (fuzi_q_ctx->migration_cnx != NULL && callback_arg != NULL) {
+                /* Errors are expected, e.g., if the server disabled migration */
+                (void)picoquic_probe_new_path(fuzi_q_ctx->migration_cnx->cnx_client, (struct sockaddr*)&fuzi_q_ctx->server_address,
+                    (struct sockaddr*)callback_arg, picoquic_get_quic_time(fuzi_q_ctx->quic));
+                fuzi_q_ctx->migration_cnx = NULL;
+            }
             break;
         case picoquic_packet_loop_time_check:
             /* Check whether the time to close the app is arriving */
@@ -452,19 +1028,70 @@ int fuzi_q_client_loop_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb
 
 
 /* Fuzi Quic Client
- * TODO: manage loop options like key updates, migrations, etc. 
+ * In client fuzz mode, connections also follow the migration and key
+ * update plans derived from their ICID, see fuzi_q_migration_plan and
+ * fuzi_q_key_update_plan.
  */
-int fuzi_q_client(fuzi_q_mode_enum fuzz_mode, const char* ip_address_text, int server_port,
-    picoquic_quic_config_t* config, size_t nb_cnx_required, uint64_t duration_max,
-    picoquic_connection_id_t * init_cid, char const* client_scenario_text)
+int fuzi_q_client(const fuzi_q_client_options_t* options)
 {
     /* Start: start the QUIC process with cert and key files */
     int ret = 0;
     fuzi_q_ctx_t fuzi_q_ctx = { 0 };
     int is_active = 0;
 
-    ret = fuzi_q_set_client_context(fuzz_mode, &fuzi_q_ctx, ip_address_text, server_port,
-        config, nb_cnx_required, duration_max, init_cid, client_scenario_text, NULL);
+    ret = fuzi_q_set_client_context(options->fuzz_mode, &fuzi_q_ctx, options->ip_address_text,
+        options->server_port, options->config, options->nb_cnx_required, options->duration_max,
+        options->init_cid, options->client_scenario_text, NULL);
+    fuzi_q_ctx.trials_per_cnx = options->trials_per_cnx;
+    if (options->fuzz_mode == fuzi_q_mode_client) {
+        fuzi_q_ctx.probe_interval = options->probe_interval;
+        fuzzer_prng_seed(&fuzi_q_ctx.probe_prng, picoquic_val64_connection_id(fuzi_q_ctx.fuzz_ctx.next_cid) ^ 0x9b0be9b0be9b0beull);
+    }
+    if (ret == 0 && options->nb_paths > 1) {
+        fuzi_q_ctx.nb_paths = (options->nb_paths < FUZI_Q_MULTIPATH_NB_PATHS_MAX) ? options->nb_paths : FUZI_Q_MULTIPATH_NB_PATHS_MAX;
+        picoquic_set_default_multipath_option(fuzi_q_ctx.quic, 1);
+    }
+    if (options->report != NULL) {
+        fuzi_q_ctx.crash_log = options->report->crash_log;
+    }
+    if (options->event_sample != FUZI_Q_EVENT_LOG_OFF) {
+        fuzi_q_ctx.fuzz_ctx.event_log_enabled = 1;
+        fuzi_q_ctx.fuzz_ctx.event_sample = (size_t)options->event_sample;
+        fuzi_q_ctx.fuzz_ctx.event_dir = (options->config == NULL) ? NULL : options->config->out_dir;
+    }
+    if (ret == 0 && options->capture_packets) {
+        fuzi_q_ctx.fuzz_ctx.event_dir = (options->config == NULL) ? NULL : options->config->out_dir;
+        /* Closed connections return their ring, so two per connection slot leave a margin */
+        if (fuzzer_capture_init(&fuzi_q_ctx.fuzz_ctx, 2 * fuzi_q_ctx.nb_cnx_ctx) != 0) {
+            fprintf(stdout, "Cannot allocate the packet capture.\n");
+            ret = -1;
+        }
+    }
+    if (ret == 0 && options->replay != NULL) {
+        /* Replay all the listed trials, each ICID hosting as many trials as needed */
+        fuzi_q_ctx.fuzz_ctx.replay = options->replay;
+        options->replay->server_is_down = 0;
+        for (size_t i = 0; i < options->replay->nb_targets; i++) {
+            if (options->replay->targets[i].trial_rank >= fuzi_q_ctx.trials_per_cnx) {
+                fuzi_q_ctx.trials_per_cnx = (size_t)options->replay->targets[i].trial_rank + 1;
+            }
+        }
+    }
+
+    /* Load the fuzzing profile learned in previous runs against this server */
+    if (ret == 0 && options->profile_file != NULL) {
+        fuzi_q_ctx.profile_file = options->profile_file;
+        ret = fuzi_q_profile_key(fuzi_q_ctx.profile_key, sizeof(fuzi_q_ctx.profile_key),
+            options->ip_address_text, options->server_port, fuzi_q_ctx.alpn);
+        if (ret == 0) {
+            if (fuzi_q_profile_load(&fuzi_q_ctx.fuzz_ctx, options->profile_file, fuzi_q_ctx.profile_key) == 0) {
+                fprintf(stdout, "Loaded fuzzing profile <%s> from %s\n", fuzi_q_ctx.profile_key, options->profile_file);
+            }
+            else {
+                fprintf(stdout, "No fuzzing profile <%s> in %s, starting from scratch.\n", fuzi_q_ctx.profile_key, options->profile_file);
+            }
+        }
+    }
 
     /* Start the client connections */
     if (ret == 0) {
@@ -488,17 +1115,55 @@ int fuzi_q_client(fuzi_q_mode_enum fuzz_mode, const char* ip_address_text, int s
             i, fuzi_q_ctx.fuzz_ctx.nb_cnx_tried[i], fuzi_q_ctx.fuzz_ctx.nb_cnx_fuzzed[i],
             fuzi_q_ctx.fuzz_ctx.nb_packets_fuzzed[i],
             fuzi_q_ctx.fuzz_ctx.nb_packets_state[i]);
+        fprintf(stdout, "    Fuzzed/assigned per wait bucket:");
+        for (int j = 0; j < FUZZER_NB_WAIT_BUCKETS; j++) {
+            fprintf(stdout, " %zu/%zu", fuzi_q_ctx.fuzz_ctx.cell_fuzzed[i][j], fuzi_q_ctx.fuzz_ctx.cell_assigned[i][j]);
+        }
+        fprintf(stdout, "\n");
     }
     fprintf(stdout, "Tried %zu connections (target: %zu). Connection min: %fs, max %fs\n",
         fuzi_q_ctx.nb_cnx_tried, fuzi_q_ctx.nb_cnx_required,
         ((double)fuzi_q_ctx.cnx_duration_min) / 1000000.0,
         ((double)fuzi_q_ctx.cnx_duration_max) / 1000000.0);
+    if (fuzi_q_ctx.rate_ctl.pool_max > 0) {
+        fprintf(stdout, "Connection pool: %zu of %zu, start interval %" PRIu64 "us, %zu increases, %zu decreases, %zu fuzzed abandoned.\n",
+            fuzi_q_ctx.rate_ctl.pool_size, fuzi_q_ctx.rate_ctl.pool_max, fuzi_q_ctx.rate_ctl.start_interval,
+            fuzi_q_ctx.rate_ctl.nb_increase, fuzi_q_ctx.rate_ctl.nb_decrease, fuzi_q_ctx.rate_ctl.nb_fuzzed_abandoned);
+    }
+    if (fuzi_q_ctx.nb_key_updates > 0) {
+        fprintf(stdout, "Started %zu key updates, flipped the key phase of %u packets.\n",
+            fuzi_q_ctx.nb_key_updates, fuzi_q_ctx.fuzz_ctx.nb_key_phase_flipped);
+    }
+    if (fuzi_q_ctx.nb_paths > 1) {
+        fprintf(stdout, "Opened %zu additional paths.\n", fuzi_q_ctx.nb_paths_added);
+    }
+    if (fuzi_q_ctx.fuzz_ctx.event_log_enabled) {
+        fprintf(stdout, "Wrote the events of %zu connections.\n", fuzi_q_ctx.fuzz_ctx.nb_event_files);
+    }
+    if (fuzi_q_ctx.fuzz_ctx.capture_pool != NULL) {
+        fprintf(stdout, "Wrote the packets of %zu connections.\n", fuzi_q_ctx.fuzz_ctx.nb_capture_files);
+    }
     fprintf(stdout, "ID of longest_connection: ");
     for (uint8_t x = 0; x < fuzi_q_ctx.icid_duration_max.id_len; x++) {
         fprintf(stdout, "%02x", fuzi_q_ctx.icid_duration_max.id[x]);
     }
     fprintf(stdout, "\n");
 
+    if (fuzi_q_ctx.profile_file != NULL) {
+        if (fuzi_q_profile_save(&fuzi_q_ctx.fuzz_ctx, fuzi_q_ctx.profile_file, fuzi_q_ctx.profile_key) != 0) {
+            fprintf(stdout, "Could not save the fuzzing profile in %s\n", fuzi_q_ctx.profile_file);
+        }
+    }
+
+    if (options->replay != NULL) {
+        options->replay->server_is_down = fuzi_q_ctx.server_is_down;
+    }
+    if (options->report != NULL) {
+        options->report->nb_cnx_tried = fuzi_q_ctx.nb_cnx_tried;
+        options->report->server_is_down = fuzi_q_ctx.server_is_down;
+        options->report->next_cid = fuzi_q_ctx.fuzz_ctx.next_cid;
+    }
+
     fuzi_q_release_client_context(&fuzi_q_ctx);
 
     return ret;
@@ -0,0 +1,266 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include <picoquic_internal.h>
+#include "fuzi_q.h"
+
+/* Per connection memory of the frames sent.
+ *
+ * The frames of each packet are parsed before the packet is fuzzed, and
+ * the fields that characterize the state of the connection are recorded:
+ * streams and offsets, flow control limits, connection ID sequence
+ * numbers, path IDs and tokens. The memory is compact and never
+ * allocates. The stream table keeps the most recently used streams,
+ * ordered from least to most recently used.
+ */
+
+#define FUZZER_MEMORY_MAX_NB_FRAMES 32
+
+static void fuzzer_memory_set(fuzzer_cnx_memory_t* memory, fuzzer_memory_field_enum field, uint64_t value)
+{
+    memory->value[field] = value;
+    memory->known |= (1u << field);
+}
+
+/* Keep the largest value observed, e.g., for sequence numbers */
+static void fuzzer_memory_set_max(fuzzer_cnx_memory_t* memory, fuzzer_memory_field_enum field, uint64_t value)
+{
+    if ((memory->known & (1u << field)) == 0 || value > memory->value[field]) {
+        fuzzer_memory_set(memory, field, value);
+    }
+}
+
+static void fuzzer_memory_stream(fuzzer_cnx_memory_t* memory, uint64_t stream_id, uint64_t offset)
+{
+    size_t nb_stored = (memory->nb_streams < FUZZER_MEMORY_NB_STREAMS) ? memory->nb_streams : FUZZER_MEMORY_NB_STREAMS;
+    size_t i = 0;
+    fuzzer_memory_stream_t stream;
+
+    while (i < nb_stored && memory->streams[i].stream_id != stream_id) {
+        i++;
+    }
+    if (i < nb_stored) {
+        stream = memory->streams[i];
+        if (offset > stream.offset) {
+            stream.offset = offset;
+        }
+    }
+    else {
+        /* New stream, replaces the least recently used one if the table is full */
+        stream.stream_id = stream_id;
+        stream.offset = offset;
+        memory->nb_streams++;
+        if (nb_stored < FUZZER_MEMORY_NB_STREAMS) {
+            i = nb_stored++;
+        }
+        else {
+            i = 0;
+        }
+    }
+    /* Move the stream to the most recently used position */
+    memmove(&memory->streams[i], &memory->streams[i + 1], (nb_stored - i - 1) * sizeof(fuzzer_memory_stream_t));
+    memory->streams[nb_stored - 1] = stream;
+}
+
+static void fuzzer_memory_observe_frame(fuzzer_cnx_memory_t* memory, const uint8_t* bytes, const uint8_t* bytes_max, int is_client)
+{
+    uint64_t frame_type;
+    uint64_t v1 = 0;
+    uint64_t v2 = 0;
+    uint64_t v3 = 0;
+    const uint8_t* p = picoquic_frames_varint_decode(bytes, bytes_max, &frame_type);
+
+    if (p == NULL) {
+        return;
+    }
+    if (PICOQUIC_IN_RANGE(frame_type, picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max)) {
+        /* Stream ID, optional offset, optional length */
+        if ((p = picoquic_frames_varint_decode(p, bytes_max, &v1)) != NULL &&
+            ((frame_type & 4) == 0 || (p = picoquic_frames_varint_decode(p, bytes_max, &v2)) != NULL)) {
+            if ((frame_type & 2) == 0) {
+                v3 = (uint64_t)(bytes_max - p);
+            }
+            else if (picoquic_frames_varint_decode(p, bytes_max, &v3) == NULL) {
+                return;
+            }
+            fuzzer_memory_stream(memory, v1, v2 + v3);
+        }
+        return;
+    }
+    switch (frame_type) {
+    case picoquic_frame_type_reset_stream:
+        /* Stream ID, error code, final size */
+        if ((p = picoquic_frames_varint_decode(p, bytes_max, &v1)) != NULL &&
+            (p = picoquic_frames_varint_skip(p, bytes_max)) != NULL &&
+            picoquic_frames_varint_decode(p, bytes_max, &v2) != NULL) {
+            fuzzer_memory_stream(memory, v1, v2);
+        }
+        break;
+    case picoquic_frame_type_stop_sending:
+        if (picoquic_frames_varint_decode(p, bytes_max, &v1) != NULL) {
+            fuzzer_memory_stream(memory, v1, 0);
+        }
+        break;
+    case picoquic_frame_type_crypto_hs:
+        if ((p = picoquic_frames_varint_decode(p, bytes_max, &v1)) != NULL &&
+            picoquic_frames_varint_decode(p, bytes_max, &v2) != NULL) {
+            fuzzer_memory_set(memory, fuzzer_memory_crypto_offset, v1 + v2);
+        }
+        break;
+    case picoquic_frame_type_new_token:
+        if ((p = picoquic_frames_varint_decode(p, bytes_max, &v1)) != NULL && v1 <= (uint64_t)(bytes_max - p)) {
+            memory->token_length = (uint8_t)((v1 > FUZZER_MEMORY_TOKEN_MAX) ? FUZZER_MEMORY_TOKEN_MAX : v1);
+            memcpy(memory->token, p, memory->token_length);
+        }
+        break;
+    case picoquic_frame_type_max_data:
+        if (picoquic_frames_varint_decode(p, bytes_max, &v1) != NULL) {
+            fuzzer_memory_set(memory, fuzzer_memory_max_data, v1);
+        }
+        break;
+    case picoquic_frame_type_max_stream_data:
+        if ((p = picoquic_frames_varint_decode(p, bytes_max, &v1)) != NULL &&
+            picoquic_frames_varint_decode(p, bytes_max, &v2) != NULL) {
+            fuzzer_memory_stream(memory, v1, 0);
+            fuzzer_memory_set(memory, fuzzer_memory_max_stream_data, v2);
+        }
+        break;
+    case picoquic_frame_type_max_streams_bidir:
+    case picoquic_frame_type_max_streams_unidir:
+        if (picoquic_frames_varint_decode(p, bytes_max, &v1) != NULL) {
+            fuzzer_memory_set(memory, (frame_type == picoquic_frame_type_max_streams_bidir) ?
+                fuzzer_memory_max_streams_bidir : fuzzer_memory_max_streams_unidir, v1);
+        }
+        break;
+    case picoquic_frame_type_new_connection_id:
+        if ((p = picoquic_frames_varint_decode(p, bytes_max, &v1)) != NULL &&
+            picoquic_frames_varint_decode(p, bytes_max, &v2) != NULL) {
+            fuzzer_memory_set_max(memory, fuzzer_memory_cid_sequence, v1);
+            fuzzer_memory_set_max(memory, fuzzer_memory_retire_prior_to, v2);
+        }
+        break;
+    case picoquic_frame_type_handshake_done:
+        if (!is_client) {
+            memory->handshake_done_sent = 1;
+        }
+        break;
+    case picoquic_frame_type_path_abandon:
+    case picoquic_frame_type_path_backup:
+    case picoquic_frame_type_path_available:
+        if (picoquic_frames_varint_decode(p, bytes_max, &v1) != NULL) {
+            fuzzer_memory_set_max(memory, fuzzer_memory_path_id, v1);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void fuzzer_memory_observe(fuzzer_cnx_memory_t* memory, const uint8_t* bytes, const uint8_t* bytes_max, int is_client)
+{
+    size_t nb_frames = 0;
+
+    while (bytes < bytes_max && nb_frames < FUZZER_MEMORY_MAX_NB_FRAMES) {
+        size_t consumed = 0;
+        int is_pure_ack = 1;
+
+        if (picoquic_skip_frame(bytes, (size_t)(bytes_max - bytes), &consumed, &is_pure_ack) != 0 || consumed == 0) {
+            break;
+        }
+        fuzzer_memory_observe_frame(memory, bytes, bytes + consumed, is_client);
+        bytes += consumed;
+        nb_frames++;
+    }
+}
+
+int fuzzer_memory_get(const fuzzer_cnx_memory_t* memory, fuzzer_memory_field_enum field, uint64_t* value)
+{
+    int is_known = (memory != NULL && (memory->known & (1u << field)) != 0);
+
+    if (is_known) {
+        *value = memory->value[field];
+    }
+    return is_known;
+}
+
+/* Values that a peer is likely to check against the observed one: the value
+ * itself, just below or just above, within the range of varints.
+ */
+uint64_t fuzzer_memory_near(fuzzer_prng_t* prng, uint64_t value)
+{
+    switch (fuzzer_prng_uniform(prng, 3)) {
+    case 0:
+        return (value > 0) ? value - 1 : value + 1;
+    case 1:
+        return (value < 0x3FFFFFFFFFFFFFFFull) ? value + 1 : value - 1;
+    default:
+        return value;
+    }
+}
+
+int fuzzer_memory_plausible(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng, fuzzer_memory_field_enum field, uint64_t* value)
+{
+    int is_known = fuzzer_memory_get(memory, field, value);
+
+    if (is_known) {
+        *value = fuzzer_memory_near(prng, *value);
+    }
+    return is_known;
+}
+
+int fuzzer_memory_pick_stream(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng, fuzzer_memory_stream_t* stream)
+{
+    size_t nb_stored;
+
+    if (memory == NULL || memory->nb_streams == 0) {
+        return 0;
+    }
+    nb_stored = (memory->nb_streams < FUZZER_MEMORY_NB_STREAMS) ? memory->nb_streams : FUZZER_MEMORY_NB_STREAMS;
+    *stream = memory->streams[fuzzer_prng_uniform(prng, nb_stored)];
+    return 1;
+}
+
+/* Record the IDs of the live paths of a multipath connection. The frames
+ * only carry the IDs of the paths whose status changes, the connection
+ * knows all of them.
+ */
+void fuzzer_memory_observe_paths(fuzzer_cnx_memory_t* memory, const picoquic_cnx_t* cnx)
+{
+    memory->nb_path_ids = 0;
+    for (int i = 0; i < cnx->nb_paths && memory->nb_path_ids < FUZZER_MEMORY_NB_PATHS; i++) {
+        memory->path_ids[memory->nb_path_ids++] = cnx->path[i]->unique_path_id;
+        fuzzer_memory_set_max(memory, fuzzer_memory_path_id, cnx->path[i]->unique_path_id);
+    }
+}
+
+int fuzzer_memory_pick_path_id(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng, uint64_t* path_id)
+{
+    if (memory == NULL || memory->nb_path_ids == 0) {
+        return 0;
+    }
+    *path_id = memory->path_ids[fuzzer_prng_uniform(prng, memory->nb_path_ids)];
+    return 1;
+}
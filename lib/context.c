@@ -22,6 +22,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include <picoquic.h>
 #include <picoquic_internal.h>
 #include <picoquic_utils.h>
@@ -73,8 +74,12 @@ static void fuzi_q_icid_list_delete_node(void* tree, picosplay_node_t* node)
         if (tree != NULL) {
             fuzzer_ctx_t* ctx = (fuzzer_ctx_t*)((char*)tree - offsetof(struct st_fuzzer_ctx_t, icid_tree));
             fuzi_q_icid_list_remove(ctx, icid_ctx);
+            fuzzer_capture_detach(ctx, icid_ctx);
         }
         /* Delete node */
+        if (icid_ctx->events != NULL) {
+            free(icid_ctx->events);
+        }
         free(icid_ctx);
     }
 }
@@ -86,19 +91,50 @@ static void remove_last_icid_from_list(fuzzer_ctx_t * ctx)
     }
 }
 
+uint64_t fuzzer_icid_random_seed(const picoquic_connection_id_t* icid, uint64_t trial_rank)
+{
+    uint8_t default_hash_seed[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    return picoquic_connection_id_hash(icid, default_hash_seed) ^ (trial_rank * 0x9e3779b97f4a7c15ull);
+}
+
+/* When replaying, use the target recorded for the trial instead of the
+ * scheduled one. Trials that are not listed are not fuzzed.
+ */
+static void fuzzer_replay_target(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx)
+{
+    if (ctx->replay != NULL) {
+        icid_ctx->target_state = fuzzer_cnx_state_max;
+        for (size_t i = 0; i < ctx->replay->nb_targets; i++) {
+            fuzzer_replay_target_t* target = &ctx->replay->targets[i];
+
+            if (target->trial_rank == icid_ctx->trial_rank &&
+                picoquic_compare_connection_id(&target->icid, &icid_ctx->icid) == 0) {
+                if (target->target_state >= 0 && target->target_state < fuzzer_cnx_state_max) {
+                    icid_ctx->target_state = (fuzzer_cnx_state_enum)target->target_state;
+                    icid_ctx->target_wait = target->target_wait;
+                    icid_ctx->target_bucket = fuzzer_wait_bucket(target->target_wait);
+                }
+                else {
+                    fuzzer_schedule_target(ctx, icid_ctx,
+                        (icid_ctx->trial_rank == 0) ? fuzzer_cnx_state_initial : fuzzer_cnx_state_ready);
+                }
+                break;
+            }
+        }
+    }
+}
+
 static fuzzer_icid_ctx_t* create_icid_ctx(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid)
 {
     fuzzer_icid_ctx_t* icid_ctx = (fuzzer_icid_ctx_t*)malloc(sizeof(fuzzer_icid_ctx_t));
     if (icid_ctx != NULL) {
         memset(icid_ctx, 0, sizeof(fuzzer_icid_ctx_t));
         (void)picoquic_parse_connection_id(icid->id, icid->id_len, &icid_ctx->icid);
-        uint8_t default_hash_seed[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-        icid_ctx->random_context = picoquic_connection_id_hash(icid, default_hash_seed);
+        icid_ctx->random_context = fuzzer_icid_random_seed(icid, 0);
         /* Set the initial values, e.g. target state */
-        uint64_t random_state = (icid_ctx->random_context ^ 0xdeadbeefc001cafeull) % fuzzer_cnx_state_max;
-        uint64_t random_wait = (icid_ctx->random_context >> 2) ^ 0xa1a2a3a4a5a6a7a8ull;
-        icid_ctx->target_state = (fuzzer_cnx_state_enum)random_state;
-        icid_ctx->target_wait = ((int)random_wait) % (ctx->wait_max[icid_ctx->target_state]+1);
+        fuzzer_schedule_target(ctx, icid_ctx, fuzzer_cnx_state_initial);
+        fuzzer_replay_target(ctx, icid_ctx);
+        fuzzer_capture_attach(ctx, icid_ctx);
         if (ctx->icid_mru != NULL) {
             ctx->icid_mru->icid_before = icid_ctx;
             icid_ctx->icid_after = ctx->icid_mru;
@@ -113,6 +149,66 @@ static fuzzer_icid_ctx_t* create_icid_ctx(fuzzer_ctx_t* ctx, picoquic_connection
     return icid_ctx;
 }
 
+/* Scheduling of target state and wait for new connections.
+ * The ICID random context seeds a short list of candidate (state, wait)
+ * pairs, and the scheduler picks the candidate whose cell has been
+ * fuzzed least so far. Cells that were assigned but not reached count
+ * for 1/FUZZER_SCHEDULER_MISS_WEIGHT of a fuzzed connection, so that states
+ * which are hard to reach, like closing, get more attempts without
+ * starving the others.
+ * The choice only depends on the ICID and on the history of the campaign,
+ * so replaying the same sequence of ICIDs yields the same assignments.
+ * Replays of suspect trials do not depend on the history, they use the
+ * recorded targets, see fuzzer_replay_target.
+ */
+
+int fuzzer_wait_bucket(int wait)
+{
+    int bucket = 0;
+
+    while (wait > 0 && bucket < FUZZER_NB_WAIT_BUCKETS - 1) {
+        bucket++;
+        wait >>= 1;
+    }
+    return bucket;
+}
+
+void fuzzer_schedule_target(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, fuzzer_cnx_state_enum min_state)
+{
+    fuzzer_prng_t prng;
+    uint64_t best_score = UINT64_MAX;
+
+    fuzzer_prng_seed(&prng, icid_ctx->random_context ^ 0xdeadbeefc001cafeull);
+
+    for (int i = 0; i < FUZZER_SCHEDULER_CANDIDATES; i++) {
+        fuzzer_cnx_state_enum state = (fuzzer_cnx_state_enum)(min_state +
+            fuzzer_prng_uniform(&prng, (uint64_t)(fuzzer_cnx_state_max - min_state)));
+        int wait_max = ctx->wait_max[state];
+        int bucket = (int)fuzzer_prng_uniform(&prng, (uint64_t)fuzzer_wait_bucket(wait_max) + 1);
+        int wait_low = (bucket == 0) ? 0 : (1 << (bucket - 1));
+        int wait_high = (bucket == FUZZER_NB_WAIT_BUCKETS - 1) ? wait_max : (1 << bucket) - 1;
+        int wait;
+        size_t fuzzed = ctx->cell_fuzzed[state][bucket];
+        size_t assigned = ctx->cell_assigned[state][bucket];
+        uint64_t score = (uint64_t)fuzzed * FUZZER_SCHEDULER_MISS_WEIGHT;
+
+        if (wait_high > wait_max) {
+            wait_high = wait_max;
+        }
+        wait = wait_low + (int)fuzzer_prng_uniform(&prng, (uint64_t)(wait_high - wait_low) + 1);
+        if (assigned > fuzzed) {
+            score += assigned - fuzzed;
+        }
+        if (score < best_score) {
+            best_score = score;
+            icid_ctx->target_state = state;
+            icid_ctx->target_bucket = bucket;
+            icid_ctx->target_wait = wait;
+        }
+    }
+    ctx->cell_assigned[icid_ctx->target_state][icid_ctx->target_bucket]++;
+}
+
 fuzzer_icid_ctx_t* fuzzer_get_icid_ctx(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid, uint64_t current_time)
 {
     fuzzer_icid_ctx_t test = { 0 };
@@ -146,11 +242,35 @@ fuzzer_icid_ctx_t* fuzzer_get_icid_ctx(fuzzer_ctx_t* ctx, picoquic_connection_id
 
     while (ctx->icid_lru != NULL && ctx->icid_lru->last_time + 2 * FUZI_Q_MAX_SILENCE < current_time) {
         remove_last_icid_from_list(ctx);
+        ctx->nb_icid_evicted++;
     }
 
     return icid_ctx;
 }
 
+/* Start a new fuzz trial on a connection that is already established.
+ * The random context is reseeded from the ICID and the trial rank, so
+ * each trial is fuzzed as if it was a new connection, and can be replayed.
+ * Only the states that the connection can still reach are scheduled.
+ * The observations made on the connection, e.g., the last MAX_DATA sent,
+ * remain valid and are kept.
+ */
+fuzzer_icid_ctx_t* fuzzer_start_trial(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid, uint64_t trial_rank, uint64_t current_time)
+{
+    fuzzer_icid_ctx_t* icid_ctx = fuzzer_get_icid_ctx(ctx, icid, current_time);
+
+    if (icid_ctx != NULL) {
+        icid_ctx->random_context = fuzzer_icid_random_seed(icid, trial_rank);
+        icid_ctx->trial_rank = trial_rank;
+        icid_ctx->packet_rank = 0;
+        icid_ctx->already_fuzzed = 0;
+        memset(icid_ctx->wait_count, 0, sizeof(icid_ctx->wait_count));
+        fuzzer_schedule_target(ctx, icid_ctx, fuzzer_cnx_state_ready);
+        fuzzer_replay_target(ctx, icid_ctx);
+    }
+    return icid_ctx;
+}
+
 /* Management of the fuzzer context itself.
  * Add definition of picoquic crypto random, so we can use it to 
  * initialize randomness when needed.
@@ -205,4 +325,61 @@ void fuzzer_random_cid(fuzzer_ctx_t* ctx, picoquic_connection_id_t* icid)
 void fuzi_q_fuzzer_release(fuzzer_ctx_t* fuzz_ctx)
 {
     picosplay_empty_tree(&fuzz_ctx->icid_tree);
+    fuzzer_capture_release(fuzz_ctx);
+}
+
+/* Log of the recently fuzzed packets.
+ * Consecutive packets of the same trial are merged in a single entry,
+ * so the ring covers as many connections as possible.
+ */
+void fuzzer_log_fuzzed(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, fuzzer_cnx_state_enum state, uint64_t current_time)
+{
+    fuzzer_log_entry_t* entry = NULL;
+
+    if (ctx->fuzz_log_nb > 0) {
+        entry = &ctx->fuzz_log[(ctx->fuzz_log_nb - 1) % FUZZER_LOG_SIZE];
+        if (picoquic_compare_connection_id(&entry->icid, &icid_ctx->icid) != 0 ||
+            entry->trial_rank != icid_ctx->trial_rank) {
+            entry = NULL;
+        }
+    }
+    if (entry == NULL) {
+        entry = &ctx->fuzz_log[ctx->fuzz_log_nb % FUZZER_LOG_SIZE];
+        memset(entry, 0, sizeof(fuzzer_log_entry_t));
+        entry->first_time = current_time;
+        entry->icid = icid_ctx->icid;
+        entry->trial_rank = icid_ctx->trial_rank;
+        entry->target_state = icid_ctx->target_state;
+        entry->target_wait = icid_ctx->target_wait;
+        ctx->fuzz_log_nb++;
+    }
+    entry->last_time = current_time;
+    entry->state = state;
+    entry->nb_packets++;
+    ctx->fuzz_log_packets++;
+}
+
+/* Print the log entries of the packets fuzzed at or after the specified time,
+ * oldest first. Returns the number of entries printed. The output can be
+ * used as input of the triage mode.
+ */
+size_t fuzzer_log_dump(fuzzer_ctx_t* ctx, FILE* F, uint64_t since_time)
+{
+    size_t nb_printed = 0;
+    size_t first = (ctx->fuzz_log_nb > FUZZER_LOG_SIZE) ? ctx->fuzz_log_nb - FUZZER_LOG_SIZE : 0;
+
+    for (size_t i = first; i < ctx->fuzz_log_nb; i++) {
+        fuzzer_log_entry_t* entry = &ctx->fuzz_log[i % FUZZER_LOG_SIZE];
+
+        if (entry->last_time >= since_time) {
+            fprintf(F, "%llu-%llu: ", (unsigned long long)entry->first_time, (unsigned long long)entry->last_time);
+            for (uint8_t x = 0; x < entry->icid.id_len; x++) {
+                fprintf(F, "%02x", entry->icid.id[x]);
+            }
+            fprintf(F, " trial %llu, state %d, %u packets fuzzed, target %d/%d\n", (unsigned long long)entry->trial_rank,
+                (int)entry->state, entry->nb_packets, (int)entry->target_state, entry->target_wait);
+            nb_printed++;
+        }
+    }
+    return nb_printed;
 }
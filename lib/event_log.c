@@ -0,0 +1,139 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Event log of fuzzed connections.
+ *
+ * Each packet processed by the fuzzer adds a small binary event to the
+ * ring of its connection. Formatting and disk I/O only happen when a
+ * ring is flushed, for the sampled connections, the fuzzed connections
+ * that ended abnormally, and the connections in flight when the server
+ * goes down. The flushed events are written as a qlog trace, one file
+ * per connection, named after the ICID.
+ */
+
+void fuzzer_event_record(fuzzer_icid_ctx_t* icid_ctx, uint64_t current_time, fuzzer_cnx_state_enum state,
+    uint8_t first_byte, size_t length, size_t fuzzed_length, int fuzzed)
+{
+    fuzzer_event_t* event;
+
+    if (icid_ctx->events == NULL) {
+        icid_ctx->events = (fuzzer_event_t*)malloc(sizeof(fuzzer_event_t) * FUZZER_EVENT_RING_SIZE);
+        if (icid_ctx->events == NULL) {
+            return;
+        }
+        icid_ctx->nb_events = 0;
+    }
+    event = &icid_ctx->events[icid_ctx->nb_events % FUZZER_EVENT_RING_SIZE];
+    event->time = current_time;
+    event->packet_rank = icid_ctx->packet_rank;
+    event->trial_rank = (uint32_t)icid_ctx->trial_rank;
+    event->length = (uint16_t)length;
+    event->fuzzed_length = (uint16_t)fuzzed_length;
+    event->first_byte = first_byte;
+    event->state = (uint8_t)state;
+    event->fuzzed = (uint8_t)fuzzed;
+    icid_ctx->nb_events++;
+}
+
+/* Sampling depends only on the ICID, so the same connections are
+ * sampled when a run is replayed.
+ */
+int fuzzer_event_is_sampled(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    if (ctx->event_sample == 0) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < icid_ctx->icid.id_len; i++) {
+        hash ^= icid_ctx->icid.id[i];
+        hash *= 0x100000001b3ull;
+    }
+    return (hash % ctx->event_sample) == 0;
+}
+
+int fuzzer_event_flush(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, char const* reason, int is_client)
+{
+    int ret = 0;
+    char icid_text[2 * PICOQUIC_CONNECTION_ID_MAX_SIZE + 1];
+    char file_name[512];
+    FILE* F = NULL;
+
+    if (icid_ctx->events == NULL || icid_ctx->nb_events == 0) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < icid_ctx->icid.id_len; i++) {
+        (void)picoquic_sprintf(icid_text + 2 * i, 3, NULL, "%02x", icid_ctx->icid.id[i]);
+    }
+    icid_text[2 * icid_ctx->icid.id_len] = 0;
+
+    if (picoquic_sprintf(file_name, sizeof(file_name), NULL, "%s%s%s.fuzi.qlog",
+        (ctx->event_dir == NULL) ? "" : ctx->event_dir, (ctx->event_dir == NULL) ? "" : PICOQUIC_FILE_SEPARATOR,
+        icid_text) != 0 || (F = picoquic_file_open(file_name, "w")) == NULL) {
+        ret = -1;
+    }
+    else {
+        size_t first = (icid_ctx->nb_events > FUZZER_EVENT_RING_SIZE) ? icid_ctx->nb_events - FUZZER_EVENT_RING_SIZE : 0;
+        uint64_t reference_time = icid_ctx->events[first % FUZZER_EVENT_RING_SIZE].time;
+
+        fprintf(F, "{ \"qlog_version\": \"0.3\", \"qlog_format\": \"JSON\", \"title\": \"fuzi_q events\",\n");
+        fprintf(F, "  \"description\": \"%s\",\n", reason);
+        fprintf(F, "  \"traces\": [{ \"vantage_point\": { \"type\": \"%s\" },\n", (is_client) ? "client" : "server");
+        fprintf(F, "    \"common_fields\": { \"ODCID\": \"%s\", \"time_format\": \"relative\", \"reference_time\": %llu.%03llu },\n",
+            icid_text, (unsigned long long)(reference_time / 1000), (unsigned long long)(reference_time % 1000));
+        fprintf(F, "    \"events\": [");
+        for (size_t i = first; i < icid_ctx->nb_events; i++) {
+            fuzzer_event_t* event = &icid_ctx->events[i % FUZZER_EVENT_RING_SIZE];
+            uint64_t delta_t = event->time - reference_time;
+
+            fprintf(F, "%s\n      { \"time\": %llu.%03llu, \"name\": \"fuzi_q:packet\", \"data\": { \"trial\": %u, \"packet_rank\": %llu, ",
+                (i == first) ? "" : ",", (unsigned long long)(delta_t / 1000), (unsigned long long)(delta_t % 1000),
+                event->trial_rank, (unsigned long long)event->packet_rank);
+            fprintf(F, "\"state\": %d, \"first_byte\": %d, \"length\": %d, \"fuzzed\": %s, \"fuzzed_length\": %d } }",
+                event->state, event->first_byte, event->length, (event->fuzzed) ? "true" : "false", event->fuzzed_length);
+        }
+        fprintf(F, "\n    ]\n  }]\n}\n");
+        (void)picoquic_file_close(F);
+        ctx->nb_event_files++;
+        /* Do not write the same events twice */
+        icid_ctx->nb_events = 0;
+    }
+
+    return ret;
+}
+
+void fuzzer_event_release(fuzzer_icid_ctx_t* icid_ctx)
+{
+    if (icid_ctx->events != NULL) {
+        free(icid_ctx->events);
+        icid_ctx->events = NULL;
+    }
+    icid_ctx->nb_events = 0;
+}
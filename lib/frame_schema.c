@@ -0,0 +1,236 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdint.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_internal.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+#ifndef PICOQUIC_STATELESS_RESET_TOKEN_SIZE
+#define PICOQUIC_STATELESS_RESET_TOKEN_SIZE 16
+#endif
+
+/* Frame schemas.
+ *
+ * The table describes the layout of the frames that the fuzzer knows.
+ * The generic engine parses a frame against its schema in a single pass,
+ * and can then mutate any of the fields with the varint mutations or by
+ * flipping bytes. Supporting a new extension frame only requires adding
+ * an entry to the table.
+ */
+
+#define FIELD_VARINT { fuzzer_field_varint, 0, 0 }
+#define FIELD_LENGTH { fuzzer_field_length, 0, 0 }
+#define FIELD_BYTES { fuzzer_field_bytes, 0, 0 }
+
+static const fuzzer_frame_schema_t fuzzer_frame_schemas[] = {
+    { "padding", picoquic_frame_type_padding, picoquic_frame_type_padding, 0, { FIELD_VARINT } },
+    { "ping", picoquic_frame_type_ping, picoquic_frame_type_ping, 0, { FIELD_VARINT } },
+    { "ack", picoquic_frame_type_ack, picoquic_frame_type_ack_ecn, 8, {
+        FIELD_VARINT, FIELD_VARINT, { fuzzer_field_count, 0, 0 }, FIELD_VARINT, { fuzzer_field_repeat, 2, 0 },
+        { fuzzer_field_varint, 0, 1 }, { fuzzer_field_varint, 0, 1 }, { fuzzer_field_varint, 0, 1 } } },
+    { "reset_stream", picoquic_frame_type_reset_stream, picoquic_frame_type_reset_stream, 3, { FIELD_VARINT, FIELD_VARINT, FIELD_VARINT } },
+    { "stop_sending", picoquic_frame_type_stop_sending, picoquic_frame_type_stop_sending, 2, { FIELD_VARINT, FIELD_VARINT } },
+    { "crypto", picoquic_frame_type_crypto_hs, picoquic_frame_type_crypto_hs, 3, { FIELD_VARINT, FIELD_LENGTH, FIELD_BYTES } },
+    { "new_token", picoquic_frame_type_new_token, picoquic_frame_type_new_token, 2, { FIELD_LENGTH, FIELD_BYTES } },
+    { "stream", picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max, 4, {
+        FIELD_VARINT, { fuzzer_field_varint, 0, 4 }, { fuzzer_field_length, 0, 2 }, FIELD_BYTES } },
+    { "max_data", picoquic_frame_type_max_data, picoquic_frame_type_max_data, 1, { FIELD_VARINT } },
+    { "max_stream_data", picoquic_frame_type_max_stream_data, picoquic_frame_type_max_stream_data, 2, { FIELD_VARINT, FIELD_VARINT } },
+    { "max_streams", picoquic_frame_type_max_streams_bidir, picoquic_frame_type_max_streams_unidir, 1, { FIELD_VARINT } },
+    { "data_blocked", picoquic_frame_type_data_blocked, picoquic_frame_type_data_blocked, 1, { FIELD_VARINT } },
+    { "stream_data_blocked", picoquic_frame_type_stream_data_blocked, picoquic_frame_type_stream_data_blocked, 2, { FIELD_VARINT, FIELD_VARINT } },
+    { "streams_blocked", picoquic_frame_type_streams_blocked_bidir, picoquic_frame_type_streams_blocked_unidir, 1, { FIELD_VARINT } },
+    { "new_connection_id", picoquic_frame_type_new_connection_id, picoquic_frame_type_new_connection_id, 5, {
+        FIELD_VARINT, FIELD_VARINT, { fuzzer_field_length8, 0, 0 }, FIELD_BYTES, { fuzzer_field_fixed, PICOQUIC_STATELESS_RESET_TOKEN_SIZE, 0 } } },
+    { "retire_connection_id", picoquic_frame_type_retire_connection_id, picoquic_frame_type_retire_connection_id, 1, { FIELD_VARINT } },
+    { "path_challenge", picoquic_frame_type_path_challenge, picoquic_frame_type_path_response, 1, { { fuzzer_field_fixed, 8, 0 } } },
+    { "connection_close", picoquic_frame_type_connection_close, picoquic_frame_type_connection_close, 4, {
+        FIELD_VARINT, FIELD_VARINT, FIELD_LENGTH, FIELD_BYTES } },
+    { "application_close", picoquic_frame_type_application_close, picoquic_frame_type_application_close, 3, {
+        FIELD_VARINT, FIELD_LENGTH, FIELD_BYTES } },
+    { "handshake_done", picoquic_frame_type_handshake_done, picoquic_frame_type_handshake_done, 0, { FIELD_VARINT } },
+    { "datagram", picoquic_frame_type_datagram, picoquic_frame_type_datagram_l, 2, { { fuzzer_field_length, 0, 1 }, FIELD_BYTES } },
+    { "ack_frequency", picoquic_frame_type_ack_frequency, picoquic_frame_type_ack_frequency, 4, {
+        FIELD_VARINT, FIELD_VARINT, FIELD_VARINT, FIELD_VARINT } },
+    { "time_stamp", picoquic_frame_type_time_stamp, picoquic_frame_type_time_stamp, 1, { FIELD_VARINT } },
+    { "path_abandon", picoquic_frame_type_path_abandon, picoquic_frame_type_path_abandon, 2, { FIELD_VARINT, FIELD_VARINT } },
+    { "path_backup", picoquic_frame_type_path_backup, picoquic_frame_type_path_backup, 2, { FIELD_VARINT, FIELD_VARINT } },
+    { "path_available", picoquic_frame_type_path_available, picoquic_frame_type_path_available, 2, { FIELD_VARINT, FIELD_VARINT } },
+    { "paths_blocked", picoquic_frame_type_paths_blocked, picoquic_frame_type_paths_blocked, 1, { FIELD_VARINT } },
+    { "bdp", picoquic_frame_type_bdp, picoquic_frame_type_bdp, 5, {
+        FIELD_VARINT, FIELD_VARINT, FIELD_VARINT, FIELD_LENGTH, FIELD_BYTES } }
+};
+
+#define FUZZER_NB_FRAME_SCHEMAS (sizeof(fuzzer_frame_schemas) / sizeof(fuzzer_frame_schema_t))
+
+const fuzzer_frame_schema_t* fuzzer_schema_find(uint64_t frame_type)
+{
+    for (size_t i = 0; i < FUZZER_NB_FRAME_SCHEMAS; i++) {
+        if (frame_type >= fuzzer_frame_schemas[i].frame_type_min && frame_type <= fuzzer_frame_schemas[i].frame_type_max) {
+            return &fuzzer_frame_schemas[i];
+        }
+    }
+    return NULL;
+}
+
+static int fuzzer_schema_add(fuzzer_parsed_frame_t* parsed, fuzzer_field_type_enum type, uint8_t* start, uint8_t* end, uint64_t value)
+{
+    if (parsed->nb_fields >= FUZZER_SCHEMA_MAX_PARSED) {
+        return -1;
+    }
+    parsed->fields[parsed->nb_fields].type = type;
+    parsed->fields[parsed->nb_fields].start = start;
+    parsed->fields[parsed->nb_fields].end = end;
+    parsed->fields[parsed->nb_fields].value = value;
+    parsed->nb_fields++;
+    return 0;
+}
+
+/* Parse the frame against its schema. The fields parsed before an error
+ * are kept, so that truncated or already damaged frames can still be
+ * mutated. Returns 0 if the whole frame was parsed.
+ */
+int fuzzer_schema_parse(uint8_t* bytes, uint8_t* bytes_max, fuzzer_parsed_frame_t* parsed)
+{
+    int ret = 0;
+    uint8_t* p;
+    uint64_t length = UINT64_MAX;
+    uint64_t count = 0;
+
+    parsed->frame_start = bytes;
+    parsed->frame_max = bytes_max;
+    parsed->nb_fields = 0;
+    parsed->schema = NULL;
+
+    if ((p = (uint8_t*)picoquic_frames_varint_decode(bytes, bytes_max, &parsed->frame_type)) == NULL ||
+        (parsed->schema = fuzzer_schema_find(parsed->frame_type)) == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < parsed->schema->nb_fields; i++) {
+        const fuzzer_field_schema_t* field = &parsed->schema->fields[i];
+        uint64_t nb_varints = 1;
+        uint64_t value = 0;
+        uint8_t* field_end;
+
+        if (field->type_mask != 0 && (parsed->frame_type & field->type_mask) == 0) {
+            continue;
+        }
+        switch (field->type) {
+        case fuzzer_field_repeat:
+            nb_varints = count * field->size;
+            /* Fall through */
+        case fuzzer_field_varint:
+        case fuzzer_field_length:
+        case fuzzer_field_count:
+            for (uint64_t j = 0; ret == 0 && j < nb_varints; j++) {
+                if ((field_end = (uint8_t*)picoquic_frames_varint_decode(p, bytes_max, &value)) == NULL ||
+                    fuzzer_schema_add(parsed, field->type, p, field_end, value) != 0) {
+                    ret = -1;
+                }
+                else {
+                    p = field_end;
+                }
+            }
+            if (field->type == fuzzer_field_length) {
+                length = value;
+            }
+            else if (field->type == fuzzer_field_count) {
+                count = value;
+            }
+            break;
+        case fuzzer_field_length8:
+            if (p >= bytes_max || fuzzer_schema_add(parsed, field->type, p, p + 1, *p) != 0) {
+                ret = -1;
+            }
+            else {
+                length = *p++;
+            }
+            break;
+        case fuzzer_field_fixed:
+        case fuzzer_field_bytes:
+            value = (field->type == fuzzer_field_fixed) ? field->size : length;
+            if (value == UINT64_MAX) {
+                value = bytes_max - p;
+            }
+            length = UINT64_MAX;
+            if (value > (uint64_t)(bytes_max - p) || fuzzer_schema_add(parsed, field->type, p, p + value, value) != 0) {
+                ret = -1;
+            }
+            else {
+                p += value;
+            }
+            break;
+        default:
+            ret = -1;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/* Mutate one field of the frame, chosen at random. Returns 1 if the
+ * frame was modified, 0 if the frame type is unknown or has no field.
+ */
+int fuzzer_schema_mutate(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
+{
+    fuzzer_parsed_frame_t parsed;
+    fuzzer_parsed_field_t* field;
+    uint64_t remaining;
+
+    (void)fuzzer_schema_parse(bytes, bytes_max, &parsed);
+    if (parsed.nb_fields == 0) {
+        return 0;
+    }
+    field = &parsed.fields[fuzzer_prng_uniform(prng, parsed.nb_fields)];
+    remaining = (uint64_t)(bytes_max - field->end);
+
+    switch (field->type) {
+    case fuzzer_field_length:
+        /* Length around the bytes left in the frame */
+        fuzzer_varint_mutate(prng, field->start, field->end, remaining);
+        break;
+    case fuzzer_field_length8: {
+        uint64_t values[5] = { 0, PICOQUIC_CONNECTION_ID_MAX_SIZE, PICOQUIC_CONNECTION_ID_MAX_SIZE + 1, 0xFF, 0 };
+        uint64_t value;
+        values[4] = fuzzer_varint_relative(prng, field->value, remaining);
+        value = values[fuzzer_prng_uniform(prng, 5)];
+        field->start[0] = (uint8_t)((value > 0xFF) ? 0xFF : value);
+        break;
+    }
+    case fuzzer_field_fixed:
+    case fuzzer_field_bytes:
+        if (field->start >= field->end) {
+            return 0;
+        }
+        field->start[fuzzer_prng_uniform(prng, field->end - field->start)] ^= (uint8_t)(1 + fuzzer_prng_uniform(prng, 255));
+        break;
+    default:
+        fuzzer_varint_mutate(prng, field->start, field->end, FUZZER_VARINT_NO_LIMIT);
+        break;
+    }
+    return 1;
+}
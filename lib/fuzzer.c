@@ -77,24 +77,92 @@ static inline int local_picoquic_max_bits(uint64_t val) {
 /* if the functions are indeed available in headers but somehow not seen by the compiler pass. */
 /* This is safer than extern declarations for functions that might be static inline elsewhere. */
 
-static int encode_and_overwrite_varint(uint8_t* field_start, uint8_t* field_end, uint8_t* frame_max, uint64_t new_value);
-uint8_t* fuzz_in_place_or_skip_varint(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max, int do_fuzz);
-void default_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max);
-void reset_stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max);
-void stop_sending_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max);
-void connection_close_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max);
-void fuzz_random_byte(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max);
-void max_stream_data_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max);
-void max_streams_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max);
+uint8_t* fuzz_in_place_or_skip_varint(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, int do_fuzz);
+void default_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max);
+void reset_stream_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory);
+void stop_sending_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory);
+void connection_close_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max);
+void fuzz_random_byte(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max);
+void max_stream_data_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory);
+void max_streams_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory);
+
+/* Set a varint field to a boundary value of its encoding length */
+static int fuzz_varint_boundary(fuzzer_prng_t* prng, uint8_t* field, uint8_t* field_end)
+{
+    return (field != NULL && field_end != NULL && field_end > field) &&
+        fuzzer_varint_overwrite(field, field_end, fuzzer_varint_boundary(prng, field_end - field));
+}
+
+/*
+ * Stateful mutations, using the observations made on the connection.
+ * They return 1 if the frame was modified, 0 if nothing was known, if
+ * the field does not end within the frame, or if the new value did not fit.
+ */
+
+/* Rewrite a varint field with a value close to the one observed */
+static int fuzzer_memory_rewrite(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng, fuzzer_memory_field_enum field,
+    uint8_t* field_start, uint8_t* field_end, uint8_t* frame_max)
+{
+    uint64_t value;
+
+    return field_end <= frame_max && fuzzer_memory_plausible(memory, prng, field, &value) &&
+        fuzzer_varint_overwrite(field_start, field_end, value);
+}
+
+/* Rewrite a stream ID with a stream in use, or with the next stream of the
+ * same type, which the peer has not seen yet. The end of the data sent on
+ * that stream is returned in offset.
+ */
+static int fuzzer_memory_rewrite_stream(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng,
+    uint8_t* field_start, uint8_t* field_end, uint8_t* frame_max, uint64_t* offset)
+{
+    fuzzer_memory_stream_t stream;
+
+    if (field_end > frame_max || !fuzzer_memory_pick_stream(memory, prng, &stream)) {
+        return 0;
+    }
+    if (fuzzer_prng_uniform(prng, 4) == 0) {
+        stream.stream_id += 4;
+        stream.offset = 0;
+    }
+    if (offset != NULL) {
+        *offset = stream.offset;
+    }
+    return fuzzer_varint_overwrite(field_start, field_end, stream.stream_id);
+}
+
+/* Rewrite a path ID with the ID of a live path, or of the next path that
+ * the peer has not seen yet. Falls back to the largest path ID observed
+ * in the frames if the connection is not multipath.
+ */
+static int fuzzer_memory_rewrite_path_id(const fuzzer_cnx_memory_t* memory, fuzzer_prng_t* prng,
+    uint8_t* field_start, uint8_t* field_end, uint8_t* frame_max)
+{
+    uint64_t path_id;
+
+    if (field_end > frame_max) {
+        return 0;
+    }
+    if (!fuzzer_memory_pick_path_id(memory, prng, &path_id)) {
+        return fuzzer_memory_rewrite(memory, prng, fuzzer_memory_path_id, field_start, field_end, frame_max);
+    }
+    if (fuzzer_prng_uniform(prng, 4) == 0 && fuzzer_memory_get(memory, fuzzer_memory_path_id, &path_id)) {
+        path_id++;
+    }
+    return fuzzer_varint_overwrite(field_start, field_end, path_id);
+}
 
 /*
  * Fuzz packet header bits (Reserved, Spin, Key Phase)
  */
-static void fuzz_packet_header_bits(uint8_t* header_bytes, size_t header_length, uint64_t fuzz_pilot)
+static void fuzz_packet_header_bits(uint8_t* header_bytes, size_t header_length, fuzzer_prng_t* prng)
 {
+    uint64_t fuzz_pilot;
+
     if (header_length == 0) {
         return;
     }
+    fuzz_pilot = fuzzer_prng_next(prng);
 
     uint8_t first_byte = header_bytes[0];
     int is_long_header = (first_byte & 0x80) != 0;
@@ -173,13 +241,13 @@ static void fuzz_packet_header_bits(uint8_t* header_bytes, size_t header_length,
     }
 }
 
-void max_streams_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void max_streams_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* max_streams_field_start = bytes + 1; /* Skip frame type */
     uint64_t original_max_streams_val; /* Not used by current strategies but good for consistency */
 
     if (max_streams_field_start >= bytes_max) { /* Not enough space for the varint field */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
 
@@ -188,7 +256,7 @@ void max_streams_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* byte
     if (!max_streams_field_end || max_streams_field_start == max_streams_field_end) {
         /* Parsing failed or empty varint, which is invalid for this frame. */
         /* Fallback to default fuzzer, which might corrupt the type or try to make sense of it. */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
     /* Ensure max_streams_field_end does not exceed bytes_max, though picoquic_frames_varint_decode should handle this. */
@@ -196,48 +264,51 @@ void max_streams_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* byte
         max_streams_field_end = bytes_max;
     }
 
+    if (fuzzer_prng_uniform(prng, 4) == 0 && fuzzer_memory_rewrite(memory, prng,
+        (bytes[0] == picoquic_frame_type_max_streams_bidir) ? fuzzer_memory_max_streams_bidir : fuzzer_memory_max_streams_unidir,
+        max_streams_field_start, max_streams_field_end, bytes_max)) {
+        return;
+    }
+
 
     int num_strategies = 6;
-    int choice = fuzz_pilot % num_strategies;
-    fuzz_pilot >>= 3; /* ceil(log2(6)) = 3 bits */
+    int choice = fuzzer_prng_uniform(prng, num_strategies);
 
     switch (choice) {
     case 0: /* Strategy 1: Fuzz Maximum Streams (generic varint fuzz) */
         /* Since it's the only field, its varint fuzzing can extend up to bytes_max. */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, max_streams_field_start, bytes_max, 1);
-        break;
-    case 1: /* Strategy 2: Set Maximum Streams to 0 */
-        encode_and_overwrite_varint(max_streams_field_start, max_streams_field_end, bytes_max, 0);
+        fuzz_in_place_or_skip_varint(prng, max_streams_field_start, bytes_max, 1);
         break;
-    case 2: /* Strategy 3: Set Maximum Streams to 1 */
-        encode_and_overwrite_varint(max_streams_field_start, max_streams_field_end, bytes_max, 1);
+    case 1: /* Strategy 2: Set Maximum Streams to a boundary of its encoding */
+    case 2:
+        fuzz_varint_boundary(prng, max_streams_field_start, max_streams_field_end);
         break;
     case 3: /* Strategy 4: Set Maximum Streams to a small value */
-        encode_and_overwrite_varint(max_streams_field_start, max_streams_field_end, bytes_max, (fuzz_pilot % 16));
+        fuzzer_varint_overwrite(max_streams_field_start, max_streams_field_end, fuzzer_prng_uniform(prng, 16));
         break;
-    case 4: /* Strategy 5: Set Maximum Streams to a large valid value (2^60 - 1) */
-        encode_and_overwrite_varint(max_streams_field_start, max_streams_field_end, bytes_max, (1ULL << 60) - 1);
+    case 4: /* Strategy 5: Set Maximum Streams around the protocol limit, 2^60 */
+        fuzzer_varint_mutate(prng, max_streams_field_start, max_streams_field_end, 1ull << 60);
         break;
     case 5: /* Strategy 6 (Default/Fallback): Call default_frame_fuzzer */
     default:
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         break;
     }
 }
 
-void max_stream_data_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void max_stream_data_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* p = bytes + 1; /* Skip frame type */
 
     if (p >= bytes_max) { /* Not enough space for even one field */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
 
     uint8_t* stream_id_start = p;
     uint8_t* stream_id_end = (uint8_t*)picoquic_frames_varint_skip(stream_id_start, bytes_max);
     if (!stream_id_end || stream_id_end > bytes_max) { /* Stream ID varint parsing failed or went out of bounds */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
 
@@ -246,128 +317,109 @@ void max_stream_data_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t*
     if (max_stream_data_start < bytes_max) { // Check if there's space for the second field to start
         actual_max_stream_data_end = (uint8_t*)picoquic_frames_varint_skip(max_stream_data_start, bytes_max);
         if (!actual_max_stream_data_end) { // Malformed Max Stream Data varint
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+            default_frame_fuzzer(prng, bytes, bytes_max);
+            return;
+        }
+    }
+
+    if (fuzzer_prng_uniform(prng, 4) == 0) {
+        /* Stream in use, or credit close to the last one sent */
+        if ((fuzzer_prng_uniform(prng, 2) == 0) ?
+            fuzzer_memory_rewrite_stream(memory, prng, stream_id_start, stream_id_end, bytes_max, NULL) :
+            fuzzer_memory_rewrite(memory, prng, fuzzer_memory_max_stream_data, max_stream_data_start, actual_max_stream_data_end, bytes_max)) {
             return;
         }
     }
 
     int num_strategies = 9;
-    int choice = fuzz_pilot % num_strategies;
-    fuzz_pilot >>= 4; /* ceil(log2(9)) = 4 bits */
+    int choice = fuzzer_prng_uniform(prng, num_strategies);
 
     switch (choice) {
     case 0: /* Fuzz Stream ID */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, stream_id_start, stream_id_end, 1);
+        fuzz_in_place_or_skip_varint(prng, stream_id_start, stream_id_end, 1);
         break;
     case 1: /* Fuzz Maximum Stream Data */
         if (max_stream_data_start < bytes_max) {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, max_stream_data_start, bytes_max, 1);
+            fuzz_in_place_or_skip_varint(prng, max_stream_data_start, bytes_max, 1);
         } else {
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback if field doesn't exist */
+            default_frame_fuzzer(prng, bytes, bytes_max); /* Fallback if field doesn't exist */
         }
         break;
-    case 2: /* Set Stream ID to 0 */
-        encode_and_overwrite_varint(stream_id_start, stream_id_end, bytes_max, 0);
-        break;
-    case 3: /* Set Stream ID to 1 */
-        encode_and_overwrite_varint(stream_id_start, stream_id_end, bytes_max, 1);
-        break;
-    case 4: /* Set Stream ID to a large value */
-        encode_and_overwrite_varint(stream_id_start, stream_id_end, bytes_max, 0x3FFFFFFFFFFFFFFFull);
-        break;
-    case 5: /* Set Maximum Stream Data to 0 */
-        if (max_stream_data_start < bytes_max) {
-            encode_and_overwrite_varint(max_stream_data_start, actual_max_stream_data_end ? actual_max_stream_data_end : bytes_max, bytes_max, 0);
-        } else {
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback if field doesn't exist */
-        }
-        break;
-    case 6: /* Set Maximum Stream Data to 1 */
-        if (max_stream_data_start < bytes_max) {
-            encode_and_overwrite_varint(max_stream_data_start, actual_max_stream_data_end ? actual_max_stream_data_end : bytes_max, bytes_max, 1);
-        } else {
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback if field doesn't exist */
-        }
+    case 2: /* Set Stream ID to a boundary of its encoding */
+    case 3:
+    case 4:
+        fuzz_varint_boundary(prng, stream_id_start, stream_id_end);
         break;
-    case 7: /* Set Maximum Stream Data to a large value */
-        if (max_stream_data_start < bytes_max) {
-            encode_and_overwrite_varint(max_stream_data_start, actual_max_stream_data_end ? actual_max_stream_data_end : bytes_max, bytes_max, 0x3FFFFFFFFFFFFFFFull);
-        } else {
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback if field doesn't exist */
+    case 5: /* Set Maximum Stream Data to a boundary of its encoding */
+    case 6:
+    case 7:
+        if (!fuzz_varint_boundary(prng, max_stream_data_start, actual_max_stream_data_end)) {
+            default_frame_fuzzer(prng, bytes, bytes_max); /* Fallback if field doesn't exist */
         }
         break;
     case 8: /* Default/Fallback */
     default:
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         break;
     }
 }
 
-void connection_close_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void connection_close_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
 {
     uint8_t frame_type_value = bytes[0];
     uint8_t* p = bytes + 1; /* Current position after frame type */
 
     if (p > bytes_max) { /* Should not happen if frame has at least a type byte */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
 
     uint8_t* error_code_start = p;
     uint8_t* error_code_end = (uint8_t*)picoquic_frames_varint_skip(p, bytes_max);
-    if (!error_code_end || error_code_end > bytes_max) { default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); return; }
+    if (!error_code_end || error_code_end > bytes_max) { default_frame_fuzzer(prng, bytes, bytes_max); return; }
     p = error_code_end;
 
     uint8_t* offending_frame_type_start = NULL;
     uint8_t* offending_frame_type_end = NULL;
     if (frame_type_value == picoquic_frame_type_connection_close) { /* 0x1c */
-        if (p > bytes_max) { default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); return; }
+        if (p > bytes_max) { default_frame_fuzzer(prng, bytes, bytes_max); return; }
         offending_frame_type_start = p;
         offending_frame_type_end = (uint8_t*)picoquic_frames_varint_skip(p, bytes_max);
-        if (!offending_frame_type_end || offending_frame_type_end > bytes_max) { default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); return; }
+        if (!offending_frame_type_end || offending_frame_type_end > bytes_max) { default_frame_fuzzer(prng, bytes, bytes_max); return; }
         p = offending_frame_type_end;
     }
 
-    if (p > bytes_max) { default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); return; }
+    if (p > bytes_max) { default_frame_fuzzer(prng, bytes, bytes_max); return; }
     uint8_t* reason_len_start = p;
     uint64_t original_reason_len_val;
     uint8_t* reason_len_end = (uint8_t*)picoquic_frames_varint_decode(p, bytes_max, &original_reason_len_val);
-    if (!reason_len_end || reason_len_end > bytes_max) { default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); return; }
+    if (!reason_len_end || reason_len_end > bytes_max) { default_frame_fuzzer(prng, bytes, bytes_max); return; }
     p = reason_len_end;
     uint8_t* reason_phrase_start = p;
 
-    int choice = fuzz_pilot % 14; /* 7 existing + 7 new = 14 strategies */
-    fuzz_pilot >>= 4; /* ceil(log2(14)) = 4 bits */
+    int choice = fuzzer_prng_uniform(prng, 14); /* 7 existing + 7 new = 14 strategies */
 
     uint64_t remaining_buffer_space = (bytes_max > reason_phrase_start) ? (bytes_max - reason_phrase_start) : 0;
 
     switch (choice) {
     case 0: /* Existing: Fuzz Error Code (varint fuzz) */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, error_code_start, error_code_end, 1);
+        fuzz_in_place_or_skip_varint(prng, error_code_start, error_code_end, 1);
         break;
     case 1: /* Existing: Fuzz Offending Frame Type (if 0x1c) (varint fuzz) */
         if (frame_type_value == picoquic_frame_type_connection_close && offending_frame_type_start && offending_frame_type_end > offending_frame_type_start) {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, offending_frame_type_start, offending_frame_type_end, 1);
+            fuzz_in_place_or_skip_varint(prng, offending_frame_type_start, offending_frame_type_end, 1);
         } else {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, error_code_start, error_code_end, 1); /* Fallback */
+            fuzz_in_place_or_skip_varint(prng, error_code_start, error_code_end, 1); /* Fallback */
         }
         break;
-    case 2: /* Existing: Reason Phrase Length - set to 0 */
-        encode_and_overwrite_varint(reason_len_start, reason_len_end, bytes_max, 0);
+    case 2: /* Existing: Reason Phrase Length - set to a boundary of its encoding */
+        fuzz_varint_boundary(prng, reason_len_start, reason_len_end);
         break;
-    case 3: /* Existing: Reason Phrase Length - set to small value (fuzz_pilot % 10 + 1) */
-        encode_and_overwrite_varint(reason_len_start, reason_len_end, bytes_max, (fuzz_pilot % 10) + 1);
+    case 3: /* Existing: Reason Phrase Length - set to small value (1 to 10) */
+        fuzzer_varint_overwrite(reason_len_start, reason_len_end, fuzzer_prng_uniform(prng, 10) + 1);
         break;
-    case 4: /* Existing: Reason Phrase Length - potentially large or exceeding available space */
-        {
-            uint64_t new_len;
-            if ((fuzz_pilot & 1) == 0) { 
-                 new_len = 0x3FFFFFFFFFFFFFFF; 
-            } else { 
-                 new_len = (fuzz_pilot >> 1) % (remaining_buffer_space + 5); 
-            }
-            encode_and_overwrite_varint(reason_len_start, reason_len_end, bytes_max, new_len);
-        }
+    case 4: /* Existing: Reason Phrase Length - around the available space */
+        fuzzer_varint_mutate(prng, reason_len_start, reason_len_end, remaining_buffer_space);
         break;
     case 5: /* Existing: Fuzz Reason Phrase content (random byte) */
         {
@@ -379,53 +431,44 @@ void connection_close_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t*
                     phrase_data_end_limit = bytes_max;
                 }
                 if (reason_phrase_start < phrase_data_end_limit) {
-                    fuzz_random_byte(fuzz_pilot, reason_phrase_start, phrase_data_end_limit);
+                    fuzz_random_byte(prng, reason_phrase_start, phrase_data_end_limit);
                 } else if (fuzzed_reason_len_val > 0 && reason_phrase_start < bytes_max) {
-                    fuzz_random_byte(fuzz_pilot, reason_phrase_start, bytes_max);
+                    fuzz_random_byte(prng, reason_phrase_start, bytes_max);
                 }
             } else { 
-                 default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+                 default_frame_fuzzer(prng, bytes, bytes_max);
             }
         }
         break;
     case 6: /* Existing: Default random byte on whole frame payload */
         if (bytes + 1 < bytes_max) {
-            fuzz_random_byte(fuzz_pilot, bytes + 1, bytes_max);
+            fuzz_random_byte(prng, bytes + 1, bytes_max);
         } else { 
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+            default_frame_fuzzer(prng, bytes, bytes_max);
         }
         break;
 
     /* New Strategies */
-    case 7: /* Set Error Code to 0 */
-        encode_and_overwrite_varint(error_code_start, error_code_end, bytes_max, 0);
-        break;
-    case 8: /* Set Error Code to large value */
-        encode_and_overwrite_varint(error_code_start, error_code_end, bytes_max, 0x3FFFFFFFFFFFFFFFull);
+    case 7: /* Set Error Code to a boundary of its encoding */
+    case 8:
+        fuzz_varint_boundary(prng, error_code_start, error_code_end);
         break;
-    case 9: /* Set Offending Frame Type to 0 (if 0x1c) */
-        if (frame_type_value == picoquic_frame_type_connection_close && offending_frame_type_start && offending_frame_type_end > offending_frame_type_start) {
-            encode_and_overwrite_varint(offending_frame_type_start, offending_frame_type_end, bytes_max, 0);
-        } else {
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback */
-        }
-        break;
-    case 10: /* Set Offending Frame Type to large varint (if 0x1c) */
-        if (frame_type_value == picoquic_frame_type_connection_close && offending_frame_type_start && offending_frame_type_end > offending_frame_type_start) {
-            encode_and_overwrite_varint(offending_frame_type_start, offending_frame_type_end, bytes_max, 0x3FFFFFFFFFFFFFFFull);
-        } else {
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback */
+    case 9: /* Set Offending Frame Type to a boundary of its encoding (if 0x1c) */
+    case 10:
+        if (frame_type_value != picoquic_frame_type_connection_close ||
+            !fuzz_varint_boundary(prng, offending_frame_type_start, offending_frame_type_end)) {
+            default_frame_fuzzer(prng, bytes, bytes_max); /* Fallback */
         }
         break;
     case 11: /* Set Reason Phrase Length to exactly match remaining buffer space */
         if (reason_len_start && reason_len_end > reason_len_start) {
-             encode_and_overwrite_varint(reason_len_start, reason_len_end, bytes_max, remaining_buffer_space);
-        } else { default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); }
+             fuzzer_varint_overwrite(reason_len_start, reason_len_end, remaining_buffer_space);
+        } else { default_frame_fuzzer(prng, bytes, bytes_max); }
         break;
     case 12: /* Set Reason Phrase Length to slightly larger than remaining buffer space */
         if (reason_len_start && reason_len_end > reason_len_start) {
-            encode_and_overwrite_varint(reason_len_start, reason_len_end, bytes_max, remaining_buffer_space + (fuzz_pilot % 5) + 1);
-        } else { default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); }
+            fuzzer_varint_overwrite(reason_len_start, reason_len_end, remaining_buffer_space + fuzzer_prng_uniform(prng, 5) + 1);
+        } else { default_frame_fuzzer(prng, bytes, bytes_max); }
         break;
     case 13: /* Fill Reason Phrase with non-UTF-8 pattern */
         {
@@ -451,25 +494,25 @@ void connection_close_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t*
         break;
 
     default: /* Should not be reached */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         break;
     }
 }
 
-void stop_sending_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void stop_sending_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* stream_id_start = bytes + 1; /* Skip frame type */
     uint8_t* app_error_code_start = NULL;
     uint8_t* app_error_code_end = NULL; /* End of the app error code varint */
 
     if (stream_id_start >= bytes_max) {
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
 
     app_error_code_start = (uint8_t*)picoquic_frames_varint_skip(stream_id_start, bytes_max);
     if (app_error_code_start == NULL || app_error_code_start > bytes_max) { /* app_error_code_start can be == bytes_max if stream_id is last field and takes all space */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
     
@@ -478,7 +521,7 @@ void stop_sending_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* byt
     if (app_error_code_start < bytes_max) {
         app_error_code_end = (uint8_t*)picoquic_frames_varint_skip(app_error_code_start, bytes_max);
         if (app_error_code_end == NULL) { /* Malformed app error code varint */
-             default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+             default_frame_fuzzer(prng, bytes, bytes_max);
              return;
         }
     } else {
@@ -493,61 +536,53 @@ void stop_sending_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* byt
          actual_app_error_code_end = (uint8_t*)picoquic_frames_varint_skip(app_error_code_start, bytes_max);
     }
 
+    if (fuzzer_prng_uniform(prng, 4) == 0 &&
+        fuzzer_memory_rewrite_stream(memory, prng, stream_id_start, app_error_code_start, bytes_max, NULL)) {
+        return;
+    }
+
 
-    int choice = fuzz_pilot % 8; /* 5 existing + 3 new = 8 strategies */
-    fuzz_pilot >>= 3; /* ceil(log2(8)) = 3 bits */
+    int choice = fuzzer_prng_uniform(prng, 8); /* 5 existing + 3 new = 8 strategies */
 
     switch (choice) {
     case 0: /* Existing: Fuzz Stream ID */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, stream_id_start, app_error_code_start, 1);
+        fuzz_in_place_or_skip_varint(prng, stream_id_start, app_error_code_start, 1);
         break;
     case 1: /* Existing: Fuzz App Error Code */
         if (app_error_code_start < bytes_max) {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, app_error_code_start, bytes_max, 1);
+            fuzz_in_place_or_skip_varint(prng, app_error_code_start, bytes_max, 1);
         } else { 
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback if no app error code field */
+            default_frame_fuzzer(prng, bytes, bytes_max); /* Fallback if no app error code field */
         }
         break;
     case 2: /* Existing: Fuzz a random byte in the whole frame (excluding type) */
         if (bytes + 1 < bytes_max) {
-            fuzz_random_byte(fuzz_pilot, bytes + 1, bytes_max);
+            fuzz_random_byte(prng, bytes + 1, bytes_max);
         } else if (bytes < bytes_max) {
-             fuzz_random_byte(fuzz_pilot, bytes, bytes_max);
+             fuzz_random_byte(prng, bytes, bytes_max);
         }
         break;
-    case 3: /* Existing: Set Stream ID to 0 */
-        encode_and_overwrite_varint(stream_id_start, app_error_code_start, bytes_max, 0);
+    case 3: /* Set Stream ID to a boundary of its encoding */
+    case 5:
+        fuzz_varint_boundary(prng, stream_id_start, app_error_code_start);
         break;
-    case 4: /* Existing: Set App Error Code to 0 */
-        if (app_error_code_start < bytes_max) {
-             encode_and_overwrite_varint(app_error_code_start, actual_app_error_code_end ? actual_app_error_code_end : bytes_max, bytes_max, 0);
-        } else { 
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);/* Fallback if no app error code field */
+    case 4: /* Set App Error Code to a boundary of its encoding */
+    case 7:
+        if (!fuzz_varint_boundary(prng, app_error_code_start, actual_app_error_code_end)) {
+            default_frame_fuzzer(prng, bytes, bytes_max);/* Fallback if no app error code field */
         }
         break;
-
-    /* New Strategies */
-    case 5: /* Set Stream ID to large value */
-        encode_and_overwrite_varint(stream_id_start, app_error_code_start, bytes_max, 0x3FFFFFFFFFFFFFFFull);
-        break;
     case 6: /* Set Stream ID to small odd value (e.g., 1) */
-        encode_and_overwrite_varint(stream_id_start, app_error_code_start, bytes_max, 1);
-        break;
-    case 7: /* Set App Error Code to large value */
-        if (app_error_code_start < bytes_max) {
-            encode_and_overwrite_varint(app_error_code_start, actual_app_error_code_end ? actual_app_error_code_end : bytes_max, bytes_max, 0x3FFFFFFFFFFFFFFFull);
-        } else {
-            default_frame_fuzzer(fuzz_pilot, bytes, bytes_max); /* Fallback if no app error code field */
-        }
+        fuzzer_varint_overwrite(stream_id_start, app_error_code_start, 1);
         break;
 
     default: /* Should not be reached with % 8 */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         break;
     }
 }
 
-void reset_stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void reset_stream_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* current_field = bytes + 1; /* Skip frame type */
     uint8_t* stream_id_start = current_field;
@@ -556,78 +591,76 @@ void reset_stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* byt
     /* uint8_t* final_size_end = NULL; // This variable is unused. actual_final_size_end is used instead. */
 
     if (stream_id_start >= bytes_max) {
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
 
     app_error_code_start = (uint8_t*)picoquic_frames_varint_skip(stream_id_start, bytes_max);
     if (app_error_code_start == NULL || app_error_code_start >= bytes_max) {
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
 
     final_size_start = (uint8_t*)picoquic_frames_varint_skip(app_error_code_start, bytes_max);
     if (final_size_start == NULL || final_size_start > bytes_max) { /* Allow final_size_start == bytes_max if final_size is empty */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         return;
     }
     
     /* The end of the final size field is bytes_max for fuzz_in_place_or_skip_varint */
-    /* actual_final_size_end is used to determine the true end of the varint for encode_and_overwrite_varint */
+    /* actual_final_size_end is used to determine the true end of the varint for fuzzer_varint_overwrite */
     uint8_t* actual_final_size_end = (uint8_t*)picoquic_frames_varint_skip(final_size_start, bytes_max);
     /* If actual_final_size_end is NULL, it implies final_size_start itself was at bytes_max or malformed. */
-    /* For encode_and_overwrite_varint, if field_end is NULL or <= field_start, it usually means no fuzz or error. */
+    /* For fuzzer_varint_overwrite, if field_end is NULL or <= field_start, it usually means no fuzz or error. */
     /* We will use bytes_max as the de-facto end for the last field if actual_final_size_end is problematic. */
 
-    int choice = fuzz_pilot % 12; /* 6 existing + 6 new strategies */
-    fuzz_pilot >>= 4; /* ceil(log2(12)) = 4 bits */
+    if (fuzzer_prng_uniform(prng, 4) == 0) {
+        /* Reset a stream in use, with a final size close to the data already sent */
+        uint64_t offset = 0;
+        if (fuzzer_memory_rewrite_stream(memory, prng, stream_id_start, app_error_code_start, bytes_max, &offset)) {
+            (void)fuzzer_varint_overwrite(final_size_start, actual_final_size_end, fuzzer_memory_near(prng, offset));
+            return;
+        }
+    }
+
+    int choice = fuzzer_prng_uniform(prng, 12); /* 6 existing + 6 new strategies */
 
     switch (choice) {
     case 0: /* Original: Fuzz Stream ID */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, stream_id_start, app_error_code_start, 1);
+        fuzz_in_place_or_skip_varint(prng, stream_id_start, app_error_code_start, 1);
         break;
     case 1: /* Original: Fuzz App Error Code */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, app_error_code_start, final_size_start, 1);
+        fuzz_in_place_or_skip_varint(prng, app_error_code_start, final_size_start, 1);
         break;
     case 2: /* Original: Fuzz Final Size */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, final_size_start, bytes_max, 1);
+        fuzz_in_place_or_skip_varint(prng, final_size_start, bytes_max, 1);
         break;
     case 3: /* Original: Fuzz a random byte in the whole frame (excluding type) */
         if (bytes + 1 < bytes_max) {
-            fuzz_random_byte(fuzz_pilot, bytes + 1, bytes_max);
+            fuzz_random_byte(prng, bytes + 1, bytes_max);
         } else if (bytes < bytes_max) {
-             fuzz_random_byte(fuzz_pilot, bytes, bytes_max);
+             fuzz_random_byte(prng, bytes, bytes_max);
         }
         break;
-    case 4: /* Original: Set Stream ID to 0 */
-        encode_and_overwrite_varint(stream_id_start, app_error_code_start, bytes_max, 0);
-        break;
-    case 5: /* Original: Set Final Size to a large value */
-        encode_and_overwrite_varint(final_size_start, actual_final_size_end ? actual_final_size_end : bytes_max, bytes_max, 0x3FFFFFFFFFFFFFFFull);
-        break;
-    
-    /* New Strategies */
-    case 6: /* Set Stream ID to large value */
-        encode_and_overwrite_varint(stream_id_start, app_error_code_start, bytes_max, 0x3FFFFFFFFFFFFFFFull);
+    case 4: /* Set Stream ID to a boundary of its encoding */
+    case 6:
+        fuzz_varint_boundary(prng, stream_id_start, app_error_code_start);
         break;
     case 7: /* Set Stream ID to small odd value (e.g., 1) */
-        encode_and_overwrite_varint(stream_id_start, app_error_code_start, bytes_max, 1);
+        fuzzer_varint_overwrite(stream_id_start, app_error_code_start, 1);
         break;
-    case 8: /* Set App Error Code to 0 */
-        encode_and_overwrite_varint(app_error_code_start, final_size_start, bytes_max, 0);
-        break;
-    case 9: /* Set App Error Code to large value */
-        encode_and_overwrite_varint(app_error_code_start, final_size_start, bytes_max, 0x3FFFFFFFFFFFFFFFull);
-        break;
-    case 10: /* Set Final Size to 0 */
-        encode_and_overwrite_varint(final_size_start, actual_final_size_end ? actual_final_size_end : bytes_max, bytes_max, 0);
+    case 8: /* Set App Error Code to a boundary of its encoding */
+    case 9:
+        fuzz_varint_boundary(prng, app_error_code_start, final_size_start);
         break;
-    case 11: /* Set Final Size to 1 */
-        encode_and_overwrite_varint(final_size_start, actual_final_size_end ? actual_final_size_end : bytes_max, bytes_max, 1);
+    case 5: /* Set Final Size to a boundary of its encoding */
+    case 10:
+    case 11:
+        fuzz_varint_boundary(prng, final_size_start, actual_final_size_end);
         break;
 
     default: /* Should not be reached with % 12 */
-        default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+        default_frame_fuzzer(prng, bytes, bytes_max);
         break;
     }
 }
@@ -637,37 +670,30 @@ void reset_stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* byt
  * Basic fuzz test just tries to flip some bits in random packets
  */
 
-uint32_t basic_packet_fuzzer(fuzzer_ctx_t* ctx, uint64_t fuzz_pilot,
+uint32_t basic_packet_fuzzer(fuzzer_ctx_t* ctx, fuzzer_prng_t* prng,
     uint8_t* bytes, size_t bytes_max, size_t length, size_t header_length)
 {
     uint32_t fuzz_index = 0;
-    uint64_t initial_fuzz_pilot = fuzz_pilot; /* Save for independent fuzz actions */
 
     /* Fuzz packet header bits with a certain probability */
-    if (length > 0 && (initial_fuzz_pilot & 0xFF) < 32) { /* Roughly 12.5% chance (32/256) */
-        fuzz_packet_header_bits(&bytes[0], header_length, initial_fuzz_pilot >> 8);
+    if (length > 0 && fuzzer_prng_uniform(prng, 8) == 0) { /* 12.5% chance */
+        fuzz_packet_header_bits(&bytes[0], header_length, prng);
         ctx->nb_header_fuzzed++;
     }
-    /* Continue with original fuzz_pilot for the main payload fuzzing logic,
-     * but shift it to ensure different fuzzing actions than header.
-     */
-    fuzz_pilot = initial_fuzz_pilot >> 16;
-
 
     /* Once in 64, fuzz by changing the length */
-    if ((fuzz_pilot & 0x3F) == 0xD) {
+    if (fuzzer_prng_uniform(prng, 64) == 0) {
         uint32_t fuzz_length_max = (uint32_t)(length + 16u);
         uint32_t fuzzed_length;
 
         if (fuzz_length_max > bytes_max) {
             fuzz_length_max = (uint32_t)bytes_max;
         }
-        fuzz_pilot >>= 4; /* Different consumption from initial_fuzz_pilot's first 3 bits */
-        fuzzed_length = 16 + (uint32_t)((fuzz_pilot & 0xFFFF) % fuzz_length_max);
-        fuzz_pilot >>= 16;
+        fuzzed_length = 16 + (uint32_t)fuzzer_prng_uniform(prng, fuzz_length_max);
         if (fuzzed_length > length) {
+            uint8_t pad_byte = (uint8_t)fuzzer_prng_next(prng);
             for (uint32_t i = (uint32_t)length; i < fuzzed_length; i++) {
-                bytes[i] = (uint8_t)fuzz_pilot;
+                bytes[i] = pad_byte;
             }
         }
         length = fuzzed_length;
@@ -680,13 +706,16 @@ uint32_t basic_packet_fuzzer(fuzzer_ctx_t* ctx, uint64_t fuzz_pilot,
     else {
         size_t fuzz_target = length - header_length;
         if (fuzz_target > 0) {
-            /* Find the position that shall be fuzzed */
-            fuzz_index = (uint32_t)(header_length + (fuzz_pilot & 0xFFFF) % fuzz_target);
-            fuzz_pilot >>= 16;
-            while (fuzz_pilot != 0 && fuzz_index < length) {
+            /* Find the position that shall be fuzzed, then overwrite 1 to 6 bytes */
+            size_t nb_bytes = 1 + (size_t)fuzzer_prng_uniform(prng, 6);
+            uint64_t fuzz_bytes = fuzzer_prng_next(prng);
+
+            fuzz_index = (uint32_t)(header_length + fuzzer_prng_uniform(prng, fuzz_target));
+            while (nb_bytes > 0 && fuzz_index < length) {
                 /* flip one byte */
-                bytes[fuzz_index++] = (uint8_t)(fuzz_pilot & 0xFF);
-                fuzz_pilot >>= 8;
+                bytes[fuzz_index++] = (uint8_t)(fuzz_bytes & 0xFF);
+                fuzz_bytes >>= 8;
+                nb_bytes--;
                 ctx->nb_fuzzed++;
             }
         }
@@ -697,111 +726,28 @@ uint32_t basic_packet_fuzzer(fuzzer_ctx_t* ctx, uint64_t fuzz_pilot,
 
 /* Frame specific fuzzers. */
 
-void fuzz_random_byte(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void fuzz_random_byte(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
 {
     if (bytes != NULL && bytes < bytes_max) { /* Ensure there's at least one byte to fuzz */
         size_t l = bytes_max - bytes;
-        size_t x = (l > 0) ? (fuzz_pilot % l) : 0; /* Ensure x is valid if l is 0 */
-        uint8_t byte_mask = (uint8_t)(fuzz_pilot >> 8);
+        size_t x = (size_t)fuzzer_prng_uniform(prng, l);
+        uint8_t byte_mask = (uint8_t)fuzzer_prng_next(prng);
         if (l > 0) {
              bytes[x] ^= byte_mask;
         }
     }
 }
 
-void ack_frequency_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
-{
-    uint8_t* payload_start = bytes;
-    uint8_t* current_field = bytes;
-
-    current_field = (uint8_t*)picoquic_frames_varint_skip(current_field, bytes_max);
-    payload_start = current_field;
-
-    if (current_field == NULL || current_field >= bytes_max) {
-        if (bytes < bytes_max) {
-            fuzz_random_byte(fuzz_pilot, bytes, bytes_max);
-        }
-        return;
-    }
-
-    int choice = fuzz_pilot % 4;
-    fuzz_pilot >>= 2;
-
-    uint8_t* seq_num_start = payload_start;
-    uint8_t* pkt_tol_start = NULL;
-    uint8_t* upd_delay_start = NULL;
-
-    if (seq_num_start < bytes_max) {
-        pkt_tol_start = (uint8_t*)picoquic_frames_varint_skip(seq_num_start, bytes_max);
-    }
-    if (pkt_tol_start != NULL && pkt_tol_start < bytes_max) {
-        upd_delay_start = (uint8_t*)picoquic_frames_varint_skip(pkt_tol_start, bytes_max);
-    }
-
-    switch (choice) {
-    case 0:
-        if (seq_num_start != NULL && seq_num_start < bytes_max) {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, seq_num_start, bytes_max, 1);
-        }
-        break;
-    case 1:
-        if (pkt_tol_start != NULL && pkt_tol_start < bytes_max) {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, pkt_tol_start, bytes_max, 1);
-        }
-        break;
-    case 2:
-        if (upd_delay_start != NULL && upd_delay_start < bytes_max) {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, upd_delay_start, bytes_max, 1);
-        }
-        break;
-    case 3:
-        if (payload_start < bytes_max) {
-            uint8_t* payload_end = bytes_max;
-            if (upd_delay_start != NULL && upd_delay_start < bytes_max) {
-                 uint8_t* temp_end = (uint8_t*)picoquic_frames_varint_skip(upd_delay_start, bytes_max);
-                 if (temp_end != NULL && temp_end <= bytes_max) payload_end = temp_end;
-            } else if (pkt_tol_start != NULL && pkt_tol_start < bytes_max) {
-                 uint8_t* temp_end = (uint8_t*)picoquic_frames_varint_skip(pkt_tol_start, bytes_max);
-                 if (temp_end != NULL && temp_end <= bytes_max) payload_end = temp_end;
-            } else if (seq_num_start != NULL && seq_num_start < bytes_max) {
-                 uint8_t* temp_end = (uint8_t*)picoquic_frames_varint_skip(seq_num_start, bytes_max);
-                 if (temp_end != NULL && temp_end <= bytes_max) payload_end = temp_end;
-            }
-            if (payload_start < payload_end) {
-                 fuzz_random_byte(fuzz_pilot, payload_start, payload_end);
-            } else if (payload_start < bytes_max) {
-                 fuzz_random_byte(fuzz_pilot, payload_start, bytes_max);
-            }
-        }
-        break;
-    default:
-        break;
-    }
-}
-
-uint8_t* fuzz_in_place_or_skip_varint(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max, int do_fuzz)
+uint8_t* fuzz_in_place_or_skip_varint(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, int do_fuzz)
 {
-    if (bytes != NULL) {
-        uint8_t* head_bytes = bytes;
-        bytes = (uint8_t *)picoquic_frames_varint_skip(bytes, bytes_max);
-        if (bytes != NULL && do_fuzz && (bytes > head_bytes)){ /* Check l > 0 */
-            size_t l = bytes - head_bytes;
-            size_t x = fuzz_pilot % l;
-            uint8_t byte_mask = (uint8_t)(fuzz_pilot >> 3);
-            if (x == 0 && l > 1) { /* Only apply 0x3F mask if not a single byte varint to preserve length encoding */
-                 byte_mask &= 0x3f;
-            } else if (x == 0 && l == 1) { /* For single byte varint, ensure it's a valid varint encoding */
-                 byte_mask = (head_bytes[x] ^ byte_mask) & 0x3F; /* Apply fuzz then mask to be valid */
-                 head_bytes[x] = byte_mask; /* Direct assignment after calculating fuzzed value */
-                 return bytes; /* Return early as we directly modified */
-            }
-            head_bytes[x] ^= byte_mask; /* Use head_bytes for modification */
-        }
+    if (bytes == NULL) {
+        return NULL;
     }
-    return bytes;
+    return (do_fuzz) ? fuzzer_varint_mutate(prng, bytes, bytes_max, FUZZER_VARINT_NO_LIMIT) :
+        (uint8_t*)picoquic_frames_varint_skip(bytes, bytes_max);
 }
 
-void varint_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max, size_t nb_varints)
+void varint_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, size_t nb_varints)
 {
     size_t fuzz_target;
     uint8_t * first_byte = bytes;
@@ -810,25 +756,24 @@ void varint_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max
     if (nb_varints <= 1 && nb_varints > 0) { /* If only one varint, target it */
         fuzz_target = 0;
     } else if (nb_varints > 1) {
-        fuzz_target = 1 + fuzz_pilot % (nb_varints - 1);
+        fuzz_target = 1 + (size_t)fuzzer_prng_uniform(prng, nb_varints - 1);
     } else { /* nb_varints is 0 */
         return;
     }
-    fuzz_pilot >>= 8;
     bytes = first_byte;
 
     while (bytes != NULL && bytes < bytes_max && nb_skipped < fuzz_target) {
         nb_skipped++;
         bytes = (uint8_t *)picoquic_frames_varint_skip(bytes, bytes_max);
     }
-    fuzz_in_place_or_skip_varint(fuzz_pilot, bytes, bytes_max, 1);
+    fuzz_in_place_or_skip_varint(prng, bytes, bytes_max, 1);
 }
 
-void ack_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start_bytes, uint8_t* frame_max_bytes)
+void ack_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* frame_start_bytes, uint8_t* frame_max_bytes)
 {
     if (frame_start_bytes < frame_max_bytes) {
-        if (((fuzz_pilot >> 16) & 0x07) == 1) {
-            uint8_t bit_to_flip = 1 << (((fuzz_pilot >> 19) % 5) + 2);
+        if (fuzzer_prng_uniform(prng, 8) == 0) {
+            uint8_t bit_to_flip = (uint8_t)(1 << (fuzzer_prng_uniform(prng, 5) + 2));
             frame_start_bytes[0] ^= bit_to_flip;
         }
     }
@@ -839,11 +784,9 @@ void ack_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start_bytes, uint8_t*
         num_varints_in_frame++;
         current_bytes = (uint8_t*)picoquic_frames_varint_skip(current_bytes, frame_max_bytes);
     }
-    varint_frame_fuzzer(fuzz_pilot, frame_start_bytes, frame_max_bytes, num_varints_in_frame);
-
-    if ((fuzz_pilot & 0xF) == 0x1) {
-        fuzz_pilot >>= 4;
+    varint_frame_fuzzer(prng, frame_start_bytes, frame_max_bytes, num_varints_in_frame);
 
+    if (fuzzer_prng_uniform(prng, 16) == 0) {
         uint8_t* largest_ack_ptr = NULL;
         uint8_t* ack_range_count_ptr = NULL;
         uint8_t* temp_ptr = frame_start_bytes;
@@ -860,21 +803,58 @@ void ack_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start_bytes, uint8_t*
         if (temp_ptr == NULL || temp_ptr >= frame_max_bytes) return;
         ack_range_count_ptr = temp_ptr;
 
-        if ((fuzz_pilot & 0x1) == 0) {
-            if (largest_ack_ptr != NULL && largest_ack_ptr < frame_max_bytes) {
-                uint8_t value_to_write = (fuzz_pilot >> 1) & 0x1;
-                largest_ack_ptr[0] = value_to_write;
-            }
+        if (fuzzer_prng_uniform(prng, 2) == 0) {
+            fuzzer_varint_overwrite(largest_ack_ptr, (uint8_t*)picoquic_frames_varint_skip(largest_ack_ptr, frame_max_bytes),
+                fuzzer_prng_uniform(prng, 2));
         }
-        fuzz_pilot >>= 2;
+        fuzzer_varint_overwrite(ack_range_count_ptr, (uint8_t*)picoquic_frames_varint_skip(ack_range_count_ptr, frame_max_bytes), 0);
+    }
+}
 
-        if (ack_range_count_ptr != NULL && ack_range_count_ptr < frame_max_bytes) {
-            ack_range_count_ptr[0] = 0x00;
+/* Move the frame to a stream in use, at an offset close to the data already sent */
+static int stream_frame_memory_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory)
+{
+    uint8_t* stream_id_start = bytes + 1;
+    uint8_t* stream_id_end = (stream_id_start < bytes_max) ? (uint8_t*)picoquic_frames_varint_skip(stream_id_start, bytes_max) : NULL;
+    uint64_t offset = 0;
+    int was_fuzzed = 0;
+
+    if (stream_id_end != NULL && fuzzer_memory_rewrite_stream(memory, prng, stream_id_start, stream_id_end, bytes_max, &offset)) {
+        was_fuzzed = 1;
+        if ((bytes[0] & 4) != 0) {
+            uint8_t* offset_end = (uint8_t*)picoquic_frames_varint_skip(stream_id_end, bytes_max);
+            (void)fuzzer_varint_overwrite(stream_id_end, offset_end, fuzzer_memory_near(prng, offset));
         }
     }
+    return was_fuzzed;
 }
 
-void stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+/* Mutate the stream data as HTTP/3 or QPACK content, without changing
+ * the stream header.
+ */
+static int stream_frame_payload_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
+{
+    uint64_t stream_id = 0;
+    uint64_t offset = 0;
+    uint64_t data_length;
+    uint8_t* data = (uint8_t*)picoquic_frames_varint_decode(bytes + 1, bytes_max, &stream_id);
+
+    if (data != NULL && (bytes[0] & 4) != 0) {
+        data = (uint8_t*)picoquic_frames_varint_decode(data, bytes_max, &offset);
+    }
+    if (data != NULL && (bytes[0] & 2) != 0) {
+        if ((data = (uint8_t*)picoquic_frames_varint_decode(data, bytes_max, &data_length)) != NULL &&
+            data_length < (uint64_t)(bytes_max - data)) {
+            bytes_max = data + data_length;
+        }
+    }
+    return fuzzer_h3_stream_mutate(prng, stream_id, offset, data, bytes_max);
+}
+
+/* The stream data is only mutated as HTTP/3 content if the connection
+ * negotiated HTTP/3, other applications get the generic mutations.
+ */
+void stream_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory, int is_h3)
 {
     uint8_t* first_byte = bytes;
     int len_bit = bytes[0] & 2;
@@ -884,8 +864,14 @@ void stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max
     int fuzz_stream_id_flag = 0;
     int fuzz_random_flag = 0;
 
-    uint64_t fuzz_variant = (fuzz_pilot ^ 0x57ea3f8a3ef822e8ull) % 5;
-    fuzz_pilot >>=3; /* Consume for variant */
+    if (is_h3 && fuzzer_prng_uniform(prng, 2) == 0 && stream_frame_payload_fuzzer(prng, bytes, bytes_max)) {
+        return;
+    }
+    if (fuzzer_prng_uniform(prng, 4) == 0 && stream_frame_memory_fuzzer(prng, bytes, bytes_max, memory)) {
+        return;
+    }
+
+    uint64_t fuzz_variant = fuzzer_prng_uniform(prng, 5);
 
     switch (fuzz_variant) {
     case 0: bytes[0] ^= 1; break; /* FIN bit */
@@ -897,33 +883,25 @@ void stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max
 
     if (bytes < bytes_max) bytes++; else bytes = NULL;
 
-    bytes = fuzz_in_place_or_skip_varint(fuzz_pilot, bytes, bytes_max, fuzz_stream_id_flag);
-    fuzz_pilot >>= 8;
+    bytes = fuzz_in_place_or_skip_varint(prng, bytes, bytes_max, fuzz_stream_id_flag);
 
     if (off_bit) {
         if (fuzz_offset_flag) {
             uint8_t* field_start = bytes;
             uint8_t* field_end = (uint8_t*)picoquic_frames_varint_skip(field_start, bytes_max);
             if (field_end != NULL && field_start != field_end) {
-                if ((fuzz_pilot & 0x03) == 0) {
-                    size_t varint_len = field_end - field_start;
-                    if (varint_len > 0 && varint_len <= 8) {
-                        field_start[0] |= 0x3F;
-                        for (size_t i = 1; i < varint_len; i++) field_start[i] = 0xFF;
-                    } else {
-                        fuzz_in_place_or_skip_varint(fuzz_pilot >> 2, field_start, bytes_max, 1);
-                    }
+                if (fuzzer_prng_uniform(prng, 4) == 0) {
+                    fuzz_varint_boundary(prng, field_start, field_end);
                 } else {
-                    fuzz_in_place_or_skip_varint(fuzz_pilot >> 2, field_start, bytes_max, 1);
+                    fuzz_in_place_or_skip_varint(prng, field_start, bytes_max, 1);
                 }
                 bytes = field_end;
             } else {
-                bytes = fuzz_in_place_or_skip_varint(fuzz_pilot >> 2, field_start, bytes_max, 1);
+                bytes = fuzz_in_place_or_skip_varint(prng, field_start, bytes_max, 1);
             }
         } else {
             bytes = (uint8_t*)picoquic_frames_varint_skip(bytes, bytes_max);
         }
-        fuzz_pilot >>= 8;
     }
 
     if (len_bit) {
@@ -933,28 +911,19 @@ void stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max
             uint8_t* length_field_end = (uint8_t*)picoquic_frames_varint_decode(length_field_start, bytes_max, &original_length_val);
 
             if (length_field_end != NULL && length_field_start != length_field_end) {
-                int length_fuzz_choice = fuzz_pilot % 8;
-                fuzz_pilot >>= 3;
+                int length_fuzz_choice = fuzzer_prng_uniform(prng, 8);
 
-                if (length_fuzz_choice < 2) {
-                    uint64_t large_value = (length_fuzz_choice == 0) ? 65536 : 0x3FFFFFFFFFFFFFFF;
-                    if (!encode_and_overwrite_varint(length_field_start, length_field_end, bytes_max, large_value)) {
-                        fuzz_in_place_or_skip_varint(fuzz_pilot, length_field_start, bytes_max, 1);
-                    }
-                } else if (length_fuzz_choice < 4) {
-                     size_t varint_len = length_field_end - length_field_start;
-                     if (varint_len > 0 && varint_len <= 8) {
-                         length_field_start[0] |= 0x3F;
-                         for (size_t i = 1; i < varint_len; i++) length_field_start[i] = 0xFF;
-                     } else {
-                         fuzz_in_place_or_skip_varint(fuzz_pilot, length_field_start, bytes_max, 1);
-                     }
+                if (length_fuzz_choice < 4) {
+                    /* Length around the data actually present */
+                    fuzzer_varint_mutate(prng, length_field_start, length_field_end, (uint64_t)(bytes_max - length_field_end));
+                } else if (length_fuzz_choice < 6) {
+                    fuzz_varint_boundary(prng, length_field_start, length_field_end);
                 } else {
-                    fuzz_in_place_or_skip_varint(fuzz_pilot, length_field_start, bytes_max, 1);
+                    fuzz_in_place_or_skip_varint(prng, length_field_start, bytes_max, 1);
                 }
                 bytes = length_field_end;
             } else {
-                bytes = fuzz_in_place_or_skip_varint(fuzz_pilot, length_field_start, bytes_max, 1);
+                bytes = fuzz_in_place_or_skip_varint(prng, length_field_start, bytes_max, 1);
             }
         } else {
             bytes = (uint8_t*)picoquic_frames_varint_skip(bytes, bytes_max);
@@ -962,142 +931,31 @@ void stream_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max
     }
 
     if (bytes != NULL && fuzz_random_flag && first_byte +1 < bytes_max) { /* ensure space for at least one byte */
-        fuzz_random_byte(fuzz_pilot, first_byte + 1, bytes_max);
-    }
-}
-
-void datagram_frame_fuzzer(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t* frame_max)
-{
-    if (frame_start >= frame_max) return;
-
-    uint8_t type_byte = frame_start[0];
-    uint8_t* payload_start = frame_start + 1;
-
-    if (payload_start > frame_max) {
-         frame_start[0] ^= (uint8_t)(fuzz_pilot & 0xFF);
-        return;
-    }
-
-    if (type_byte & 1) {
-        uint8_t* length_start = payload_start;
-        uint64_t original_length;
-        uint8_t* length_end = (uint8_t*)picoquic_frames_varint_decode(length_start, frame_max, &original_length);
-
-        if (length_end != NULL && length_start != length_end) {
-            uint8_t* data_actual_start = length_end;
-
-            int choice = fuzz_pilot % 8;
-            fuzz_pilot >>= 3;
-
-            if (choice < 2) {
-                uint64_t large_value = (choice == 0) ? 65536 : 0x3FFFFFFFFFFFFFFF;
-                encode_and_overwrite_varint(length_start, length_end, frame_max, large_value);
-            } else if (choice == 2) {
-                encode_and_overwrite_varint(length_start, length_end, frame_max, 0);
-            } else if (choice < 5) {
-                fuzz_in_place_or_skip_varint(fuzz_pilot, length_start, frame_max, 1);
-            }
-
-            if (data_actual_start < frame_max) {
-                size_t fuzzable_data_len = 0;
-                if (original_length > 0 && data_actual_start + original_length <= frame_max) {
-                    fuzzable_data_len = original_length;
-                } else if (original_length > 0 && data_actual_start < frame_max) {
-                    fuzzable_data_len = frame_max - data_actual_start;
-                }
-
-                if (fuzzable_data_len > 0) {
-                    size_t num_flips = 1 + (fuzz_pilot % 2);
-                    fuzz_pilot >>= 1;
-                    for (size_t i = 0; i < num_flips; i++) {
-                        if (fuzzable_data_len == 0) break;
-                        size_t flip_idx = fuzz_pilot % fuzzable_data_len;
-                        if (icid_ctx == NULL && fuzz_pilot == 0) {
-                            fuzz_pilot = frame_start[0];
-                        } else if (fuzz_pilot == 0 && icid_ctx != NULL) {
-                             fuzz_pilot = picoquic_test_random(&icid_ctx->random_context);
-                        }
-                        data_actual_start[flip_idx] ^= (uint8_t)(fuzz_pilot & 0xFF);
-                        fuzz_pilot >>= 8;
-                    }
-                }
-            }
-        } else {
-            frame_start[0] ^= (uint8_t)(fuzz_pilot & 0xFF);
-        }
-    } else {
-        if (payload_start < frame_max) {
-            size_t data_present_len = frame_max - payload_start;
-            size_t num_flips = 1 + (fuzz_pilot % 3);
-            fuzz_pilot >>= 2;
-            for (size_t i = 0; i < num_flips; i++) {
-                if (data_present_len == 0) break;
-                size_t flip_idx = fuzz_pilot % data_present_len;
-                 if (icid_ctx == NULL && fuzz_pilot == 0) {
-                    fuzz_pilot = frame_start[0];
-                } else if (fuzz_pilot == 0 && icid_ctx != NULL) {
-                     fuzz_pilot = picoquic_test_random(&icid_ctx->random_context);
-                }
-                payload_start[flip_idx] ^= (uint8_t)(fuzz_pilot & 0xFF);
-                fuzz_pilot >>= 8;
-            }
-        } else {
-             frame_start[0] ^= (uint8_t)(fuzz_pilot & 0xFF);
-        }
+        fuzz_random_byte(prng, first_byte + 1, bytes_max);
     }
 }
 
-void challenge_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
-{
-    size_t x = fuzz_pilot % 41;
-
-    if (x == 0) {
-        bytes[0] ^= 1;
-    }
-    else {
-        x = 1 + ((x - 1) & 7);
-        if (bytes + x < bytes_max) {
-            bytes[x] ^= (uint8_t)(fuzz_pilot >> 5);
-        }
-    }
-}
-
-/* padding_frame_fuzzer: MODIFIED for Handshake Done tracking */
-void padding_frame_fuzzer(picoquic_cnx_t* cnx, fuzzer_icid_ctx_t* icid_ctx, uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void padding_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
 {
     size_t l = bytes_max - bytes;
     if (l == 0) return;
 
-    /* HANDSHAKE_DONE tracking */
-    if (icid_ctx != NULL && cnx != NULL && !picoquic_is_client(cnx) && bytes[0] == picoquic_frame_type_handshake_done) {
-        icid_ctx->handshake_done_sent_by_server = 1;
-    }
-
-    int action_choice = fuzz_pilot % 3;
-    fuzz_pilot >>= 2;
+    int action_choice = fuzzer_prng_uniform(prng, 3);
 
     if (action_choice == 0 && bytes[0] == picoquic_frame_type_padding && l > 1) {
         for (uint8_t* p = bytes + 1; p < bytes_max; p++) {
-            if (fuzz_pilot == 0 && icid_ctx != NULL) {
-                 fuzz_pilot = picoquic_test_random(&icid_ctx->random_context);
-            } else if (fuzz_pilot == 0 && icid_ctx == NULL) {
-                 fuzz_pilot = bytes[0] ^ 0xFF; /* Basic replenishment if no context */
-            }
-            if ((fuzz_pilot & 0x03) == 0) {
-                *p = (uint8_t)((fuzz_pilot >> 2) % 255) + 1;
+            if (fuzzer_prng_uniform(prng, 4) == 0) {
+                *p = (uint8_t)fuzzer_prng_uniform(prng, 255) + 1;
             }
-            fuzz_pilot >>= 4;
         }
     } else if (action_choice == 1) {
         int fuzz_type_decision = 1;
         if (l > 1) {
-            fuzz_type_decision = (fuzz_pilot & 7) == 0;
-            fuzz_pilot >>= 3;
+            fuzz_type_decision = fuzzer_prng_uniform(prng, 8) == 0;
         }
 
         if (fuzz_type_decision) {
-            int flip = fuzz_pilot & 1;
-            fuzz_pilot >>=1;
+            int flip = (int)fuzzer_prng_uniform(prng, 2);
 
             switch (bytes[0]) {
             case picoquic_frame_type_padding:
@@ -1110,7 +968,7 @@ void padding_frame_fuzzer(picoquic_cnx_t* cnx, fuzzer_icid_ctx_t* icid_ctx, uint
                 bytes[0] = (flip) ? picoquic_frame_type_ping : picoquic_frame_type_padding;
                 break;
             default:
-                bytes[0] ^= (uint8_t)(fuzz_pilot & 0xFF);
+                bytes[0] ^= (uint8_t)fuzzer_prng_next(prng);
                 break;
             }
         }
@@ -1137,20 +995,19 @@ void padding_frame_fuzzer(picoquic_cnx_t* cnx, fuzzer_icid_ctx_t* icid_ctx, uint
             size_t x_m = insert_table_size;
             do {
                 if (x_m == 0) { x_i = 0; break;} /* Avoid modulo by zero if table is empty or l is too small for all entries */
-                x_i = fuzz_pilot % x_m;
+                x_i = (size_t)fuzzer_prng_uniform(prng, x_m);
                 x_m = x_i;
             } while (x_i > 0 && insert_table[x_i].i_count > l);
 
             if(insert_table[x_i].i_count <= l) { /* Ensure selected frame fits */
                 bytes[0] = insert_table[x_i].i_type;
-                fuzz_pilot >>= 4;
-                varint_frame_fuzzer(fuzz_pilot, bytes, bytes_max, insert_table[x_i].i_count);
+                varint_frame_fuzzer(prng, bytes, bytes_max, insert_table[x_i].i_count);
             }
         }
     }
 }
 
-void new_token_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t* bytes_max)
+void new_token_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* frame_start, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* token_len_varint_start;
     uint8_t* token_data_start;
@@ -1160,7 +1017,7 @@ void new_token_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t*
 
     if (token_len_varint_start == NULL || token_len_varint_start >= bytes_max) {
         if (frame_start < bytes_max) {
-            fuzz_random_byte(fuzz_pilot, frame_start, bytes_max);
+            fuzz_random_byte(prng, frame_start, bytes_max);
         }
         return;
     }
@@ -1168,41 +1025,38 @@ void new_token_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t*
     token_data_start = (uint8_t*)picoquic_frames_varint_decode(token_len_varint_start, bytes_max, &actual_token_length_val);
 
     if (token_data_start == NULL) {
-        fuzz_in_place_or_skip_varint(fuzz_pilot, token_len_varint_start, bytes_max, 1);
+        fuzz_in_place_or_skip_varint(prng, token_len_varint_start, bytes_max, 1);
+        return;
+    }
+
+    if (memory != NULL && memory->token_length > 0 && fuzzer_prng_uniform(prng, 4) == 0 &&
+        token_data_start + memory->token_length <= bytes_max) {
+        /* Send again the start of a token already sent */
+        memcpy(token_data_start, memory->token, memory->token_length);
         return;
     }
 
-    int choice = fuzz_pilot % 4;
-    fuzz_pilot >>= 2;
+    int choice = fuzzer_prng_uniform(prng, 4);
 
     switch (choice) {
     case 0:
         {
-            int len_choice = fuzz_pilot % 4;
-            fuzz_pilot >>= 2;
+            int len_choice = fuzzer_prng_uniform(prng, 4);
 
             switch (len_choice) {
             case 0: case 1: case 2: /* Fall through to general fuzz for simplicity */
-                 fuzz_in_place_or_skip_varint(fuzz_pilot, token_len_varint_start, bytes_max, 1);
+                 fuzz_in_place_or_skip_varint(prng, token_len_varint_start, bytes_max, 1);
                  return; /* Return after this attempt */
             default:
-                {
-                    uint8_t* temp_len_end = (uint8_t*)picoquic_frames_varint_skip(token_len_varint_start, bytes_max);
-                    if (temp_len_end > token_len_varint_start) { /* Check if varint has any length */
-                        size_t len_varint_byte_len = temp_len_end - token_len_varint_start;
-                        token_len_varint_start[0] |= 0x3F;
-                        for (size_t i = 1; i < len_varint_byte_len; i++) {
-                            token_len_varint_start[i] = 0xFF;
-                        }
-                    }
-                    return;
-                }
+                /* Token length around the bytes left in the frame */
+                fuzzer_varint_mutate(prng, token_len_varint_start, token_data_start, (uint64_t)(bytes_max - token_data_start));
+                return;
             }
         }
         break; /* Should be unreachable due to returns in case 0 */
 
     case 3:
-        fuzz_in_place_or_skip_varint(fuzz_pilot, token_len_varint_start, bytes_max, 1);
+        fuzz_in_place_or_skip_varint(prng, token_len_varint_start, bytes_max, 1);
         break;
 
     case 1:
@@ -1213,8 +1067,7 @@ void new_token_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t*
             }
             if (token_data_start < effective_token_data_end) {
                 uint8_t pattern = 0x00;
-                int pattern_choice = fuzz_pilot % 3;
-                fuzz_pilot >>= 2;
+                int pattern_choice = fuzzer_prng_uniform(prng, 3);
                 if (pattern_choice == 0) pattern = 0x00;
                 else if (pattern_choice == 1) pattern = 0xFF;
                 else pattern = 0xA5;
@@ -1230,21 +1083,21 @@ void new_token_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t*
                 effective_token_data_end = bytes_max;
             }
             if (token_data_start < effective_token_data_end) {
-                fuzz_random_byte(fuzz_pilot, token_data_start, effective_token_data_end);
+                fuzz_random_byte(prng, token_data_start, effective_token_data_end);
             }
         }
         break;
     }
 }
 
-void new_connection_id_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t* frame_max, fuzzer_icid_ctx_t* icid_ctx)
+void new_connection_id_frame_fuzzer_logic(fuzzer_prng_t* prng, uint8_t* frame_start, uint8_t* frame_max, fuzzer_icid_ctx_t* icid_ctx)
 {
     uint8_t* p = frame_start;
     int specific_fuzz_applied = 0;
 
     p = (uint8_t*)picoquic_frames_varint_skip(p, frame_max);
     if (p == NULL || p >= frame_max) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
@@ -1252,12 +1105,11 @@ void new_connection_id_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_st
     uint64_t original_seq_no;
     uint8_t* seq_no_end = (uint8_t*)picoquic_frames_varint_decode(seq_no_start, frame_max, &original_seq_no);
     if (seq_no_end == NULL || seq_no_start == seq_no_end) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
     if (icid_ctx != NULL) {
-        icid_ctx->last_new_cid_seq_no_sent = original_seq_no;
         icid_ctx->new_cid_seq_no_available = 1;
     }
 
@@ -1265,44 +1117,44 @@ void new_connection_id_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_st
     uint64_t original_retire_prior_to;
     uint8_t* retire_prior_to_end = (uint8_t*)picoquic_frames_varint_decode(retire_prior_to_start, frame_max, &original_retire_prior_to);
     if (retire_prior_to_end == NULL || retire_prior_to_start == retire_prior_to_end) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
     uint8_t* length_field_ptr = retire_prior_to_end;
     if (length_field_ptr >= frame_max) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
     uint8_t original_cid_len = *length_field_ptr;
 
     uint8_t* cid_start = length_field_ptr + 1;
     if (cid_start + original_cid_len > frame_max) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
     uint8_t* token_start = cid_start + original_cid_len;
     if (token_start + PICOQUIC_STATELESS_RESET_TOKEN_SIZE > frame_max) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
-    if ((fuzz_pilot % 3) == 0) {
-        fuzz_pilot >>=2;
-
-        int target_choice = fuzz_pilot % 5;
-        fuzz_pilot >>= 3;
+    if (fuzzer_prng_uniform(prng, 3) == 0) {
+        int target_choice = fuzzer_prng_uniform(prng, 5);
 
         switch (target_choice) {
         case 0:
             {
                 uint64_t new_seq_val;
-                int val_choice = fuzz_pilot % 3;
-                if (val_choice == 0) new_seq_val = 0;
-                else if (val_choice == 1) new_seq_val = 0x3FFF;
-                else new_seq_val = fuzz_pilot % 16;
+                int val_choice = (int)fuzzer_prng_uniform(prng, 4);
+                if (val_choice < 2) new_seq_val = fuzzer_varint_boundary(prng, seq_no_end - seq_no_start);
+                else if (val_choice == 2 && icid_ctx != NULL &&
+                    fuzzer_memory_plausible(&icid_ctx->memory, prng, fuzzer_memory_cid_sequence, &new_seq_val)) {
+                    /* Repeat, skip or reuse a recent sequence number */
+                }
+                else new_seq_val = fuzzer_prng_uniform(prng, 16);
 
-                if (encode_and_overwrite_varint(seq_no_start, seq_no_end, frame_max, new_seq_val)) {
+                if (fuzzer_varint_overwrite(seq_no_start, seq_no_end, new_seq_val)) {
                     specific_fuzz_applied = 1;
                 }
             }
@@ -1310,19 +1162,19 @@ void new_connection_id_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_st
         case 1:
             {
                 uint64_t new_retire_val;
-                int val_choice = fuzz_pilot % 3;
+                int val_choice = (int)fuzzer_prng_uniform(prng, 3);
                 if (val_choice == 0) new_retire_val = original_seq_no;
                 else if (val_choice == 1) new_retire_val = 0;
                 else new_retire_val = (original_seq_no > 0) ? (original_seq_no - 1) : 0;
 
-                if (encode_and_overwrite_varint(retire_prior_to_start, retire_prior_to_end, frame_max, new_retire_val)) {
+                if (fuzzer_varint_overwrite(retire_prior_to_start, retire_prior_to_end, new_retire_val)) {
                     specific_fuzz_applied = 1;
                 }
             }
             break;
         case 2:
             {
-                int val_choice = fuzz_pilot % 3;
+                int val_choice = (int)fuzzer_prng_uniform(prng, 3);
                 if (val_choice == 0) *length_field_ptr = 0;
                 else if (val_choice == 1) *length_field_ptr = PICOQUIC_CONNECTION_ID_MAX_SIZE;
                 else *length_field_ptr = PICOQUIC_CONNECTION_ID_MAX_SIZE + 1;
@@ -1331,21 +1183,20 @@ void new_connection_id_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_st
             break;
         case 3:
             if (original_cid_len > 0) {
-                int flips = 1 + (fuzz_pilot % 2);
+                int flips = 1 + (int)fuzzer_prng_uniform(prng, 2);
                 for (int i = 0; i < flips; i++) {
-                    if (original_cid_len == 0) break;
-                    size_t idx = (fuzz_pilot >> (i*4)) % original_cid_len;
-                    cid_start[idx] ^= (uint8_t)((fuzz_pilot >> (i*8 + 3)) & 0xFF);
+                    size_t idx = (size_t)fuzzer_prng_uniform(prng, original_cid_len);
+                    cid_start[idx] ^= (uint8_t)fuzzer_prng_next(prng);
                 }
                 specific_fuzz_applied = 1;
             }
             break;
         case 4:
             {
-                int flips = 1 + (fuzz_pilot % 2);
+                int flips = 1 + (int)fuzzer_prng_uniform(prng, 2);
                  for (int i = 0; i < flips; i++) {
-                    size_t idx = (fuzz_pilot >> (i*4)) % PICOQUIC_STATELESS_RESET_TOKEN_SIZE;
-                    token_start[idx] ^= (uint8_t)((fuzz_pilot >> (i*8 + 3)) & 0xFF);
+                    size_t idx = (size_t)fuzzer_prng_uniform(prng, PICOQUIC_STATELESS_RESET_TOKEN_SIZE);
+                    token_start[idx] ^= (uint8_t)fuzzer_prng_next(prng);
                 }
                 specific_fuzz_applied = 1;
             }
@@ -1354,22 +1205,22 @@ void new_connection_id_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_st
     }
 
     if (!specific_fuzz_applied) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
     }
 }
 
-void new_cid_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void new_cid_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
 {
-    default_frame_fuzzer(fuzz_pilot, bytes, bytes_max);
+    default_frame_fuzzer(prng, bytes, bytes_max);
 }
 
-void retire_connection_id_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* frame_max)
+void retire_connection_id_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* frame_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* frame_payload_start = (uint8_t*)picoquic_frames_varint_skip(bytes, frame_max);
 
     if (frame_payload_start == NULL || frame_payload_start >= frame_max) {
         if (bytes < frame_max) {
-            fuzz_random_byte(fuzz_pilot, bytes, frame_max);
+            fuzz_random_byte(prng, bytes, frame_max);
         }
         return;
     }
@@ -1379,12 +1230,17 @@ void retire_connection_id_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint
     uint8_t* seq_num_end = (uint8_t*)picoquic_frames_varint_decode(seq_num_start, frame_max, &original_seq_no);
 
     if (seq_num_end == NULL || seq_num_start == seq_num_end) {
-      fuzz_in_place_or_skip_varint(fuzz_pilot >> 2, seq_num_start, frame_max, 1);
+      fuzz_in_place_or_skip_varint(prng, seq_num_start, frame_max, 1);
       return;
     }
 
-    int choice = fuzz_pilot % 4;
-    fuzz_pilot >>= 2;
+    if (fuzzer_prng_uniform(prng, 4) == 0 && fuzzer_memory_rewrite(memory, prng,
+        (fuzzer_prng_uniform(prng, 2) == 0) ? fuzzer_memory_cid_sequence : fuzzer_memory_retire_prior_to,
+        seq_num_start, seq_num_end, frame_max)) {
+        return;
+    }
+
+    int choice = fuzzer_prng_uniform(prng, 4);
 
     size_t varint_len = seq_num_end - seq_num_start;
 
@@ -1394,93 +1250,24 @@ void retire_connection_id_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint
 
     switch (choice) {
     case 0:
-        if (varint_len > 0) {
-            uint8_t prefix = seq_num_start[0] & 0xC0;
-            seq_num_start[0] = prefix;
-            for (size_t i = 1; i < varint_len; i++) {
-                seq_num_start[i] = 0x00;
-            }
-        }
-        break;
     case 1:
-        if (varint_len > 0) {
-            uint8_t prefix = seq_num_start[0] & 0xC0;
-            if (varint_len == 1) {
-                seq_num_start[0] = prefix | 0x01;
-            } else {
-                seq_num_start[0] = prefix;
-                for (size_t i = 1; i < varint_len -1; i++) {
-                    seq_num_start[i] = 0x00;
-                }
-                seq_num_start[varint_len - 1] = 0x01;
-            }
-        }
-        break;
     case 2:
-        if (varint_len > 0) {
-            seq_num_start[0] |= 0x3F;
-            for (size_t i = 1; i < varint_len; i++) {
-                seq_num_start[i] = 0xFF;
-            }
-        }
+        fuzz_varint_boundary(prng, seq_num_start, seq_num_end);
         break;
     default:
-        if ((fuzz_pilot & 0x03) == 0) {
-            fuzz_pilot >>=2;
-            uint64_t small_seq_val = fuzz_pilot % 16;
-            if (!encode_and_overwrite_varint(seq_num_start, seq_num_end, frame_max, small_seq_val)) {
-                 fuzz_in_place_or_skip_varint(fuzz_pilot >> 4, seq_num_start, frame_max, 1);
+        if (fuzzer_prng_uniform(prng, 4) == 0) {
+            uint64_t small_seq_val = fuzzer_prng_uniform(prng, 16);
+            if (!fuzzer_varint_overwrite(seq_num_start, seq_num_end, small_seq_val)) {
+                 fuzz_in_place_or_skip_varint(prng, seq_num_start, frame_max, 1);
             }
         } else {
-            fuzz_in_place_or_skip_varint(fuzz_pilot >> 2, seq_num_start, frame_max, 1);
+            fuzz_in_place_or_skip_varint(prng, seq_num_start, frame_max, 1);
         }
         break;
     }
 }
 
-static int encode_and_overwrite_varint(uint8_t* field_start, uint8_t* field_end, uint8_t* frame_max, uint64_t new_value)
-{
-    if (field_start == NULL || field_end == NULL || field_start >= field_end || field_start >= frame_max) {
-        return 0;
-    }
-
-    size_t original_varint_len = field_end - field_start;
-    uint8_t temp_buffer[16];
-    uint8_t* p_next_byte_in_temp;
-    size_t encoded_len;
-
-    /* Use the standard picoquic_frames_varint_encode */
-    p_next_byte_in_temp = picoquic_frames_varint_encode(temp_buffer, temp_buffer + sizeof(temp_buffer), new_value);
-
-    if (p_next_byte_in_temp == NULL) {
-        /* This indicates an encoding failure by picoquic_frames_varint_encode. */
-        /* This shouldn't happen with a 16-byte temp_buffer for any valid uint64_t varint. */
-        return 0; 
-    }
-
-    encoded_len = p_next_byte_in_temp - temp_buffer;
-
-    if (encoded_len == 0) {
-        /* This case implies picoquic_frames_varint_encode returned `temp_buffer` without writing, */
-        /* or new_value itself implies a zero-length encoding (not standard for varints). */
-        /* picoquic_frames_varint_encode should correctly produce encoded_len = 1 for new_value = 0. */
-        /* Thus, encoded_len == 0 here is an actual error or unexpected behavior. */
-        return 0;
-    }
-
-    size_t new_varint_len = encoded_len;
-
-    if (new_varint_len <= original_varint_len) {
-        memcpy(field_start, temp_buffer, new_varint_len);
-        if (new_varint_len < original_varint_len) {
-            memset(field_start + new_varint_len, 0, original_varint_len - new_varint_len);
-        }
-        return 1;
-    }
-    return 0;
-}
-
-void path_abandon_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t* bytes_max)
+void path_abandon_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* frame_start, uint8_t* bytes_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* p = frame_start;
     uint64_t frame_type;
@@ -1488,7 +1275,7 @@ void path_abandon_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
 
     p = (uint8_t*)picoquic_frames_varint_decode(p, bytes_max, &frame_type);
     if (p == NULL || p >= bytes_max) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, bytes_max);
+        default_frame_fuzzer(prng, frame_start, bytes_max);
         return;
     }
 
@@ -1497,7 +1284,7 @@ void path_abandon_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
     uint8_t* path_id_end = (uint8_t*)picoquic_frames_varint_decode(path_id_start, bytes_max, &original_path_id);
 
     if (path_id_end == NULL || path_id_start == path_id_end) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, bytes_max);
+        default_frame_fuzzer(prng, frame_start, bytes_max);
         return;
     }
 
@@ -1510,32 +1297,24 @@ void path_abandon_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
          error_code_end = NULL;
     }
 
-    if ((fuzz_pilot & 0x03) == 0) {
-        fuzz_pilot >>= 2;
-        int fuzz_target_choice = fuzz_pilot % 2;
-        fuzz_pilot >>= 1;
+    if (fuzzer_prng_uniform(prng, 4) == 0 &&
+        fuzzer_memory_rewrite_path_id(memory, prng, path_id_start, path_id_end, bytes_max)) {
+        return;
+    }
+
+    if (fuzzer_prng_uniform(prng, 4) == 0) {
+        int fuzz_target_choice = fuzzer_prng_uniform(prng, 2);
 
         if (fuzz_target_choice == 0) {
             if (path_id_start != NULL && path_id_end != NULL) {
-                uint64_t new_path_id_val = ((fuzz_pilot >> 1) & 1) ? 0x3FFFFFFFFFFFFFFF : 0;
-                if (encode_and_overwrite_varint(path_id_start, path_id_end, bytes_max, new_path_id_val)) {
-                    specific_fuzz_done = 1;
-                }
+                specific_fuzz_done = fuzz_varint_boundary(prng, path_id_start, path_id_end);
             }
         } else {
             if (error_code_start != NULL && error_code_end != NULL) {
-                uint64_t new_error_code_val;
-                int error_choice = fuzz_pilot % 3;
-                fuzz_pilot >>= 2;
-                if (error_choice == 0) {
-                    new_error_code_val = 0;
-                } else if (error_choice == 1) {
-                    new_error_code_val = PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR;
+                if (fuzzer_prng_uniform(prng, 3) == 0) {
+                    specific_fuzz_done = fuzzer_varint_overwrite(error_code_start, error_code_end, PICOQUIC_TRANSPORT_FRAME_FORMAT_ERROR);
                 } else {
-                    new_error_code_val = 0x3FFFFFFFFFFFFFFF;
-                }
-                if (encode_and_overwrite_varint(error_code_start, error_code_end, bytes_max, new_error_code_val)) {
-                    specific_fuzz_done = 1;
+                    specific_fuzz_done = fuzz_varint_boundary(prng, error_code_start, error_code_end);
                 }
             }
         }
@@ -1546,23 +1325,22 @@ void path_abandon_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
         current_field = (uint8_t*)picoquic_frames_varint_skip(current_field, bytes_max);
 
         if (current_field != NULL && current_field < bytes_max) {
-            current_field = fuzz_in_place_or_skip_varint(fuzz_pilot, current_field, bytes_max, 1);
-            fuzz_pilot >>= 8;
+            current_field = fuzz_in_place_or_skip_varint(prng, current_field, bytes_max, 1);
         }
         if (current_field != NULL && current_field < bytes_max) {
-            fuzz_in_place_or_skip_varint(fuzz_pilot, current_field, bytes_max, 1);
+            fuzz_in_place_or_skip_varint(prng, current_field, bytes_max, 1);
         }
     }
 }
 
-void crypto_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t* frame_max, fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx)
+void crypto_frame_fuzzer_logic(fuzzer_prng_t* prng, uint8_t* frame_start, uint8_t* frame_max, fuzzer_icid_ctx_t* icid_ctx)
 {
     uint8_t* p = frame_start;
     int specific_fuzz_applied = 0;
 
     p = (uint8_t*)picoquic_frames_varint_skip(p, frame_max);
     if (p == NULL || p >= frame_max) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
@@ -1570,7 +1348,7 @@ void crypto_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
     uint64_t original_offset;
     uint8_t* offset_end = (uint8_t*)picoquic_frames_varint_decode(offset_start, frame_max, &original_offset);
     if (offset_end == NULL || offset_start == offset_end) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
@@ -1578,7 +1356,7 @@ void crypto_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
     uint64_t original_length;
     uint8_t* length_end = (uint8_t*)picoquic_frames_varint_decode(length_start, frame_max, &original_length);
     if (length_end == NULL || length_start == length_end) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
@@ -1588,49 +1366,33 @@ void crypto_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
         data_present_len = frame_max - data_start;
     }
 
-    if ((fuzz_pilot & 0x01) == 0) {
-        fuzz_pilot >>= 1;
-        int choice = fuzz_pilot % 4;
-        fuzz_pilot >>= 2;
+    if (icid_ctx != NULL && fuzzer_prng_uniform(prng, 4) == 0 &&
+        fuzzer_memory_rewrite(&icid_ctx->memory, prng, fuzzer_memory_crypto_offset, offset_start, offset_end, frame_max)) {
+        /* Offset close to the end of the crypto data sent */
+        return;
+    }
+
+    if (fuzzer_prng_uniform(prng, 2) == 0) {
+        int choice = fuzzer_prng_uniform(prng, 4);
 
         switch (choice) {
         case 0:
-            if (offset_start && offset_end) {
-                uint64_t new_offset_val = (fuzz_pilot & 1) ? 0x3FFFFFFFFFFFFFFF : 0;
-                if (encode_and_overwrite_varint(offset_start, offset_end, frame_max, new_offset_val)) {
-                    specific_fuzz_applied = 1;
-                }
-            }
+            specific_fuzz_applied = fuzz_varint_boundary(prng, offset_start, offset_end);
             break;
         case 1:
-            if (length_start && length_end) {
-                uint64_t new_length_val = (fuzz_pilot & 1) ? 0x3FFFFFFFFFFFFFFF : 65536;
-                if (encode_and_overwrite_varint(length_start, length_end, frame_max, new_length_val)) {
-                    specific_fuzz_applied = 1;
-                }
-            }
+            /* Length around the data actually present */
+            specific_fuzz_applied = fuzzer_varint_overwrite(length_start, length_end,
+                fuzzer_varint_relative(prng, original_length, data_present_len));
             break;
         case 2:
-            if (length_start && length_end) {
-                if (encode_and_overwrite_varint(length_start, length_end, frame_max, 0)) {
-                    specific_fuzz_applied = 1;
-                }
-            }
+            specific_fuzz_applied = fuzz_varint_boundary(prng, length_start, length_end);
             break;
         case 3:
             if (data_present_len > 0) {
-                size_t num_flips = 1 + (fuzz_pilot % 3);
-                fuzz_pilot >>= 2;
+                size_t num_flips = 1 + (size_t)fuzzer_prng_uniform(prng, 3);
                 for (size_t i = 0; i < num_flips; i++) {
-                    if (data_present_len == 0) break;
-                    size_t flip_idx = fuzz_pilot % data_present_len;
-                    if (icid_ctx == NULL && fuzz_pilot == 0) {
-                        fuzz_pilot = frame_start[0];
-                    } else if (fuzz_pilot == 0 && icid_ctx != NULL) {
-                         fuzz_pilot = picoquic_test_random(&icid_ctx->random_context);
-                    }
-                    data_start[flip_idx] ^= (uint8_t)(fuzz_pilot & 0xFF);
-                    fuzz_pilot >>= 8;
+                    size_t flip_idx = (size_t)fuzzer_prng_uniform(prng, data_present_len);
+                    data_start[flip_idx] ^= (uint8_t)fuzzer_prng_next(prng);
                 }
                 specific_fuzz_applied = 1;
             }
@@ -1639,11 +1401,53 @@ void crypto_frame_fuzzer_logic(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_
     }
 
     if (!specific_fuzz_applied) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
+    }
+}
+
+/* Mutate the TLS message at the start of the crypto stream, e.g., the
+ * ClientHello and its transport parameters. The message length may change,
+ * in which case the CRYPTO length is rewritten and the rest of the packet
+ * is shifted. Returns 1 if the packet was modified.
+ */
+static int crypto_frame_tls_fuzzer(fuzzer_prng_t* prng, uint8_t* packet, size_t bytes_max, size_t* length,
+    uint8_t* frame_start, uint8_t* frame_max)
+{
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    uint64_t offset;
+    uint64_t data_length;
+    uint8_t* length_field = NULL;
+    uint8_t* data = (uint8_t*)picoquic_frames_varint_skip(frame_start, frame_max);
+    size_t tail_length;
+    size_t data_max;
+    size_t new_length;
+
+    if (data == NULL || (data = (uint8_t*)picoquic_frames_varint_decode(data, frame_max, &offset)) == NULL || offset != 0) {
+        return 0;
     }
+    length_field = data;
+    if ((data = (uint8_t*)picoquic_frames_varint_decode(data, frame_max, &data_length)) == NULL ||
+        data_length > (uint64_t)(frame_max - data)) {
+        return 0;
+    }
+    tail_length = (packet + *length) - (data + data_length);
+    data_max = (bytes_max - tail_length) - (data - packet);
+    if (data_max > sizeof(buffer)) {
+        data_max = sizeof(buffer);
+    }
+    memcpy(buffer, data, (size_t)data_length);
+    new_length = fuzzer_tls_mutate(prng, buffer, (size_t)data_length, data_max);
+    if (new_length == 0 || !fuzzer_varint_encode(length_field, data - length_field, new_length)) {
+        return 0;
+    }
+    memmove(data + new_length, data + data_length, tail_length);
+    memcpy(data, buffer, new_length);
+    *length = (data - packet) + new_length + tail_length;
+
+    return 1;
 }
 
-void path_id_sequence_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t* frame_max)
+void path_id_sequence_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* frame_start, uint8_t* frame_max, const fuzzer_cnx_memory_t* memory)
 {
     uint8_t* p = frame_start;
     uint64_t frame_type;
@@ -1651,7 +1455,7 @@ void path_id_sequence_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, ui
 
     p = (uint8_t*)picoquic_frames_varint_decode(p, frame_max, &frame_type);
     if (p == NULL || p >= frame_max) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
@@ -1660,7 +1464,7 @@ void path_id_sequence_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, ui
     uint8_t* path_id_end = (uint8_t*)picoquic_frames_varint_decode(path_id_start, frame_max, &original_path_id);
 
     if (path_id_end == NULL || path_id_start == path_id_end) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
@@ -1673,31 +1477,25 @@ void path_id_sequence_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, ui
         seq_no_end = NULL;
     }
 
-    int choice = fuzz_pilot % 3;
-    fuzz_pilot >>= 2;
+    if (fuzzer_prng_uniform(prng, 4) == 0 &&
+        fuzzer_memory_rewrite_path_id(memory, prng, path_id_start, path_id_end, frame_max)) {
+        return;
+    }
+
+    int choice = fuzzer_prng_uniform(prng, 3);
 
     if (choice == 0) {
-        if (path_id_start && path_id_end) {
-            uint64_t new_path_id_val = (fuzz_pilot & 1) ? 0x3FFFFFFFFFFFFFFF : 0;
-            if (encode_and_overwrite_varint(path_id_start, path_id_end, frame_max, new_path_id_val)) {
-                specific_fuzz_done = 1;
-            }
-        }
+        specific_fuzz_done = fuzz_varint_boundary(prng, path_id_start, path_id_end);
     } else if (choice == 1) {
-        if (seq_no_start && seq_no_end) {
-            uint64_t new_seq_no_val = (fuzz_pilot & 1) ? 0x3FFFFFFFFFFFFFFF : 0;
-            if (encode_and_overwrite_varint(seq_no_start, seq_no_end, frame_max, new_seq_no_val)) {
-                specific_fuzz_done = 1;
-            }
-        }
+        specific_fuzz_done = fuzz_varint_boundary(prng, seq_no_start, seq_no_end);
     }
 
     if (!specific_fuzz_done) {
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
     }
 }
 
-void default_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_max)
+void default_frame_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
 {
     uint8_t* frame_byte = bytes;
 
@@ -1713,77 +1511,203 @@ void default_frame_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, uint8_t* bytes_ma
     }
     /* Ensure bytes < bytes_max before fuzzing */
     if (bytes < bytes_max) {
-        fuzz_random_byte(fuzz_pilot, bytes, bytes_max);
+        fuzz_random_byte(prng, bytes, bytes_max);
     }
 }
 
-void max_data_fuzzer(uint64_t fuzz_pilot, uint8_t* frame_start, uint8_t* frame_max, fuzzer_ctx_t* f_ctx, fuzzer_icid_ctx_t* icid_ctx)
+void max_data_fuzzer(fuzzer_prng_t* prng, uint8_t* frame_start, uint8_t* frame_max, fuzzer_icid_ctx_t* icid_ctx)
 {
     uint8_t* p_val = frame_start + 1; // Skip frame type
     if (p_val >= frame_max) { // Check if there's space for at least one byte for the varint
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
     uint8_t* max_data_field_start = p_val;
     uint64_t original_max_data_val;
+    uint64_t last_max_data = 0;
     uint8_t* max_data_field_end = (uint8_t*)picoquic_frames_varint_decode(max_data_field_start, frame_max, &original_max_data_val);
 
     if (max_data_field_end == NULL || max_data_field_start == max_data_field_end) { // Parsing failed or empty varint
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         return;
     }
 
-    if (icid_ctx != NULL) { // Store original value for context-aware fuzzing
-        icid_ctx->last_sent_max_data = original_max_data_val;
-        icid_ctx->has_sent_max_data = 1;
-    }
-
-    int num_strategies = 6; // 3 new value sets, 1 generic varint fuzz, 1 context-aware, 1 default_frame_fuzzer pass
-    int choice = fuzz_pilot % num_strategies;
-    fuzz_pilot >>= 3; // Consume bits for choice (ceil(log2(6)) = 3)
+    int num_strategies = 6; // 2 boundary sets, 1 generic varint fuzz, 2 context-aware, 1 default_frame_fuzzer pass
+    int choice = fuzzer_prng_uniform(prng, num_strategies);
 
     switch (choice) {
-    case 0: /* Set Maximum Data to 0 */
-        encode_and_overwrite_varint(max_data_field_start, max_data_field_end, frame_max, 0);
-        break;
-    case 1: /* Set Maximum Data to 1 */
-        encode_and_overwrite_varint(max_data_field_start, max_data_field_end, frame_max, 1);
+    case 0: /* Set Maximum Data to a boundary of its encoding */
+    case 1:
+        fuzz_varint_boundary(prng, max_data_field_start, max_data_field_end);
         break;
-    case 2: /* Set Maximum Data to large value */
-        encode_and_overwrite_varint(max_data_field_start, max_data_field_end, frame_max, 0x3FFFFFFFFFFFFFFFull);
+    case 2: /* Mutate around the last credit sent, if known */
+        if (icid_ctx == NULL || !fuzzer_memory_get(&icid_ctx->memory, fuzzer_memory_max_data, &last_max_data)) {
+            last_max_data = FUZZER_VARINT_NO_LIMIT;
+        }
+        fuzzer_varint_mutate(prng, max_data_field_start, max_data_field_end, last_max_data);
         break;
     case 3: /* Apply generic varint fuzz to Maximum Data field */
         /* For MAX_DATA, it's the only field, so its extent is up to frame_max from max_data_field_start. */
-        fuzz_in_place_or_skip_varint(fuzz_pilot, max_data_field_start, frame_max, 1);
+        fuzz_in_place_or_skip_varint(prng, max_data_field_start, frame_max, 1);
         break;
-    case 4: /* Existing context-aware strategy */
-        if (icid_ctx != NULL && icid_ctx->has_sent_max_data && icid_ctx->last_sent_max_data > 0) {
-            uint64_t fuzzed_val = icid_ctx->last_sent_max_data / 2;
-            if (fuzzed_val == icid_ctx->last_sent_max_data && fuzzed_val > 0) { // Ensure value changes if possible
-                fuzzed_val--;
-            }
-            encode_and_overwrite_varint(max_data_field_start, max_data_field_end, frame_max, fuzzed_val);
+    case 4: /* Context-aware strategy: reduce the credit, or announce it again with a small change */
+        if (icid_ctx != NULL && fuzzer_memory_get(&icid_ctx->memory, fuzzer_memory_max_data, &last_max_data) && last_max_data > 0) {
+            uint64_t fuzzed_val = (fuzzer_prng_uniform(prng, 2) == 0) ? last_max_data / 2 : fuzzer_memory_near(prng, last_max_data);
+            fuzzer_varint_overwrite(max_data_field_start, max_data_field_end, fuzzed_val);
             /* This strategy now performs a specific action. No automatic default_frame_fuzzer here. */
         } else {
             /* Fallback to default if context not available for this specific strategy */
-            default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+            default_frame_fuzzer(prng, frame_start, frame_max);
         }
         break;
     case 5: /* Default frame fuzzer as an explicit strategy path */
     default: /* Fallback for any unhandled case or if other cases resulted in no action */
-        default_frame_fuzzer(fuzz_pilot, frame_start, frame_max);
+        default_frame_fuzzer(prng, frame_start, frame_max);
         break;
     }
 }
 
-/* frame_header_fuzzer: MODIFIED signature */
-int frame_header_fuzzer(fuzzer_ctx_t* f_ctx, picoquic_cnx_t* cnx, fuzzer_icid_ctx_t* icid_ctx, uint64_t fuzz_pilot,
-    uint8_t* bytes, size_t bytes_max, size_t length, size_t header_length)
+/* Pick the frame type or one of the varint fields of the frame */
+static uint8_t* schema_varint_offset(fuzzer_prng_t* prng, uint8_t* frame_byte, uint8_t* frame_max)
+{
+    fuzzer_parsed_frame_t parsed;
+    uint8_t* varints[FUZZER_SCHEMA_MAX_PARSED + 1];
+    size_t nb_varints = 0;
+
+    varints[nb_varints++] = frame_byte;
+    (void)fuzzer_schema_parse(frame_byte, frame_max, &parsed);
+    for (size_t i = 0; i < parsed.nb_fields; i++) {
+        if (parsed.fields[i].type != fuzzer_field_length8 && parsed.fields[i].type != fuzzer_field_fixed &&
+            parsed.fields[i].type != fuzzer_field_bytes) {
+            varints[nb_varints++] = parsed.fields[i].start;
+        }
+    }
+    return varints[fuzzer_prng_uniform(prng, nb_varints)];
+}
+
+/* Path validation, CID and multipath path management frames */
+static int fuzzer_is_path_frame(const uint8_t* frame_byte, const uint8_t* frame_max)
+{
+    uint64_t frame_type;
+
+    if (picoquic_frames_varint_decode(frame_byte, frame_max, &frame_type) == NULL) {
+        return 0;
+    }
+    switch (frame_type) {
+    case picoquic_frame_type_path_challenge:
+    case picoquic_frame_type_path_response:
+    case picoquic_frame_type_new_connection_id:
+    case picoquic_frame_type_retire_connection_id:
+    case picoquic_frame_type_path_abandon:
+    case picoquic_frame_type_path_available:
+    case picoquic_frame_type_path_backup:
+    case picoquic_frame_type_paths_blocked:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Frame fuzzers that depend on the semantics of the frame or on the state
+ * of the connection. The frames that only need field mutations, e.g.,
+ * path challenges, datagrams, blocked frames or ACK frequency, are fuzzed
+ * by the schema engine.
+ */
+static void frame_type_fuzzer(picoquic_cnx_t* cnx, fuzzer_icid_ctx_t* icid_ctx, fuzzer_prng_t* prng,
+    uint8_t* packet, size_t bytes_max, size_t* length, uint8_t* frame_byte, uint8_t* frame_max)
+{
+    const fuzzer_cnx_memory_t* memory = (icid_ctx == NULL) ? NULL : &icid_ctx->memory;
+
+    if (PICOQUIC_IN_RANGE(*frame_byte, picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max)) {
+        int is_h3 = cnx != NULL && cnx->alpn != NULL && picoquic_parse_alpn(cnx->alpn) == picoquic_alpn_http_3;
+
+        stream_frame_fuzzer(prng, frame_byte, frame_max, memory, is_h3);
+    }
+    else {
+        switch (*frame_byte) {
+        case picoquic_frame_type_ack:
+        case picoquic_frame_type_ack_ecn:
+            ack_frame_fuzzer(prng, frame_byte, frame_max);
+            break;
+        case picoquic_frame_type_reset_stream:
+            reset_stream_frame_fuzzer(prng, frame_byte, frame_max, memory);
+            break;
+        case picoquic_frame_type_stop_sending:
+            stop_sending_frame_fuzzer(prng, frame_byte, frame_max, memory);
+            break;
+        case picoquic_frame_type_max_data:
+            max_data_fuzzer(prng, frame_byte, frame_max, icid_ctx);
+            break;
+        case picoquic_frame_type_max_stream_data:
+            max_stream_data_frame_fuzzer(prng, frame_byte, frame_max, memory);
+            break;
+        case picoquic_frame_type_max_streams_bidir:
+        case picoquic_frame_type_max_streams_unidir:
+            max_streams_frame_fuzzer(prng, frame_byte, frame_max, memory);
+            break;
+        case picoquic_frame_type_retire_connection_id:
+            retire_connection_id_frame_fuzzer(prng, frame_byte, frame_max, memory);
+            break;
+        case picoquic_frame_type_connection_close:
+        case picoquic_frame_type_application_close:
+            connection_close_frame_fuzzer(prng, frame_byte, frame_max);
+            break;
+        case picoquic_frame_type_crypto_hs:
+            if (fuzzer_prng_uniform(prng, 2) != 0 ||
+                !crypto_frame_tls_fuzzer(prng, packet, bytes_max, length, frame_byte, frame_max)) {
+                crypto_frame_fuzzer_logic(prng, frame_byte, frame_max, icid_ctx);
+            }
+            break;
+        case picoquic_frame_type_padding:
+        case picoquic_frame_type_ping:
+        case picoquic_frame_type_handshake_done:
+            padding_frame_fuzzer(prng, frame_byte, frame_max);
+            break;
+        case picoquic_frame_type_new_connection_id:
+            new_connection_id_frame_fuzzer_logic(prng, frame_byte, frame_max, icid_ctx);
+            break;
+        case picoquic_frame_type_new_token:
+            new_token_frame_fuzzer(prng, frame_byte, frame_max, memory);
+            break;
+        default: {
+            uint64_t frame_id64;
+            if (picoquic_frames_varint_decode(frame_byte, frame_max, &frame_id64) != NULL) {
+                switch (frame_id64) {
+                case picoquic_frame_type_path_abandon:
+                    path_abandon_frame_fuzzer(prng, frame_byte, frame_max, memory);
+                    break;
+                case picoquic_frame_type_path_available:
+                case picoquic_frame_type_path_backup:
+                    path_id_sequence_frame_fuzzer(prng, frame_byte, frame_max, memory);
+                    break;
+                default:
+                    /* Path challenges, datagrams, blocked frames, ACK frequency,
+                     * time stamp, BDP and other frames described in the schema table. */
+                    if (!fuzzer_schema_mutate(prng, frame_byte, frame_max)) {
+                        default_frame_fuzzer(prng, frame_byte, frame_max);
+                    }
+                    break;
+                }
+            } else {
+                 default_frame_fuzzer(prng, frame_byte, frame_max);
+            }
+            break;
+        }
+        }
+    }
+}
+
+/* frame_header_fuzzer: fuzz one of the frames in the packet. The packet
+ * length is updated if a field is re-encoded with a different length.
+ */
+int frame_header_fuzzer(fuzzer_ctx_t* f_ctx, picoquic_cnx_t* cnx, fuzzer_icid_ctx_t* icid_ctx, fuzzer_prng_t* prng,
+    uint8_t* bytes, size_t bytes_max, size_t* length, size_t header_length)
 {
     uint8_t* frame_head[FUZZER_MAX_NB_FRAMES];
     uint8_t* frame_next[FUZZER_MAX_NB_FRAMES];
-    uint8_t* last_byte = bytes + bytes_max;
+    uint8_t* packet = bytes;
+    uint8_t* last_byte = bytes + *length;
     size_t nb_frames = 0;
     int was_fuzzed = 1;
 
@@ -1805,115 +1729,31 @@ int frame_header_fuzzer(fuzzer_ctx_t* f_ctx, picoquic_cnx_t* cnx, fuzzer_icid_ct
     }
 
     if (nb_frames > 0) {
-        size_t fuzzed_frame_idx = (size_t)(fuzz_pilot % nb_frames);
-        uint8_t* frame_byte = frame_head[fuzzed_frame_idx];
-        uint8_t* frame_max = frame_next[fuzzed_frame_idx];
+        size_t fuzzed_frame_idx = (size_t)fuzzer_prng_uniform(prng, nb_frames);
 
-        fuzz_pilot >>= 5;
+        if (icid_ctx != NULL && (icid_ctx->migrated || icid_ctx->memory.nb_path_ids > 1) && fuzzer_prng_uniform(prng, 4) != 0) {
+            /* After a migration, or on multipath connections, prefer the path frames */
+            for (size_t i = 0; i < nb_frames; i++) {
+                size_t rank = (fuzzed_frame_idx + i) % nb_frames;
 
-        /* HANDSHAKE_DONE tracking moved here */
-        if (cnx != NULL && !picoquic_is_client(cnx) && icid_ctx != NULL && *frame_byte == picoquic_frame_type_handshake_done) {
-            icid_ctx->handshake_done_sent_by_server = 1;
+                if (fuzzer_is_path_frame(frame_head[rank], frame_next[rank])) {
+                    fuzzed_frame_idx = rank;
+                    break;
+                }
+            }
         }
+        uint8_t* frame_byte = frame_head[fuzzed_frame_idx];
+        uint8_t* frame_max = frame_next[fuzzed_frame_idx];
 
-        if (PICOQUIC_IN_RANGE(*frame_byte, picoquic_frame_type_stream_range_min, picoquic_frame_type_stream_range_max)) {
-            stream_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
+        if (fuzzer_prng_uniform(prng, 8) == 0) {
+            /* Re-encode the frame type or one of the varint fields with a different
+             * length, e.g., non minimal, and shift the rest of the packet. */
+            *length = fuzzer_varint_resize(prng, packet, *length, bytes_max, schema_varint_offset(prng, frame_byte, frame_max) - packet);
         }
-        else {
-            switch (*frame_byte) {
-            case picoquic_frame_type_ack:
-            case picoquic_frame_type_ack_ecn:
-                ack_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_reset_stream:
-                reset_stream_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_stop_sending:
-                stop_sending_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_max_data:
-                max_data_fuzzer(fuzz_pilot, frame_byte, frame_max, f_ctx, icid_ctx);
-                break;
-            case picoquic_frame_type_max_stream_data:
-                max_stream_data_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_max_streams_bidir:
-            case picoquic_frame_type_max_streams_unidir:
-                max_streams_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_data_blocked:
-                varint_frame_fuzzer(fuzz_pilot, frame_byte, frame_max, 2);
-                break;
-            case picoquic_frame_type_stream_data_blocked:
-                varint_frame_fuzzer(fuzz_pilot, frame_byte, frame_max, 3);
-                break;
-            case picoquic_frame_type_streams_blocked_bidir:
-            case picoquic_frame_type_streams_blocked_unidir:
-                varint_frame_fuzzer(fuzz_pilot, frame_byte, frame_max, 2);
-                break;
-            case picoquic_frame_type_retire_connection_id:
-                retire_connection_id_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_connection_close:
-            case picoquic_frame_type_application_close:
-                connection_close_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_datagram:
-            case picoquic_frame_type_datagram_l:
-                datagram_frame_fuzzer(f_ctx, icid_ctx, fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_path_challenge:
-            case picoquic_frame_type_path_response:
-                challenge_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_crypto_hs:
-                crypto_frame_fuzzer_logic(fuzz_pilot, frame_byte, frame_max, f_ctx, icid_ctx);
-                break;
-            case picoquic_frame_type_padding:
-            case picoquic_frame_type_ping:
-            case picoquic_frame_type_handshake_done:
-                /* Pass cnx and icid_ctx for HANDSHAKE_DONE tracking and random replenishment */
-                padding_frame_fuzzer(cnx, icid_ctx, fuzz_pilot, frame_byte, frame_max);
-                break;
-            case picoquic_frame_type_new_connection_id:
-                new_connection_id_frame_fuzzer_logic(fuzz_pilot, frame_byte, frame_max, icid_ctx);
-                break;
-            case picoquic_frame_type_new_token:
-                new_token_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                break;
-            default: {
-                uint64_t frame_id64;
-                if (picoquic_frames_varint_decode(frame_byte, frame_max, &frame_id64) != NULL) {
-                    switch (frame_id64) {
-                    case picoquic_frame_type_ack_frequency:
-                        ack_frequency_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                        break;
-                    case picoquic_frame_type_time_stamp:
-                        varint_frame_fuzzer(fuzz_pilot, frame_byte, frame_max, 2);
-                        break;
-                    case picoquic_frame_type_path_abandon:
-                        path_abandon_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                        break;
-                    case picoquic_frame_type_path_available:
-                    case picoquic_frame_type_path_backup:
-                        path_id_sequence_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                        break;
-                    case picoquic_frame_type_paths_blocked:
-                        varint_frame_fuzzer(fuzz_pilot, frame_byte, frame_max, 2);
-                        break;
-                    case picoquic_frame_type_bdp:
-                        varint_frame_fuzzer(fuzz_pilot, frame_byte, frame_max, 5);
-                        break;
-                    default:
-                        default_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                        break;
-                    }
-                } else {
-                     default_frame_fuzzer(fuzz_pilot, frame_byte, frame_max);
-                }
-                break;
-            }
-            }
+        else if (fuzzer_prng_uniform(prng, 4) != 0 || !fuzzer_schema_mutate(prng, frame_byte, frame_max)) {
+            /* The schema mutations apply to any frame, the frame fuzzers add
+             * mutations that depend on the frame semantics or on the connection state */
+            frame_type_fuzzer(cnx, icid_ctx, prng, packet, bytes_max, length, frame_byte, frame_max);
         }
     } else {
         was_fuzzed = 0;
@@ -1954,7 +1794,7 @@ size_t length_non_padded(uint8_t* bytes, size_t length, size_t header_length)
     return (final_pad == NULL) ? length : (final_pad - bytes_begin);
 }
 
-size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, size_t vn_header_len, size_t current_length, size_t bytes_max)
+size_t version_negotiation_packet_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, size_t vn_header_len, size_t current_length, size_t bytes_max)
 {
     size_t original_current_length = current_length;
 
@@ -1970,13 +1810,12 @@ size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, si
     }
     size_t num_versions = version_list_len / 4;
 
-    int choice = fuzz_pilot % 16;
-    fuzz_pilot >>= 4;
+    int choice = fuzzer_prng_uniform(prng, 16);
 
     switch (choice) {
     case 0:
         if (vn_header_len > 0) {
-            bytes[0] ^= (uint8_t)(fuzz_pilot & 0x3F);
+            bytes[0] ^= (uint8_t)(fuzzer_prng_next(prng) & 0x3F);
         }
         break;
     case 1: break;
@@ -1987,8 +1826,7 @@ size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, si
         break;
     case 3:
         if (num_versions > 0) {
-            size_t bytes_to_remove = (fuzz_pilot % 3) + 1;
-            fuzz_pilot >>= 2;
+            size_t bytes_to_remove = (size_t)fuzzer_prng_uniform(prng, 3) + 1;
             if (current_length > vn_header_len + bytes_to_remove) {
                 current_length -= bytes_to_remove;
             } else if (current_length > vn_header_len) {
@@ -2000,8 +1838,7 @@ size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, si
     case 5:
     case 6:
         if (num_versions > 0) {
-            size_t version_idx = fuzz_pilot % num_versions;
-            fuzz_pilot >>= 4;
+            size_t version_idx = fuzzer_prng_uniform(prng, num_versions);
             uint8_t* version_ptr = version_list_start + (version_idx * 4);
 
             if (version_ptr + 4 <= bytes + original_current_length) {
@@ -2010,20 +1847,19 @@ size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, si
                 } else if (choice == 5) {
                     picoquic_frames_uint32_encode(version_ptr, version_ptr + 4, 0x1A1A1A1A);
                 } else {
-                    version_ptr[0] ^= (uint8_t)(fuzz_pilot & 0xFF);
-                    version_ptr[1] ^= (uint8_t)((fuzz_pilot >> 8) & 0xFF);
-                    version_ptr[2] ^= (uint8_t)((fuzz_pilot >> 16) & 0xFF);
-                    version_ptr[3] ^= (uint8_t)((fuzz_pilot >> 24) & 0xFF);
+                    uint64_t version_mask = fuzzer_prng_next(prng);
+                    version_ptr[0] ^= (uint8_t)(version_mask & 0xFF);
+                    version_ptr[1] ^= (uint8_t)((version_mask >> 8) & 0xFF);
+                    version_ptr[2] ^= (uint8_t)((version_mask >> 16) & 0xFF);
+                    version_ptr[3] ^= (uint8_t)((version_mask >> 24) & 0xFF);
                 }
             }
         }
         break;
     case 7:
         if (num_versions >= 2) {
-            size_t v_idx_target = fuzz_pilot % num_versions;
-            fuzz_pilot >>= 4;
-            size_t v_idx_source = fuzz_pilot % num_versions;
-            fuzz_pilot >>= 4;
+            size_t v_idx_target = fuzzer_prng_uniform(prng, num_versions);
+            size_t v_idx_source = fuzzer_prng_uniform(prng, num_versions);
 
             if (v_idx_target != v_idx_source) {
                 uint8_t* target_ptr = version_list_start + (v_idx_target * 4);
@@ -2037,19 +1873,14 @@ size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, si
     case 8:
         if (current_length + 4 <= bytes_max) {
             uint8_t* new_version_ptr = bytes + current_length;
-            new_version_ptr[0] = (uint8_t)(fuzz_pilot & 0xFF);
-            new_version_ptr[1] = (uint8_t)((fuzz_pilot >> 8) & 0xFF);
-            new_version_ptr[2] = (uint8_t)((fuzz_pilot >> 16) & 0xFF);
-            new_version_ptr[3] = (uint8_t)((fuzz_pilot >> 24) & 0xFF);
+            picoquic_frames_uint32_encode(new_version_ptr, new_version_ptr + 4, (uint32_t)fuzzer_prng_next(prng));
             current_length += 4;
         }
         break;
     case 9:
         if (num_versions >= 2) {
-            size_t v_idx1 = fuzz_pilot % num_versions;
-            fuzz_pilot >>= 4;
-            size_t v_idx2 = fuzz_pilot % num_versions;
-            fuzz_pilot >>= 4;
+            size_t v_idx1 = fuzzer_prng_uniform(prng, num_versions);
+            size_t v_idx2 = fuzzer_prng_uniform(prng, num_versions);
 
             if (v_idx1 != v_idx2) {
                 uint8_t* ptr1 = version_list_start + (v_idx1 * 4);
@@ -2065,9 +1896,8 @@ size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, si
         break;
     default:
         if (version_list_len > 0 && version_list_start < bytes + current_length ) {
-            size_t fuzz_offset_in_list = fuzz_pilot % version_list_len;
-            fuzz_pilot >>= 6;
-            version_list_start[fuzz_offset_in_list] ^= (uint8_t)(fuzz_pilot & 0xFF);
+            size_t fuzz_offset_in_list = fuzzer_prng_uniform(prng, version_list_len);
+            version_list_start[fuzz_offset_in_list] ^= (uint8_t)fuzzer_prng_next(prng);
         }
         break;
     }
@@ -2082,7 +1912,7 @@ size_t version_negotiation_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, si
     return current_length;
 }
 
-size_t retry_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, size_t current_length, size_t bytes_max)
+size_t retry_packet_fuzzer(fuzzer_prng_t* prng, uint8_t* bytes, size_t current_length, size_t bytes_max)
 {
     size_t original_length = current_length;
     if (current_length < 23) {
@@ -2110,41 +1940,32 @@ size_t retry_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, size_t current_l
     }
     size_t token_len = integrity_tag_start - token_start;
 
-    int choice = fuzz_pilot % 16;
-    fuzz_pilot >>= 4;
+    int choice = fuzzer_prng_uniform(prng, 16);
 
     switch (choice) {
-    case 0: bytes[0] ^= (uint8_t)(fuzz_pilot & 0x0F); break;
-    case 1: if (original_length >= 5) { bytes[1 + (fuzz_pilot % 4)] ^= (uint8_t)(fuzz_pilot >> 2); } break;
+    case 0: bytes[0] ^= (uint8_t)(fuzzer_prng_next(prng) & 0x0F); break;
+    case 1: if (original_length >= 5) { bytes[1 + fuzzer_prng_uniform(prng, 4)] ^= (uint8_t)fuzzer_prng_next(prng); } break;
     case 2:
         if (token_len > 0) {
-            size_t num_flips = 1 + (fuzz_pilot % 3);
-            fuzz_pilot >>= 2;
+            size_t num_flips = 1 + (size_t)fuzzer_prng_uniform(prng, 3);
             for (size_t i = 0; i < num_flips; i++) {
-                if (token_len == 0) break;
-                size_t flip_idx = fuzz_pilot % token_len;
-                fuzz_pilot >>= (token_len > 1 ? picoquic_max_bits(token_len -1) : 1);
-                token_start[flip_idx] ^= (uint8_t)(fuzz_pilot & 0xFF);
-                fuzz_pilot >>= 8;
+                size_t flip_idx = (size_t)fuzzer_prng_uniform(prng, token_len);
+                token_start[flip_idx] ^= (uint8_t)fuzzer_prng_next(prng);
             }
         }
         break;
     case 3:
         {
-            size_t num_flips = 1 + (fuzz_pilot % 4);
-            fuzz_pilot >>= 2;
+            size_t num_flips = 1 + (size_t)fuzzer_prng_uniform(prng, 4);
             for (size_t i = 0; i < num_flips; i++) {
-                size_t flip_idx = fuzz_pilot % 16;
-                fuzz_pilot >>= 4;
-                integrity_tag_start[flip_idx] ^= (uint8_t)(fuzz_pilot & 0xFF);
-                fuzz_pilot >>= 8;
+                size_t flip_idx = fuzzer_prng_uniform(prng, 16);
+                integrity_tag_start[flip_idx] ^= (uint8_t)fuzzer_prng_next(prng);
             }
         }
         break;
     case 4:
         if (original_length > 23) {
-            size_t cut_amount = 1 + (fuzz_pilot % 15);
-            fuzz_pilot >>= 4;
+            size_t cut_amount = 1 + (size_t)fuzzer_prng_uniform(prng, 15);
             if (original_length > cut_amount) {
                  current_length = original_length - cut_amount;
                  if (current_length < (scid_len_offset + 1 + scid_len + token_len)) {
@@ -2155,8 +1976,7 @@ size_t retry_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, size_t current_l
         break;
     case 5:
         if (token_len > 0) {
-            size_t cut_amount = 1 + (fuzz_pilot % token_len);
-            fuzz_pilot >>= (token_len > 1 ? picoquic_max_bits(token_len-1):1);
+            size_t cut_amount = 1 + (size_t)fuzzer_prng_uniform(prng, token_len);
             current_length = (token_start - bytes) + (token_len - cut_amount);
         } else if (original_length > (scid_len_offset + 1 + scid_len)) {
             current_length = scid_len_offset + 1 + scid_len;
@@ -2164,22 +1984,20 @@ size_t retry_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, size_t current_l
         break;
     case 6:
         if (bytes_max > original_length) {
-            size_t add_amount = 1 + (fuzz_pilot % 8);
-            fuzz_pilot >>= 3;
+            size_t add_amount = 1 + (size_t)fuzzer_prng_uniform(prng, 8);
             if (original_length + add_amount > bytes_max) {
                 add_amount = bytes_max - original_length;
             }
             if (add_amount > 0) {
                 for (size_t i = 0; i < add_amount; i++) {
-                    bytes[original_length + i] = (uint8_t)(fuzz_pilot & 0xFF);
-                    fuzz_pilot >>= (i % 2 == 0 ? 3: 5) ;
+                    bytes[original_length + i] = (uint8_t)fuzzer_prng_next(prng);
                 }
                 current_length = original_length + add_amount;
 
                 if (original_length >= 16) {
                     uint8_t* original_tag_loc = bytes + original_length - 16;
                     if (original_tag_loc < bytes + current_length - 16) {
-                         original_tag_loc[fuzz_pilot % 16] ^= (uint8_t)((fuzz_pilot>>4)&0xFF);
+                         original_tag_loc[fuzzer_prng_uniform(prng, 16)] ^= (uint8_t)fuzzer_prng_next(prng);
                     }
                 }
             }
@@ -2191,13 +2009,13 @@ size_t retry_packet_fuzzer(uint64_t fuzz_pilot, uint8_t* bytes, size_t current_l
         {
             size_t header_and_cid_len = scid_len_offset + 1 + scid_len;
             if (header_and_cid_len > 0) {
-                 size_t flip_idx = fuzz_pilot % header_and_cid_len;
+                 size_t flip_idx = (size_t)fuzzer_prng_uniform(prng, header_and_cid_len);
                  if (flip_idx < original_length) {
-                    bytes[flip_idx] ^= (uint8_t)((fuzz_pilot >> 6) & 0xFF);
+                    bytes[flip_idx] ^= (uint8_t)fuzzer_prng_next(prng);
                  }
             } else if (token_len > 0) {
-                 size_t flip_idx = fuzz_pilot % token_len;
-                 token_start[flip_idx] ^= (uint8_t)((fuzz_pilot >> 6) & 0xFF);
+                 size_t flip_idx = (size_t)fuzzer_prng_uniform(prng, token_len);
+                 token_start[flip_idx] ^= (uint8_t)fuzzer_prng_next(prng);
             }
         }
         break;
@@ -2230,21 +2048,44 @@ fuzzer_cnx_state_enum fuzzer_get_cnx_state(picoquic_cnx_t* cnx)
     return fuzz_cnx_state;
 }
 
-/* fuzi_q_fuzzer: MODIFIED for Handshake Interruption */
-uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
-    uint8_t* bytes, size_t bytes_max, size_t length, size_t header_length)
+/* fuzi_q_fuzzer_packet: MODIFIED for Handshake Interruption */
+static uint32_t fuzi_q_fuzzer_packet(fuzzer_ctx_t* ctx, fuzzer_icid_ctx_t* icid_ctx, picoquic_cnx_t* cnx,
+    uint64_t current_time, uint8_t* bytes, size_t bytes_max, size_t length, size_t header_length)
 {
-    fuzzer_ctx_t* ctx = (fuzzer_ctx_t*)fuzz_ctx_param;
-    uint64_t current_time = (cnx != NULL && cnx->quic != NULL) ? picoquic_get_quic_time(cnx->quic) : 0;
-    fuzzer_icid_ctx_t* icid_ctx = (cnx != NULL) ? fuzzer_get_icid_ctx(ctx, &cnx->initial_cnxid, current_time) : NULL;
+    fuzzer_prng_t prng_ctx;
+    fuzzer_prng_t* prng = &prng_ctx;
+    fuzzer_cnx_state_enum fuzz_cnx_state = (cnx != NULL) ? fuzzer_get_cnx_state(cnx) : fuzzer_cnx_state_closing;
+    uint32_t fuzzed_length = (uint32_t)length;
+
+    /* One PRNG stream per packet, seeded from the ICID stream so that replays are deterministic */
+    fuzzer_prng_seed(prng, picoquic_test_random(&icid_ctx->random_context));
+    icid_ctx->packet_rank++;
+    /* Record the state of the connection before any mutation */
+    if (header_length < length) {
+        fuzzer_memory_observe(&icid_ctx->memory, bytes + header_length, bytes + length, cnx != NULL && picoquic_is_client(cnx));
+    }
+    if (cnx != NULL && cnx->is_multipath_enabled) {
+        fuzzer_memory_observe_paths(&icid_ctx->memory, cnx);
+    }
 
-    if (icid_ctx == NULL) { /* Should ideally not happen if cnx is valid */
+    if (ctx->replay != NULL && (icid_ctx->target_state >= fuzzer_cnx_state_max ||
+        icid_ctx->packet_rank - 1 < ctx->replay->first_packet || icid_ctx->packet_rank - 1 > ctx->replay->last_packet)) {
+        /* Not part of the replay. The random context still advanced, so the next packets are fuzzed as originally. */
         return (uint32_t)length;
     }
 
-    uint64_t fuzz_pilot = picoquic_test_random(&icid_ctx->random_context);
-    fuzzer_cnx_state_enum fuzz_cnx_state = (cnx != NULL) ? fuzzer_get_cnx_state(cnx) : fuzzer_cnx_state_closing;
-    uint32_t fuzzed_length = (uint32_t)length;
+    if (icid_ctx->key_phase_flips > 0 && length > 0 && (bytes[0] & 0x80) == 0) {
+        /* Just after a key update, claim the other key phase, so that the peer
+         * tries the other keys before discarding the packet. */
+        icid_ctx->key_phase_flips--;
+        if (fuzzer_prng_uniform(prng, 2) == 0) {
+            bytes[0] ^= 0x04;
+            ctx->nb_key_phase_flipped++;
+            ctx->nb_packets_fuzzed[fuzz_cnx_state] += 1;
+            fuzzer_log_fuzzed(ctx, icid_ctx, fuzz_cnx_state, current_time);
+            return (uint32_t)length;
+        }
+    }
 
     /* Inside fuzi_q_fuzzer, after icid_ctx and cnx are known to be valid, */
     /* and after fuzz_cnx_state is set. */
@@ -2271,8 +2112,7 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
         /* Assuming 'bytes + 5' is a safe upper bound based on 'length >= 5' */
         picoquic_frames_uint32_decode(bytes + 1, bytes + 5, &version_val);
         if (version_val == 0x00000000) {
-            if (!icid_ctx->already_fuzzed || ((fuzz_pilot & 0xf) <= 7)) {
-                fuzz_pilot >>=4;
+            if (!icid_ctx->already_fuzzed || fuzzer_prng_uniform(prng, 2) == 0) {
                 uint8_t dcid_len = 0;
             uint8_t scid_len = 0;
             size_t vn_header_len = 1 + 4;
@@ -2285,7 +2125,7 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
                     vn_header_len += 1 + scid_len;
                     if (vn_header_len <= length) {
                         if (vn_header_len < length) {
-                            fuzzed_length = (uint32_t)version_negotiation_packet_fuzzer(fuzz_pilot, bytes, vn_header_len, length, bytes_max);
+                            fuzzed_length = (uint32_t)version_negotiation_packet_fuzzer(prng, bytes, vn_header_len, length, bytes_max);
                         }
                         if (icid_ctx->already_fuzzed == 0) {
                             icid_ctx->already_fuzzed = 1;
@@ -2293,6 +2133,7 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
                              ctx->nb_cnx_fuzzed[fuzz_cnx_state] += 1;
                         }
                         ctx->nb_packets_fuzzed[fuzz_cnx_state] +=1;
+                        fuzzer_log_fuzzed(ctx, icid_ctx, fuzz_cnx_state, current_time);
                         return fuzzed_length;
                     }
                 }
@@ -2316,23 +2157,22 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
             }
         }
         if (condition_met) {
-            if (!icid_ctx->already_fuzzed || ((fuzz_pilot & 0xf) <= 7)) {
-                fuzz_pilot >>=4;
-                fuzzed_length = (uint32_t)retry_packet_fuzzer(fuzz_pilot, bytes, length, bytes_max);
+            if (!icid_ctx->already_fuzzed || fuzzer_prng_uniform(prng, 2) == 0) {
+                fuzzed_length = (uint32_t)retry_packet_fuzzer(prng, bytes, length, bytes_max);
             if (icid_ctx->already_fuzzed == 0) {
                 icid_ctx->already_fuzzed = 1;
                 ctx->nb_cnx_tried[icid_ctx->target_state] += 1;
                 ctx->nb_cnx_fuzzed[fuzz_cnx_state] += 1;
             }
             ctx->nb_packets_fuzzed[fuzz_cnx_state] +=1;
+            fuzzer_log_fuzzed(ctx, icid_ctx, fuzz_cnx_state, current_time);
             return fuzzed_length;
             }
         }
         return (uint32_t)length;
     }
 
-    int fuzz_again = ((fuzz_pilot & 0xf) <= 7);
-    fuzz_pilot >>= 4; /* Consume bits for fuzz_again for main packet fuzzing */
+    int fuzz_again = (fuzzer_prng_uniform(prng, 2) == 0);
 
     if (fuzz_cnx_state < 0 || fuzz_cnx_state >= fuzzer_cnx_state_max) {
         fuzz_cnx_state = fuzzer_cnx_state_closing;
@@ -2353,46 +2193,55 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
                 icid_ctx->wait_count[fuzz_cnx_state] >= icid_ctx->target_wait)) &&
             (!icid_ctx->already_fuzzed || fuzz_again)) {
 
-            uint64_t main_strategy_choice = fuzz_pilot & 0x0F; /* Now 4 bits for up to 16 strategies */
-            fuzz_pilot >>= 4; /* Consume these 4 bits */
+            uint64_t main_strategy_choice = fuzzer_prng_uniform(prng, 16);
 
             size_t final_pad = length_non_padded(bytes, length, header_length);
-            int fuzz_more = ((fuzz_pilot >> 8) & 1) > 0; /* This bit is now relative to already shifted pilot */
+            int fuzz_more = (fuzzer_prng_uniform(prng, 2) == 0);
             int was_fuzzed = 0;
-            uint64_t sub_fuzzer_pilot = fuzz_pilot; /* Default for strategies not using list */
 
             if (main_strategy_choice < 3) { /* Strategies 0, 1, 2: Inject from fuzi_q_frame_list */
-                size_t fuzz_frame_id = (size_t)((fuzz_pilot) % nb_fuzi_q_frame_list);
+                size_t fuzz_frame_id = (size_t)fuzzer_prng_uniform(prng, nb_fuzi_q_frame_list);
                 /* printf("Fuzzer selected frame for injection: %s (ID: %zu)\n", fuzi_q_frame_list[fuzz_frame_id].name, fuzz_frame_id); */
-                sub_fuzzer_pilot = fuzz_pilot >> 5; /* Consume fuzz_frame_id bits */
 
+                const uint8_t* frame_val = fuzi_q_frame_list[fuzz_frame_id].val;
                 size_t len = fuzi_q_frame_list[fuzz_frame_id].len;
+                uint8_t wrapped[PICOQUIC_MAX_PACKET_SIZE];
+
+                if (fuzi_q_frame_layer(&fuzi_q_frame_list[fuzz_frame_id]) != fuzi_q_layer_quic) {
+                    /* Application entries are only meaningful inside a STREAM frame.
+                     * If the wrapped entry does not fit, inject it raw. */
+                    size_t wrapped_len = fuzzer_app_frame_wrap(prng, &icid_ctx->memory, cnx != NULL && picoquic_is_client(cnx),
+                        &fuzi_q_frame_list[fuzz_frame_id], wrapped, sizeof(wrapped));
+                    if (wrapped_len > 0) {
+                        frame_val = wrapped;
+                        len = wrapped_len;
+                    }
+                }
                 switch (main_strategy_choice) {
                 case 0: /* Add random frame at end */
                     if (final_pad + len <= bytes_max) {
-                        memcpy(&bytes[final_pad], fuzi_q_frame_list[fuzz_frame_id].val, len);
+                        memcpy(&bytes[final_pad], frame_val, len);
                         final_pad += len; was_fuzzed++;
                     }
                     break;
                 case 1: /* Add random frame at beginning */
                      if (final_pad + len <= bytes_max && header_length + len <= final_pad) {
                         memmove(bytes + header_length + len, bytes + header_length, final_pad - header_length);
-                        memcpy(&bytes[header_length], fuzi_q_frame_list[fuzz_frame_id].val, len);
+                        memcpy(&bytes[header_length], frame_val, len);
                         final_pad += len; was_fuzzed++;
                     } else if (header_length + len <= bytes_max) {
-                        memcpy(&bytes[header_length], fuzi_q_frame_list[fuzz_frame_id].val, len);
+                        memcpy(&bytes[header_length], frame_val, len);
                         final_pad = header_length + len; was_fuzzed++;
                     }
                     break;
                 case 2: /* Replace packet with random frame */
                     if (header_length + len <= bytes_max) {
-                        memcpy(&bytes[header_length], fuzi_q_frame_list[fuzz_frame_id].val, len);
+                        memcpy(&bytes[header_length], frame_val, len);
                         final_pad = header_length + len; was_fuzzed++;
                     }
                     break;
                 }
             } else if (main_strategy_choice == 3) { /* Fill with PINGs */
-                sub_fuzzer_pilot = fuzz_pilot; /* Use remaining pilot for frame_header_fuzzer */
                 if (bytes_max > header_length) {
                     size_t current_pos = header_length;
                     size_t ping_count = 0;
@@ -2408,14 +2257,12 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
             } else if (main_strategy_choice == 4 && cnx != NULL && picoquic_is_client(cnx) &&
                        fuzzer_get_cnx_state(cnx) < fuzzer_cnx_state_ready && header_length + 1 <= bytes_max) {
                 /* Client sends HANDSHAKE_DONE */
-                sub_fuzzer_pilot = fuzz_pilot;
                 bytes[header_length] = picoquic_frame_type_handshake_done;
                 final_pad = header_length + 1;
                 was_fuzzed++;
             } else if (main_strategy_choice == 5 && cnx != NULL && !picoquic_is_client(cnx) &&
-                       icid_ctx->handshake_done_sent_by_server == 1) {
+                       icid_ctx->memory.handshake_done_sent) {
                 /* Server sends CRYPTO after HANDSHAKE_DONE */
-                sub_fuzzer_pilot = fuzz_pilot;
                 size_t crypto_frame_idx = 0; /* Find a crypto frame */
                 int found_crypto = 0;
                 for (size_t i = 0; i < nb_fuzi_q_frame_list; i++) {
@@ -2433,8 +2280,6 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
                         was_fuzzed++;
                     }
                 }
-            } else { /* Other strategies or no specific action taken by main_strategy_choice */
-                 sub_fuzzer_pilot = fuzz_pilot; /* Use remaining pilot */
             }
 
             if (was_fuzzed) {
@@ -2449,24 +2294,26 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
             if (!was_fuzzed || fuzz_more) {
                 int fuzzed_by_header_fuzzer = 0;
                 if (final_pad > header_length) {
-                    fuzzed_by_header_fuzzer = frame_header_fuzzer(ctx, cnx, icid_ctx, sub_fuzzer_pilot, bytes, bytes_max, final_pad, header_length);
+                    fuzzed_by_header_fuzzer = frame_header_fuzzer(ctx, cnx, icid_ctx, prng, bytes, bytes_max, &final_pad, header_length);
                 }
                 if (!fuzzed_by_header_fuzzer && !was_fuzzed) {
-                    fuzzed_length = basic_packet_fuzzer(ctx, sub_fuzzer_pilot, bytes, bytes_max, length, header_length);
+                    fuzzed_length = basic_packet_fuzzer(ctx, prng, bytes, bytes_max, length, header_length);
                 } else if (fuzzed_by_header_fuzzer) {
                      was_fuzzed = 1;
                      fuzzed_length = (uint32_t)final_pad;
                 }
             }
 
-            if (((fuzz_pilot >> 20) & 0x03) == 0) {
-                if (icid_ctx->new_cid_seq_no_available == 1) {
+            if (fuzzer_prng_uniform(prng, 4) == 0) {
+                uint64_t last_new_cid_seq_no = 0;
+                if (icid_ctx->new_cid_seq_no_available == 1 &&
+                    fuzzer_memory_get(&icid_ctx->memory, fuzzer_memory_cid_sequence, &last_new_cid_seq_no)) {
                     uint8_t retire_frame_buffer[24];
                     uint8_t* p_retire = retire_frame_buffer;
                     uint8_t* p_retire_max = retire_frame_buffer + sizeof(retire_frame_buffer);
                     p_retire = picoquic_frames_varint_encode(p_retire, p_retire_max, picoquic_frame_type_retire_connection_id);
                     if (p_retire != NULL) {
-                        p_retire = picoquic_frames_varint_encode(p_retire, p_retire_max, icid_ctx->last_new_cid_seq_no_sent);
+                        p_retire = picoquic_frames_varint_encode(p_retire, p_retire_max, last_new_cid_seq_no);
                     }
                     if (p_retire != NULL) {
                         size_t retire_len = p_retire - retire_frame_buffer;
@@ -2484,11 +2331,16 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
                 icid_ctx->already_fuzzed = 1;
                 ctx->nb_cnx_tried[icid_ctx->target_state] += 1;
                 ctx->nb_cnx_fuzzed[fuzz_cnx_state] += 1;
-                if (fuzz_cnx_state == icid_ctx->target_state && icid_ctx->wait_count[fuzz_cnx_state] > ctx->waited_max[icid_ctx->target_state]) {
-                    ctx->waited_max[icid_ctx->target_state] = icid_ctx->wait_count[fuzz_cnx_state];
+                if (fuzz_cnx_state == icid_ctx->target_state) {
+                    /* The scheduler only credits the cell if the target was actually reached */
+                    ctx->cell_fuzzed[icid_ctx->target_state][icid_ctx->target_bucket] += 1;
+                    if (icid_ctx->wait_count[fuzz_cnx_state] > ctx->waited_max[icid_ctx->target_state]) {
+                        ctx->waited_max[icid_ctx->target_state] = icid_ctx->wait_count[fuzz_cnx_state];
+                    }
                 }
             }
             ctx->nb_packets_fuzzed[fuzz_cnx_state] += 1;
+            fuzzer_log_fuzzed(ctx, icid_ctx, fuzz_cnx_state, current_time);
         }
 
         if (ctx->parent != NULL) {
@@ -2497,3 +2349,40 @@ uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
     }
     return fuzzed_length;
 }
+
+uint32_t fuzi_q_fuzzer(void* fuzz_ctx_param, picoquic_cnx_t* cnx,
+    uint8_t* bytes, size_t bytes_max, size_t length, size_t header_length)
+{
+    fuzzer_ctx_t* ctx = (fuzzer_ctx_t*)fuzz_ctx_param;
+    uint64_t current_time = (cnx != NULL && cnx->quic != NULL) ? picoquic_get_quic_time(cnx->quic) : 0;
+    fuzzer_icid_ctx_t* icid_ctx = NULL;
+    uint32_t fuzzed_length = (uint32_t)length;
+
+    if (cnx != NULL && ctx->parent != NULL && cnx == ctx->parent->probe_ctx.cnx_client) {
+        /* Never fuzz the liveness probe */
+        return fuzzed_length;
+    }
+    icid_ctx = (cnx != NULL) ? fuzzer_get_icid_ctx(ctx, &cnx->initial_cnxid, current_time) : NULL;
+
+    if (icid_ctx != NULL) { /* Should ideally not happen if cnx is valid */
+        if (ctx->event_log_enabled || icid_ctx->capture != NULL) {
+            uint8_t first_byte = (length > 0) ? bytes[0] : 0;
+            size_t nb_fuzzed = ctx->fuzz_log_packets;
+            fuzzer_capture_packet_t* captured = (icid_ctx->capture == NULL) ? NULL :
+                fuzzer_capture_original(icid_ctx, current_time, bytes, length);
+
+            fuzzed_length = fuzi_q_fuzzer_packet(ctx, icid_ctx, cnx, current_time, bytes, bytes_max, length, header_length);
+            if (captured != NULL) {
+                fuzzer_capture_fuzzed(captured, bytes, fuzzed_length, ctx->fuzz_log_packets != nb_fuzzed);
+            }
+            if (ctx->event_log_enabled) {
+                fuzzer_event_record(icid_ctx, current_time, fuzzer_get_cnx_state(cnx), first_byte, length, fuzzed_length,
+                    ctx->fuzz_log_packets != nb_fuzzed);
+            }
+        }
+        else {
+            fuzzed_length = fuzi_q_fuzzer_packet(ctx, icid_ctx, cnx, current_time, bytes, bytes_max, length, header_length);
+        }
+    }
+    return fuzzed_length;
+}
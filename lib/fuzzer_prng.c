@@ -0,0 +1,86 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+#include "fuzi_q.h"
+
+/* Pseudo random generator for the fuzzer.
+ *
+ * The state is expanded from a single 64 bit seed using splitmix64,
+ * which guarantees that the xoshiro state is never all zeroes.
+ */
+
+static uint64_t fuzzer_prng_splitmix64(uint64_t* x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t fuzzer_prng_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void fuzzer_prng_seed(fuzzer_prng_t* prng, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++) {
+        prng->s[i] = fuzzer_prng_splitmix64(&seed);
+    }
+}
+
+uint64_t fuzzer_prng_next(fuzzer_prng_t* prng)
+{
+    uint64_t* s = prng->s;
+    uint64_t result = fuzzer_prng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = fuzzer_prng_rotl(s[3], 45);
+
+    return result;
+}
+
+/* Draw a number in [0, range) by rejecting the values below
+ * 2^64 mod range, so that every result is equally likely.
+ * The rejection probability is below 1/2, and negligible for
+ * the small ranges used by the fuzzer.
+ */
+uint64_t fuzzer_prng_uniform(fuzzer_prng_t* prng, uint64_t range)
+{
+    uint64_t threshold;
+    uint64_t r;
+
+    if (range <= 1) {
+        return 0;
+    }
+    threshold = (0 - range) % range;
+    do {
+        r = fuzzer_prng_next(prng);
+    } while (r < threshold);
+
+    return r % range;
+}
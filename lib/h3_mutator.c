@@ -0,0 +1,511 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* HTTP/3 aware mutation of stream data.
+ *
+ * The data of a STREAM frame is parsed as the application would parse
+ * it: a sequence of HTTP/3 frames on request and control streams, QPACK
+ * instructions on the encoder and decoder streams. One element is then
+ * mutated in place, so that the length and offset of the STREAM frame
+ * remain consistent and the packet reaches the HTTP/3 layer of the peer.
+ *
+ * Stream data only starts at a frame boundary at offset 0. At other
+ * offsets, the data is treated as HTTP/3 frames if it parses as a
+ * sequence of complete frames, and as QPACK instructions otherwise.
+ */
+
+#define FUZZER_H3_MAX_FRAMES 32
+#define FUZZER_QPACK_MAX_LINES 32
+
+/* Frame types: the defined ones, the HTTP/2 types that are forbidden in
+ * HTTP/3, a reserved type and an unassigned one.
+ */
+static const uint64_t fuzzer_h3_frame_types[] = {
+    FUZZER_H3_FRAME_DATA, FUZZER_H3_FRAME_HEADERS, FUZZER_H3_FRAME_CANCEL_PUSH, FUZZER_H3_FRAME_SETTINGS,
+    FUZZER_H3_FRAME_PUSH_PROMISE, FUZZER_H3_FRAME_GOAWAY, FUZZER_H3_FRAME_MAX_PUSH_ID,
+    FUZZER_H3_FRAME_PRIORITY_UPDATE_REQUEST, FUZZER_H3_FRAME_PRIORITY_UPDATE_PUSH,
+    0x02, 0x06, 0x08, 0x09, 0x21, 0x2f
+};
+
+/* Stream types, including a reserved type and WebTransport */
+static const uint64_t fuzzer_h3_stream_types[] = {
+    FUZZER_H3_STREAM_CONTROL, FUZZER_H3_STREAM_PUSH, FUZZER_H3_STREAM_QPACK_ENCODER,
+    FUZZER_H3_STREAM_QPACK_DECODER, 0x21, 0x54
+};
+
+/* Settings: QPACK_MAX_TABLE_CAPACITY, MAX_FIELD_SECTION_SIZE,
+ * QPACK_BLOCKED_STREAMS, ENABLE_CONNECT_PROTOCOL, H3_DATAGRAM, the
+ * HTTP/2 settings forbidden in HTTP/3, and a reserved value.
+ */
+static const uint64_t fuzzer_h3_settings[] = {
+    0x01, 0x06, 0x07, 0x08, 0x33, 0x00, 0x02, 0x03, 0x04, 0x05, 0x21
+};
+
+typedef struct st_fuzzer_h3_frame_t {
+    uint8_t* start;
+    uint8_t* length_field;
+    uint8_t* payload;
+    uint8_t* end; /* May be data_max if the frame is truncated */
+    uint64_t frame_type;
+} fuzzer_h3_frame_t;
+
+/* QPACK representations, identified by the high bits of their first
+ * byte. The rest of the first byte starts a prefix integer, which is
+ * either an index or the length of a literal name. Representations with
+ * a value are followed by a string, with the Huffman bit and a 7 bit
+ * prefix length.
+ */
+typedef struct st_fuzzer_qpack_representation_t {
+    uint8_t mask;
+    uint8_t pattern;
+    uint8_t prefix_bits;
+    uint8_t is_name_length;
+    uint8_t has_value;
+} fuzzer_qpack_representation_t;
+
+static const fuzzer_qpack_representation_t fuzzer_qpack_encoder_instructions[] = {
+    { 0x80, 0x80, 6, 0, 1 }, /* Insert with name reference */
+    { 0xc0, 0x40, 5, 1, 1 }, /* Insert with literal name */
+    { 0xe0, 0x20, 5, 0, 0 }, /* Set dynamic table capacity */
+    { 0xe0, 0x00, 5, 0, 0 } /* Duplicate */
+};
+
+static const fuzzer_qpack_representation_t fuzzer_qpack_decoder_instructions[] = {
+    { 0x80, 0x80, 7, 0, 0 }, /* Section acknowledgment */
+    { 0xc0, 0x40, 6, 0, 0 }, /* Stream cancellation */
+    { 0xc0, 0x00, 6, 0, 0 } /* Insert count increment */
+};
+
+static const fuzzer_qpack_representation_t fuzzer_qpack_field_lines[] = {
+    { 0x80, 0x80, 6, 0, 0 }, /* Indexed field line */
+    { 0xc0, 0x40, 4, 0, 1 }, /* Literal with name reference */
+    { 0xe0, 0x20, 3, 1, 1 }, /* Literal with literal name */
+    { 0xf0, 0x10, 4, 0, 0 }, /* Indexed with post-base index */
+    { 0xf0, 0x00, 3, 0, 1 } /* Literal with post-base name reference */
+};
+
+typedef struct st_fuzzer_qpack_line_t {
+    uint8_t* start;
+    uint8_t* value; /* Start of the value string, or NULL */
+    const fuzzer_qpack_representation_t* representation;
+} fuzzer_qpack_line_t;
+
+/* Skip a QPACK prefix integer, as defined in RFC 7541 */
+static uint8_t* fuzzer_qpack_int_skip(uint8_t* bytes, uint8_t* bytes_max, uint8_t prefix_bits, uint64_t* value)
+{
+    uint8_t mask = (uint8_t)((1 << prefix_bits) - 1);
+    int shift = 0;
+
+    if (bytes == NULL || bytes >= bytes_max) {
+        return NULL;
+    }
+    *value = *bytes & mask;
+    if ((*bytes++ & mask) == mask) {
+        do {
+            if (bytes >= bytes_max || shift > 56) {
+                return NULL;
+            }
+            *value += (uint64_t)(*bytes & 0x7f) << shift;
+            shift += 7;
+        } while ((*bytes++ & 0x80) != 0);
+    }
+    return bytes;
+}
+
+/* Skip a QPACK string, whose length prefix is in the first byte */
+static uint8_t* fuzzer_qpack_string_skip(uint8_t* bytes, uint8_t* bytes_max, uint8_t prefix_bits)
+{
+    uint64_t length = 0;
+
+    bytes = fuzzer_qpack_int_skip(bytes, bytes_max, prefix_bits, &length);
+    if (bytes != NULL && length > (uint64_t)(bytes_max - bytes)) {
+        bytes = NULL;
+    }
+    return (bytes == NULL) ? NULL : bytes + length;
+}
+
+/* Parse a sequence of QPACK instructions or field lines. Returns the
+ * number of lines parsed; *complete is set if the parse reached the end
+ * of the data exactly.
+ */
+static size_t fuzzer_qpack_parse(uint8_t* bytes, uint8_t* bytes_max, const fuzzer_qpack_representation_t* table,
+    size_t table_size, fuzzer_qpack_line_t* lines, int* complete)
+{
+    size_t nb_lines = 0;
+
+    *complete = 0;
+    while (bytes != NULL && bytes < bytes_max && nb_lines < FUZZER_QPACK_MAX_LINES) {
+        const fuzzer_qpack_representation_t* representation = NULL;
+        uint8_t* next;
+
+        for (size_t i = 0; i < table_size; i++) {
+            if ((bytes[0] & table[i].mask) == table[i].pattern) {
+                representation = &table[i];
+                break;
+            }
+        }
+        if (representation == NULL) {
+            break;
+        }
+        lines[nb_lines].start = bytes;
+        lines[nb_lines].value = NULL;
+        lines[nb_lines].representation = representation;
+        if (representation->is_name_length) {
+            next = fuzzer_qpack_string_skip(bytes, bytes_max, representation->prefix_bits);
+        }
+        else {
+            uint64_t index;
+            next = fuzzer_qpack_int_skip(bytes, bytes_max, representation->prefix_bits, &index);
+        }
+        if (next != NULL && representation->has_value) {
+            lines[nb_lines].value = next;
+            next = fuzzer_qpack_string_skip(next, bytes_max, 7);
+        }
+        nb_lines++;
+        bytes = next;
+    }
+    *complete = (bytes == bytes_max);
+
+    return nb_lines;
+}
+
+/* Set a prefix integer to zero, to its largest single byte value, or
+ * to a value whose continuation bytes run to the end of the data and
+ * overflow 64 bits.
+ */
+static void fuzzer_qpack_int_mutate(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max, uint8_t prefix_bits)
+{
+    uint8_t mask = (uint8_t)((1 << prefix_bits) - 1);
+
+    switch (fuzzer_prng_uniform(prng, 3)) {
+    case 0:
+        bytes[0] &= (uint8_t)~mask;
+        break;
+    case 1:
+        bytes[0] = (bytes[0] & (uint8_t)~mask) | (mask - 1);
+        break;
+    default:
+        bytes[0] |= mask;
+        for (int i = 1; i <= 10 && bytes + i < bytes_max; i++) {
+            bytes[i] = 0xff;
+        }
+        break;
+    }
+}
+
+/* Mutate one of the lines: change its representation, keeping the low
+ * bits, or mutate its index, name length or value length.
+ */
+static int fuzzer_qpack_lines_mutate(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max,
+    const fuzzer_qpack_representation_t* table, size_t table_size)
+{
+    fuzzer_qpack_line_t lines[FUZZER_QPACK_MAX_LINES];
+    int complete;
+    size_t nb_lines = fuzzer_qpack_parse(bytes, bytes_max, table, table_size, lines, &complete);
+    fuzzer_qpack_line_t* line;
+
+    if (nb_lines == 0) {
+        return 0;
+    }
+    line = &lines[fuzzer_prng_uniform(prng, nb_lines)];
+    switch (fuzzer_prng_uniform(prng, 4)) {
+    case 0: {
+        const fuzzer_qpack_representation_t* other = &table[fuzzer_prng_uniform(prng, table_size)];
+        line->start[0] = (line->start[0] & (uint8_t)~other->mask) | other->pattern;
+        break;
+    }
+    case 1:
+        if (line->value != NULL && line->value < bytes_max) {
+            /* Flip the Huffman bit of the value */
+            line->value[0] ^= 0x80;
+            break;
+        }
+        /* Fall through */
+    case 2:
+        if (line->value != NULL && line->value < bytes_max) {
+            fuzzer_qpack_int_mutate(prng, line->value, bytes_max, 7);
+            break;
+        }
+        /* Fall through */
+    default:
+        fuzzer_qpack_int_mutate(prng, line->start, bytes_max, line->representation->prefix_bits);
+        break;
+    }
+    return 1;
+}
+
+/* Mutate a field section: the encoded required insert count, the sign
+ * and value of the delta base, or one of the field lines.
+ */
+static int fuzzer_h3_field_section_mutate(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
+{
+    uint64_t value;
+    uint8_t* base = fuzzer_qpack_int_skip(bytes, bytes_max, 8, &value);
+    uint8_t* lines = fuzzer_qpack_int_skip(base, bytes_max, 7, &value);
+
+    if (bytes >= bytes_max) {
+        return 0;
+    }
+    switch ((lines == NULL || lines >= bytes_max) ? fuzzer_prng_uniform(prng, 3) : fuzzer_prng_uniform(prng, 6)) {
+    case 0:
+        fuzzer_qpack_int_mutate(prng, bytes, bytes_max, 8);
+        break;
+    case 1:
+        if (base != NULL && base < bytes_max) {
+            base[0] ^= 0x80;
+        }
+        else {
+            fuzzer_qpack_int_mutate(prng, bytes, bytes_max, 8);
+        }
+        break;
+    case 2:
+        if (base != NULL && base < bytes_max) {
+            fuzzer_qpack_int_mutate(prng, base, bytes_max, 7);
+        }
+        else {
+            fuzzer_qpack_int_mutate(prng, bytes, bytes_max, 8);
+        }
+        break;
+    default:
+        return fuzzer_qpack_lines_mutate(prng, lines, bytes_max, fuzzer_qpack_field_lines, FUZZER_NB_ELEMENTS(fuzzer_qpack_field_lines));
+    }
+    return 1;
+}
+
+/* Parse a sequence of HTTP/3 frames. Returns the number of frames; the
+ * last one may be truncated. *complete is set if the last frame ends
+ * exactly at the end of the data.
+ */
+static size_t fuzzer_h3_frames_parse(uint8_t* bytes, uint8_t* bytes_max, fuzzer_h3_frame_t* frames, int* complete)
+{
+    size_t nb_frames = 0;
+
+    *complete = 0;
+    while (bytes < bytes_max && nb_frames < FUZZER_H3_MAX_FRAMES) {
+        fuzzer_h3_frame_t* frame = &frames[nb_frames];
+        uint64_t length;
+
+        frame->start = bytes;
+        if ((frame->length_field = (uint8_t*)picoquic_frames_varint_decode(bytes, bytes_max, &frame->frame_type)) == NULL ||
+            (frame->payload = (uint8_t*)picoquic_frames_varint_decode(frame->length_field, bytes_max, &length)) == NULL) {
+            break;
+        }
+        nb_frames++;
+        if (length > (uint64_t)(bytes_max - frame->payload)) {
+            frame->end = bytes_max;
+            break;
+        }
+        frame->end = frame->payload + length;
+        bytes = frame->end;
+        *complete = (bytes == bytes_max);
+    }
+
+    return nb_frames;
+}
+
+/* Mutate the settings: identifier, value, or repeat the previous identifier */
+static void fuzzer_h3_settings_mutate(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
+{
+    uint8_t* settings[FUZZER_H3_MAX_FRAMES];
+    size_t nb_settings = 0;
+    uint8_t* setting_id;
+    uint8_t* value;
+
+    while (bytes != NULL && bytes < bytes_max && nb_settings < FUZZER_H3_MAX_FRAMES) {
+        settings[nb_settings++] = bytes;
+        bytes = (uint8_t*)picoquic_frames_varint_skip(bytes, bytes_max);
+        bytes = (uint8_t*)picoquic_frames_varint_skip(bytes, bytes_max);
+    }
+    if (nb_settings == 0) {
+        return;
+    }
+    setting_id = settings[fuzzer_prng_uniform(prng, nb_settings)];
+    if ((value = (uint8_t*)picoquic_frames_varint_skip(setting_id, bytes_max)) == NULL) {
+        return;
+    }
+    switch (fuzzer_prng_uniform(prng, 3)) {
+    case 0:
+        (void)fuzzer_varint_overwrite(setting_id, value,
+            fuzzer_h3_settings[fuzzer_prng_uniform(prng, FUZZER_NB_ELEMENTS(fuzzer_h3_settings))]);
+        break;
+    case 1:
+        if (setting_id != settings[0]) {
+            /* Repeated settings are a connection error */
+            uint64_t first_id;
+            (void)picoquic_frames_varint_decode(settings[0], bytes_max, &first_id);
+            (void)fuzzer_varint_overwrite(setting_id, value, first_id);
+            break;
+        }
+        /* Fall through */
+    default:
+        (void)fuzzer_varint_mutate(prng, value, bytes_max, FUZZER_VARINT_NO_LIMIT);
+        break;
+    }
+}
+
+/* Mutate the payload of a frame according to its type */
+static void fuzzer_h3_payload_mutate(fuzzer_prng_t* prng, fuzzer_h3_frame_t* frame)
+{
+    uint8_t* payload = frame->payload;
+
+    switch (frame->frame_type) {
+    case FUZZER_H3_FRAME_SETTINGS:
+        fuzzer_h3_settings_mutate(prng, payload, frame->end);
+        break;
+    case FUZZER_H3_FRAME_PUSH_PROMISE:
+        payload = fuzzer_varint_mutate(prng, payload, frame->end, FUZZER_VARINT_NO_LIMIT);
+        if (payload != NULL && fuzzer_prng_uniform(prng, 2) == 0) {
+            break;
+        }
+        payload = (uint8_t*)picoquic_frames_varint_skip(frame->payload, frame->end);
+        /* Fall through */
+    case FUZZER_H3_FRAME_HEADERS:
+        if (payload != NULL) {
+            (void)fuzzer_h3_field_section_mutate(prng, payload, frame->end);
+        }
+        break;
+    case FUZZER_H3_FRAME_CANCEL_PUSH:
+    case FUZZER_H3_FRAME_GOAWAY:
+    case FUZZER_H3_FRAME_MAX_PUSH_ID:
+    case FUZZER_H3_FRAME_PRIORITY_UPDATE_REQUEST:
+    case FUZZER_H3_FRAME_PRIORITY_UPDATE_PUSH:
+        (void)fuzzer_varint_mutate(prng, payload, frame->end, FUZZER_VARINT_NO_LIMIT);
+        break;
+    default:
+        if (payload < frame->end) {
+            payload[fuzzer_prng_uniform(prng, frame->end - payload)] ^= (uint8_t)(1 + fuzzer_prng_uniform(prng, 255));
+        }
+        break;
+    }
+}
+
+/* Swap a frame with the next one, e.g., DATA before HEADERS */
+static void fuzzer_h3_frames_swap(fuzzer_h3_frame_t* first, fuzzer_h3_frame_t* second)
+{
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    size_t first_length = first->end - first->start;
+    size_t second_length = second->end - second->start;
+
+    if (first_length <= sizeof(buffer)) {
+        memcpy(buffer, first->start, first_length);
+        memmove(first->start, second->start, second_length);
+        memcpy(first->start + second_length, buffer, first_length);
+    }
+}
+
+static int fuzzer_h3_frames_mutate(fuzzer_prng_t* prng, uint8_t* bytes, uint8_t* bytes_max)
+{
+    fuzzer_h3_frame_t frames[FUZZER_H3_MAX_FRAMES];
+    int complete;
+    size_t nb_frames = fuzzer_h3_frames_parse(bytes, bytes_max, frames, &complete);
+    size_t rank;
+    fuzzer_h3_frame_t* frame;
+
+    if (nb_frames == 0) {
+        return 0;
+    }
+    rank = (size_t)fuzzer_prng_uniform(prng, nb_frames);
+    frame = &frames[rank];
+    switch (fuzzer_prng_uniform(prng, 8)) {
+    case 0:
+        (void)fuzzer_varint_overwrite(frame->start, frame->length_field,
+            fuzzer_h3_frame_types[fuzzer_prng_uniform(prng, FUZZER_NB_ELEMENTS(fuzzer_h3_frame_types))]);
+        break;
+    case 1:
+        (void)fuzzer_varint_mutate(prng, frame->length_field, frame->payload, (uint64_t)(bytes_max - frame->payload));
+        break;
+    case 2:
+        if (rank + 1 < nb_frames) {
+            fuzzer_h3_frames_swap(frame, &frames[rank + 1]);
+            break;
+        }
+        /* Fall through */
+    default:
+        fuzzer_h3_payload_mutate(prng, frame);
+        break;
+    }
+    return 1;
+}
+
+/* Mutate the data of a stream, starting at the given offset.
+ * Returns 1 if the data was modified.
+ */
+int fuzzer_h3_stream_mutate(fuzzer_prng_t* prng, uint64_t stream_id, uint64_t offset, uint8_t* data, uint8_t* data_max)
+{
+    fuzzer_h3_frame_t frames[FUZZER_H3_MAX_FRAMES];
+    fuzzer_qpack_line_t lines[FUZZER_QPACK_MAX_LINES];
+    int complete = 0;
+
+    if (data == NULL || data >= data_max) {
+        return 0;
+    }
+    if ((stream_id & 2) == 0) {
+        /* Request stream */
+        if (offset == 0 || (fuzzer_h3_frames_parse(data, data_max, frames, &complete) > 0 && complete)) {
+            return fuzzer_h3_frames_mutate(prng, data, data_max);
+        }
+    }
+    else if (offset == 0) {
+        uint64_t stream_type;
+        uint8_t* bytes = (uint8_t*)picoquic_frames_varint_decode(data, data_max, &stream_type);
+
+        if (bytes == NULL || fuzzer_prng_uniform(prng, 8) == 0) {
+            (void)fuzzer_varint_overwrite(data, (bytes == NULL) ? data + 1 : bytes,
+                fuzzer_h3_stream_types[fuzzer_prng_uniform(prng, FUZZER_NB_ELEMENTS(fuzzer_h3_stream_types))]);
+            return 1;
+        }
+        switch (stream_type) {
+        case FUZZER_H3_STREAM_PUSH:
+            bytes = (uint8_t*)picoquic_frames_varint_skip(bytes, data_max);
+            /* Fall through */
+        case FUZZER_H3_STREAM_CONTROL:
+            return (bytes == NULL) ? 0 : fuzzer_h3_frames_mutate(prng, bytes, data_max);
+        case FUZZER_H3_STREAM_QPACK_ENCODER:
+            return fuzzer_qpack_lines_mutate(prng, bytes, data_max, fuzzer_qpack_encoder_instructions,
+                FUZZER_NB_ELEMENTS(fuzzer_qpack_encoder_instructions));
+        case FUZZER_H3_STREAM_QPACK_DECODER:
+            return fuzzer_qpack_lines_mutate(prng, bytes, data_max, fuzzer_qpack_decoder_instructions,
+                FUZZER_NB_ELEMENTS(fuzzer_qpack_decoder_instructions));
+        default:
+            break;
+        }
+    }
+    else if (fuzzer_h3_frames_parse(data, data_max, frames, &complete) > 0 && complete) {
+        return fuzzer_h3_frames_mutate(prng, data, data_max);
+    }
+    else if (fuzzer_qpack_parse(data, data_max, fuzzer_qpack_encoder_instructions,
+        FUZZER_NB_ELEMENTS(fuzzer_qpack_encoder_instructions), lines, &complete) > 0 && complete) {
+        return fuzzer_qpack_lines_mutate(prng, data, data_max, fuzzer_qpack_encoder_instructions,
+            FUZZER_NB_ELEMENTS(fuzzer_qpack_encoder_instructions));
+    }
+    else {
+        return fuzzer_qpack_lines_mutate(prng, data, data_max, fuzzer_qpack_decoder_instructions,
+            FUZZER_NB_ELEMENTS(fuzzer_qpack_decoder_instructions));
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Fuzzing profiles are kept in a text file, with one section per target:
+ *
+ *     profile <key>
+ *     <state> <wait_max> <waited_max> <nb_packets_state> <nb_packets_fuzzed>
+ *     ...
+ *
+ * Saving a profile rewrites the file, keeping the sections of other
+ * targets unchanged and replacing the section of the current target.
+ */
+
+#define FUZI_Q_PROFILE_LINE_MAX 512
+#define FUZI_Q_PROFILE_HEADER "profile "
+
+int fuzi_q_profile_key(char* key, size_t key_max, char const* server_name, int server_port, char const* alpn)
+{
+    int ret = picoquic_sprintf(key, key_max, NULL, "%s:%d/%s",
+        (server_name == NULL) ? "server" : server_name, server_port,
+        (alpn == NULL) ? "default" : alpn);
+
+    if (ret == 0) {
+        /* Keys are stored on a single line, without white space */
+        for (char* x = key; *x != 0; x++) {
+            if (*x == ' ' || *x == '\t' || *x == '\r' || *x == '\n') {
+                *x = '_';
+            }
+        }
+    }
+    return ret;
+}
+
+/* Check whether a line is the header of a section, and if key is not
+ * NULL whether that is the section of the specified key.
+ */
+static int fuzi_q_profile_is_header(char const* line, char const* key)
+{
+    size_t header_len = strlen(FUZI_Q_PROFILE_HEADER);
+    int is_header = (strncmp(line, FUZI_Q_PROFILE_HEADER, header_len) == 0);
+
+    if (is_header && key != NULL) {
+        size_t key_len = strlen(key);
+        char const* line_key = line + header_len;
+
+        is_header = (strncmp(line_key, key, key_len) == 0 &&
+            (line_key[key_len] == 0 || line_key[key_len] == '\r' || line_key[key_len] == '\n'));
+    }
+    return is_header;
+}
+
+int fuzi_q_profile_load(fuzzer_ctx_t* fuzz_ctx, char const* profile_file, char const* key)
+{
+    int ret = 0;
+    int found = 0;
+    FILE* F = picoquic_file_open(profile_file, "r");
+
+    if (F == NULL) {
+        ret = -1;
+    }
+    else {
+        char line[FUZI_Q_PROFILE_LINE_MAX];
+        int in_section = 0;
+
+        while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+            if (fuzi_q_profile_is_header(line, NULL)) {
+                in_section = fuzi_q_profile_is_header(line, key);
+                found |= in_section;
+            }
+            else if (in_section) {
+                int state;
+                int wait_max;
+                int waited_max;
+                unsigned long long nb_packets_state;
+                unsigned long long nb_packets_fuzzed;
+
+                if (sscanf(line, "%d %d %d %llu %llu", &state, &wait_max, &waited_max,
+                    &nb_packets_state, &nb_packets_fuzzed) != 5 ||
+                    state < 0 || state >= fuzzer_cnx_state_max || wait_max < 0 || waited_max < 0) {
+                    DBG_PRINTF("Invalid profile line: %s", line);
+                    ret = -1;
+                }
+                else {
+                    if (wait_max > fuzz_ctx->wait_max[state]) {
+                        fuzz_ctx->wait_max[state] = wait_max;
+                    }
+                    if (waited_max > fuzz_ctx->waited_max[state]) {
+                        fuzz_ctx->waited_max[state] = waited_max;
+                    }
+                    fuzz_ctx->profile_packets_state[state] = (uint64_t)nb_packets_state;
+                    fuzz_ctx->profile_packets_fuzzed[state] = (uint64_t)nb_packets_fuzzed;
+                }
+            }
+        }
+        (void)picoquic_file_close(F);
+
+        if (ret == 0 && !found) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Read the content of the profile file, minus the section of the
+ * specified key. Sets *others to NULL if the file does not exist yet.
+ * Returns -1 if memory cannot be allocated, so that the caller does
+ * not overwrite the file and lose the other sections.
+ */
+static int fuzi_q_profile_read_others(char const* profile_file, char const* key, char** others, size_t* length)
+{
+    int ret = 0;
+    size_t others_max = 0;
+    FILE* F = picoquic_file_open(profile_file, "r");
+
+    *others = NULL;
+    *length = 0;
+    if (F != NULL) {
+        char line[FUZI_Q_PROFILE_LINE_MAX];
+        int in_section = 0;
+
+        while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+            size_t line_len = strlen(line);
+
+            if (fuzi_q_profile_is_header(line, NULL)) {
+                in_section = fuzi_q_profile_is_header(line, key);
+            }
+            if (in_section) {
+                continue;
+            }
+            if (*length + line_len + 1 > others_max) {
+                size_t new_max = (others_max == 0) ? 4096 : 2 * others_max;
+                char* new_others;
+
+                while (new_max < *length + line_len + 1) {
+                    new_max *= 2;
+                }
+                new_others = (char*)realloc(*others, new_max);
+                if (new_others == NULL) {
+                    free(*others);
+                    *others = NULL;
+                    *length = 0;
+                    ret = -1;
+                    break;
+                }
+                *others = new_others;
+                others_max = new_max;
+            }
+            memcpy(*others + *length, line, line_len);
+            *length += line_len;
+        }
+        (void)picoquic_file_close(F);
+    }
+    return ret;
+}
+
+int fuzi_q_profile_save(fuzzer_ctx_t* fuzz_ctx, char const* profile_file, char const* key)
+{
+    size_t others_length = 0;
+    char* others = NULL;
+    int ret = fuzi_q_profile_read_others(profile_file, key, &others, &others_length);
+    FILE* F = NULL;
+
+    if (ret == 0) {
+        F = picoquic_file_open(profile_file, "w");
+    }
+    if (F == NULL) {
+        ret = -1;
+    }
+    else {
+        if (others != NULL && fwrite(others, 1, others_length, F) != others_length) {
+            ret = -1;
+        }
+        if (ret == 0 && fprintf(F, "%s%s\n", FUZI_Q_PROFILE_HEADER, key) <= 0) {
+            ret = -1;
+        }
+        for (int i = 0; ret == 0 && i < fuzzer_cnx_state_max; i++) {
+            if (fprintf(F, "%d %d %d %llu %llu\n", i, fuzz_ctx->wait_max[i], fuzz_ctx->waited_max[i],
+                (unsigned long long)(fuzz_ctx->profile_packets_state[i] + fuzz_ctx->nb_packets_state[i]),
+                (unsigned long long)(fuzz_ctx->profile_packets_fuzzed[i] + fuzz_ctx->nb_packets_fuzzed[i])) <= 0) {
+                ret = -1;
+            }
+        }
+        (void)picoquic_file_close(F);
+    }
+
+    if (others != NULL) {
+        free(others);
+    }
+
+    return ret;
+}
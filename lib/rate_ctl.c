@@ -0,0 +1,147 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "fuzi_q.h"
+
+/* Connection rate controller.
+ *
+ * The outcomes of the connections are evaluated per epoch, an epoch
+ * ending when as many connections as the current pool size have closed.
+ * At the end of an epoch, the controller checks the connections that were
+ * not fuzzed for signs of overload: too many connections abandoned after
+ * repeated retransmissions or silence, too few connections completing the
+ * handshake, or an average RTT much larger than the smallest RTT observed.
+ * Fuzzed connections are expected to fail, so they only count for the
+ * length of the epoch. On overload, the pool size
+ * is halved and the interval between connection starts is doubled.
+ * Otherwise, the pool grows by one connection and the interval is
+ * reduced by a quarter, until the configured bounds are reached.
+ */
+
+void fuzi_q_rate_init(fuzi_q_rate_ctl_t* rate_ctl, size_t pool_max, uint64_t current_time)
+{
+    memset(rate_ctl, 0, sizeof(fuzi_q_rate_ctl_t));
+    rate_ctl->pool_min = 1;
+    rate_ctl->pool_max = pool_max;
+    rate_ctl->pool_size = (pool_max + 1) / 2;
+    rate_ctl->rtt_min = UINT64_MAX;
+    rate_ctl->next_start_time = current_time;
+}
+
+int fuzi_q_rate_can_start(fuzi_q_rate_ctl_t* rate_ctl, size_t nb_active, uint64_t current_time)
+{
+    /* A controller that was never initialized does not limit the pool */
+    return (rate_ctl->pool_max == 0 ||
+        (nb_active < rate_ctl->pool_size && current_time >= rate_ctl->next_start_time));
+}
+
+void fuzi_q_rate_on_start(fuzi_q_rate_ctl_t* rate_ctl, uint64_t current_time)
+{
+    rate_ctl->next_start_time = current_time + rate_ctl->start_interval;
+}
+
+static int fuzi_q_rate_is_overloaded(fuzi_q_rate_ctl_t* rate_ctl)
+{
+    int is_overloaded = 0;
+
+    if (rate_ctl->epoch_abandoned * FUZI_Q_RATE_ABANDON_RATIO > rate_ctl->epoch_unfuzzed) {
+        is_overloaded = 1;
+    }
+    else if (rate_ctl->epoch_success * FUZI_Q_RATE_SUCCESS_RATIO < rate_ctl->epoch_unfuzzed) {
+        is_overloaded = 1;
+    }
+    else if (rate_ctl->epoch_nb_rtt > 0 && rate_ctl->rtt_min != UINT64_MAX) {
+        uint64_t rtt_average = rate_ctl->epoch_rtt_sum / rate_ctl->epoch_nb_rtt;
+
+        if (rtt_average > 2 * rate_ctl->rtt_min &&
+            rtt_average > rate_ctl->rtt_min + FUZI_Q_RATE_RTT_MARGIN) {
+            is_overloaded = 1;
+        }
+    }
+
+    return is_overloaded;
+}
+
+void fuzi_q_rate_on_close(fuzi_q_rate_ctl_t* rate_ctl, int was_fuzzed, int handshake_done, int abandoned, uint64_t rtt)
+{
+    if (rate_ctl->pool_max == 0) {
+        return;
+    }
+
+    rate_ctl->epoch_closed++;
+    if (was_fuzzed) {
+        if (abandoned) {
+            rate_ctl->nb_fuzzed_abandoned++;
+        }
+    }
+    else {
+        rate_ctl->epoch_unfuzzed++;
+        if (abandoned) {
+            rate_ctl->epoch_abandoned++;
+        }
+    }
+    if (handshake_done && !was_fuzzed) {
+        rate_ctl->epoch_success++;
+        if (rtt > 0) {
+            rate_ctl->epoch_rtt_sum += rtt;
+            rate_ctl->epoch_nb_rtt++;
+            if (rtt < rate_ctl->rtt_min) {
+                rate_ctl->rtt_min = rtt;
+            }
+        }
+    }
+
+    if (rate_ctl->epoch_closed >= rate_ctl->pool_size) {
+        if (fuzi_q_rate_is_overloaded(rate_ctl)) {
+            rate_ctl->pool_size /= 2;
+            if (rate_ctl->pool_size < rate_ctl->pool_min) {
+                rate_ctl->pool_size = rate_ctl->pool_min;
+            }
+            rate_ctl->start_interval *= 2;
+            if (rate_ctl->start_interval < FUZI_Q_RATE_INTERVAL_MIN) {
+                rate_ctl->start_interval = FUZI_Q_RATE_INTERVAL_MIN;
+            }
+            else if (rate_ctl->start_interval > FUZI_Q_RATE_INTERVAL_MAX) {
+                rate_ctl->start_interval = FUZI_Q_RATE_INTERVAL_MAX;
+            }
+            rate_ctl->nb_decrease++;
+        }
+        else {
+            if (rate_ctl->pool_size < rate_ctl->pool_max) {
+                rate_ctl->pool_size++;
+            }
+            rate_ctl->start_interval -= rate_ctl->start_interval / 4;
+            if (rate_ctl->start_interval < FUZI_Q_RATE_INTERVAL_MIN) {
+                rate_ctl->start_interval = 0;
+            }
+            rate_ctl->nb_increase++;
+        }
+        rate_ctl->epoch_closed = 0;
+        rate_ctl->epoch_unfuzzed = 0;
+        rate_ctl->epoch_abandoned = 0;
+        rate_ctl->epoch_success = 0;
+        rate_ctl->epoch_rtt_sum = 0;
+        rate_ctl->epoch_nb_rtt = 0;
+    }
+}
@@ -0,0 +1,87 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Generation of the client scenario of each connection.
+ *
+ * The scenario is derived from the ICID, so that a replay of the
+ * connection runs the same streams. The number of streams, their
+ * repetitions, the sizes of the documents and of the posted data, and
+ * the dependencies between streams all vary, so that the fuzzed frames
+ * hit streams in many different states: idle, open, half closed, or
+ * waiting for an earlier stream to complete.
+ */
+
+static uint64_t fuzi_q_scenario_size(fuzzer_prng_t* prng)
+{
+    /* Sizes at packet and flow control boundaries, or on a log scale */
+    static const uint64_t boundaries[] = { 0, 1, 1200, 1500, 16383, 16384, 65535, 65536 };
+
+    if (fuzzer_prng_uniform(prng, 2) == 0) {
+        return boundaries[fuzzer_prng_uniform(prng, sizeof(boundaries) / sizeof(boundaries[0]))];
+    }
+    return fuzzer_prng_uniform(prng, (uint64_t)2 << fuzzer_prng_uniform(prng, FUZI_Q_SCENARIO_SIZE_LOG_MAX));
+}
+
+int fuzi_q_scenario_generate(const picoquic_connection_id_t* icid, fuzi_q_scenario_t* scenario)
+{
+    int ret = 0;
+    uint8_t scenario_hash_seed[] = { 's', 'c', 'e', 'n', 'a', 'r', 'i', 'o', 0, 1, 2, 3, 4, 5, 6, 7 };
+    fuzzer_prng_t prng;
+    uint64_t stream_id = 0;
+    picoquic_demo_stream_desc_t* sc = scenario->streams;
+
+    fuzzer_prng_seed(&prng, picoquic_connection_id_hash(icid, scenario_hash_seed));
+    scenario->nb_streams = 1 + (size_t)fuzzer_prng_uniform(&prng, FUZI_Q_SCENARIO_STREAMS_MAX);
+
+    for (size_t i = 0; ret == 0 && i < scenario->nb_streams; i++) {
+        uint64_t doc_size = fuzi_q_scenario_size(&prng);
+
+        memset(&sc[i], 0, sizeof(picoquic_demo_stream_desc_t));
+        sc[i].repeat_count = (fuzzer_prng_uniform(&prng, 8) == 0) ? 1 + fuzzer_prng_uniform(&prng, FUZI_Q_SCENARIO_REPEAT_MAX) : 0;
+        sc[i].stream_id = stream_id;
+        /* Half of the streams start at once, the others after an earlier stream */
+        sc[i].previous_stream_id = (i == 0 || fuzzer_prng_uniform(&prng, 2) == 0) ?
+            PICOQUIC_DEMO_STREAM_ID_INITIAL : sc[fuzzer_prng_uniform(&prng, i)].stream_id;
+        /* One stream in four is an upload */
+        sc[i].post_size = (fuzzer_prng_uniform(&prng, 4) == 0) ? fuzi_q_scenario_size(&prng) : 0;
+        sc[i].is_binary = (int)fuzzer_prng_uniform(&prng, 2);
+        /* The names are stored in the scenario, which needs no allocation */
+        ret = picoquic_sprintf(scenario->doc_name[i], FUZI_Q_SCENARIO_NAME_MAX, NULL, "/%llu", (unsigned long long)doc_size);
+        if (ret == 0) {
+            ret = picoquic_sprintf(scenario->f_name[i], FUZI_Q_SCENARIO_NAME_MAX, NULL, "_%llu", (unsigned long long)doc_size);
+        }
+        sc[i].doc_name = scenario->doc_name[i];
+        sc[i].f_name = scenario->f_name[i];
+        stream_id += 4 * (sc[i].repeat_count + 1);
+    }
+
+    if (ret != 0) {
+        scenario->nb_streams = 0;
+    }
+    return ret;
+}
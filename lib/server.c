@@ -24,6 +24,7 @@
 #include <string.h>
 #include <picoquic_internal.h>
 #include <picoquic_packet_loop.h>
+#include <picosocks.h>
 #include <autoqlog.h>
 #include <performance_log.h>
 #include "fuzi_q.h"
@@ -63,10 +64,91 @@ int fuzi_q_server_loop_cb(picoquic_quic_t* quic, picoquic_packet_loop_cb_enum cb
     return ret;
 }
 
+/* Server loop used when stateless responses are enabled. The picoquic
+ * packet loop does not let the application see packets before they are
+ * processed, so this loop reads the sockets, answers the selected Initials
+ * directly, and passes the other packets to picoquic.
+ */
+static SOCKET_TYPE fuzi_q_server_socket(picoquic_server_sockets_t* sockets, struct sockaddr_storage* addr)
+{
+    /* The server sockets are opened for AF_INET6, then AF_INET */
+    return sockets->s_socket[(addr->ss_family == AF_INET) ? 1 : 0];
+}
+
+static int fuzi_q_server_stateless_loop(fuzi_q_ctx_t* fuzi_q_ctx, int server_port, uint64_t duration_max)
+{
+    int ret = 0;
+    picoquic_server_sockets_t sockets;
+    uint64_t current_time = picoquic_current_time();
+    uint64_t end_of_time = (duration_max == 0) ? UINT64_MAX : current_time + duration_max * 1000000;
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t send_buffer[PICOQUIC_MAX_PACKET_SIZE];
+
+    if ((ret = picoquic_open_server_sockets(&sockets, server_port)) != 0) {
+        fprintf(stdout, "Cannot open the server sockets on port %d.\n", server_port);
+        return ret;
+    }
+    fprintf(stdout, "Waiting for packets, answering 1 Initial in %u statelessly.\n", fuzi_q_ctx->stateless.ratio);
+
+    while (ret == 0 && current_time < end_of_time) {
+        struct sockaddr_storage addr_from;
+        struct sockaddr_storage addr_to;
+        int if_index_to = 0;
+        unsigned char received_ecn = 0;
+        size_t send_length = 0;
+        int64_t delta_t = picoquic_get_next_wake_delay(fuzi_q_ctx->quic, current_time, FUZI_Q_MAX_SILENCE);
+        int bytes_recv = picoquic_select(sockets.s_socket, PICOQUIC_NB_SERVER_SOCKETS, &addr_from, &addr_to,
+            &if_index_to, &received_ecn, buffer, sizeof(buffer), delta_t, &current_time);
+
+        if (bytes_recv < 0) {
+            ret = -1;
+        }
+        else if (bytes_recv > 0) {
+            size_t response_length = fuzi_q_stateless_response(&fuzi_q_ctx->stateless, buffer, (size_t)bytes_recv,
+                send_buffer, sizeof(send_buffer));
+
+            if (response_length > 0) {
+                int sock_err = 0;
+                (void)picoquic_send_through_socket(fuzi_q_server_socket(&sockets, &addr_from), (struct sockaddr*)&addr_from,
+                    (struct sockaddr*)&addr_to, if_index_to, (const char*)send_buffer, (int)response_length, &sock_err);
+            }
+            else {
+                /* Errors on incoming packets are not fatal for the server */
+                (void)picoquic_incoming_packet(fuzi_q_ctx->quic, buffer, (size_t)bytes_recv, (struct sockaddr*)&addr_from,
+                    (struct sockaddr*)&addr_to, if_index_to, received_ecn, current_time);
+            }
+        }
+
+        do {
+            struct sockaddr_storage peer_addr;
+            struct sockaddr_storage local_addr;
+            int if_index = 0;
+
+            send_length = 0;
+            current_time = picoquic_current_time();
+            ret = picoquic_prepare_next_packet(fuzi_q_ctx->quic, current_time, send_buffer, sizeof(send_buffer), &send_length,
+                &peer_addr, &local_addr, &if_index, NULL, NULL);
+            if (ret == 0 && send_length > 0) {
+                int sock_err = 0;
+                (void)picoquic_send_through_socket(fuzi_q_server_socket(&sockets, &peer_addr), (struct sockaddr*)&peer_addr,
+                    (struct sockaddr*)&local_addr, if_index, (const char*)send_buffer, (int)send_length, &sock_err);
+            }
+        } while (ret == 0 && send_length > 0);
+    }
+
+    fprintf(stdout, "Received %" PRIu64 " Initials, answered %" PRIu64 " with VN, %" PRIu64 " with Retry.\n",
+        fuzi_q_ctx->stateless.nb_initials, fuzi_q_ctx->stateless.nb_vn, fuzi_q_ctx->stateless.nb_retry);
+    picoquic_close_server_sockets(&sockets);
+
+    return ret;
+}
+
 /* Fuzi Quic Server
- * TODO: manage loop options like key updates, migrations, etc. 
+ * The server does not start migrations or key updates. It answers those
+ * started by the clients, which plan them per connection.
  */
-int fuzi_q_server(fuzi_q_mode_enum fuzz_mode, picoquic_quic_config_t* config, uint64_t duration_max)
+int fuzi_q_server(fuzi_q_mode_enum fuzz_mode, picoquic_quic_config_t* config, uint64_t duration_max,
+    char const* profile_file, uint32_t stateless_ratio)
 {
     /* Start: start the QUIC process with cert and key files */
     int ret = 0;
@@ -93,7 +175,15 @@ int fuzi_q_server(fuzi_q_mode_enum fuzz_mode, picoquic_quic_config_t* config, ui
         }
         else {
             fuzi_q_ctx.fuzz_mode = fuzz_mode;
+            fuzi_q_ctx.stateless.ratio = stateless_ratio;
             fuzi_q_fuzzer_init(&fuzi_q_ctx.fuzz_ctx, NULL, NULL);
+            if (profile_file != NULL &&
+                fuzi_q_profile_key(fuzi_q_ctx.profile_key, sizeof(fuzi_q_ctx.profile_key), NULL, config->server_port, config->alpn) == 0) {
+                fuzi_q_ctx.profile_file = profile_file;
+                if (fuzi_q_profile_load(&fuzi_q_ctx.fuzz_ctx, profile_file, fuzi_q_ctx.profile_key) == 0) {
+                    fprintf(stdout, "Loaded fuzzing profile <%s> from %s\n", fuzi_q_ctx.profile_key, profile_file);
+                }
+            }
             picoquic_set_fuzz(fuzi_q_ctx.quic, fuzi_q_fuzzer, &fuzi_q_ctx.fuzz_ctx);
             picoquic_set_key_log_file_from_env(fuzi_q_ctx.quic);
 
@@ -126,7 +216,10 @@ int fuzi_q_server(fuzi_q_mode_enum fuzz_mode, picoquic_quic_config_t* config, ui
         }
     }
 
-    if (ret == 0) {
+    if (ret == 0 && stateless_ratio > 0) {
+        ret = fuzi_q_server_stateless_loop(&fuzi_q_ctx, config->server_port, duration_max);
+    }
+    else if (ret == 0) {
         /* Wait for packets */
 #if _WINDOWS
         ret = picoquic_packet_loop_win(fuzi_q_ctx.quic, config->server_port, 0, config->dest_if,
@@ -140,7 +233,13 @@ int fuzi_q_server(fuzi_q_mode_enum fuzz_mode, picoquic_quic_config_t* config, ui
     /* And exit */
     printf("Server exit, ret = 0x%x\n", ret);
 
+    if (fuzi_q_ctx.profile_file != NULL &&
+        fuzi_q_profile_save(&fuzi_q_ctx.fuzz_ctx, fuzi_q_ctx.profile_file, fuzi_q_ctx.profile_key) != 0) {
+        printf("Could not save the fuzzing profile in %s\n", fuzi_q_ctx.profile_file);
+    }
+
     fuzi_q_fuzzer_release(&fuzi_q_ctx.fuzz_ctx);
+    fuzi_q_stateless_release(&fuzi_q_ctx.stateless);
 
     if (fuzi_q_ctx.quic != NULL) {
         picoquic_free(fuzi_q_ctx.quic);
@@ -0,0 +1,277 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_internal.h>
+#include <picoquic_utils.h>
+#include <tls_api.h>
+#include "fuzi_q.h"
+
+/* Stateless responses in server mode.
+ *
+ * Picoquic only sends Version Negotiation or Retry packets when the
+ * configuration requires it, and these packets do not go through the
+ * fuzz hook. Instead, the server loop passes each incoming packet to
+ * fuzi_q_stateless_response before picoquic sees it. A fraction of the
+ * client Initials is answered with a synthesized VN or Retry packet,
+ * mutated, and the Initial is dropped, so no connection is created. The
+ * decisions use a PRNG seeded with the DCID of the Initial, so that the
+ * retransmissions of an Initial get the same response.
+ */
+
+/* Parse the header of a client Initial. Returns 0 if the packet is not
+ * a long header Initial packet of a non zero version.
+ */
+static int fuzi_q_stateless_parse(const uint8_t* bytes, size_t length, uint32_t* version,
+    picoquic_connection_id_t* dcid, picoquic_connection_id_t* scid)
+{
+    size_t offset = 5;
+
+    if (length < 7 || (bytes[0] & 0xc0) != 0xc0 || (*version = PICOPARSE_32(bytes + 1)) == 0 ||
+        ((bytes[0] >> 4) & 3) != ((*version == FUZI_Q_QUIC_V2_VERSION) ? 1 : 0)) {
+        return 0;
+    }
+    if (bytes[offset] > PICOQUIC_CONNECTION_ID_MAX_SIZE || offset + 2 + bytes[offset] > length) {
+        return 0;
+    }
+    dcid->id_len = bytes[offset];
+    memcpy(dcid->id, bytes + offset + 1, dcid->id_len);
+    offset += 1 + dcid->id_len;
+    if (bytes[offset] > PICOQUIC_CONNECTION_ID_MAX_SIZE || offset + 1 + bytes[offset] > length) {
+        return 0;
+    }
+    scid->id_len = bytes[offset];
+    memcpy(scid->id, bytes + offset + 1, scid->id_len);
+
+    return 1;
+}
+
+static uint8_t* fuzi_q_stateless_cid(uint8_t* p, const picoquic_connection_id_t* cid)
+{
+    *p++ = cid->id_len;
+    memcpy(p, cid->id, cid->id_len);
+    return p + cid->id_len;
+}
+
+/* Change one byte of a CID echo, or its length */
+static void fuzi_q_stateless_wrong_cid(fuzzer_prng_t* prng, picoquic_connection_id_t* cid)
+{
+    if (cid->id_len > 0 && fuzzer_prng_uniform(prng, 2) == 0) {
+        cid->id[fuzzer_prng_uniform(prng, cid->id_len)] ^= (uint8_t)(1 + fuzzer_prng_uniform(prng, 255));
+    }
+    else {
+        cid->id_len = (uint8_t)fuzzer_prng_uniform(prng, PICOQUIC_CONNECTION_ID_MAX_SIZE + 1);
+        for (uint8_t i = 0; i < cid->id_len; i++) {
+            cid->id[i] = (uint8_t)fuzzer_prng_next(prng);
+        }
+    }
+}
+
+/* Build a Version Negotiation packet in response to an Initial, listing the
+ * supported versions and a grease version, then mutate the CID echoes or the
+ * version list. Returns the packet length.
+ */
+size_t fuzi_q_stateless_vn(fuzzer_prng_t* prng, uint32_t version, const picoquic_connection_id_t* dcid,
+    const picoquic_connection_id_t* scid, uint8_t* bytes, size_t bytes_max)
+{
+    picoquic_connection_id_t vn_dcid = *scid;
+    picoquic_connection_id_t vn_scid = *dcid;
+    uint64_t choice = fuzzer_prng_uniform(prng, 8);
+    size_t header_length;
+    size_t length;
+    uint8_t* p = bytes;
+
+    if (bytes_max < 1 + 4 + 2 + 2 * PICOQUIC_CONNECTION_ID_MAX_SIZE + 4 * (picoquic_nb_supported_versions + 2)) {
+        return 0;
+    }
+    if (choice == 1) {
+        fuzi_q_stateless_wrong_cid(prng, &vn_dcid);
+    }
+    else if (choice == 2) {
+        fuzi_q_stateless_wrong_cid(prng, &vn_scid);
+    }
+    *p++ = 0x80 | (uint8_t)fuzzer_prng_uniform(prng, 0x80);
+    picoformat_32(p, 0);
+    p += 4;
+    p = fuzi_q_stateless_cid(p, &vn_dcid);
+    p = fuzi_q_stateless_cid(p, &vn_scid);
+    header_length = p - bytes;
+
+    switch (choice) {
+    case 3:
+        /* Empty list */
+        break;
+    case 4:
+        /* The version of the Initial, which the client must ignore */
+        picoformat_32(p, version);
+        p += 4;
+        break;
+    case 5:
+        /* Fill the packet with grease and random versions */
+        while (p + 4 <= bytes + bytes_max && p + 4 <= bytes + PICOQUIC_MAX_PACKET_SIZE) {
+            picoformat_32(p, (fuzzer_prng_uniform(prng, 2) == 0) ? (uint32_t)fuzzer_prng_next(prng) :
+                (((uint32_t)fuzzer_prng_next(prng) & 0xf0f0f0f0) | 0x0a0a0a0a));
+            p += 4;
+        }
+        break;
+    default:
+        for (size_t i = 0; i < picoquic_nb_supported_versions; i++) {
+            picoformat_32(p, picoquic_supported_versions[i].version);
+            p += 4;
+        }
+        picoformat_32(p, ((uint32_t)fuzzer_prng_next(prng) & 0xf0f0f0f0) | 0x0a0a0a0a);
+        p += 4;
+        break;
+    }
+    length = p - bytes;
+    if (choice == 6) {
+        /* List length not a multiple of 4 */
+        length -= 1 + (size_t)fuzzer_prng_uniform(prng, 3);
+    }
+    else if (choice == 7 && length > header_length) {
+        length = version_negotiation_packet_fuzzer(prng, bytes, header_length, length, bytes_max);
+    }
+    return length;
+}
+
+/* Build a Retry packet in response to an Initial, with a new SCID, a random
+ * token and the integrity tag computed over the DCID of the Initial, then
+ * mutate the CIDs, the token or the tag. Returns the packet length, or 0 if
+ * there is no integrity context for the version.
+ */
+size_t fuzi_q_stateless_retry(fuzzer_prng_t* prng, void* retry_aead, uint32_t version, const picoquic_connection_id_t* dcid,
+    const picoquic_connection_id_t* scid, uint8_t* bytes, size_t bytes_max)
+{
+    picoquic_connection_id_t retry_dcid = *scid;
+    picoquic_connection_id_t retry_scid;
+    picoquic_connection_id_t odcid = *dcid;
+    uint64_t choice = fuzzer_prng_uniform(prng, 8);
+    size_t token_length = 16 + (size_t)fuzzer_prng_uniform(prng, FUZI_Q_STATELESS_TOKEN_MAX - 15);
+    size_t length;
+    uint8_t* p = bytes;
+
+    if (retry_aead == NULL || bytes_max < 1 + 4 + 2 + 2 * PICOQUIC_CONNECTION_ID_MAX_SIZE + FUZI_Q_STATELESS_TOKEN_MAX + 16) {
+        return 0;
+    }
+    retry_scid.id_len = 8;
+    for (uint8_t i = 0; i < retry_scid.id_len; i++) {
+        retry_scid.id[i] = (uint8_t)fuzzer_prng_next(prng);
+    }
+    switch (choice) {
+    case 1:
+        /* Same SCID as the original DCID */
+        retry_scid = *dcid;
+        break;
+    case 2:
+        retry_scid.id_len = (fuzzer_prng_uniform(prng, 2) == 0) ? 0 : PICOQUIC_CONNECTION_ID_MAX_SIZE;
+        for (uint8_t i = 0; i < retry_scid.id_len; i++) {
+            retry_scid.id[i] = (uint8_t)fuzzer_prng_next(prng);
+        }
+        break;
+    case 3:
+        /* Clients must discard a Retry with an empty token */
+        token_length = 0;
+        break;
+    case 4:
+        fuzi_q_stateless_wrong_cid(prng, &retry_dcid);
+        break;
+    case 5:
+        /* Tag computed over another connection ID */
+        fuzi_q_stateless_wrong_cid(prng, &odcid);
+        break;
+    default:
+        break;
+    }
+
+    *p++ = ((version == FUZI_Q_QUIC_V2_VERSION) ? 0xc0 : 0xf0) | (uint8_t)fuzzer_prng_uniform(prng, 16);
+    picoformat_32(p, version);
+    p += 4;
+    p = fuzi_q_stateless_cid(p, &retry_dcid);
+    p = fuzi_q_stateless_cid(p, &retry_scid);
+    for (size_t i = 0; i < token_length; i++) {
+        *p++ = (uint8_t)fuzzer_prng_next(prng);
+    }
+    length = picoquic_encode_retry_protection(retry_aead, bytes, bytes_max, p - bytes, &odcid);
+
+    if (choice == 6 && length > 16) {
+        bytes[length - 1 - fuzzer_prng_uniform(prng, 16)] ^= (uint8_t)(1 + fuzzer_prng_uniform(prng, 255));
+    }
+    else if (choice == 7) {
+        length = retry_packet_fuzzer(prng, bytes, length, bytes_max);
+    }
+    return length;
+}
+
+/* Check whether an incoming packet is a client Initial selected for a
+ * stateless response, and if so build the response. Returns the length
+ * of the response, or 0 if the packet shall be processed by picoquic.
+ */
+size_t fuzi_q_stateless_response(fuzi_q_stateless_t* stateless, const uint8_t* bytes, size_t length,
+    uint8_t* response, size_t response_max)
+{
+    uint32_t version;
+    picoquic_connection_id_t dcid;
+    picoquic_connection_id_t scid;
+    fuzzer_prng_t prng;
+    size_t response_length = 0;
+
+    if (stateless->ratio == 0 || !fuzi_q_stateless_parse(bytes, length, &version, &dcid, &scid)) {
+        return 0;
+    }
+    stateless->nb_initials++;
+    fuzzer_prng_seed(&prng, fuzzer_icid_random_seed(&dcid, 0));
+    if (fuzzer_prng_uniform(&prng, stateless->ratio) != 0) {
+        return 0;
+    }
+    if (fuzzer_prng_uniform(&prng, 2) == 0) {
+        int version_index = picoquic_get_version_index(version);
+
+        if (version_index >= 0 && version_index < FUZI_Q_STATELESS_NB_VERSIONS) {
+            if (stateless->retry_aead[version_index] == NULL) {
+                stateless->retry_aead[version_index] = picoquic_create_retry_protection_context(1,
+                    picoquic_supported_versions[version_index].version_retry_key,
+                    picoquic_supported_versions[version_index].tls_prefix_label);
+            }
+            response_length = fuzi_q_stateless_retry(&prng, stateless->retry_aead[version_index], version,
+                &dcid, &scid, response, response_max);
+        }
+        if (response_length > 0) {
+            stateless->nb_retry++;
+        }
+    }
+    if (response_length == 0 && (response_length = fuzi_q_stateless_vn(&prng, version, &dcid, &scid, response, response_max)) > 0) {
+        stateless->nb_vn++;
+    }
+    return response_length;
+}
+
+void fuzi_q_stateless_release(fuzi_q_stateless_t* stateless)
+{
+    for (size_t i = 0; i < FUZI_Q_STATELESS_NB_VERSIONS; i++) {
+        if (stateless->retry_aead[i] != NULL) {
+            picoquic_aead_free(stateless->retry_aead[i]);
+            stateless->retry_aead[i] = NULL;
+        }
+    }
+}
@@ -0,0 +1,306 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _WINDOWS
+/* nanosleep and kill are POSIX, not part of the C99 library */
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#ifndef _WINDOWS
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Markers of the reports printed by the sanitizers. Some sanitizers,
+ * e.g., UBSAN by default, report errors without stopping the process,
+ * so the log is checked even if the target is still running.
+ */
+static char const* fuzi_q_sanitizer_markers[] = {
+    "ERROR: AddressSanitizer",
+    "ERROR: LeakSanitizer",
+    "ERROR: MemorySanitizer",
+    "WARNING: ThreadSanitizer",
+    "runtime error:",
+    "SUMMARY: UndefinedBehaviorSanitizer"
+};
+
+static size_t const nb_fuzi_q_sanitizer_markers = sizeof(fuzi_q_sanitizer_markers) / sizeof(char const*);
+
+/* Scan the log from the specified offset, and update the offset.
+ * Only complete lines are scanned. Returns 1 and copies the first matching
+ * line in the report if a sanitizer report was found, 0 otherwise.
+ */
+int fuzi_q_supervisor_scan_log(char const* log_file, long* offset, char* report, size_t report_max)
+{
+    int found = 0;
+    FILE* F = picoquic_file_open(log_file, "r");
+
+    if (F != NULL) {
+        if (fseek(F, *offset, SEEK_SET) == 0) {
+            char line[512];
+
+            while (fgets(line, sizeof(line), F) != NULL) {
+                size_t line_len = strlen(line);
+
+                if (line_len == 0 || line[line_len - 1] != '\n') {
+                    /* Partial line, scan it again when complete */
+                    break;
+                }
+                *offset += (long)line_len;
+                for (size_t i = 0; !found && i < nb_fuzi_q_sanitizer_markers; i++) {
+                    if (strstr(line, fuzi_q_sanitizer_markers[i]) != NULL) {
+                        found = 1;
+                        line[line_len - 1] = 0;
+                        (void)picoquic_sprintf(report, report_max, NULL, "%s", line);
+                    }
+                }
+                if (found) {
+                    break;
+                }
+            }
+        }
+        (void)picoquic_file_close(F);
+    }
+
+    return found;
+}
+
+/* The supervision of a child process uses fork and waitpid, so the
+ * supervise mode is only available on POSIX systems.
+ */
+#ifndef _WINDOWS
+static void fuzi_q_supervisor_sleep(uint64_t delay)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(delay / 1000000);
+    ts.tv_nsec = (long)((delay % 1000000) * 1000);
+    (void)nanosleep(&ts, NULL);
+}
+
+int fuzi_q_supervisor_start(fuzi_q_supervisor_t* supervisor)
+{
+    int ret = 0;
+    pid_t pid;
+
+    supervisor->has_exited = 0;
+    supervisor->exit_status = 0;
+    supervisor->exit_signal = 0;
+    supervisor->sanitizer_found = 0;
+    supervisor->sanitizer_report[0] = 0;
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+        ret = -1;
+    }
+    else if (pid == 0) {
+        /* Child: redirect the output to the target log, then run the command */
+        int fd = open(supervisor->target_log, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) {
+            (void)dup2(fd, STDOUT_FILENO);
+            (void)dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execl("/bin/sh", "sh", "-c", supervisor->target_cmd, (char*)NULL);
+        _exit(127);
+    }
+    else {
+        supervisor->pid = (long)pid;
+        supervisor->nb_starts++;
+    }
+
+    return ret;
+}
+
+/* Check whether the target exited, or printed a sanitizer report.
+ * Returns 1 if the target crashed.
+ */
+int fuzi_q_supervisor_poll(fuzi_q_supervisor_t* supervisor)
+{
+    int status = 0;
+
+    if (supervisor->pid > 0 && !supervisor->has_exited &&
+        waitpid((pid_t)supervisor->pid, &status, WNOHANG) == (pid_t)supervisor->pid) {
+        supervisor->has_exited = 1;
+        if (WIFEXITED(status)) {
+            supervisor->exit_status = WEXITSTATUS(status);
+        }
+        else if (WIFSIGNALED(status)) {
+            supervisor->exit_signal = WTERMSIG(status);
+        }
+    }
+    if (!supervisor->sanitizer_found) {
+        supervisor->sanitizer_found = fuzi_q_supervisor_scan_log(supervisor->target_log, &supervisor->log_offset,
+            supervisor->sanitizer_report, sizeof(supervisor->sanitizer_report));
+    }
+    return supervisor->has_exited || supervisor->sanitizer_found;
+}
+
+void fuzi_q_supervisor_stop(fuzi_q_supervisor_t* supervisor)
+{
+    if (supervisor->pid > 0 && !supervisor->has_exited) {
+        uint64_t waited = 0;
+
+        (void)kill((pid_t)supervisor->pid, SIGTERM);
+        while (waitpid((pid_t)supervisor->pid, NULL, WNOHANG) == 0) {
+            if (waited >= FUZI_Q_SUPERVISOR_STOP_DELAY) {
+                (void)kill((pid_t)supervisor->pid, SIGKILL);
+                (void)waitpid((pid_t)supervisor->pid, NULL, 0);
+                break;
+            }
+            fuzi_q_supervisor_sleep(100000);
+            waited += 100000;
+        }
+        supervisor->has_exited = 1;
+    }
+    supervisor->pid = 0;
+}
+
+/* Append the cause of the crash to the record started by the client */
+static void fuzi_q_supervisor_record(fuzi_q_supervisor_t* supervisor, FILE* F, int server_is_down)
+{
+    supervisor->nb_crashes++;
+    fprintf(F, "Crash #%zu of target started %zu times:", supervisor->nb_crashes, supervisor->nb_starts);
+    if (supervisor->has_exited) {
+        if (supervisor->exit_signal != 0) {
+            fprintf(F, " killed by signal %d.", supervisor->exit_signal);
+        }
+        else {
+            fprintf(F, " exited with status %d.", supervisor->exit_status);
+        }
+    }
+    else if (server_is_down) {
+        fprintf(F, " target not responding.");
+    }
+    if (supervisor->sanitizer_found) {
+        fprintf(F, " Sanitizer: %s", supervisor->sanitizer_report);
+    }
+    fprintf(F, "\n\n");
+    fflush(F);
+}
+
+int fuzi_q_supervise(char const* target_cmd, const fuzi_q_client_options_t* options)
+{
+    int ret = 0;
+    fuzi_q_supervisor_t supervisor = { 0 };
+    fuzi_q_run_report_t report = { 0 };
+    fuzi_q_client_options_t run_options = *options;
+    picoquic_connection_id_t next_cid = { { 0 }, 0 };
+    size_t nb_cnx_tried = 0;
+    uint64_t start_time = picoquic_current_time();
+    FILE* F = picoquic_file_open(FUZI_Q_SUPERVISOR_CRASH_LOG, "a");
+
+    /* Without the liveness probe, a crash would only be noticed when the
+     * client gives up after its up time interval */
+    if (run_options.probe_interval == 0) {
+        run_options.probe_interval = FUZI_Q_PROBE_INTERVAL_DEFAULT;
+    }
+    supervisor.target_cmd = target_cmd;
+    supervisor.target_log = FUZI_Q_SUPERVISOR_TARGET_LOG;
+    if (options->init_cid != NULL) {
+        next_cid = *options->init_cid;
+    }
+
+    if (F == NULL) {
+        fprintf(stdout, "Cannot open %s\n", FUZI_Q_SUPERVISOR_CRASH_LOG);
+        ret = -1;
+    }
+    else if (fuzi_q_supervisor_start(&supervisor) != 0) {
+        fprintf(stdout, "Cannot start target: %s\n", target_cmd);
+        ret = -1;
+    }
+
+    while (ret == 0) {
+        size_t nb_remaining = 0;
+        uint64_t duration_remaining = 0;
+        uint64_t elapsed = (picoquic_current_time() - start_time) / 1000000;
+        int crashed;
+
+        if (options->nb_cnx_required != 0) {
+            if (nb_cnx_tried >= options->nb_cnx_required) {
+                break;
+            }
+            nb_remaining = options->nb_cnx_required - nb_cnx_tried;
+        }
+        if (options->duration_max != 0) {
+            if (elapsed >= options->duration_max) {
+                break;
+            }
+            duration_remaining = options->duration_max - elapsed;
+        }
+
+        fuzi_q_supervisor_sleep(FUZI_Q_SUPERVISOR_STARTUP_DELAY);
+        memset(&report, 0, sizeof(report));
+        report.crash_log = F;
+        run_options.fuzz_mode = fuzi_q_mode_client;
+        run_options.nb_cnx_required = nb_remaining;
+        run_options.duration_max = duration_remaining;
+        run_options.init_cid = &next_cid;
+        run_options.replay = NULL;
+        run_options.report = &report;
+        ret = fuzi_q_client(&run_options);
+        nb_cnx_tried += report.nb_cnx_tried;
+        next_cid = report.next_cid;
+
+        crashed = fuzi_q_supervisor_poll(&supervisor);
+        if (!crashed && !report.server_is_down) {
+            /* The campaign completed */
+            break;
+        }
+        fuzi_q_supervisor_record(&supervisor, F, report.server_is_down);
+        fuzi_q_supervisor_stop(&supervisor);
+        if (report.nb_cnx_tried == 0) {
+            /* Restarting a target that fails before any trial would loop forever */
+            fprintf(stdout, "Target failed before any trial, see %s.\n", supervisor.target_log);
+            ret = -1;
+        }
+        else if (ret == 0) {
+            fprintf(stdout, "Target crash #%zu, restarting the target.\n", supervisor.nb_crashes);
+        }
+        if (ret == 0 && fuzi_q_supervisor_start(&supervisor) != 0) {
+            fprintf(stdout, "Cannot restart target: %s\n", target_cmd);
+            ret = -1;
+        }
+    }
+
+    fuzi_q_supervisor_stop(&supervisor);
+    fprintf(stdout, "Supervised %zu trials, %zu target crashes recorded in %s.\n",
+        nb_cnx_tried, supervisor.nb_crashes, FUZI_Q_SUPERVISOR_CRASH_LOG);
+
+    if (F != NULL) {
+        (void)picoquic_file_close(F);
+    }
+
+    return ret;
+}
+#endif
@@ -0,0 +1,533 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stddef.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Structure-aware mutation of TLS handshake messages.
+ *
+ * Flipping bytes in a ClientHello almost always breaks the TLS parser
+ * before the message reaches the interesting code. Instead, the message
+ * is parsed down to its extensions, and for the QUIC transport parameters
+ * down to the individual parameters. One element is mutated, then the
+ * message is rebuilt with consistent lengths. The ClientHello, ServerHello
+ * and EncryptedExtensions messages are supported, which covers the
+ * transport parameters sent by both clients and servers.
+ */
+
+#define FUZZER_TLS_CLIENT_HELLO 1
+#define FUZZER_TLS_SERVER_HELLO 2
+#define FUZZER_TLS_ENCRYPTED_EXTENSIONS 8
+
+#define FUZZER_TLS_EXT_SERVER_NAME 0x00
+#define FUZZER_TLS_EXT_ALPN 0x10
+#define FUZZER_TLS_EXT_KEY_SHARE 0x33
+#define FUZZER_TLS_EXT_TRANSPORT_PARAMETERS 0x39
+#define FUZZER_TLS_EXT_TRANSPORT_PARAMETERS_DRAFT 0xffa5
+
+#define FUZZER_TLS_MAX_ITEMS 64
+#define FUZZER_TLS_VALUE_MAX 32
+
+/* An extension, or a transport parameter */
+typedef struct st_fuzzer_tls_item_t {
+    uint64_t type;
+    const uint8_t* data;
+    size_t length;
+} fuzzer_tls_item_t;
+
+/* Transport parameters with a varint value, and the limit checked by the
+ * receiver, if any: max_udp_payload_size at least 1200, max_streams at
+ * most 2^60, ack_delay_exponent at most 20, max_ack_delay below 2^14,
+ * active_connection_id_limit at least 2.
+ */
+typedef struct st_fuzzer_tp_limit_t {
+    uint64_t id;
+    uint64_t limit;
+} fuzzer_tp_limit_t;
+
+static const fuzzer_tp_limit_t fuzzer_tp_varints[] = {
+    { 0x01, FUZZER_VARINT_NO_LIMIT }, /* max_idle_timeout */
+    { 0x03, 1200 }, /* max_udp_payload_size */
+    { 0x04, FUZZER_VARINT_NO_LIMIT }, /* initial_max_data */
+    { 0x05, FUZZER_VARINT_NO_LIMIT }, /* initial_max_stream_data_bidi_local */
+    { 0x06, FUZZER_VARINT_NO_LIMIT }, /* initial_max_stream_data_bidi_remote */
+    { 0x07, FUZZER_VARINT_NO_LIMIT }, /* initial_max_stream_data_uni */
+    { 0x08, 1ull << 60 }, /* initial_max_streams_bidi */
+    { 0x09, 1ull << 60 }, /* initial_max_streams_uni */
+    { 0x0a, 20 }, /* ack_delay_exponent */
+    { 0x0b, 1ull << 14 }, /* max_ack_delay */
+    { 0x0e, 2 }, /* active_connection_id_limit */
+    { 0x20, FUZZER_VARINT_NO_LIMIT }, /* max_datagram_frame_size */
+    { 0xff04de1b, FUZZER_VARINT_NO_LIMIT } /* min_ack_delay */
+};
+
+/* Parameters to add: server only parameters, disable_active_migration,
+ * and parameters from extensions. Grease parameters are added separately.
+ */
+static const uint64_t fuzzer_tp_added[] = {
+    0x00, /* original_destination_connection_id */
+    0x02, /* stateless_reset_token */
+    0x0c, /* disable_active_migration */
+    0x0d, /* preferred_address */
+    0x10, /* retry_source_connection_id */
+    0x11, /* version_information */
+    0x20, /* max_datagram_frame_size */
+    0x2ab2, /* grease_quic_bit */
+    0xff04de1b /* min_ack_delay */
+};
+
+/* Groups for key shares: x25519, secp256r1, a grease value, and an
+ * unassigned value.
+ */
+static const uint16_t fuzzer_tls_groups[] = { 0x001d, 0x0017, 0x0a0a, 0xfefe };
+
+static size_t fuzzer_tls_parse_extensions(const uint8_t* bytes, const uint8_t* bytes_max, fuzzer_tls_item_t* items)
+{
+    size_t nb_items = 0;
+
+    while (bytes + 4 <= bytes_max && nb_items < FUZZER_TLS_MAX_ITEMS) {
+        size_t length = PICOPARSE_16(bytes + 2);
+
+        if (bytes + 4 + length > bytes_max) {
+            break;
+        }
+        items[nb_items].type = PICOPARSE_16(bytes);
+        items[nb_items].data = bytes + 4;
+        items[nb_items].length = length;
+        nb_items++;
+        bytes += 4 + length;
+    }
+    return (bytes == bytes_max) ? nb_items : 0;
+}
+
+static size_t fuzzer_tls_parse_params(const uint8_t* bytes, const uint8_t* bytes_max, fuzzer_tls_item_t* items)
+{
+    size_t nb_items = 0;
+
+    while (bytes != NULL && bytes < bytes_max && nb_items < FUZZER_TLS_MAX_ITEMS) {
+        uint64_t id;
+        uint64_t length;
+
+        if ((bytes = picoquic_frames_varint_decode(bytes, bytes_max, &id)) == NULL ||
+            (bytes = picoquic_frames_varint_decode(bytes, bytes_max, &length)) == NULL ||
+            length > (uint64_t)(bytes_max - bytes)) {
+            return 0;
+        }
+        items[nb_items].type = id;
+        items[nb_items].data = bytes;
+        items[nb_items].length = (size_t)length;
+        nb_items++;
+        bytes += length;
+    }
+    return (bytes == bytes_max) ? nb_items : 0;
+}
+
+static uint8_t* fuzzer_tls_write_16(uint8_t* p, uint8_t* p_max, size_t value)
+{
+    if (p == NULL || p + 2 > p_max || value > 0xffff) {
+        return NULL;
+    }
+    picoformat_16(p, (uint16_t)value);
+    return p + 2;
+}
+
+static uint8_t* fuzzer_tls_write_bytes(uint8_t* p, uint8_t* p_max, const uint8_t* bytes, size_t length)
+{
+    if (p == NULL || p + length > p_max) {
+        return NULL;
+    }
+    if (length > 0) {
+        memcpy(p, bytes, length);
+    }
+    return p + length;
+}
+
+static uint8_t* fuzzer_tls_write_extensions(uint8_t* p, uint8_t* p_max, const fuzzer_tls_item_t* items, size_t nb_items)
+{
+    for (size_t i = 0; p != NULL && i < nb_items; i++) {
+        p = fuzzer_tls_write_16(p, p_max, (size_t)items[i].type);
+        p = fuzzer_tls_write_16(p, p_max, items[i].length);
+        p = fuzzer_tls_write_bytes(p, p_max, items[i].data, items[i].length);
+    }
+    return p;
+}
+
+static uint8_t* fuzzer_tls_write_params(uint8_t* p, uint8_t* p_max, const fuzzer_tls_item_t* items, size_t nb_items)
+{
+    for (size_t i = 0; p != NULL && i < nb_items; i++) {
+        p = picoquic_frames_varint_encode(p, p_max, items[i].type);
+        p = picoquic_frames_varint_encode(p, p_max, items[i].length);
+        p = fuzzer_tls_write_bytes(p, p_max, items[i].data, items[i].length);
+    }
+    return p;
+}
+
+/* Remove, duplicate or move one of the items, or truncate its data */
+static int fuzzer_tls_items_mutate(fuzzer_prng_t* prng, fuzzer_tls_item_t* items, size_t* nb_items)
+{
+    size_t rank = (size_t)fuzzer_prng_uniform(prng, *nb_items);
+
+    switch (fuzzer_prng_uniform(prng, 4)) {
+    case 0:
+        memmove(&items[rank], &items[rank + 1], (*nb_items - rank - 1) * sizeof(fuzzer_tls_item_t));
+        *nb_items -= 1;
+        break;
+    case 1:
+        if (*nb_items < FUZZER_TLS_MAX_ITEMS) {
+            /* Duplicates are a protocol violation */
+            items[*nb_items] = items[rank];
+            *nb_items += 1;
+            break;
+        }
+        /* Fall through */
+    case 2: {
+        /* Move to the front or to the end, e.g., pre_shared_key must be last */
+        fuzzer_tls_item_t item = items[rank];
+        memmove(&items[rank], &items[rank + 1], (*nb_items - rank - 1) * sizeof(fuzzer_tls_item_t));
+        if (fuzzer_prng_uniform(prng, 2) == 0) {
+            memmove(&items[1], &items[0], (*nb_items - 1) * sizeof(fuzzer_tls_item_t));
+            items[0] = item;
+        }
+        else {
+            items[*nb_items - 1] = item;
+        }
+        break;
+    }
+    default:
+        items[rank].length = (items[rank].length == 0) ? 0 : (size_t)fuzzer_prng_uniform(prng, items[rank].length);
+        break;
+    }
+    return 1;
+}
+
+/* Mutate the transport parameters. The new content is written in buffer,
+ * and replaces the data of the extension.
+ */
+static int fuzzer_tls_params_mutate(fuzzer_prng_t* prng, fuzzer_tls_item_t* extension, uint8_t* buffer, size_t buffer_max)
+{
+    fuzzer_tls_item_t params[FUZZER_TLS_MAX_ITEMS + 1];
+    size_t nb_params = fuzzer_tls_parse_params(extension->data, extension->data + extension->length, params);
+    uint8_t value[FUZZER_TLS_VALUE_MAX];
+    uint8_t* p;
+
+    if (nb_params == 0 && extension->length > 0) {
+        return 0;
+    }
+    if (nb_params == 0 || fuzzer_prng_uniform(prng, 4) == 0) {
+        /* Add a parameter, either a grease value or one of the list */
+        fuzzer_tls_item_t* param = &params[nb_params++];
+        size_t value_length = (size_t)fuzzer_prng_uniform(prng, 3) * 8;
+
+        param->type = (fuzzer_prng_uniform(prng, 2) == 0) ? 31 * fuzzer_prng_uniform(prng, 1024) + 27 :
+            fuzzer_tp_added[fuzzer_prng_uniform(prng, FUZZER_NB_ELEMENTS(fuzzer_tp_added))];
+        for (size_t i = 0; i < value_length; i++) {
+            value[i] = (uint8_t)fuzzer_prng_next(prng);
+        }
+        param->data = value;
+        param->length = value_length;
+    }
+    else {
+        fuzzer_tls_item_t* param = &params[fuzzer_prng_uniform(prng, nb_params)];
+        uint64_t limit = FUZZER_VARINT_NO_LIMIT;
+        uint64_t old_value;
+        int is_varint = 0;
+
+        for (size_t i = 0; i < FUZZER_NB_ELEMENTS(fuzzer_tp_varints); i++) {
+            if (fuzzer_tp_varints[i].id == param->type) {
+                limit = fuzzer_tp_varints[i].limit;
+                is_varint = 1;
+                break;
+            }
+        }
+        if (is_varint && fuzzer_prng_uniform(prng, 4) != 0 &&
+            picoquic_frames_varint_decode(param->data, param->data + param->length, &old_value) == param->data + param->length) {
+            /* New value, re-encoded with the minimal length or on 8 bytes */
+            uint64_t new_value = (fuzzer_prng_uniform(prng, 2) == 0) ?
+                fuzzer_varint_relative(prng, old_value, limit) : fuzzer_varint_boundary(prng, (size_t)1 << fuzzer_prng_uniform(prng, 4));
+            size_t new_length = (fuzzer_prng_uniform(prng, 8) == 0) ? 8 : fuzzer_varint_length(new_value);
+
+            if (new_value > FUZZER_VARINT_MAX) {
+                new_value = FUZZER_VARINT_MAX;
+                new_length = 8;
+            }
+            (void)fuzzer_varint_encode(value, new_length, new_value);
+            param->data = value;
+            param->length = new_length;
+        }
+        else {
+            (void)fuzzer_tls_items_mutate(prng, params, &nb_params);
+        }
+    }
+
+    if ((p = fuzzer_tls_write_params(buffer, buffer + buffer_max, params, nb_params)) == NULL) {
+        return 0;
+    }
+    extension->data = buffer;
+    extension->length = p - buffer;
+    return 1;
+}
+
+/* Mutate the ALPN list: empty list, empty or very long protocol name, or
+ * an inner length that does not match the extension.
+ */
+static int fuzzer_tls_alpn_mutate(fuzzer_prng_t* prng, fuzzer_tls_item_t* extension, uint8_t* buffer, size_t buffer_max)
+{
+    uint8_t* p = buffer;
+    uint8_t* p_max = buffer + buffer_max;
+
+    switch (fuzzer_prng_uniform(prng, 4)) {
+    case 0:
+        p = fuzzer_tls_write_16(p, p_max, 0);
+        break;
+    case 1:
+        p = fuzzer_tls_write_16(p, p_max, 1);
+        if (p != NULL && p < p_max) {
+            *p++ = 0;
+        }
+        break;
+    case 2:
+        p = fuzzer_tls_write_16(p, p_max, 256);
+        if (p != NULL && p + 256 <= p_max) {
+            *p++ = 255;
+            memset(p, 'h', 255);
+            p += 255;
+        }
+        else {
+            p = NULL;
+        }
+        break;
+    default:
+        if (extension->length < 2) {
+            return 0;
+        }
+        p = fuzzer_tls_write_16(p, p_max, PICOPARSE_16(extension->data) + 1);
+        p = fuzzer_tls_write_bytes(p, p_max, extension->data + 2, extension->length - 2);
+        break;
+    }
+    if (p == NULL) {
+        return 0;
+    }
+    extension->data = buffer;
+    extension->length = p - buffer;
+    return 1;
+}
+
+/* Mutate the first key share: no share, unexpected group, truncated key,
+ * or the same group twice. Server key shares have no list length.
+ */
+static int fuzzer_tls_key_share_mutate(fuzzer_prng_t* prng, int is_client_hello, fuzzer_tls_item_t* extension,
+    uint8_t* buffer, size_t buffer_max)
+{
+    const uint8_t* share = extension->data + ((is_client_hello) ? 2 : 0);
+    const uint8_t* data_max = extension->data + extension->length;
+    size_t key_length;
+    size_t share_length;
+    uint8_t* shares;
+    uint8_t* p = buffer;
+    uint8_t* p_max = buffer + buffer_max;
+
+    if (share + 4 > data_max || share + 4 + PICOPARSE_16(share + 2) > data_max) {
+        return 0;
+    }
+    key_length = PICOPARSE_16(share + 2);
+    share_length = 4 + key_length;
+    if (is_client_hello) {
+        p += 2;
+    }
+    shares = p;
+    switch (fuzzer_prng_uniform(prng, (is_client_hello) ? 4 : 2)) {
+    case 0:
+        p = fuzzer_tls_write_16(p, p_max, fuzzer_tls_groups[fuzzer_prng_uniform(prng, FUZZER_NB_ELEMENTS(fuzzer_tls_groups))]);
+        p = fuzzer_tls_write_bytes(p, p_max, share + 2, share_length - 2);
+        break;
+    case 1:
+        key_length = (key_length == 0) ? 1 : (size_t)fuzzer_prng_uniform(prng, key_length);
+        p = fuzzer_tls_write_bytes(p, p_max, share, 2);
+        p = fuzzer_tls_write_16(p, p_max, key_length);
+        p = fuzzer_tls_write_bytes(p, p_max, share + 4, (key_length < share_length - 4) ? key_length : share_length - 4);
+        if (p != NULL && key_length > share_length - 4) {
+            p = NULL;
+        }
+        break;
+    case 2:
+        /* No key share, as when asking for a retry */
+        break;
+    default:
+        p = fuzzer_tls_write_bytes(p, p_max, share, share_length);
+        p = fuzzer_tls_write_bytes(p, p_max, share, share_length);
+        break;
+    }
+    if (p == NULL || (is_client_hello && fuzzer_tls_write_16(buffer, p_max, p - shares) == NULL)) {
+        return 0;
+    }
+    extension->data = buffer;
+    extension->length = p - buffer;
+    return 1;
+}
+
+/* Find the extensions of the first handshake message. Returns the offset
+ * of the extensions length field, or 0 if the message is not supported
+ * or not complete.
+ */
+static size_t fuzzer_tls_find_extensions(const uint8_t* data, size_t length, size_t* message_end)
+{
+    size_t message_length;
+    size_t offset = 4;
+
+    if (length < 4) {
+        return 0;
+    }
+    message_length = ((size_t)data[1] << 16) | ((size_t)data[2] << 8) | data[3];
+    if (message_length > length - 4) {
+        return 0;
+    }
+    *message_end = 4 + message_length;
+    switch (data[0]) {
+    case FUZZER_TLS_CLIENT_HELLO:
+    case FUZZER_TLS_SERVER_HELLO:
+        /* Legacy version, random, and session ID */
+        offset += 2 + 32;
+        if (offset >= *message_end) {
+            return 0;
+        }
+        offset += 1 + (size_t)data[offset];
+        if (data[0] == FUZZER_TLS_CLIENT_HELLO) {
+            /* Cipher suites and compression methods */
+            if (offset + 2 > *message_end) {
+                return 0;
+            }
+            offset += 2 + PICOPARSE_16(data + offset);
+            if (offset >= *message_end) {
+                return 0;
+            }
+            offset += 1 + (size_t)data[offset];
+        }
+        else {
+            /* Cipher suite and compression method */
+            offset += 3;
+        }
+        break;
+    case FUZZER_TLS_ENCRYPTED_EXTENSIONS:
+        break;
+    default:
+        return 0;
+    }
+    if (offset + 2 > *message_end || offset + 2 + PICOPARSE_16(data + offset) != *message_end) {
+        return 0;
+    }
+    return offset;
+}
+
+/* Mutate the first handshake message of the data, which must start at
+ * a message boundary. Returns the new length of the data, at most
+ * data_max, or 0 if the data was not modified.
+ */
+size_t fuzzer_tls_mutate(fuzzer_prng_t* prng, uint8_t* data, size_t length, size_t data_max)
+{
+    fuzzer_tls_item_t extensions[FUZZER_TLS_MAX_ITEMS + 1];
+    uint8_t buffer[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t out[2 * PICOQUIC_MAX_PACKET_SIZE];
+    size_t message_end = 0;
+    size_t extensions_offset = fuzzer_tls_find_extensions(data, length, &message_end);
+    size_t nb_extensions;
+    size_t new_length;
+    int is_mutated = 0;
+    uint8_t* p;
+    uint8_t* p_max = out + sizeof(out);
+
+    if (extensions_offset == 0 ||
+        (nb_extensions = fuzzer_tls_parse_extensions(data + extensions_offset + 2, data + message_end, extensions)) == 0) {
+        return 0;
+    }
+
+    switch (fuzzer_prng_uniform(prng, 8)) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+        for (size_t i = 0; i < nb_extensions; i++) {
+            if (extensions[i].type == FUZZER_TLS_EXT_TRANSPORT_PARAMETERS ||
+                extensions[i].type == FUZZER_TLS_EXT_TRANSPORT_PARAMETERS_DRAFT) {
+                is_mutated = fuzzer_tls_params_mutate(prng, &extensions[i], buffer, sizeof(buffer));
+                break;
+            }
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < nb_extensions; i++) {
+            if (extensions[i].type == FUZZER_TLS_EXT_ALPN) {
+                is_mutated = fuzzer_tls_alpn_mutate(prng, &extensions[i], buffer, sizeof(buffer));
+                break;
+            }
+        }
+        break;
+    case 5:
+        for (size_t i = 0; i < nb_extensions; i++) {
+            if (extensions[i].type == FUZZER_TLS_EXT_KEY_SHARE) {
+                is_mutated = fuzzer_tls_key_share_mutate(prng, data[0] == FUZZER_TLS_CLIENT_HELLO, &extensions[i], buffer, sizeof(buffer));
+                break;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    if (!is_mutated) {
+        /* Mutate the list of extensions, or add a grease extension */
+        if (fuzzer_prng_uniform(prng, 4) == 0) {
+            extensions[nb_extensions].type = 0x0a0a + 0x1010 * fuzzer_prng_uniform(prng, 16);
+            extensions[nb_extensions].data = data;
+            extensions[nb_extensions].length = (size_t)fuzzer_prng_uniform(prng, 9);
+            nb_extensions++;
+            is_mutated = 1;
+        }
+        else {
+            is_mutated = fuzzer_tls_items_mutate(prng, extensions, &nb_extensions);
+        }
+    }
+    if (!is_mutated) {
+        return 0;
+    }
+
+    /* Rebuild the message with the new extensions, then copy what follows */
+    p = fuzzer_tls_write_bytes(out, p_max, data, extensions_offset + 2);
+    p = fuzzer_tls_write_extensions(p, p_max, extensions, nb_extensions);
+    if (p == NULL || (size_t)(p - out) - extensions_offset - 2 > 0xffff) {
+        return 0;
+    }
+    picoformat_16(out + extensions_offset, (uint16_t)((p - out) - extensions_offset - 2));
+    new_length = (p - out) - 4;
+    out[1] = (uint8_t)(new_length >> 16);
+    out[2] = (uint8_t)(new_length >> 8);
+    out[3] = (uint8_t)new_length;
+    p = fuzzer_tls_write_bytes(p, p_max, data + message_end, length - message_end);
+    if (p == NULL || (size_t)(p - out) > data_max) {
+        return 0;
+    }
+    new_length = p - out;
+    memcpy(data, out, new_length);
+
+    return new_length;
+}
@@ -0,0 +1,367 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Crash triage.
+ *
+ * The list of suspect trials is typically the list printed by the client
+ * when the liveness probe detects that the server is down, saved in a file.
+ * Each line lists an ICID, optionally preceded by the fuzzing time range
+ * and followed by the trial rank and the scheduled target:
+ *
+ *     <first_time>-<last_time>: <icid> trial <rank>, state <s>, <n> packets fuzzed, target <state>/<wait>
+ *
+ * Lines with only "<icid> [<rank> <state> <wait>]" are also accepted, and
+ * lines that do not start with an ICID are ignored.
+ */
+
+#define FUZI_Q_TRIAGE_LINE_MAX 512
+
+static int fuzi_q_triage_is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static int fuzi_q_triage_parse_line(char const* line, fuzzer_replay_target_t* target)
+{
+    int ret = -1;
+    char const* x = line;
+    size_t hex_len = 0;
+
+    while (*x == ' ' || *x == '\t') {
+        x++;
+    }
+    /* Skip the optional time range */
+    if (*x >= '0' && *x <= '9') {
+        char const* y = x;
+        while (*y >= '0' && *y <= '9') {
+            y++;
+        }
+        if (*y == '-') {
+            char const* colon = strchr(y, ':');
+            if (colon != NULL) {
+                x = colon + 1;
+                while (*x == ' ') {
+                    x++;
+                }
+            }
+        }
+    }
+    while (fuzi_q_triage_is_hex(x[hex_len])) {
+        hex_len++;
+    }
+    if (hex_len >= 2 && (hex_len & 1) == 0 && hex_len <= 2 * PICOQUIC_CONNECTION_ID_MAX_SIZE &&
+        (x[hex_len] == 0 || x[hex_len] == ' ' || x[hex_len] == '\t' || x[hex_len] == '\r' || x[hex_len] == '\n')) {
+        unsigned long long trial_rank = 0;
+        int state;
+        unsigned int nb_packets;
+
+        memset(target, 0, sizeof(fuzzer_replay_target_t));
+        target->target_state = -1;
+        if (picoquic_parse_connection_id_hexa(x, hex_len, &target->icid) == hex_len / 2) {
+            ret = 0;
+            x += hex_len;
+            if (sscanf(x, " trial %llu, state %d, %u packets fuzzed, target %d/%d", &trial_rank, &state,
+                &nb_packets, &target->target_state, &target->target_wait) != 5 &&
+                sscanf(x, " %llu %d %d", &trial_rank, &target->target_state, &target->target_wait) != 3) {
+                target->target_state = -1;
+                target->target_wait = 0;
+            }
+            target->trial_rank = (uint64_t)trial_rank;
+        }
+    }
+    return ret;
+}
+
+int fuzi_q_triage_read_targets(char const* file_name, fuzzer_replay_target_t** targets, size_t* nb_targets)
+{
+    int ret = 0;
+    size_t nb_max = 0;
+    FILE* F = picoquic_file_open(file_name, "r");
+
+    *targets = NULL;
+    *nb_targets = 0;
+
+    if (F == NULL) {
+        ret = -1;
+    }
+    else {
+        char line[FUZI_Q_TRIAGE_LINE_MAX];
+
+        while (ret == 0 && fgets(line, sizeof(line), F) != NULL) {
+            fuzzer_replay_target_t target;
+            int is_new = 1;
+
+            if (fuzi_q_triage_parse_line(line, &target) != 0) {
+                continue;
+            }
+            /* The same trial may appear in several log entries */
+            for (size_t i = 0; is_new && i < *nb_targets; i++) {
+                if ((*targets)[i].trial_rank == target.trial_rank &&
+                    picoquic_compare_connection_id(&(*targets)[i].icid, &target.icid) == 0) {
+                    is_new = 0;
+                }
+            }
+            if (!is_new) {
+                continue;
+            }
+            if (*nb_targets >= nb_max) {
+                size_t new_max = (nb_max == 0) ? 64 : 2 * nb_max;
+                fuzzer_replay_target_t* new_targets = (fuzzer_replay_target_t*)realloc(*targets,
+                    new_max * sizeof(fuzzer_replay_target_t));
+                if (new_targets == NULL) {
+                    ret = -1;
+                    break;
+                }
+                *targets = new_targets;
+                nb_max = new_max;
+            }
+            (*targets)[*nb_targets] = target;
+            *nb_targets += 1;
+        }
+        (void)picoquic_file_close(F);
+    }
+
+    if (ret != 0 && *targets != NULL) {
+        free(*targets);
+        *targets = NULL;
+        *nb_targets = 0;
+    }
+
+    return ret;
+}
+
+static int fuzi_q_triage_run(fuzi_q_triage_oracle_fn oracle, void* oracle_ctx, fuzi_q_replay_t* replay, size_t* nb_runs)
+{
+    *nb_runs += 1;
+    return oracle(oracle_ctx, replay);
+}
+
+/* Bisection over the replay targets. The connections of each subset are
+ * replayed in parallel. If neither half crashes the target on its own, the
+ * crash requires trials from both halves and the bisection stops there.
+ * Returns 0 if the crash was reproduced, -1 otherwise.
+ */
+int fuzi_q_triage_bisect(fuzi_q_triage_oracle_fn oracle, void* oracle_ctx, fuzi_q_replay_t* replay, size_t* nb_runs)
+{
+    int ret = 0;
+    int crashed = fuzi_q_triage_run(oracle, oracle_ctx, replay, nb_runs);
+
+    if (crashed != 1) {
+        ret = -1;
+    }
+
+    while (ret == 0 && replay->nb_targets > 1) {
+        fuzzer_replay_target_t* all_targets = replay->targets;
+        size_t nb_all = replay->nb_targets;
+        size_t nb_half = nb_all / 2;
+
+        replay->nb_targets = nb_half;
+        crashed = fuzi_q_triage_run(oracle, oracle_ctx, replay, nb_runs);
+        if (crashed == 0) {
+            replay->targets = all_targets + nb_half;
+            replay->nb_targets = nb_all - nb_half;
+            crashed = fuzi_q_triage_run(oracle, oracle_ctx, replay, nb_runs);
+        }
+        if (crashed != 1) {
+            replay->targets = all_targets;
+            replay->nb_targets = nb_all;
+            if (crashed < 0) {
+                ret = -1;
+            }
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/* Minimization of the window of fuzzed packets: find the smallest last
+ * packet, then the largest first packet, for which the target still
+ * crashes. Packets outside the window are sent without fuzzing.
+ */
+int fuzi_q_triage_minimize(fuzi_q_triage_oracle_fn oracle, void* oracle_ctx, fuzi_q_replay_t* replay, size_t* nb_runs)
+{
+    int ret = 0;
+    int crashed;
+    uint64_t low = 0;
+    uint64_t high = FUZI_Q_TRIAGE_MAX_PACKETS - 1;
+
+    replay->first_packet = 0;
+    replay->last_packet = high;
+    crashed = fuzi_q_triage_run(oracle, oracle_ctx, replay, nb_runs);
+
+    if (crashed < 0) {
+        ret = -1;
+    }
+    else if (crashed == 0) {
+        /* The crash requires packets beyond the search range, keep the full window */
+        replay->last_packet = UINT64_MAX;
+    }
+    else {
+        while (ret == 0 && low < high) {
+            uint64_t middle = low + (high - low) / 2;
+
+            replay->last_packet = middle;
+            crashed = fuzi_q_triage_run(oracle, oracle_ctx, replay, nb_runs);
+            if (crashed < 0) {
+                ret = -1;
+            }
+            else if (crashed) {
+                high = middle;
+            }
+            else {
+                low = middle + 1;
+            }
+        }
+        replay->last_packet = high;
+
+        low = 0;
+        while (ret == 0 && low < high) {
+            uint64_t middle = low + (high - low + 1) / 2;
+
+            replay->first_packet = middle;
+            crashed = fuzi_q_triage_run(oracle, oracle_ctx, replay, nb_runs);
+            if (crashed < 0) {
+                ret = -1;
+            }
+            else if (crashed) {
+                low = middle;
+            }
+            else {
+                high = middle - 1;
+            }
+        }
+        replay->first_packet = low;
+    }
+
+    return ret;
+}
+
+/* Oracle replaying the trials with the fuzi_q client against a local
+ * target, restarted before each run with the specified command.
+ */
+typedef struct st_fuzi_q_triage_ctx_t {
+    char const* restart_cmd;
+    const char* ip_address_text;
+    int server_port;
+    picoquic_quic_config_t* config;
+    uint64_t duration_max;
+    char const* client_scenario_text;
+    uint64_t probe_interval;
+} fuzi_q_triage_ctx_t;
+
+static int fuzi_q_triage_oracle(void* oracle_ctx, fuzi_q_replay_t* replay)
+{
+    fuzi_q_triage_ctx_t* triage_ctx = (fuzi_q_triage_ctx_t*)oracle_ctx;
+    int ret = 0;
+
+    if (triage_ctx->restart_cmd != NULL) {
+        fflush(stdout);
+        if (system(triage_ctx->restart_cmd) != 0) {
+            fprintf(stdout, "Restart command failed: %s\n", triage_ctx->restart_cmd);
+            ret = -1;
+        }
+    }
+    if (ret == 0) {
+        fuzi_q_client_options_t options = { 0 };
+
+        options.fuzz_mode = fuzi_q_mode_client;
+        options.ip_address_text = triage_ctx->ip_address_text;
+        options.server_port = triage_ctx->server_port;
+        options.config = triage_ctx->config;
+        options.duration_max = triage_ctx->duration_max;
+        options.client_scenario_text = triage_ctx->client_scenario_text;
+        options.trials_per_cnx = 1;
+        options.probe_interval = triage_ctx->probe_interval;
+        options.event_sample = FUZI_Q_EVENT_LOG_OFF;
+        options.replay = replay;
+        ret = fuzi_q_client(&options);
+        ret = (ret == 0) ? replay->server_is_down : -1;
+    }
+    fprintf(stdout, "Triage run: %zu trials, packets %llu to %llu, %s.\n", replay->nb_targets,
+        (unsigned long long)replay->first_packet, (unsigned long long)replay->last_packet,
+        (ret == 1) ? "crash" : ((ret == 0) ? "no crash" : "error"));
+    return ret;
+}
+
+int fuzi_q_triage(char const* target_file, char const* restart_cmd, const char* ip_address_text, int server_port,
+    picoquic_quic_config_t* config, uint64_t duration_max, char const* client_scenario_text, uint64_t probe_interval)
+{
+    int ret = 0;
+    size_t nb_runs = 0;
+    fuzzer_replay_target_t* targets = NULL;
+    fuzi_q_replay_t replay = { 0 };
+    fuzi_q_triage_ctx_t triage_ctx = { 0 };
+
+    triage_ctx.restart_cmd = restart_cmd;
+    triage_ctx.ip_address_text = ip_address_text;
+    triage_ctx.server_port = server_port;
+    triage_ctx.config = config;
+    triage_ctx.duration_max = duration_max;
+    triage_ctx.client_scenario_text = client_scenario_text;
+    triage_ctx.probe_interval = (probe_interval == 0) ? FUZI_Q_PROBE_INTERVAL_DEFAULT : probe_interval;
+
+    if (fuzi_q_triage_read_targets(target_file, &targets, &replay.nb_targets) != 0 || replay.nb_targets == 0) {
+        fprintf(stdout, "Cannot read suspect trials from %s\n", target_file);
+        ret = -1;
+    }
+    else {
+        replay.targets = targets;
+        replay.first_packet = 0;
+        replay.last_packet = UINT64_MAX;
+        fprintf(stdout, "Triage of %zu suspect trials.\n", replay.nb_targets);
+
+        if (fuzi_q_triage_bisect(fuzi_q_triage_oracle, &triage_ctx, &replay, &nb_runs) != 0) {
+            fprintf(stdout, "Could not reproduce the crash.\n");
+            ret = -1;
+        }
+        else if (fuzi_q_triage_minimize(fuzi_q_triage_oracle, &triage_ctx, &replay, &nb_runs) != 0) {
+            fprintf(stdout, "Error while minimizing the packet sequence.\n");
+            ret = -1;
+        }
+        else {
+            fprintf(stdout, "Crash reproduced with %zu trials, fuzzed packets %llu to %llu, after %zu runs:\n",
+                replay.nb_targets, (unsigned long long)replay.first_packet,
+                (unsigned long long)replay.last_packet, nb_runs);
+            for (size_t i = 0; i < replay.nb_targets; i++) {
+                for (uint8_t x = 0; x < replay.targets[i].icid.id_len; x++) {
+                    fprintf(stdout, "%02x", replay.targets[i].icid.id[x]);
+                }
+                fprintf(stdout, " %llu %d %d\n", (unsigned long long)replay.targets[i].trial_rank,
+                    replay.targets[i].target_state, replay.targets[i].target_wait);
+            }
+        }
+    }
+
+    if (targets != NULL) {
+        free(targets);
+    }
+
+    return ret;
+}
@@ -0,0 +1,217 @@
+/*
+* Author: Christian Huitema
+* Copyright (c) 2022, Private Octopus, Inc.
+* All rights reserved.
+*
+* Permission to use, copy, modify, and distribute this software for any
+* purpose with or without fee is hereby granted, provided that the above
+* copyright notice and this permission notice appear in all copies.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL Private Octopus, Inc. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdint.h>
+#include <string.h>
+#include <picoquic.h>
+#include <picoquic_utils.h>
+#include "fuzi_q.h"
+
+/* Varint mutations.
+ *
+ * Implementations tend to fail at the edges of the encoding: the largest
+ * value of each length, the first value that needs a longer encoding,
+ * 16 and 32 bit overflows, and values just around the limits that the
+ * peer checks. The boundary table lists these values in increasing order.
+ */
+
+static const uint64_t fuzzer_varint_boundaries[] = {
+    0, 1, 0x3F, 0x40, 0xFF, 0x100, 0x3FFF, 0x4000, 0xFFFF, 0x10000,
+    0x3FFFFFFF, 0x40000000, 0xFFFFFFFFull, 0x100000000ull,
+    0x3FFFFFFFFFFFFFFEull, 0x3FFFFFFFFFFFFFFFull
+};
+
+#define FUZZER_VARINT_NB_BOUNDARIES (sizeof(fuzzer_varint_boundaries) / sizeof(uint64_t))
+
+/* Largest value that can be encoded on length bytes */
+static uint64_t fuzzer_varint_length_max(size_t length)
+{
+    return (length >= 8) ? FUZZER_VARINT_MAX : ((uint64_t)1 << (8 * length - 2)) - 1;
+}
+
+size_t fuzzer_varint_length(uint64_t value)
+{
+    size_t length = 1;
+
+    while (length < 8 && value > fuzzer_varint_length_max(length)) {
+        length *= 2;
+    }
+    return length;
+}
+
+/* Encode on exactly length bytes, which may not be the minimal encoding.
+ * Returns 0 if length is not a valid varint length or is too short.
+ */
+int fuzzer_varint_encode(uint8_t* bytes, size_t length, uint64_t value)
+{
+    uint8_t prefix;
+
+    switch (length) {
+    case 1: prefix = 0x00; break;
+    case 2: prefix = 0x40; break;
+    case 4: prefix = 0x80; break;
+    case 8: prefix = 0xC0; break;
+    default: return 0;
+    }
+    if (value > fuzzer_varint_length_max(length)) {
+        return 0;
+    }
+    for (size_t i = length; i > 0; i--) {
+        bytes[i - 1] = (uint8_t)value;
+        value >>= 8;
+    }
+    bytes[0] |= prefix;
+    return 1;
+}
+
+/* Pick a boundary value that can be encoded on length bytes */
+uint64_t fuzzer_varint_boundary(fuzzer_prng_t* prng, size_t length)
+{
+    uint64_t length_max = fuzzer_varint_length_max(length);
+    size_t nb_fit = 0;
+
+    while (nb_fit < FUZZER_VARINT_NB_BOUNDARIES && fuzzer_varint_boundaries[nb_fit] <= length_max) {
+        nb_fit++;
+    }
+    return fuzzer_varint_boundaries[fuzzer_prng_uniform(prng, nb_fit)];
+}
+
+/* Values derived from the current one, or around the limit if one is known */
+uint64_t fuzzer_varint_relative(fuzzer_prng_t* prng, uint64_t value, uint64_t limit)
+{
+    uint64_t r;
+
+    if (limit > FUZZER_VARINT_MAX && limit != FUZZER_VARINT_NO_LIMIT) {
+        limit = FUZZER_VARINT_MAX;
+    }
+    switch (fuzzer_prng_uniform(prng, (limit == FUZZER_VARINT_NO_LIMIT) ? 4 : 7)) {
+    case 0:
+        r = (value > 0) ? value - 1 : 1;
+        break;
+    case 1:
+        r = value + 1;
+        break;
+    case 2:
+        r = (value == 0) ? 2 : ((value > FUZZER_VARINT_MAX / 2) ? FUZZER_VARINT_MAX : 2 * value);
+        break;
+    case 3:
+        r = value / 2;
+        break;
+    case 4:
+        r = (limit > 0) ? limit - 1 : 0;
+        break;
+    case 5:
+        r = limit;
+        break;
+    default:
+        r = limit + 1;
+        break;
+    }
+    return (r > FUZZER_VARINT_MAX) ? FUZZER_VARINT_MAX : r;
+}
+
+/* Overwrite a varint field without changing its length. Values too large
+ * for the field are replaced by the largest value that fits, which is
+ * itself a boundary.
+ */
+int fuzzer_varint_overwrite(uint8_t* field, uint8_t* field_end, uint64_t value)
+{
+    size_t length;
+
+    if (field == NULL || field_end == NULL || field_end <= field) {
+        return 0;
+    }
+    length = field_end - field;
+    if (value > fuzzer_varint_length_max(length)) {
+        value = fuzzer_varint_length_max(length);
+    }
+    return fuzzer_varint_encode(field, length, value);
+}
+
+/* Mutate the varint at field in place, and return the end of the field,
+ * or NULL if the field cannot be parsed.
+ */
+uint8_t* fuzzer_varint_mutate(fuzzer_prng_t* prng, uint8_t* field, uint8_t* bytes_max, uint64_t limit)
+{
+    uint64_t value;
+    uint8_t* field_end;
+
+    if (field == NULL || (field_end = (uint8_t*)picoquic_frames_varint_decode(field, bytes_max, &value)) == NULL) {
+        return NULL;
+    }
+    switch (fuzzer_prng_uniform(prng, 4)) {
+    case 0:
+        value = fuzzer_varint_boundary(prng, field_end - field);
+        break;
+    case 1:
+    case 2:
+        value = fuzzer_varint_relative(prng, value, limit);
+        break;
+    default:
+        /* Flip random bits of the value, keeping the encoding length */
+        value ^= fuzzer_prng_next(prng) & fuzzer_varint_length_max(field_end - field);
+        break;
+    }
+    (void)fuzzer_varint_overwrite(field, field_end, value);
+
+    return field_end;
+}
+
+/* Re-encode the varint at field_offset in the packet with a different
+ * length, either with the same value in a non minimal encoding or with
+ * a new value, and shift the rest of the packet accordingly. Returns the
+ * new length of the packet, which is unchanged if the field cannot be
+ * parsed or if the packet would not fit in bytes_max.
+ */
+size_t fuzzer_varint_resize(fuzzer_prng_t* prng, uint8_t* bytes, size_t length, size_t bytes_max, size_t field_offset)
+{
+    uint64_t value;
+    uint8_t* field = bytes + field_offset;
+    uint8_t* field_end;
+    size_t old_length;
+    size_t new_length;
+    size_t min_length;
+
+    if (field_offset >= length || (field_end = (uint8_t*)picoquic_frames_varint_decode(field, bytes + length, &value)) == NULL) {
+        return length;
+    }
+    old_length = field_end - field;
+    if (fuzzer_prng_uniform(prng, 2) == 0) {
+        value = (fuzzer_prng_uniform(prng, 2) == 0) ? fuzzer_varint_boundary(prng, 8) :
+            fuzzer_varint_relative(prng, value, FUZZER_VARINT_NO_LIMIT);
+    }
+    min_length = fuzzer_varint_length(value);
+    new_length = (size_t)1 << fuzzer_prng_uniform(prng, 4);
+    if (new_length < min_length) {
+        new_length = min_length;
+    }
+    if (new_length == old_length) {
+        new_length = (old_length < 8) ? 8 : min_length;
+    }
+    if (length - old_length + new_length > bytes_max) {
+        return length;
+    }
+    memmove(field + new_length, field_end, length - (field_offset + old_length));
+    (void)fuzzer_varint_encode(field, new_length, value);
+
+    return length - old_length + new_length;
+}
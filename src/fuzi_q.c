@@ -68,8 +68,17 @@ void usage()
 {
     fprintf(stderr, "fuzi_q: over the net quic fuzzer\n");
     fprintf(stderr, "Usage: fuzi_q <options> fuzz_mode [server_name port [scenario]] \n");
-    fprintf(stderr, "  fuzz_mode can be one of client, clean or server.");
+    fprintf(stderr, "       fuzi_q <options> triage suspects_file restart_cmd server_name port [scenario]\n");
+    fprintf(stderr, "       fuzi_q <options> supervise target_cmd server_name port [scenario]\n");
+    fprintf(stderr, "  fuzz_mode can be one of client, clean, blast or server.");
     fprintf(stderr, "  For the client or clean fuzz_mode, specify server_name and port.\n");
+    fprintf(stderr, "  The triage mode replays the suspect trials listed when the server went down,\n");
+    fprintf(stderr, "  restarting the target with restart_cmd (\"-\" for none) before each run, and\n");
+    fprintf(stderr, "  bisects them down to the trial and packets that crash the target.\n");
+    fprintf(stderr, "  The supervise mode runs target_cmd as a local server, fuzzes it as in client\n");
+    fprintf(stderr, "  mode, records each crash in %s and restarts the target (not on Windows).\n", FUZI_Q_SUPERVISOR_CRASH_LOG);
+    fprintf(stderr, "  The blast mode sends mutated Initial packets to server_name and port without\n");
+    fprintf(stderr, "  creating connections, -f setting the number of Initials, and counts the replies.\n");
     fprintf(stderr, "  For the server fuzz_mode, use -p to specify the port,\n");
     fprintf(stderr, "  and also -c and -k for certificate and matching private key.\n");
     picoquic_config_usage();
@@ -77,7 +86,20 @@ void usage()
     fprintf(stderr, "  -f nb_fuzz_trials     Number of trials to be attempted.\n");
     fprintf(stderr, "  -d duration_max       Duration of the test, in seconds.\n");
     fprintf(stderr, "  -X initial_cid        CID of first client connection.\n");
-    fprintf(stderr, "\nThe scenario argument is same as for picoquicdemo.\n");
+    fprintf(stderr, "  -Y profile_file       Load the fuzzing profile at start, save it at exit.\n");
+    fprintf(stderr, "  -Z trials_per_cnx     Number of fuzz trials hosted by each client connection.\n");
+    fprintf(stderr, "  -N probe_interval     Client mode, run a liveness probe sending PINGs every probe_interval ms\n");
+    fprintf(stderr, "                        (default 0: no probe; triage and supervise use %d ms if not set).\n", (int)(FUZI_Q_PROBE_INTERVAL_DEFAULT / 1000));
+    fprintf(stderr, "  -H event_sample       Keep packet events in memory, write them for the abnormal\n");
+    fprintf(stderr, "                        connections and for one connection in event_sample (0: none).\n");
+    fprintf(stderr, "  -A                    Capture the last packets of each connection, before and\n");
+    fprintf(stderr, "                        after fuzzing, and write them in pcapng after anomalies.\n");
+    fprintf(stderr, "  -g stateless_ratio    Server mode, answer 1 client Initial in stateless_ratio with\n");
+    fprintf(stderr, "                        a fuzzed Version Negotiation or Retry packet (0: none).\n");
+    fprintf(stderr, "  -u nb_paths           Client mode, negotiate multipath and open nb_paths paths\n");
+    fprintf(stderr, "                        from loopback addresses (default 1, at most %d).\n", FUZI_Q_MULTIPATH_NB_PATHS_MAX);
+    fprintf(stderr, "\nThe scenario argument is same as for picoquicdemo. Without it, each client connection\n");
+    fprintf(stderr, "runs its own scenario, with streams, sizes and dependencies generated from its initial CID.\n");
     fprintf(stderr, "\nThe fuzzing of a connection depends on the value of the initial CID for that connection. On the client,\n");
     fprintf(stderr, "these CIDs are derived from the previous one using SHA 256. By default, the very first CID is picked\n");
     fprintf(stderr, "at random, but it can be specifed using the parameter -X when reproducing a previous fuzz.\n");
@@ -108,13 +130,24 @@ int main(int argc, char** argv)
     int arg_as_int;
     picoquic_connection_id_t init_cid = { 0 };
     char const* scenario = NULL;
+    char const* suspects_file = NULL;
+    char const* restart_cmd = NULL;
+    char const* target_cmd = NULL;
+    char const* profile_file = NULL;
+    size_t trials_per_cnx = 1;
+    uint64_t probe_interval = 0;
+    int event_sample = FUZI_Q_EVENT_LOG_OFF;
+    int capture_packets = 0;
+    uint32_t stateless_ratio = 0;
+    size_t nb_paths = 1;
+    fuzi_q_client_options_t client_options = { 0 };
 #ifdef _WINDOWS
     WSADATA wsaData = { 0 };
     (void)WSA_START(MAKEWORD(2, 2), &wsaData);
 #endif
     picoquic_config_init(&config);
-    memcpy(option_string, "d:f:X:", 6);
-    ret = picoquic_config_option_letters(option_string + 6, sizeof(option_string) - 6, NULL);
+    memcpy(option_string, "d:f:X:Y:Z:N:H:Ag:u:", 19);
+    ret = picoquic_config_option_letters(option_string + 19, sizeof(option_string) - 19, NULL);
 
     if (ret == 0) {
         /* Get the parameters */
@@ -144,6 +177,57 @@ int main(int argc, char** argv)
                     usage();
                 }
                 break;
+            case 'Y':
+                profile_file = optarg;
+                break;
+            case 'Z':
+                if ((arg_as_int = atoi(optarg)) <= 0) {
+                    fprintf(stderr, "Invalid number of trials per connection: %s\n", optarg);
+                    usage();
+                }
+                else {
+                    trials_per_cnx = (size_t)arg_as_int;
+                }
+                break;
+            case 'N':
+                if ((arg_as_int = atoi(optarg)) < 0) {
+                    fprintf(stderr, "Invalid probe interval: %s\n", optarg);
+                    usage();
+                }
+                else {
+                    probe_interval = ((uint64_t)arg_as_int) * 1000;
+                }
+                break;
+            case 'H':
+                if ((arg_as_int = atoi(optarg)) < 0) {
+                    fprintf(stderr, "Invalid event sample: %s\n", optarg);
+                    usage();
+                }
+                else {
+                    event_sample = arg_as_int;
+                }
+                break;
+            case 'A':
+                capture_packets = 1;
+                break;
+            case 'g':
+                if ((arg_as_int = atoi(optarg)) < 0) {
+                    fprintf(stderr, "Invalid stateless ratio: %s\n", optarg);
+                    usage();
+                }
+                else {
+                    stateless_ratio = (uint32_t)arg_as_int;
+                }
+                break;
+            case 'u':
+                if ((arg_as_int = atoi(optarg)) < 1 || arg_as_int > FUZI_Q_MULTIPATH_NB_PATHS_MAX) {
+                    fprintf(stderr, "Invalid number of paths: %s\n", optarg);
+                    usage();
+                }
+                else {
+                    nb_paths = (size_t)arg_as_int;
+                }
+                break;
             default:
                 if (picoquic_config_command_line(opt, &optind, argc, (char const**)argv, optarg, &config) != 0) {
                     usage();
@@ -165,6 +249,19 @@ int main(int argc, char** argv)
         else if (strcmp(a_fuzz_mode, "clean") == 0) {
             fuzz_mode = fuzi_q_mode_clean;
         }
+        else if (strcmp(a_fuzz_mode, "triage") == 0) {
+            fuzz_mode = fuzi_q_mode_triage;
+        }
+        else if (strcmp(a_fuzz_mode, "supervise") == 0) {
+#ifdef _WINDOWS
+            fprintf(stdout, "The supervise mode is not supported on Windows.\n");
+#else
+            fuzz_mode = fuzi_q_mode_supervise;
+#endif
+        }
+        else if (strcmp(a_fuzz_mode, "blast") == 0) {
+            fuzz_mode = fuzi_q_mode_blast;
+        }
         else {
             fprintf(stdout, "Fuzz mode incorrect, %s\n", a_fuzz_mode);
         }
@@ -178,7 +275,30 @@ int main(int argc, char** argv)
     }
     else
     {
-        if (fuzz_mode == fuzi_q_mode_client || fuzz_mode == fuzi_q_mode_clean) {
+        if (fuzz_mode == fuzi_q_mode_triage) {
+            if (optind + 2 > argc) {
+                fprintf(stdout, "Expected suspects file and restart command after triage\n");
+                usage();
+            }
+            else {
+                suspects_file = argv[optind++];
+                restart_cmd = argv[optind++];
+                if (strcmp(restart_cmd, "-") == 0) {
+                    restart_cmd = NULL;
+                }
+            }
+        }
+        else if (fuzz_mode == fuzi_q_mode_supervise) {
+            if (optind + 1 > argc) {
+                fprintf(stdout, "Expected target command after supervise\n");
+                usage();
+            }
+            else {
+                target_cmd = argv[optind++];
+            }
+        }
+        if (fuzz_mode == fuzi_q_mode_client || fuzz_mode == fuzi_q_mode_clean || fuzz_mode == fuzi_q_mode_triage ||
+            fuzz_mode == fuzi_q_mode_supervise || fuzz_mode == fuzi_q_mode_blast) {
             if (optind + 2 > argc) {
                 fprintf(stdout, "Expected server and port after fuzz mode\n");
                 usage();
@@ -204,11 +324,36 @@ int main(int argc, char** argv)
     }
 
     /* Run */
+    client_options.fuzz_mode = fuzz_mode;
+    client_options.ip_address_text = server_name;
+    client_options.server_port = server_port;
+    client_options.config = &config;
+    client_options.nb_cnx_required = nb_fuzz_trials;
+    client_options.duration_max = fuzz_duration_max;
+    client_options.init_cid = &init_cid;
+    client_options.client_scenario_text = scenario;
+    client_options.profile_file = profile_file;
+    client_options.trials_per_cnx = trials_per_cnx;
+    client_options.probe_interval = probe_interval;
+    client_options.event_sample = event_sample;
+    client_options.capture_packets = capture_packets;
+    client_options.nb_paths = nb_paths;
     if (fuzz_mode == fuzi_q_mode_client || fuzz_mode == fuzi_q_mode_clean) {
-        ret = fuzi_q_client(fuzz_mode, server_name, server_port, &config, nb_fuzz_trials, fuzz_duration_max, &init_cid, scenario);
+        ret = fuzi_q_client(&client_options);
+    }
+#ifndef _WINDOWS
+    else if (fuzz_mode == fuzi_q_mode_supervise) {
+        ret = fuzi_q_supervise(target_cmd, &client_options);
+    }
+#endif
+    else if (fuzz_mode == fuzi_q_mode_blast) {
+        ret = fuzi_q_blast(server_name, server_port, &config, nb_fuzz_trials, fuzz_duration_max, &init_cid);
+    }
+    else if (fuzz_mode == fuzi_q_mode_triage) {
+        ret = fuzi_q_triage(suspects_file, restart_cmd, server_name, server_port, &config, fuzz_duration_max, scenario, probe_interval);
     }
     else {
-        ret = fuzi_q_server(fuzz_mode, &config, fuzz_duration_max);
+        ret = fuzi_q_server(fuzz_mode, &config, fuzz_duration_max, profile_file, stateless_ratio);
     }
     /* Clean up */
     picoquic_config_clear(&config);
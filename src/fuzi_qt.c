@@ -45,7 +45,31 @@ static const fuzi_q_test_def_t test_table[] =
 {
     { "basic", fuzi_q_basic_test },
     { "basic_client", fuzi_q_basic_client_test },
-    { "icid_table", icid_table_test}
+    { "icid_table", icid_table_test},
+    { "fuzzer_prng", fuzzer_prng_test},
+    { "fuzzer_scheduler", fuzzer_scheduler_test},
+    { "fuzzer_profile", fuzzer_profile_test},
+    { "fuzzer_trial", fuzzer_trial_test},
+    { "fuzzer_rate", fuzzer_rate_test},
+    { "fuzzer_log", fuzzer_log_test},
+    { "fuzzer_triage", fuzzer_triage_test},
+    { "fuzzer_supervisor_log", fuzzer_supervisor_log_test},
+    { "fuzzer_event", fuzzer_event_test},
+    { "fuzzer_capture", fuzzer_capture_test},
+    { "fuzzer_memory", fuzzer_memory_test},
+    { "fuzzer_varint", fuzzer_varint_test},
+    { "fuzzer_schema", fuzzer_schema_test},
+    { "fuzzer_app_frame", fuzzer_app_frame_test},
+    { "fuzzer_h3_mutate", fuzzer_h3_mutate_test},
+    { "fuzi_q_blaster", fuzi_q_blaster_test},
+    { "fuzzer_tls_mutate", fuzzer_tls_mutate_test},
+    { "fuzi_q_stateless", fuzi_q_stateless_test},
+    { "fuzi_q_migration_plan", fuzi_q_migration_plan_test},
+    { "fuzi_q_key_update_plan", fuzi_q_key_update_plan_test},
+    { "fuzi_q_multipath", fuzi_q_multipath_test},
+    { "fuzi_q_scenario", fuzi_q_scenario_test},
+    { "fuzi_q_many_clients", fuzi_q_many_clients_test},
+    { "fuzi_q_wake_up", fuzi_q_wake_up_test}
 };
 
 static size_t const nb_tests = sizeof(test_table) / sizeof(fuzi_q_test_def_t);
@@ -53,6 +53,18 @@ typedef struct st_fuzi_q_test_attach_t {
     struct sockaddr_storage node_addr;
 } fuzi_q_test_attach_t;
 
+/* Events of the simulation: a node wakes up, or a packet arrives at the
+ * end of a link.
+ */
+#define FUZI_Q_TEST_EVENT_NODE 1
+#define FUZI_Q_TEST_EVENT_LINK 2
+
+typedef struct st_fuzi_q_test_event_t {
+    uint64_t event_time;
+    int event_type;
+    int index;
+} fuzi_q_test_event_t;
+
 typedef struct st_fuzi_q_test_config_t {
     uint64_t simulated_time;
     uint64_t simulate_loss;
@@ -69,8 +81,29 @@ typedef struct st_fuzi_q_test_config_t {
     fuzi_q_test_attach_t* attachments;
     uint64_t cnx_error_client;
     uint64_t cnx_error_server;
+    /* Queue of the next events, and time of the earliest queued event
+     * for each node and link, UINT64_MAX if none is queued */
+    int events_ready;
+    fuzi_q_test_event_t* events;
+    size_t nb_events;
+    size_t events_max;
+    uint64_t* node_event_time;
+    uint64_t* link_event_time;
+    /* In topologies with several clients, the loop terminates only
+     * after all clients are done */
+    uint8_t* node_done;
+    int nb_clients_running;
 } fuzi_q_test_config_t;
 
+/* Description of a client in a topology with several clients */
+typedef struct st_fuzi_q_test_client_spec_t {
+    fuzi_q_mode_enum fuzz_mode;
+    uint64_t icid_seed;
+    double data_rate_in_gps;
+    uint64_t microsec_latency;
+    size_t nb_cnx_required;
+} fuzi_q_test_client_spec_t;
+
 /* Find arrival context by link ID and destination address */
 int fuzi_q_test_find_dest_node(fuzi_q_test_config_t* config, int link_id, struct sockaddr* addr)
 {
@@ -133,6 +166,145 @@ struct sockaddr* fuzi_q_test_find_send_addr(fuzi_q_test_config_t* config, int sr
     return dest_addr;
 }
 
+/* Event queue.
+ * The events are kept in a binary heap, ordered by time, then nodes before
+ * links, then by index, which is the order in which a scan of all nodes and
+ * links would pick them. The queue is keyed lazily: when the next event of
+ * a node or link becomes earlier, a new event is queued and the old one is
+ * ignored when it comes out; when it becomes later, the old event is kept,
+ * and re-queued at the new time when it comes out.
+ */
+static int fuzi_q_test_event_before(const fuzi_q_test_event_t* a, const fuzi_q_test_event_t* b)
+{
+    if (a->event_time != b->event_time) {
+        return a->event_time < b->event_time;
+    }
+    if (a->event_type != b->event_type) {
+        return a->event_type < b->event_type;
+    }
+    return a->index < b->index;
+}
+
+static int fuzi_q_test_event_push(fuzi_q_test_config_t* config, uint64_t event_time, int event_type, int index)
+{
+    int ret = 0;
+    size_t i;
+
+    if (config->nb_events >= config->events_max) {
+        size_t new_max = (config->events_max == 0) ? 64 : 2 * config->events_max;
+        fuzi_q_test_event_t* new_events = (fuzi_q_test_event_t*)realloc(config->events, new_max * sizeof(fuzi_q_test_event_t));
+
+        if (new_events == NULL) {
+            return -1;
+        }
+        config->events = new_events;
+        config->events_max = new_max;
+    }
+    i = config->nb_events++;
+    config->events[i].event_time = event_time;
+    config->events[i].event_type = event_type;
+    config->events[i].index = index;
+    while (i > 0 && fuzi_q_test_event_before(&config->events[i], &config->events[(i - 1) / 2])) {
+        fuzi_q_test_event_t x = config->events[i];
+        config->events[i] = config->events[(i - 1) / 2];
+        config->events[(i - 1) / 2] = x;
+        i = (i - 1) / 2;
+    }
+    return ret;
+}
+
+static fuzi_q_test_event_t fuzi_q_test_event_pop(fuzi_q_test_config_t* config)
+{
+    fuzi_q_test_event_t first = config->events[0];
+    size_t i = 0;
+
+    config->events[0] = config->events[--config->nb_events];
+    while (2 * i + 1 < config->nb_events) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < config->nb_events && fuzi_q_test_event_before(&config->events[child + 1], &config->events[child])) {
+            child++;
+        }
+        if (!fuzi_q_test_event_before(&config->events[child], &config->events[i])) {
+            break;
+        }
+        fuzi_q_test_event_t x = config->events[i];
+        config->events[i] = config->events[child];
+        config->events[child] = x;
+        i = child;
+    }
+    return first;
+}
+
+/* Actual time of the next event of a node or link */
+static uint64_t fuzi_q_test_event_time(fuzi_q_test_config_t* config, int event_type, int index)
+{
+    uint64_t event_time = UINT64_MAX;
+
+    if (event_type == FUZI_Q_TEST_EVENT_NODE) {
+        /* Look at both quic timer and fuzi level timer */
+        uint64_t fuzz_time = fuzi_q_next_time(&config->nodes[index]);
+
+        event_time = picoquic_get_next_wake_time(config->nodes[index].quic, config->simulated_time);
+        if (event_time > fuzz_time) {
+            event_time = fuzz_time;
+        }
+    }
+    else if (config->links[index]->first_packet != NULL) {
+        event_time = config->links[index]->first_packet->arrival_time;
+    }
+    return event_time;
+}
+
+/* Queue a new event if the next event of the node or link became earlier.
+ * Called after each change of a node or link, does nothing until the
+ * queue is initialized by the first loop step. Clients that are done are
+ * not stepped anymore, the packets sent to them are still received.
+ */
+static int fuzi_q_test_event_schedule(fuzi_q_test_config_t* config, int event_type, int index)
+{
+    int ret = 0;
+
+    if (config->events_ready && (event_type != FUZI_Q_TEST_EVENT_NODE ||
+        config->node_done == NULL || !config->node_done[index])) {
+        uint64_t* queued_time = (event_type == FUZI_Q_TEST_EVENT_NODE) ?
+            &config->node_event_time[index] : &config->link_event_time[index];
+        uint64_t event_time = fuzi_q_test_event_time(config, event_type, index);
+
+        if (event_time < *queued_time) {
+            ret = fuzi_q_test_event_push(config, event_time, event_type, index);
+            *queued_time = event_time;
+        }
+    }
+    return ret;
+}
+
+static int fuzi_q_test_event_init(fuzi_q_test_config_t* config)
+{
+    int ret = 0;
+
+    config->node_event_time = (uint64_t*)malloc(config->nb_nodes * sizeof(uint64_t));
+    config->link_event_time = (uint64_t*)malloc(config->nb_links * sizeof(uint64_t));
+    if (config->node_event_time == NULL || config->link_event_time == NULL) {
+        ret = -1;
+    }
+    else {
+        config->events_ready = 1;
+        for (int i = 0; i < config->nb_nodes; i++) {
+            config->node_event_time[i] = UINT64_MAX;
+        }
+        for (int i = 0; i < config->nb_links; i++) {
+            config->link_event_time[i] = UINT64_MAX;
+        }
+        for (int i = 0; ret == 0 && i < config->nb_nodes; i++) {
+            ret = fuzi_q_test_event_schedule(config, FUZI_Q_TEST_EVENT_NODE, i);
+        }
+        for (int i = 0; ret == 0 && i < config->nb_links; i++) {
+            ret = fuzi_q_test_event_schedule(config, FUZI_Q_TEST_EVENT_LINK, i);
+        }
+    }
+    return ret;
+}
+
 /* Packet departure from selected node */
 int fuzi_q_test_packet_departure(fuzi_q_test_config_t* config, int node_id, int* is_active)
 {
@@ -164,6 +336,7 @@ int fuzi_q_test_packet_departure(fuzi_q_test_config_t* config, int node_id, int*
             if (link_id >= 0) {
                 *is_active = 1;
                 picoquictest_sim_link_submit(config->links[link_id], packet, config->simulated_time);
+                ret = fuzi_q_test_event_schedule(config, FUZI_Q_TEST_EVENT_LINK, link_id);
             }
             else {
                 /* packet cannot be routed. */
@@ -183,6 +356,15 @@ int fuzi_q_test_post_departure(fuzi_q_test_config_t* config, int node_id, int* i
     if (fuzi_q_ctx->fuzz_mode == fuzi_q_mode_client ||
         fuzi_q_ctx->fuzz_mode == fuzi_q_mode_clean) {
         ret = fuzi_q_loop_check_cnx(fuzi_q_ctx, config->simulated_time, is_active);
+        if (ret == PICOQUIC_NO_ERROR_TERMINATE_PACKET_LOOP && config->node_done != NULL) {
+            if (!config->node_done[node_id]) {
+                config->node_done[node_id] = 1;
+                config->nb_clients_running--;
+            }
+            if (config->nb_clients_running > 0) {
+                ret = 0;
+            }
+        }
     }
 
     return ret;
@@ -212,17 +394,23 @@ int fuzi_q_test_packet_arrival(fuzi_q_test_config_t* config, int link_id, int* i
                 (struct sockaddr*)&packet->addr_from,
                 (struct sockaddr*)&packet->addr_to, 0, 0,
                 config->simulated_time);
+            if (ret == 0) {
+                ret = fuzi_q_test_event_schedule(config, FUZI_Q_TEST_EVENT_NODE, node_id);
+            }
         }
         else {
             /* simulated loss */
         }
         free(packet);
+        if (ret == 0) {
+            ret = fuzi_q_test_event_schedule(config, FUZI_Q_TEST_EVENT_LINK, link_id);
+        }
     }
 
     return ret;
 }
 
-/* Execute the loop */
+/* Execute the loop: process the next event in the queue */
 int fuzi_q_test_loop_step(fuzi_q_test_config_t* config, int* is_active)
 {
     int ret = 0;
@@ -230,42 +418,45 @@ int fuzi_q_test_loop_step(fuzi_q_test_config_t* config, int* is_active)
     int next_step_index = 0;
     uint64_t next_time = UINT64_MAX;
 
-    /* Check which node has the lowest wait time */
-    for (int i = 0; i < config->nb_nodes; i++) {
-        /* Look at both quic timer and fuzi level timer */
-        uint64_t quic_time = picoquic_get_next_wake_time(config->nodes[i].quic, config->simulated_time);
-        uint64_t fuzz_time = fuzi_q_next_time(&config->nodes[i]);
-        if (quic_time > fuzz_time) {
-            quic_time = fuzz_time;
+    if (!config->events_ready) {
+        ret = fuzi_q_test_event_init(config);
+    }
+    while (ret == 0 && next_step_type == 0 && config->nb_events > 0) {
+        fuzi_q_test_event_t event = fuzi_q_test_event_pop(config);
+        uint64_t* queued_time = (event.event_type == FUZI_Q_TEST_EVENT_NODE) ?
+            &config->node_event_time[event.index] : &config->link_event_time[event.index];
+
+        if (event.event_time != *queued_time) {
+            /* Superseded by an earlier event of the same node or link */
+            continue;
         }
-        if (quic_time < next_time) {
-            next_time = quic_time;
-            next_step_type = 1;
-            next_step_index = i;
+        *queued_time = UINT64_MAX;
+        next_time = fuzi_q_test_event_time(config, event.event_type, event.index);
+        if (next_time > event.event_time) {
+            /* The event was delayed, queue it again at its actual time */
+            ret = fuzi_q_test_event_schedule(config, event.event_type, event.index);
         }
-    }
-    /* Check which link has the lowest arrival time */
-    for (int i = 0; i < config->nb_links; i++) {
-        if (config->links[i]->first_packet != NULL &&
-            config->links[i]->first_packet->arrival_time < next_time) {
-            next_time = config->links[i]->first_packet->arrival_time;
-            next_step_type = 2;
-            next_step_index = i;
+        else {
+            next_step_type = event.event_type;
+            next_step_index = event.index;
         }
     }
-    if (next_time < UINT64_MAX) {
+    if (ret == 0 && next_step_type != 0) {
         /* Update the time */
         if (next_time > config->simulated_time) {
             config->simulated_time = next_time;
         }
         switch (next_step_type) {
-        case 1: /* context #next_step_index is ready to send data */
+        case FUZI_Q_TEST_EVENT_NODE: /* context #next_step_index is ready to send data */
             ret = fuzi_q_test_packet_departure(config, next_step_index, is_active);
             if (ret == 0) {
                 ret = fuzi_q_test_post_departure(config, next_step_index, is_active);
             }
+            if (ret == 0) {
+                ret = fuzi_q_test_event_schedule(config, FUZI_Q_TEST_EVENT_NODE, next_step_index);
+            }
             break;
-        case 2:
+        case FUZI_Q_TEST_EVENT_LINK:
             /* If arrival, take next packet, find destination by address, and submit to end-of-link context */
             ret = fuzi_q_test_packet_arrival(config, next_step_index, is_active);
             break;
@@ -275,7 +466,7 @@ int fuzi_q_test_loop_step(fuzi_q_test_config_t* config, int* is_active)
             break;
         }
     }
-    else {
+    else if (ret == 0) {
         ret = -1;
     }
 
@@ -309,6 +500,22 @@ void fuzi_q_test_config_delete(fuzi_q_test_config_t* config)
         free(config->attachments);
     }
 
+    if (config->events != NULL) {
+        free(config->events);
+    }
+
+    if (config->node_event_time != NULL) {
+        free(config->node_event_time);
+    }
+
+    if (config->link_event_time != NULL) {
+        free(config->link_event_time);
+    }
+
+    if (config->node_done != NULL) {
+        free(config->node_done);
+    }
+
     free(config);
 }
 
@@ -401,7 +608,7 @@ fuzi_q_test_config_t* fuzi_q_test_config_create(int nb_nodes, int nb_links, int
 
 int fuzi_q_set_test_client_ctx(fuzi_q_test_config_t* test_config, fuzi_q_ctx_t* fuzi_q_ctx, fuzi_q_mode_enum fuzz_mode,
     size_t nb_cnx_ctx, size_t nb_cnx_required, uint64_t duration_max, char const * client_scenario_text, 
-    struct sockaddr* server_addr, char const * qlog_dir)
+    struct sockaddr* server_addr, char const * qlog_dir, picoquic_connection_id_t* init_cid)
 {
     int ret = 0;
     uint64_t current_time = test_config->simulated_time; 
@@ -443,7 +650,7 @@ int fuzi_q_set_test_client_ctx(fuzi_q_test_config_t* test_config, fuzi_q_ctx_t*
             ret = -1;
         }
         else {
-            fuzi_q_fuzzer_init(&fuzi_q_ctx->fuzz_ctx, NULL, NULL);
+            fuzi_q_fuzzer_init(&fuzi_q_ctx->fuzz_ctx, init_cid, NULL);
             fuzi_q_ctx->fuzz_ctx.parent = fuzi_q_ctx;
             if (fuzz_mode != fuzi_q_mode_clean) {
                 picoquic_set_fuzz(fuzi_q_ctx->quic, fuzi_q_fuzzer, &fuzi_q_ctx->fuzz_ctx);
@@ -555,7 +762,7 @@ fuzi_q_test_config_t* fuzi_q_test_basic_config_create(uint64_t simulate_loss, fu
                 nb_cnx_ctx, duration_max, server_addr, qlog_dir);
             c_ret = fuzi_q_set_test_client_ctx(config, &config->nodes[1], client_fuzz_mode,
                 nb_cnx_ctx, nb_cnx_required, duration_max, client_scenario_text,
-                server_addr, qlog_dir);
+                server_addr, qlog_dir, NULL);
         }
         if (a_ret != 0 || s_ret != 0 || c_ret != 0) {
             DBG_PRINTF("Configuration failed, address: %d, server: %d, client: %d", a_ret, s_ret, c_ret);
@@ -566,6 +773,95 @@ fuzi_q_test_config_t* fuzi_q_test_basic_config_create(uint64_t simulate_loss, fu
     return config;
 }
 
+/* Topology with several clients and one or more servers.
+ * Servers are placed on nodes[0..nb_servers-1], clients on the following
+ * nodes. Client k connects to server (k % nb_servers) through its own pair
+ * of links: link 2k carries the packets from the client to the server,
+ * link 2k+1 the packets from the server to the client. The link data rate
+ * and latency are set per client, and each client derives the ICID of its
+ * connections from its own seed, so the server sees distinct connections.
+ */
+fuzi_q_test_config_t* fuzi_q_test_topology_config_create(int nb_servers, fuzi_q_mode_enum server_fuzz_mode,
+    int nb_clients, const fuzi_q_test_client_spec_t* clients, size_t nb_cnx_ctx, uint64_t duration_max,
+    char const* client_scenario_text, char const* qlog_dir)
+{
+    fuzi_q_test_config_t* config = NULL;
+    int ret = 0;
+
+    if (nb_servers <= 0 || nb_clients <= 0 || nb_servers > nb_clients) {
+        return NULL;
+    }
+
+    config = fuzi_q_test_config_create(nb_servers + nb_clients, 2 * nb_clients, 2 * nb_clients, nb_clients);
+    if (config != NULL) {
+        config->node_done = (uint8_t*)malloc(config->nb_nodes);
+        if (config->node_done == NULL) {
+            ret = -1;
+        }
+        else {
+            memset(config->node_done, 0, config->nb_nodes);
+            config->nb_clients_running = nb_clients;
+        }
+
+        for (int k = 0; ret == 0 && k < nb_clients; k++) {
+            int server_id = k % nb_servers;
+            int up_link = 2 * k;
+            int down_link = 2 * k + 1;
+
+            /* Recreate the links with the characteristics of the client */
+            for (int i = up_link; ret == 0 && i <= down_link; i++) {
+                picoquictest_sim_link_delete(config->links[i]);
+                config->links[i] = picoquictest_sim_link_create(clients[k].data_rate_in_gps,
+                    clients[k].microsec_latency, NULL, 0, config->simulated_time);
+                if (config->links[i] == NULL) {
+                    ret = -1;
+                }
+            }
+            config->return_links[up_link] = down_link;
+            config->return_links[down_link] = up_link;
+            /* All the attachments of a server share the address of its first attachment */
+            config->attachments[up_link].node_id = server_id;
+            config->attachments[up_link].link_id = up_link;
+            if (k >= nb_servers) {
+                picoquic_store_addr(&config->attachments[up_link].node_addr,
+                    (struct sockaddr*)&config->attachments[2 * server_id].node_addr);
+            }
+            config->attachments[down_link].node_id = nb_servers + k;
+            config->attachments[down_link].link_id = down_link;
+        }
+
+        /* Configure the servers, then the clients */
+        for (int s = 0; ret == 0 && s < nb_servers; s++) {
+            size_t nb_clients_served = (nb_clients - s + nb_servers - 1) / nb_servers;
+            ret = fuzi_q_set_test_server_ctx(config, &config->nodes[s], server_fuzz_mode,
+                nb_cnx_ctx * nb_clients_served, duration_max,
+                (struct sockaddr*)&config->attachments[2 * s].node_addr, qlog_dir);
+        }
+
+        for (int k = 0; ret == 0 && k < nb_clients; k++) {
+            picoquic_connection_id_t init_cid = { { 0 }, 8 };
+            struct sockaddr* server_addr = fuzi_q_test_find_send_addr(config, nb_servers + k, k % nb_servers);
+
+            picoformat_64(init_cid.id, clients[k].icid_seed);
+            if (server_addr == NULL) {
+                ret = -1;
+            }
+            else {
+                ret = fuzi_q_set_test_client_ctx(config, &config->nodes[nb_servers + k], clients[k].fuzz_mode,
+                    nb_cnx_ctx, clients[k].nb_cnx_required, duration_max, client_scenario_text,
+                    server_addr, qlog_dir, &init_cid);
+            }
+        }
+
+        if (ret != 0) {
+            DBG_PRINTF("Topology configuration failed, %d servers, %d clients, ret: %d", nb_servers, nb_clients, ret);
+            fuzi_q_test_config_delete(config);
+            config = NULL;
+        }
+    }
+    return config;
+}
+
 int fuzi_q_test_check_fuzz(size_t nb_cnx_required, fuzzer_ctx_t * fuzz_ctx)
 {
     size_t total_tried = 0;
@@ -598,19 +894,13 @@ int fuzi_q_test_check_fuzz(size_t nb_cnx_required, fuzzer_ctx_t * fuzz_ctx)
     return ret;
 }
 
-/* Basic loop, supporting 4 variations */
-int fuzi_q_basic_test_loop(int fuzz_client, int fuzz_server, int simulate_loss)
+/* Run the simulation until the clients are done */
+static int fuzi_q_test_run_loop(fuzi_q_test_config_t* config, uint64_t max_time)
 {
     int ret = 0;
-    fuzi_q_mode_enum client_fuzz_mode = (fuzz_client) ? fuzi_q_mode_client : fuzi_q_mode_clean;
-    fuzi_q_mode_enum server_fuzz_mode = (fuzz_server) ? fuzi_q_mode_server : fuzi_q_mode_clean_server;
     int nb_steps = 0;
     int nb_inactive = 0;
-    size_t nb_cnx_required = 16;
-    const uint64_t max_time = 360000000;
     const int max_inactive = 128;
-    fuzi_q_test_config_t* config = fuzi_q_test_basic_config_create(simulate_loss, client_fuzz_mode, server_fuzz_mode,
-        4, nb_cnx_required, 360000000, NULL, ".");
 
     while (ret == 0 && nb_inactive < max_inactive && config->simulated_time < max_time) {
         /* Run the simulation. Monitor the connection. Monitor the media. */
@@ -642,6 +932,27 @@ int fuzi_q_basic_test_loop(int fuzz_client, int fuzz_server, int simulate_loss)
         }
     }
 
+    return ret;
+}
+
+/* Basic loop, supporting 4 variations */
+int fuzi_q_basic_test_loop(int fuzz_client, int fuzz_server, int simulate_loss)
+{
+    int ret = 0;
+    fuzi_q_mode_enum client_fuzz_mode = (fuzz_client) ? fuzi_q_mode_client : fuzi_q_mode_clean;
+    fuzi_q_mode_enum server_fuzz_mode = (fuzz_server) ? fuzi_q_mode_server : fuzi_q_mode_clean_server;
+    size_t nb_cnx_required = 16;
+    const uint64_t max_time = 360000000;
+    fuzi_q_test_config_t* config = fuzi_q_test_basic_config_create(simulate_loss, client_fuzz_mode, server_fuzz_mode,
+        4, nb_cnx_required, 360000000, NULL, ".");
+
+    if (config == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = fuzi_q_test_run_loop(config, max_time);
+    }
+
     if (ret == 0) {
         fuzi_q_ctx_t* fuzi_q_ctx = &config->nodes[1];
         if (fuzi_q_ctx->server_is_down) {
@@ -676,4 +987,114 @@ int fuzi_q_basic_test()
 int fuzi_q_basic_client_test()
 {
     return fuzi_q_basic_test_loop(1, 0, 0);
-}
\ No newline at end of file
+}
+
+/* Check the ICID table of a server after a run. The chains must match the
+ * tree, the contexts must be in MRU order, and none of them may be kept
+ * past the eviction delay. The tree holds at most one context per client
+ * connection, and each connection that reached the server created one,
+ * whether it is still in the table or was evicted.
+ */
+static int fuzi_q_test_check_icid_table(int server_id, fuzzer_ctx_t* fuzz_ctx, size_t nb_cnx_min, size_t nb_cnx_max)
+{
+    int ret = 0;
+    size_t nb_icid = (size_t)fuzz_ctx->icid_tree.size;
+
+    if (icid_table_check_chain(fuzz_ctx, nb_icid) != 0) {
+        DBG_PRINTF("Server %d, ICID chains do not match the %zu contexts", server_id, nb_icid);
+        ret = -1;
+    }
+    else if (nb_icid > nb_cnx_max || nb_icid + fuzz_ctx->nb_icid_evicted < nb_cnx_min) {
+        DBG_PRINTF("Server %d, %zu contexts and %zu evicted, expected %zu to %zu connections",
+            server_id, nb_icid, fuzz_ctx->nb_icid_evicted, nb_cnx_min, nb_cnx_max);
+        ret = -1;
+    }
+    else {
+        for (fuzzer_icid_ctx_t* icid_ctx = fuzz_ctx->icid_mru; icid_ctx != NULL && icid_ctx->icid_after != NULL;
+            icid_ctx = icid_ctx->icid_after) {
+            if (icid_ctx->icid_after->last_time > icid_ctx->last_time) {
+                DBG_PRINTF("Server %d, ICID contexts not in MRU order", server_id);
+                ret = -1;
+                break;
+            }
+            else if (icid_ctx->icid_after->last_time + 2 * FUZI_Q_MAX_SILENCE < fuzz_ctx->icid_mru->last_time) {
+                DBG_PRINTF("Server %d, ICID context kept past the eviction delay", server_id);
+                ret = -1;
+                break;
+            }
+        }
+    }
+    return ret;
+}
+
+/* Many clients test: fuzzing and clean clients, each with its own seed
+ * and link characteristics, share two servers and a single virtual clock.
+ */
+int fuzi_q_many_clients_test()
+{
+    int ret = 0;
+    const int nb_servers = 2;
+    const uint64_t max_time = 360000000;
+    fuzi_q_test_client_spec_t clients[8];
+    int nb_clients = (int)(sizeof(clients) / sizeof(fuzi_q_test_client_spec_t));
+    fuzi_q_test_config_t* config = NULL;
+
+    for (int k = 0; k < nb_clients; k++) {
+        clients[k].fuzz_mode = (k % 4 == 3) ? fuzi_q_mode_clean : fuzi_q_mode_client;
+        clients[k].icid_seed = 0xf0f1f2f3f4f5f600ull + k;
+        clients[k].data_rate_in_gps = 0.01 * (1 + (k % 3));
+        clients[k].microsec_latency = 5000 + 2500 * k;
+        clients[k].nb_cnx_required = 8;
+    }
+
+    config = fuzi_q_test_topology_config_create(nb_servers, fuzi_q_mode_server, nb_clients, clients,
+        4, 360000000, NULL, NULL);
+    if (config == NULL) {
+        ret = -1;
+    }
+    else {
+        ret = fuzi_q_test_run_loop(config, max_time);
+    }
+
+    for (int k = 0; ret == 0 && k < nb_clients; k++) {
+        fuzi_q_ctx_t* fuzi_q_ctx = &config->nodes[nb_servers + k];
+        if (fuzi_q_ctx->server_is_down) {
+            DBG_PRINTF("Client %d, server down at time %" PRIu64, k, config->simulated_time);
+            ret = -1;
+        }
+        else if (fuzi_q_ctx->nb_cnx_tried != clients[k].nb_cnx_required) {
+            DBG_PRINTF("Client %d tried %zu connections instead of %zu", k, fuzi_q_ctx->nb_cnx_tried, clients[k].nb_cnx_required);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && config->nb_clients_running != 0) {
+        DBG_PRINTF("%d clients still running at time %" PRIu64, config->nb_clients_running, config->simulated_time);
+        ret = -1;
+    }
+
+    /* Each server sees the connections of its clients. The clean clients
+     * complete their handshakes, so their connections all reach the server. */
+    for (int s = 0; ret == 0 && s < nb_servers; s++) {
+        size_t nb_cnx_min = 0;
+        size_t nb_cnx_max = 0;
+
+        for (int k = s; k < nb_clients; k += nb_servers) {
+            nb_cnx_max += clients[k].nb_cnx_required;
+            if (clients[k].fuzz_mode == fuzi_q_mode_clean) {
+                nb_cnx_min += clients[k].nb_cnx_required;
+            }
+        }
+        if (nb_cnx_min == 0) {
+            /* Fuzzed clients only, at least one connection reaches the server */
+            nb_cnx_min = 1;
+        }
+        ret = fuzi_q_test_check_icid_table(s, &config->nodes[s].fuzz_ctx, nb_cnx_min, nb_cnx_max);
+    }
+
+    if (config != NULL) {
+        fuzi_q_test_config_delete(config);
+    }
+
+    return ret;
+}
@@ -22,6 +22,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include <picoquic.h>
 #include <picoquic_internal.h>
 #include <picoquic_utils.h>
@@ -152,4 +153,1687 @@ int icid_table_test()
 
     fuzi_q_fuzzer_release(&ctx);
     return ret;
-}
\ No newline at end of file
+}
+/* Check that the per packet PRNG is deterministic, that the
+ * seed expansion matches the reference splitmix64 output,
+ * and that bounded draws stay in range and are roughly balanced.
+ */
+int fuzzer_prng_test()
+{
+    int ret = 0;
+    fuzzer_prng_t prng1;
+    fuzzer_prng_t prng2;
+    uint64_t range_list[] = { 0, 1, 2, 3, 5, 16, 41, 1000, 0x8000000000000001ull };
+    size_t nb_range_list = sizeof(range_list) / sizeof(uint64_t);
+    size_t bucket[5] = { 0 };
+
+    fuzzer_prng_seed(&prng1, 0);
+    if (prng1.s[0] != 0xe220a8397b1dcdafull) {
+        DBG_PRINTF("Unexpected seed expansion: 0x%llx", (unsigned long long)prng1.s[0]);
+        ret = -1;
+    }
+
+    fuzzer_prng_seed(&prng1, 0x123456789abcdefull);
+    fuzzer_prng_seed(&prng2, 0x123456789abcdefull);
+    for (int i = 0; ret == 0 && i < 1000; i++) {
+        if (fuzzer_prng_next(&prng1) != fuzzer_prng_next(&prng2)) {
+            DBG_PRINTF("Sequences diverge at rank %d", i);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        fuzzer_prng_seed(&prng2, 0x123456789abcdeeull);
+        if (fuzzer_prng_next(&prng1) == fuzzer_prng_next(&prng2)) {
+            DBG_PRINTF("%s", "Different seeds produce the same value");
+            ret = -1;
+        }
+    }
+
+    for (size_t i = 0; ret == 0 && i < nb_range_list; i++) {
+        for (int j = 0; j < 1000; j++) {
+            uint64_t x = fuzzer_prng_uniform(&prng1, range_list[i]);
+            if (x != 0 && x >= range_list[i]) {
+                DBG_PRINTF("Value 0x%llx out of range 0x%llx", (unsigned long long)x, (unsigned long long)range_list[i]);
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        for (int j = 0; j < 5000; j++) {
+            bucket[fuzzer_prng_uniform(&prng1, 5)]++;
+        }
+        for (int k = 0; k < 5; k++) {
+            if (bucket[k] < 800 || bucket[k] > 1200) {
+                DBG_PRINTF("Bucket %d has %zu values out of 5000", k, bucket[k]);
+                ret = -1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/* Check that the scheduler spreads connections evenly across the
+ * (state, wait bucket) cells, that it gives more attempts to cells
+ * that are hard to reach or starved, and that assignments are reproducible.
+ */
+static int fuzzer_scheduler_run(fuzzer_ctx_t* ctx, size_t nb_cnx, int closing_reachable, uint64_t* signature)
+{
+    fuzzer_icid_ctx_t icid_ctx;
+    uint64_t seed = 0x5eed5eed5eed5eedull;
+
+    *signature = 0;
+    for (size_t i = 0; i < nb_cnx; i++) {
+        memset(&icid_ctx, 0, sizeof(icid_ctx));
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        icid_ctx.random_context = seed;
+        fuzzer_schedule_target(ctx, &icid_ctx, fuzzer_cnx_state_initial);
+        if (icid_ctx.target_wait > ctx->wait_max[icid_ctx.target_state] ||
+            fuzzer_wait_bucket(icid_ctx.target_wait) != icid_ctx.target_bucket) {
+            DBG_PRINTF("Invalid wait %d, bucket %d for state %d", icid_ctx.target_wait, icid_ctx.target_bucket,
+                icid_ctx.target_state);
+            return -1;
+        }
+        if (closing_reachable || icid_ctx.target_state != fuzzer_cnx_state_closing) {
+            ctx->cell_fuzzed[icid_ctx.target_state][icid_ctx.target_bucket]++;
+        }
+        *signature = (*signature * 31) ^ ((uint64_t)icid_ctx.target_state << 32) ^ (uint64_t)icid_ctx.target_wait;
+    }
+    return 0;
+}
+
+static void fuzzer_scheduler_init(fuzzer_ctx_t* ctx)
+{
+    memset(ctx, 0, sizeof(fuzzer_ctx_t));
+    for (int i = 0; i < fuzzer_cnx_state_max; i++) {
+        ctx->wait_max[i] = 1;
+    }
+    ctx->wait_max[fuzzer_cnx_state_ready] = 40;
+}
+
+int fuzzer_scheduler_test()
+{
+    int ret = 0;
+    fuzzer_ctx_t ctx;
+    size_t nb_cells = 0;
+    size_t nb_cnx = 1300;
+    size_t expected;
+    size_t closing_assigned = 0;
+    uint64_t signature1 = 0;
+    uint64_t signature2 = 0;
+
+    /* All cells reachable: coverage should be uniform */
+    fuzzer_scheduler_init(&ctx);
+    ret = fuzzer_scheduler_run(&ctx, nb_cnx, 1, &signature1);
+    for (int i = 0; i < fuzzer_cnx_state_max; i++) {
+        nb_cells += (size_t)fuzzer_wait_bucket(ctx.wait_max[i]) + 1;
+    }
+    expected = nb_cnx / nb_cells;
+    for (int i = 0; ret == 0 && i < fuzzer_cnx_state_max; i++) {
+        for (int j = 0; j <= fuzzer_wait_bucket(ctx.wait_max[i]); j++) {
+            if (ctx.cell_fuzzed[i][j] < expected / 2 || ctx.cell_fuzzed[i][j] > expected + expected / 2) {
+                DBG_PRINTF("State %d bucket %d fuzzed %zu times, expected %zu", i, j, ctx.cell_fuzzed[i][j], expected);
+                ret = -1;
+            }
+        }
+    }
+
+    /* Same sequence of ICID, same assignments */
+    if (ret == 0) {
+        fuzzer_scheduler_init(&ctx);
+        ret = fuzzer_scheduler_run(&ctx, nb_cnx, 1, &signature2);
+        if (ret == 0 && signature1 != signature2) {
+            DBG_PRINTF("%s", "Scheduling is not reproducible");
+            ret = -1;
+        }
+    }
+
+    /* Closing never reached: more attempts, but bounded */
+    if (ret == 0) {
+        fuzzer_scheduler_init(&ctx);
+        ret = fuzzer_scheduler_run(&ctx, nb_cnx, 0, &signature2);
+        for (int j = 0; j < FUZZER_NB_WAIT_BUCKETS; j++) {
+            closing_assigned += ctx.cell_assigned[fuzzer_cnx_state_closing][j];
+        }
+        if (ret == 0 && (closing_assigned <= 2 * expected || closing_assigned > nb_cnx / 3)) {
+            DBG_PRINTF("Unreachable closing state assigned %zu times out of %zu", closing_assigned, nb_cnx);
+            ret = -1;
+        }
+    }
+
+    /* A starved cell is picked whenever it is among the candidates, much more
+     * often than its share of the cells */
+    for (int k = 0; ret == 0 && k < 2; k++) {
+        fuzzer_cnx_state_enum starved_state = (k == 0) ? fuzzer_cnx_state_closing : fuzzer_cnx_state_ready;
+        int starved_bucket = (k == 0) ? 1 : 3;
+        size_t nb_starved_cnx = 200;
+        size_t share;
+
+        fuzzer_scheduler_init(&ctx);
+        for (int i = 0; i < fuzzer_cnx_state_max; i++) {
+            for (int j = 0; j <= fuzzer_wait_bucket(ctx.wait_max[i]); j++) {
+                ctx.cell_fuzzed[i][j] = nb_starved_cnx;
+            }
+        }
+        ctx.cell_fuzzed[starved_state][starved_bucket] = 0;
+        share = nb_starved_cnx / (size_t)(fuzzer_cnx_state_max * (fuzzer_wait_bucket(ctx.wait_max[starved_state]) + 1));
+        ret = fuzzer_scheduler_run(&ctx, nb_starved_cnx, 1, &signature2);
+        if (ret == 0 && ctx.cell_assigned[starved_state][starved_bucket] <= 2 * share) {
+            DBG_PRINTF("Starved cell %d/%d assigned %zu times out of %zu", starved_state, starved_bucket,
+                ctx.cell_assigned[starved_state][starved_bucket], nb_starved_cnx);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Save two profiles in the same file, reload them in fresh contexts,
+ * and verify that the values are restored and the packet counts accumulated.
+ */
+int fuzzer_profile_test()
+{
+    int ret = 0;
+    char const* profile_file = "fuzi_q_profile_test.txt";
+    char key1[FUZI_Q_PROFILE_KEY_MAX];
+    char key2[FUZI_Q_PROFILE_KEY_MAX];
+    fuzzer_ctx_t ctx1;
+    fuzzer_ctx_t ctx2;
+    fuzzer_ctx_t ctx3;
+
+    fuzi_q_fuzzer_init(&ctx1, NULL, NULL);
+    fuzi_q_fuzzer_init(&ctx2, NULL, NULL);
+    for (int i = 0; i < fuzzer_cnx_state_max; i++) {
+        ctx1.wait_max[i] = 10 + i;
+        ctx1.waited_max[i] = 5 + i;
+        ctx1.nb_packets_state[i] = 1000 + i;
+        ctx1.nb_packets_fuzzed[i] = 100 + i;
+        ctx2.wait_max[i] = 20 + i;
+    }
+
+    (void)remove(profile_file);
+    if (fuzi_q_profile_key(key1, sizeof(key1), "test.example.com", 4443, "h3") != 0 ||
+        fuzi_q_profile_key(key2, sizeof(key2), "test.example.com", 4443, NULL) != 0 ||
+        strcmp(key1, "test.example.com:4443/h3") != 0) {
+        DBG_PRINTF("%s", "Cannot format the profile keys");
+        ret = -1;
+    }
+    else if (fuzi_q_profile_save(&ctx1, profile_file, key1) != 0 ||
+        fuzi_q_profile_save(&ctx2, profile_file, key2) != 0 ||
+        fuzi_q_profile_save(&ctx1, profile_file, key1) != 0) {
+        DBG_PRINTF("%s", "Cannot save the profiles");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        fuzi_q_fuzzer_init(&ctx3, NULL, NULL);
+        if (fuzi_q_profile_load(&ctx3, profile_file, key1) != 0) {
+            DBG_PRINTF("%s", "Cannot load the first profile");
+            ret = -1;
+        }
+        for (int i = 0; ret == 0 && i < fuzzer_cnx_state_max; i++) {
+            if (ctx3.wait_max[i] != ctx1.wait_max[i] || ctx3.waited_max[i] != ctx1.waited_max[i] ||
+                ctx3.profile_packets_state[i] != ctx1.nb_packets_state[i] ||
+                ctx3.profile_packets_fuzzed[i] != ctx1.nb_packets_fuzzed[i]) {
+                DBG_PRINTF("Profile mismatch for state %d", i);
+                ret = -1;
+            }
+        }
+        fuzi_q_fuzzer_release(&ctx3);
+    }
+
+    if (ret == 0) {
+        fuzi_q_fuzzer_init(&ctx3, NULL, NULL);
+        if (fuzi_q_profile_load(&ctx3, profile_file, key2) != 0 ||
+            ctx3.wait_max[fuzzer_cnx_state_ready] != ctx2.wait_max[fuzzer_cnx_state_ready]) {
+            DBG_PRINTF("%s", "Second profile not preserved");
+            ret = -1;
+        }
+        else if (fuzi_q_profile_load(&ctx3, profile_file, "unknown:443/h3") == 0) {
+            DBG_PRINTF("%s", "Loaded a profile that was never saved");
+            ret = -1;
+        }
+        fuzi_q_fuzzer_release(&ctx3);
+    }
+
+    fuzi_q_fuzzer_release(&ctx1);
+    fuzi_q_fuzzer_release(&ctx2);
+    (void)remove(profile_file);
+
+    return ret;
+}
+
+/* Check that each trial hosted by a connection gets its own
+ * reproducible random context, and a target in the ready or closing state.
+ */
+int fuzzer_trial_test()
+{
+    int ret = 0;
+    uint64_t current_time = 1000;
+    uint64_t seeds[4];
+    fuzzer_ctx_t ctx = { 0 };
+    fuzzer_icid_ctx_t* icid_ctx;
+
+    fuzi_q_fuzzer_init(&ctx, NULL, NULL);
+
+    icid_ctx = fuzzer_get_icid_ctx(&ctx, &test_icid[0], current_time);
+    if (icid_ctx == NULL) {
+        ret = -1;
+    }
+    else {
+        seeds[0] = icid_ctx->random_context;
+        icid_ctx->already_fuzzed = 1;
+    }
+
+    for (uint64_t trial = 1; ret == 0 && trial < 4; trial++) {
+        icid_ctx = fuzzer_start_trial(&ctx, &test_icid[0], trial, current_time);
+        if (icid_ctx == NULL) {
+            DBG_PRINTF("Cannot start trial %d", (int)trial);
+            ret = -1;
+        }
+        else if (icid_ctx->trial_rank != trial || icid_ctx->already_fuzzed ||
+            icid_ctx->target_state < fuzzer_cnx_state_ready) {
+            DBG_PRINTF("Bad trial %d context, state %d", (int)trial, icid_ctx->target_state);
+            ret = -1;
+        }
+        else {
+            seeds[trial] = icid_ctx->random_context;
+            for (uint64_t i = 0; i < trial; i++) {
+                if (seeds[i] == seeds[trial]) {
+                    DBG_PRINTF("Trial %d reuses the seed of trial %d", (int)trial, (int)i);
+                    ret = -1;
+                }
+            }
+            icid_ctx->already_fuzzed = 1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Replaying a trial produces the same random context */
+        icid_ctx = fuzzer_start_trial(&ctx, &test_icid[0], 2, current_time);
+        if (icid_ctx == NULL || icid_ctx->random_context != seeds[2] || ctx.icid_tree.size != 1) {
+            DBG_PRINTF("%s", "Trial replay does not match");
+            ret = -1;
+        }
+    }
+
+    fuzi_q_fuzzer_release(&ctx);
+    return ret;
+}
+
+/* Check that the connection rate controller grows the pool while the
+ * server keeps up, shrinks it and slows down connection starts when
+ * unfuzzed connections are abandoned or the RTT grows, and ignores the
+ * failures of fuzzed connections.
+ */
+static void fuzzer_rate_epoch(fuzi_q_rate_ctl_t* rate_ctl, int was_fuzzed, size_t nb_abandoned, uint64_t rtt)
+{
+    size_t nb_closed = rate_ctl->pool_size;
+
+    for (size_t i = 0; i < nb_closed; i++) {
+        int abandoned = (i < nb_abandoned);
+        fuzi_q_rate_on_close(rate_ctl, was_fuzzed, !abandoned, abandoned, rtt);
+    }
+}
+
+int fuzzer_rate_test()
+{
+    int ret = 0;
+    uint64_t current_time = 1000000;
+    fuzi_q_rate_ctl_t rate_ctl;
+
+    /* A zeroed controller does not limit anything */
+    memset(&rate_ctl, 0, sizeof(rate_ctl));
+    if (!fuzi_q_rate_can_start(&rate_ctl, 1000, 0)) {
+        DBG_PRINTF("%s", "Disabled controller blocks connections");
+        ret = -1;
+    }
+
+    fuzi_q_rate_init(&rate_ctl, 16, current_time);
+    if (ret == 0 && (!fuzi_q_rate_can_start(&rate_ctl, 7, current_time) ||
+        fuzi_q_rate_can_start(&rate_ctl, 8, current_time))) {
+        DBG_PRINTF("%s", "Initial pool size not enforced");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        /* Healthy epochs grow the pool up to its maximum */
+        for (int i = 0; i < 12; i++) {
+            fuzzer_rate_epoch(&rate_ctl, 0, 0, 20000);
+        }
+        if (rate_ctl.pool_size != 16 || rate_ctl.start_interval != 0) {
+            DBG_PRINTF("Healthy pool at %zu", rate_ctl.pool_size);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Fuzzed connections abandoned: no decrease */
+        fuzzer_rate_epoch(&rate_ctl, 1, 16, 20000);
+        fuzzer_rate_epoch(&rate_ctl, 1, 8, 20000);
+        if (rate_ctl.pool_size != 16 || rate_ctl.nb_decrease != 0 || rate_ctl.nb_fuzzed_abandoned != 24) {
+            DBG_PRINTF("After fuzzed abandons, pool %zu, %zu decreases", rate_ctl.pool_size, rate_ctl.nb_decrease);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Half the connections abandoned: multiplicative decrease */
+        fuzzer_rate_epoch(&rate_ctl, 0, 8, 20000);
+        fuzzer_rate_epoch(&rate_ctl, 0, 4, 20000);
+        if (rate_ctl.pool_size != 4 || rate_ctl.start_interval != 2 * FUZI_Q_RATE_INTERVAL_MIN) {
+            DBG_PRINTF("After abandons, pool %zu, interval %llu", rate_ctl.pool_size,
+                (unsigned long long)rate_ctl.start_interval);
+            ret = -1;
+        }
+        else {
+            fuzi_q_rate_on_start(&rate_ctl, current_time);
+            if (fuzi_q_rate_can_start(&rate_ctl, 0, current_time + FUZI_Q_RATE_INTERVAL_MIN) ||
+                !fuzi_q_rate_can_start(&rate_ctl, 0, current_time + 2 * FUZI_Q_RATE_INTERVAL_MIN)) {
+                DBG_PRINTF("%s", "Start interval not enforced");
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        /* RTT inflation is also a sign of overload */
+        fuzzer_rate_epoch(&rate_ctl, 0, 0, 100000);
+        if (rate_ctl.pool_size != 2) {
+            DBG_PRINTF("After RTT increase, pool %zu", rate_ctl.pool_size);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* Additive increase back to the bound, never above */
+        for (int i = 0; i < 40; i++) {
+            fuzzer_rate_epoch(&rate_ctl, 0, 0, 20000);
+        }
+        if (rate_ctl.pool_size != 16 || rate_ctl.start_interval != 0) {
+            DBG_PRINTF("After recovery, pool %zu, interval %llu", rate_ctl.pool_size,
+                (unsigned long long)rate_ctl.start_interval);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Check that the packet loop wakes up at the next fuzi_q event: a paced
+ * connection start, a probe timeout, or immediately if the event is past.
+ */
+int fuzi_q_wake_up_test()
+{
+    int ret = 0;
+    uint64_t current_time = 1000000;
+    fuzi_q_ctx_t* fuzi_q_ctx = (fuzi_q_ctx_t*)malloc(sizeof(fuzi_q_ctx_t));
+    picoquic_cnx_t* probe_cnx = (picoquic_cnx_t*)malloc(sizeof(picoquic_cnx_t));
+    picoquic_path_t* probe_path = (picoquic_path_t*)malloc(sizeof(picoquic_path_t));
+    packet_loop_time_check_arg_t time_check;
+
+    if (fuzi_q_ctx == NULL || probe_cnx == NULL || probe_path == NULL) {
+        ret = -1;
+    }
+    else {
+        memset(fuzi_q_ctx, 0, sizeof(fuzi_q_ctx_t));
+        fuzi_q_ctx->fuzz_mode = fuzi_q_mode_client;
+        fuzi_q_ctx->end_of_time = UINT64_MAX;
+        fuzi_q_ctx->next_success_time = current_time + 60000000;
+        fuzi_q_ctx->nb_cnx_required = 16;
+        fuzi_q_ctx->rate_ctl.start_interval = 2000;
+        fuzi_q_ctx->rate_ctl.next_start_time = current_time + 2000;
+
+        time_check.current_time = current_time;
+        time_check.delta_t = 1000000;
+        fuzi_q_check_time(fuzi_q_ctx, &time_check);
+        if (time_check.delta_t != 2000) {
+            DBG_PRINTF("Paced start, wake up after %lld instead of 2000", (long long)time_check.delta_t);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The probe times out before the next paced start */
+        memset(probe_cnx, 0, sizeof(picoquic_cnx_t));
+        memset(probe_path, 0, sizeof(picoquic_path_t));
+        probe_cnx->path = &probe_path;
+        probe_cnx->latest_receive_time = current_time - 5000;
+        fuzi_q_ctx->probe_ctx.cnx_client = probe_cnx;
+        fuzi_q_ctx->probe_ctx.success_observed = 1;
+        fuzi_q_ctx->probe_interval = 20000;
+        fuzi_q_ctx->rate_ctl.next_start_time = current_time + 100000;
+
+        time_check.current_time = current_time;
+        time_check.delta_t = 1000000;
+        fuzi_q_check_time(fuzi_q_ctx, &time_check);
+        if (time_check.delta_t != 20000 + 3 * FUZI_Q_PROBE_RTT_MIN - 5000) {
+            DBG_PRINTF("Probe timeout, wake up after %lld", (long long)time_check.delta_t);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* A deadline already passed wakes up the loop at once */
+        probe_cnx->latest_receive_time = current_time - 1000000;
+        time_check.current_time = current_time;
+        time_check.delta_t = 1000000;
+        fuzi_q_check_time(fuzi_q_ctx, &time_check);
+        if (time_check.delta_t != 0) {
+            DBG_PRINTF("Past probe deadline, wake up after %lld", (long long)time_check.delta_t);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* The QUIC wake up time is kept if it comes first */
+        time_check.current_time = current_time - 1000000;
+        time_check.delta_t = 100;
+        fuzi_q_check_time(fuzi_q_ctx, &time_check);
+        if (time_check.delta_t != 100) {
+            DBG_PRINTF("Earlier QUIC event, wake up after %lld", (long long)time_check.delta_t);
+            ret = -1;
+        }
+    }
+
+    if (fuzi_q_ctx != NULL) {
+        free(fuzi_q_ctx);
+    }
+    if (probe_cnx != NULL) {
+        free(probe_cnx);
+    }
+    if (probe_path != NULL) {
+        free(probe_path);
+    }
+
+    return ret;
+}
+
+/* Check that the fuzz log merges consecutive packets of the same trial,
+ * wraps around, and lists the connections fuzzed after a given time.
+ */
+int fuzzer_log_test()
+{
+    int ret = 0;
+    fuzzer_ctx_t ctx;
+    fuzzer_icid_ctx_t icid_ctx;
+    uint64_t current_time = 0;
+    char const* log_file = "fuzi_q_log_test.txt";
+    FILE* F;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&icid_ctx, 0, sizeof(icid_ctx));
+
+    /* Three packets of the same trial make a single entry */
+    icid_ctx.icid = test_icid[3];
+    for (int i = 0; i < 3; i++) {
+        current_time += 1000;
+        fuzzer_log_fuzzed(&ctx, &icid_ctx, fuzzer_cnx_state_ready, current_time);
+    }
+    if (ctx.fuzz_log_nb != 1 || ctx.fuzz_log[0].nb_packets != 3 || ctx.fuzz_log[0].first_time != 1000 ||
+        ctx.fuzz_log[0].last_time != 3000) {
+        DBG_PRINTF("%s", "Consecutive packets not merged");
+        ret = -1;
+    }
+
+    /* Alternating trials fill the ring and wrap around */
+    for (size_t i = 0; ret == 0 && i < 2 * FUZZER_LOG_SIZE; i++) {
+        current_time += 1000;
+        icid_ctx.icid = test_icid[4 + (i % 2)];
+        icid_ctx.trial_rank = i / 2;
+        fuzzer_log_fuzzed(&ctx, &icid_ctx, fuzzer_cnx_state_initial, current_time);
+    }
+    if (ret == 0 && ctx.fuzz_log_nb != 2 * FUZZER_LOG_SIZE + 1) {
+        DBG_PRINTF("Unexpected number of log entries: %zu", ctx.fuzz_log_nb);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        if ((F = picoquic_file_open(log_file, "w")) == NULL) {
+            ret = -1;
+        }
+        else {
+            size_t nb_all = fuzzer_log_dump(&ctx, F, 0);
+            size_t nb_recent = fuzzer_log_dump(&ctx, F, current_time - 4500);
+
+            (void)picoquic_file_close(F);
+            if (nb_all != FUZZER_LOG_SIZE || nb_recent != 5) {
+                DBG_PRINTF("Dumped %zu entries, %zu recent", nb_all, nb_recent);
+                ret = -1;
+            }
+        }
+        (void)remove(log_file);
+    }
+
+    return ret;
+}
+
+/* Check that the event ring keeps the last events of a connection,
+ * that sampling only depends on the ICID, and that flushing writes
+ * the events once.
+ */
+int fuzzer_event_test()
+{
+    int ret = 0;
+    fuzzer_ctx_t ctx;
+    fuzzer_icid_ctx_t icid_ctx;
+    char const* event_file = "02020202020202.fuzi.qlog";
+    size_t nb_sampled = 0;
+    FILE* F;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&icid_ctx, 0, sizeof(icid_ctx));
+    icid_ctx.icid = test_icid[7];
+
+    for (size_t i = 0; i < FUZZER_EVENT_RING_SIZE + 5; i++) {
+        icid_ctx.packet_rank = i + 1;
+        fuzzer_event_record(&icid_ctx, 1000 * (i + 1), fuzzer_cnx_state_ready, 0x40, 1200, 1200, (i % 7) == 0);
+    }
+    if (icid_ctx.events == NULL || icid_ctx.nb_events != FUZZER_EVENT_RING_SIZE + 5 ||
+        icid_ctx.events[4].packet_rank != FUZZER_EVENT_RING_SIZE + 5 ||
+        icid_ctx.events[5].packet_rank != 6) {
+        DBG_PRINTF("%s", "Event ring did not wrap around");
+        ret = -1;
+    }
+
+    /* Sampling is off by default, then selects some of the ICID */
+    if (ret == 0 && fuzzer_event_is_sampled(&ctx, &icid_ctx)) {
+        DBG_PRINTF("%s", "Sampled with event_sample = 0");
+        ret = -1;
+    }
+    ctx.event_sample = 1;
+    if (ret == 0 && !fuzzer_event_is_sampled(&ctx, &icid_ctx)) {
+        DBG_PRINTF("%s", "Not sampled with event_sample = 1");
+        ret = -1;
+    }
+    ctx.event_sample = 4;
+    for (size_t i = 0; ret == 0 && i < nb_test_icid; i++) {
+        fuzzer_icid_ctx_t other_ctx;
+
+        memset(&other_ctx, 0, sizeof(other_ctx));
+        other_ctx.icid = test_icid[i];
+        nb_sampled += fuzzer_event_is_sampled(&ctx, &other_ctx);
+    }
+    if (ret == 0 && (nb_sampled == 0 || nb_sampled == nb_test_icid)) {
+        DBG_PRINTF("%zu ICID sampled with event_sample = 4", nb_sampled);
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        if (fuzzer_event_flush(&ctx, &icid_ctx, "test", 1) != 0 || ctx.nb_event_files != 1 ||
+            icid_ctx.nb_events != 0 || (F = picoquic_file_open(event_file, "r")) == NULL) {
+            DBG_PRINTF("%s", "Event flush failed");
+            ret = -1;
+        }
+        else {
+            (void)picoquic_file_close(F);
+            /* A second flush has nothing to write */
+            if (fuzzer_event_flush(&ctx, &icid_ctx, "test", 1) != 0 || ctx.nb_event_files != 1) {
+                DBG_PRINTF("%s", "Events written twice");
+                ret = -1;
+            }
+        }
+        (void)remove(event_file);
+    }
+
+    fuzzer_event_release(&icid_ctx);
+    if (ret == 0 && icid_ctx.events != NULL) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Check that capture rings come from a fixed pool, keep the last packets
+ * of the connection, and are written as a pcapng file.
+ */
+int fuzzer_capture_test()
+{
+    int ret = 0;
+    fuzzer_ctx_t ctx;
+    fuzzer_icid_ctx_t icid_ctx[3];
+    char const* capture_file = "02020202020202.fuzi.pcapng";
+    uint8_t packet[64];
+    FILE* F;
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(icid_ctx, 0, sizeof(icid_ctx));
+
+    if (fuzzer_capture_init(&ctx, 2) != 0) {
+        ret = -1;
+    }
+    for (int i = 0; ret == 0 && i < 3; i++) {
+        icid_ctx[i].icid = test_icid[7 + i];
+        fuzzer_capture_attach(&ctx, &icid_ctx[i]);
+    }
+    if (ret == 0 && (icid_ctx[0].capture == NULL || icid_ctx[1].capture == NULL || icid_ctx[2].capture != NULL)) {
+        DBG_PRINTF("%s", "Capture pool not used as expected");
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < FUZZER_CAPTURE_RING_SIZE + 3; i++) {
+        fuzzer_capture_packet_t* captured;
+
+        memset(packet, (int)i, sizeof(packet));
+        icid_ctx[0].packet_rank = i;
+        captured = fuzzer_capture_original(&icid_ctx[0], 1000 * (i + 1), packet, sizeof(packet));
+        packet[0] ^= 0xff;
+        fuzzer_capture_fuzzed(captured, packet, sizeof(packet) - 1, (i % 2) == 0);
+    }
+    if (ret == 0) {
+        fuzzer_capture_packet_t* oldest = &icid_ctx[0].capture->packets[3];
+
+        if (icid_ctx[0].capture->nb_packets != FUZZER_CAPTURE_RING_SIZE + 3 || oldest->packet_rank != 3 ||
+            oldest->original[0] != 3 || oldest->fuzzed_length != 0 ||
+            icid_ctx[0].capture->packets[4].fuzzed_length != sizeof(packet) - 1 ||
+            icid_ctx[0].capture->packets[4].fuzzed[0] != (4 ^ 0xff)) {
+            DBG_PRINTF("%s", "Capture ring not as expected");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        if (fuzzer_capture_write(&ctx, &icid_ctx[0], "test") != 0 || ctx.nb_capture_files != 1 ||
+            (F = picoquic_file_open(capture_file, "rb")) == NULL) {
+            DBG_PRINTF("%s", "Capture write failed");
+            ret = -1;
+        }
+        else {
+            uint32_t header[3];
+
+            if (fread(header, sizeof(uint32_t), 3, F) != 3 || header[0] != 0x0A0D0D0A || header[2] != 0x1A2B3C4D) {
+                DBG_PRINTF("%s", "Not a pcapng file");
+                ret = -1;
+            }
+            (void)picoquic_file_close(F);
+        }
+        (void)remove(capture_file);
+    }
+
+    /* Detached rings return to the pool */
+    if (ret == 0) {
+        fuzzer_capture_detach(&ctx, &icid_ctx[0]);
+        fuzzer_capture_attach(&ctx, &icid_ctx[2]);
+        if (icid_ctx[0].capture != NULL || icid_ctx[2].capture == NULL || icid_ctx[2].capture->nb_packets != 0) {
+            DBG_PRINTF("%s", "Capture ring not recycled");
+            ret = -1;
+        }
+    }
+    fuzzer_capture_release(&ctx);
+
+    return ret;
+}
+
+/* Check that the connection memory records the state carried by the
+ * frames sent, keeps the most recently used streams, and proposes values
+ * close to it.
+ */
+int fuzzer_memory_test()
+{
+    int ret = 0;
+    fuzzer_cnx_memory_t memory;
+    fuzzer_prng_t prng;
+    fuzzer_memory_stream_t stream;
+    uint64_t value = 0;
+    uint8_t packet[] = {
+        picoquic_frame_type_max_data, 0x44, 0x00,
+        0x0e, 0x04, 0x40, 0x64, 0x03, 'a', 'b', 'c', /* Stream 4, offset 100, length 3 */
+        picoquic_frame_type_new_connection_id, 0x02, 0x01, 0x04, 1, 2, 3, 4,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+        picoquic_frame_type_new_token, 0x04, 0xde, 0xad, 0xbe, 0xef,
+        picoquic_frame_type_handshake_done
+    };
+
+    memset(&memory, 0, sizeof(memory));
+    fuzzer_prng_seed(&prng, 0xdeadbeef);
+
+    if (fuzzer_memory_get(&memory, fuzzer_memory_max_data, &value) ||
+        fuzzer_memory_pick_stream(&memory, &prng, &stream)) {
+        DBG_PRINTF("%s", "Empty memory reports values");
+        ret = -1;
+    }
+
+    fuzzer_memory_observe(&memory, packet, packet + sizeof(packet), 1);
+
+    if (ret == 0 && (!fuzzer_memory_get(&memory, fuzzer_memory_max_data, &value) || value != 0x400)) {
+        DBG_PRINTF("Max data: %llu", (unsigned long long)value);
+        ret = -1;
+    }
+    if (ret == 0 && (!fuzzer_memory_get(&memory, fuzzer_memory_cid_sequence, &value) || value != 2 ||
+        !fuzzer_memory_get(&memory, fuzzer_memory_retire_prior_to, &value) || value != 1)) {
+        DBG_PRINTF("%s", "Connection ID sequence not recorded");
+        ret = -1;
+    }
+    if (ret == 0 && (!fuzzer_memory_pick_stream(&memory, &prng, &stream) ||
+        stream.stream_id != 4 || stream.offset != 103)) {
+        DBG_PRINTF("%s", "Stream not recorded");
+        ret = -1;
+    }
+    if (ret == 0) {
+        /* Fill the stream table, refresh stream 4, then add one more stream:
+         * the least recently used stream 8 is evicted, not stream 4 */
+        for (uint8_t stream_id = 8; stream_id <= 36; stream_id += 4) {
+            uint8_t stream_frame[3] = { 0x0a, stream_id, 0 };
+            if (stream_id == 36) {
+                stream_frame[1] = 4;
+                fuzzer_memory_observe(&memory, stream_frame, stream_frame + sizeof(stream_frame), 1);
+                stream_frame[1] = stream_id;
+            }
+            fuzzer_memory_observe(&memory, stream_frame, stream_frame + sizeof(stream_frame), 1);
+        }
+        if (memory.nb_streams != 9 || memory.streams[FUZZER_MEMORY_NB_STREAMS - 2].stream_id != 4 ||
+            memory.streams[FUZZER_MEMORY_NB_STREAMS - 2].offset != 103 || memory.streams[0].stream_id != 12) {
+            DBG_PRINTF("%s", "Stream table not in least recently used order");
+            ret = -1;
+        }
+    }
+    if (ret == 0 && (memory.token_length != 4 || memory.token[0] != 0xde || memory.handshake_done_sent)) {
+        /* Handshake done is only meaningful when sent by the server */
+        DBG_PRINTF("%s", "Token or handshake done not as expected");
+        ret = -1;
+    }
+    for (int i = 0; ret == 0 && i < 64; i++) {
+        if (!fuzzer_memory_plausible(&memory, &prng, fuzzer_memory_max_data, &value) ||
+            value < 0x3FF || value > 0x401) {
+            DBG_PRINTF("Value not near max data: %llu", (unsigned long long)value);
+            ret = -1;
+        }
+    }
+    if (ret == 0 && (fuzzer_memory_near(&prng, 0) > 1 || fuzzer_memory_near(&prng, 0x3FFFFFFFFFFFFFFFull) < 0x3FFFFFFFFFFFFFFEull)) {
+        DBG_PRINTF("%s", "Near values outside the varint range");
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Check the varint mutations: encodings of fixed length, boundary values,
+ * in place rewrites and length changing rewrites.
+ */
+int fuzzer_varint_test()
+{
+    int ret = 0;
+    fuzzer_prng_t prng;
+    uint8_t field[8];
+    uint8_t packet[16] = { 0x10, 0x25, 0x01, 0x02, 0x03 };
+    uint64_t value = 0;
+
+    fuzzer_prng_seed(&prng, 0x12345678);
+
+    if (fuzzer_varint_length(63) != 1 || fuzzer_varint_length(64) != 2 || fuzzer_varint_length(0x3FFF) != 2 ||
+        fuzzer_varint_length(0x4000) != 4 || fuzzer_varint_length(0x40000000) != 8) {
+        DBG_PRINTF("%s", "Varint lengths not as expected");
+        ret = -1;
+    }
+    /* Non minimal encoding of 1 on 4 bytes, then value too large for 2 bytes */
+    if (ret == 0 && (!fuzzer_varint_encode(field, 4, 1) || field[0] != 0x80 || field[3] != 1 ||
+        fuzzer_varint_encode(field, 2, 0x4000) || fuzzer_varint_encode(field, 3, 1))) {
+        DBG_PRINTF("%s", "Fixed length encoding failed");
+        ret = -1;
+    }
+    for (int i = 0; ret == 0 && i < 64; i++) {
+        if (fuzzer_varint_boundary(&prng, 1) > 63 || fuzzer_varint_boundary(&prng, 2) > 0x3FFF ||
+            fuzzer_varint_boundary(&prng, 8) > FUZZER_VARINT_MAX) {
+            DBG_PRINTF("%s", "Boundary does not fit");
+            ret = -1;
+        }
+        else if ((value = fuzzer_varint_relative(&prng, 1000, 100)) != 999 && value != 1001 &&
+            value != 2000 && value != 500 && value != 99 && value != 100 && value != 101) {
+            DBG_PRINTF("Unexpected relative value: %llu", (unsigned long long)value);
+            ret = -1;
+        }
+    }
+    /* Values too large for the field are clamped, keeping the length */
+    if (ret == 0 && (!fuzzer_varint_overwrite(field, field + 2, FUZZER_VARINT_MAX) ||
+        picoquic_frames_varint_decode(field, field + 2, &value) != field + 2 || value != 0x3FFF)) {
+        DBG_PRINTF("%s", "Overwrite not clamped");
+        ret = -1;
+    }
+    /* Resize the first field of the MAX_DATA frame and check that the rest shifted */
+    for (int i = 0; ret == 0 && i < 16; i++) {
+        uint8_t resized[16];
+        size_t length;
+        const uint8_t* field_end;
+
+        memcpy(resized, packet, sizeof(packet));
+        length = fuzzer_varint_resize(&prng, resized, 5, sizeof(resized), 1);
+        field_end = picoquic_frames_varint_decode(resized + 1, resized + length, &value);
+        if (field_end == NULL || (size_t)(field_end - resized) != length - 3 || length == 5 ||
+            memcmp(field_end, packet + 2, 3) != 0) {
+            DBG_PRINTF("Resize failed, length %zu", length);
+            ret = -1;
+        }
+    }
+    if (ret == 0 && fuzzer_varint_resize(&prng, packet, 5, 5, 1) > 5) {
+        DBG_PRINTF("%s", "Resize overflowed the buffer");
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Check that frames are parsed against their schema, including optional,
+ * length prefixed and repeated fields, and that mutations stay within
+ * the frame.
+ */
+int fuzzer_schema_test()
+{
+    int ret = 0;
+    fuzzer_prng_t prng;
+    fuzzer_parsed_frame_t parsed;
+    /* ACK_ECN, largest 0x40, delay 3, 2 ranges, first range 1, then gap/range pairs, 3 ECN counts */
+    uint8_t ack[] = { 0x03, 0x40, 0x40, 0x03, 0x02, 0x01, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07 };
+    /* STREAM with offset and length, 2 data bytes */
+    uint8_t stream[] = { 0x0e, 0x04, 0x40, 0x64, 0x02, 'a', 'b' };
+    /* NEW_CONNECTION_ID with 4 bytes CID */
+    uint8_t new_cid[] = { 0x18, 0x02, 0x01, 0x04, 1, 2, 3, 4,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+    uint8_t buffer[sizeof(new_cid) + 8];
+
+    fuzzer_prng_seed(&prng, 0xabcdef);
+
+    if (fuzzer_schema_parse(ack, ack + sizeof(ack), &parsed) != 0 || parsed.nb_fields != 11 ||
+        parsed.fields[2].type != fuzzer_field_count || parsed.fields[0].value != 0x40 ||
+        parsed.fields[10].end != ack + sizeof(ack)) {
+        DBG_PRINTF("%s", "ACK not parsed as expected");
+        ret = -1;
+    }
+    else if (fuzzer_schema_parse(ack, ack + 10, &parsed) == 0 || parsed.nb_fields != 8) {
+        /* The same frame without ECN counts is too short for ACK_ECN */
+        DBG_PRINTF("%s", "Truncated ACK not detected");
+        ret = -1;
+    }
+    else if (fuzzer_schema_parse(stream, stream + sizeof(stream), &parsed) != 0 || parsed.nb_fields != 4 ||
+        parsed.fields[1].value != 100 || parsed.fields[3].start != stream + 5 || parsed.fields[3].value != 2) {
+        DBG_PRINTF("%s", "Stream frame not parsed as expected");
+        ret = -1;
+    }
+    else if ((stream[0] = 0x08, fuzzer_schema_parse(stream, stream + sizeof(stream), &parsed)) != 0 ||
+        parsed.nb_fields != 2 || parsed.fields[1].end != stream + sizeof(stream)) {
+        /* Without offset and length, the data extends to the end of the frame */
+        DBG_PRINTF("%s", "Stream frame without length not parsed as expected");
+        ret = -1;
+    }
+    else if (fuzzer_schema_parse(new_cid, new_cid + sizeof(new_cid), &parsed) != 0 || parsed.nb_fields != 5 ||
+        parsed.fields[3].end - parsed.fields[3].start != 4 || parsed.fields[4].type != fuzzer_field_fixed) {
+        DBG_PRINTF("%s", "New connection ID not parsed as expected");
+        ret = -1;
+    }
+    else if (fuzzer_schema_find(0x3f) != NULL || fuzzer_schema_parse(buffer, buffer, &parsed) == 0) {
+        DBG_PRINTF("%s", "Unknown frame type accepted");
+        ret = -1;
+    }
+
+    /* Mutations change the frame, and never write past its end */
+    for (int i = 0; ret == 0 && i < 256; i++) {
+        memcpy(buffer, new_cid, sizeof(new_cid));
+        memset(buffer + sizeof(new_cid), 0x5a, sizeof(buffer) - sizeof(new_cid));
+        if (fuzzer_schema_mutate(&prng, buffer, buffer + sizeof(new_cid)) != 1 ||
+            buffer[sizeof(new_cid)] != 0x5a || buffer[sizeof(buffer) - 1] != 0x5a) {
+            DBG_PRINTF("Mutation %d failed", i);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Check that application entries are classified by layer, and wrapped
+ * in STREAM frames on the stream and at the offset the application uses.
+ */
+int fuzzer_app_frame_test()
+{
+    int ret = 0;
+    fuzzer_prng_t prng;
+    fuzzer_cnx_memory_t memory;
+    uint8_t settings_val[] = { 0x04, 0x03, 0x06, 0x44, 0x00 };
+    uint8_t data_val[] = { 0x00, 0x01, 0x61 };
+    uint8_t hpack_val[] = { 0x82 };
+    uint8_t qpack_val[] = { 0x3f, 0xe1, 0x1f };
+    uint8_t ping_val[] = { 0x01 };
+    fuzi_q_frames_t settings = { "h3_settings_one", settings_val, sizeof(settings_val) };
+    fuzi_q_frames_t data = { "h3_data_payload", data_val, sizeof(data_val) };
+    fuzi_q_frames_t hpack = { "test_hpack_indexed", hpack_val, sizeof(hpack_val) };
+    fuzi_q_frames_t qpack = { "qpack_enc_set_dynamic_table_capacity", qpack_val, sizeof(qpack_val) };
+    fuzi_q_frames_t ping = { "ping", ping_val, sizeof(ping_val) };
+    uint8_t expected_settings[] = { 0x0e, 0x02, 0x01, 0x05, 0x04, 0x03, 0x06, 0x44, 0x00 };
+    uint8_t expected_hpack[] = { 0x0e, 0x04, 0x40, 0x64, 0x05, 0x01, 0x03, 0x00, 0x00, 0x82 };
+    uint8_t expected_qpack[] = { 0x0e, 0x06, 0x00, 0x04, 0x02, 0x3f, 0xe1, 0x1f };
+    uint8_t buffer[64];
+    size_t length;
+
+    fuzzer_prng_seed(&prng, 0x3a3a);
+    memset(&memory, 0, sizeof(memory));
+    /* Client with control stream 2 opened, and request stream 4 in progress */
+    memory.nb_streams = 2;
+    memory.streams[0].stream_id = 2;
+    memory.streams[0].offset = 1;
+    memory.streams[1].stream_id = 4;
+    memory.streams[1].offset = 100;
+
+    if (fuzi_q_frame_layer(&settings) != fuzi_q_layer_h3_control ||
+        fuzi_q_frame_layer(&data) != fuzi_q_layer_h3_request ||
+        fuzi_q_frame_layer(&hpack) != fuzi_q_layer_hpack ||
+        fuzi_q_frame_layer(&qpack) != fuzi_q_layer_qpack_encoder ||
+        fuzi_q_frame_layer(&ping) != fuzi_q_layer_quic) {
+        DBG_PRINTF("%s", "Entries not classified as expected");
+        ret = -1;
+    }
+    else if ((length = fuzzer_app_frame_wrap(&prng, &memory, 1, &settings, buffer, sizeof(buffer))) != sizeof(expected_settings) ||
+        memcmp(buffer, expected_settings, length) != 0) {
+        DBG_PRINTF("%s", "Settings not sent on the control stream");
+        ret = -1;
+    }
+    else if ((length = fuzzer_app_frame_wrap(&prng, &memory, 1, &qpack, buffer, sizeof(buffer))) != sizeof(expected_qpack) ||
+        memcmp(buffer, expected_qpack, length) != 0) {
+        DBG_PRINTF("%s", "QPACK instruction not sent on a new encoder stream");
+        ret = -1;
+    }
+    else if (fuzzer_app_frame_wrap(&prng, &memory, 1, &settings, buffer, 8) != 0) {
+        DBG_PRINTF("%s", "Wrapped entry larger than the buffer");
+        ret = -1;
+    }
+
+    /* Field sections go in a HEADERS frame, on the open request stream or on the next one */
+    for (int i = 0; ret == 0 && i < 16; i++) {
+        length = fuzzer_app_frame_wrap(&prng, &memory, 1, &hpack, buffer, sizeof(buffer));
+        if (length == sizeof(expected_hpack)) {
+            if (memcmp(buffer, expected_hpack, length) != 0) {
+                ret = -1;
+            }
+        }
+        else if (length != sizeof(expected_hpack) - 1 || buffer[1] != 0x08 || buffer[2] != 0x00 || buffer[4] != 0x01) {
+            ret = -1;
+        }
+        if (ret != 0) {
+            DBG_PRINTF("HPACK entry %d not wrapped as expected", i);
+        }
+    }
+
+    return ret;
+}
+
+/* Check that the HTTP/3 mutations modify the data of control, request
+ * and QPACK streams without writing past the end of the data.
+ */
+int fuzzer_h3_mutate_test()
+{
+    int ret = 0;
+    fuzzer_prng_t prng;
+    /* Control stream: stream type, SETTINGS with two settings, GOAWAY */
+    uint8_t control[] = { 0x00, 0x04, 0x05, 0x01, 0x40, 0x64, 0x07, 0x00, 0x07, 0x01, 0x04 };
+    /* Request stream: HEADERS with prefix and one indexed field line, then DATA */
+    uint8_t request[] = { 0x01, 0x03, 0x00, 0x00, 0xd1, 0x00, 0x02, 'o', 'k' };
+    /* Encoder stream: set capacity, insert with name reference */
+    uint8_t encoder[] = { 0x02, 0x3f, 0xe1, 0x1f, 0xc0, 0x02, 'a', 'b' };
+    struct {
+        uint64_t stream_id;
+        uint64_t offset;
+        uint8_t* data;
+        size_t length;
+    } cases[] = {
+        { 2, 0, control, sizeof(control) },
+        { 0, 0, request, sizeof(request) },
+        { 6, 0, encoder, sizeof(encoder) },
+        { 2, 1, control + 1, sizeof(control) - 1 },
+        { 6, 1, encoder + 1, sizeof(encoder) - 1 }
+    };
+    uint8_t buffer[32];
+
+    fuzzer_prng_seed(&prng, 0x4833);
+
+    if (fuzzer_h3_stream_mutate(&prng, 0, 0, buffer, buffer) != 0) {
+        DBG_PRINTF("%s", "Empty stream data mutated");
+        ret = -1;
+    }
+
+    for (size_t i = 0; ret == 0 && i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int nb_changed = 0;
+
+        for (int j = 0; ret == 0 && j < 64; j++) {
+            memcpy(buffer, cases[i].data, cases[i].length);
+            memset(buffer + cases[i].length, 0x5a, sizeof(buffer) - cases[i].length);
+            if (fuzzer_h3_stream_mutate(&prng, cases[i].stream_id, cases[i].offset, buffer, buffer + cases[i].length) != 0 &&
+                memcmp(buffer, cases[i].data, cases[i].length) != 0) {
+                nb_changed++;
+            }
+            for (size_t k = cases[i].length; k < sizeof(buffer); k++) {
+                if (buffer[k] != 0x5a) {
+                    DBG_PRINTF("Case %zu, mutation %d writes past the data", i, j);
+                    ret = -1;
+                    break;
+                }
+            }
+        }
+        if (ret == 0 && nb_changed < 32) {
+            DBG_PRINTF("Case %zu, only %d mutations out of 64", i, nb_changed);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Check the classification of the replies to the Initial blaster, and
+ * the mutation of the ClientHello frames.
+ */
+int fuzi_q_blaster_test()
+{
+    int ret = 0;
+    fuzzer_prng_t prng;
+    picoquic_connection_id_t dcid;
+    uint8_t initial_v1[] = { 0xc0, 0x00, 0x00, 0x00, 0x01, 0x04, 1, 2, 3, 4, 0x00 };
+    uint8_t retry_v2[] = { 0xc0, 0x6b, 0x33, 0x43, 0xcf, 0x04, 1, 2, 3, 4, 0x00 };
+    uint8_t vn[] = { 0x80, 0x00, 0x00, 0x00, 0x00, 0x04, 1, 2, 3, 4, 0x00 };
+    uint8_t short_header[] = { 0x40, 1, 2, 3, 4, 5, 6, 7, 8, 0x00 };
+    uint8_t truncated[] = { 0xc0, 0x00, 0x00, 0x00, 0x01, 0x08, 1, 2 };
+    /* CRYPTO frame at offset 0 with 4 bytes of data, then padding */
+    uint8_t chello[] = { 0x06, 0x00, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    uint8_t frames[sizeof(chello) + 4];
+    int nb_intact = 0;
+
+    if (fuzi_q_blaster_classify(initial_v1, sizeof(initial_v1), 8, &dcid) != fuzi_q_reply_initial ||
+        dcid.id_len != 4 || dcid.id[3] != 4) {
+        DBG_PRINTF("%s", "Initial reply not classified");
+        ret = -1;
+    }
+    else if (fuzi_q_blaster_classify(retry_v2, sizeof(retry_v2), 8, &dcid) != fuzi_q_reply_retry) {
+        DBG_PRINTF("%s", "QUIC v2 Retry not classified");
+        ret = -1;
+    }
+    else if (fuzi_q_blaster_classify(vn, sizeof(vn), 8, &dcid) != fuzi_q_reply_version_negotiation) {
+        DBG_PRINTF("%s", "Version negotiation not classified");
+        ret = -1;
+    }
+    else if (fuzi_q_blaster_classify(short_header, sizeof(short_header), 8, &dcid) != fuzi_q_reply_short_header ||
+        dcid.id_len != 8 || dcid.id[7] != 8) {
+        DBG_PRINTF("%s", "Short header reply not classified");
+        ret = -1;
+    }
+    else if (fuzi_q_blaster_classify(truncated, sizeof(truncated), 8, &dcid) != fuzi_q_reply_other) {
+        DBG_PRINTF("%s", "Truncated reply accepted");
+        ret = -1;
+    }
+
+    /* Mutations stay within the frames, and some Initials are sent intact */
+    fuzzer_prng_seed(&prng, 0xb1a57);
+    for (int i = 0; ret == 0 && i < 64; i++) {
+        memcpy(frames, chello, sizeof(chello));
+        memset(frames + sizeof(chello), 0x5a, sizeof(frames) - sizeof(chello));
+        if (fuzi_q_blaster_mutate(&prng, frames, sizeof(chello)) == 0) {
+            nb_intact++;
+            if (memcmp(frames, chello, sizeof(chello)) != 0) {
+                ret = -1;
+            }
+        }
+        for (size_t j = sizeof(chello); j < sizeof(frames); j++) {
+            if (frames[j] != 0x5a) {
+                ret = -1;
+            }
+        }
+        if (ret != 0) {
+            DBG_PRINTF("Mutation %d not as expected", i);
+        }
+    }
+    if (ret == 0 && (nb_intact == 0 || nb_intact > 32)) {
+        DBG_PRINTF("%d intact Initials out of 64", nb_intact);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Check that the TLS mutations produce messages with consistent lengths,
+ * keep the data that follows the message, and stay within the buffer.
+ */
+int fuzzer_tls_mutate_test()
+{
+    int ret = 0;
+    fuzzer_prng_t prng;
+    uint8_t chello[128];
+    uint8_t extensions[] = {
+        0x00, 0x10, 0x00, 0x05, 0x00, 0x03, 0x02, 'h', '3', /* ALPN */
+        0x00, 0x33, 0x00, 0x0a, 0x00, 0x08, 0x00, 0x1d, 0x00, 0x04, 1, 2, 3, 4, /* key_share */
+        0x00, 0x39, 0x00, 0x0b, 0x01, 0x02, 0x40, 0x64, 0x04, 0x02, 0x44, 0x00, 0x0e, 0x01, 0x04 /* transport parameters */
+    };
+    uint8_t tail[] = { 0x0f, 0x00 };
+    uint8_t finished[] = { 0x14, 0x00, 0x00, 0x02, 0xaa, 0xbb };
+    uint8_t buffer[512];
+    size_t extensions_offset = 4 + 2 + 32 + 1 + 4 + 2;
+    size_t length = 0;
+    size_t data_max = 256;
+    int nb_changed = 0;
+
+    /* ClientHello: version, random, no session ID, one cipher suite, null compression */
+    memset(chello, 0, sizeof(chello));
+    chello[0] = 1;
+    chello[4] = 3;
+    chello[5] = 3;
+    chello[4 + 2 + 32 + 1 + 1] = 2;
+    chello[4 + 2 + 32 + 1 + 2] = 0x13;
+    chello[4 + 2 + 32 + 1 + 3] = 1;
+    chello[4 + 2 + 32 + 1 + 4] = 1;
+    chello[extensions_offset + 1] = (uint8_t)sizeof(extensions);
+    memcpy(chello + extensions_offset + 2, extensions, sizeof(extensions));
+    length = extensions_offset + 2 + sizeof(extensions);
+    chello[3] = (uint8_t)(length - 4);
+    memcpy(chello + length, tail, sizeof(tail));
+    length += sizeof(tail);
+
+    fuzzer_prng_seed(&prng, 0x7153);
+
+    memcpy(buffer, finished, sizeof(finished));
+    if (fuzzer_tls_mutate(&prng, buffer, sizeof(finished), data_max) != 0) {
+        DBG_PRINTF("%s", "Unsupported message mutated");
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < 256; i++) {
+        size_t new_length;
+
+        memcpy(buffer, chello, length);
+        memset(buffer + length, 0x5a, sizeof(buffer) - length);
+        new_length = fuzzer_tls_mutate(&prng, buffer, length, data_max);
+        if (new_length == 0) {
+            continue;
+        }
+        nb_changed++;
+        if (new_length > data_max || new_length < extensions_offset + 2 + sizeof(tail)) {
+            DBG_PRINTF("Mutation %d, unexpected length %zu", i, new_length);
+            ret = -1;
+        }
+        else if ((((size_t)buffer[1] << 16) | ((size_t)buffer[2] << 8) | buffer[3]) != new_length - 4 - sizeof(tail) ||
+            (((size_t)buffer[extensions_offset] << 8) | buffer[extensions_offset + 1]) !=
+            new_length - extensions_offset - 2 - sizeof(tail)) {
+            DBG_PRINTF("Mutation %d, inconsistent message lengths", i);
+            ret = -1;
+        }
+        else if (memcmp(buffer + new_length - sizeof(tail), tail, sizeof(tail)) != 0) {
+            DBG_PRINTF("Mutation %d, data after the message not preserved", i);
+            ret = -1;
+        }
+        for (size_t k = data_max; ret == 0 && k < sizeof(buffer); k++) {
+            if (buffer[k] != 0x5a) {
+                DBG_PRINTF("Mutation %d writes past the data", i);
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0 && nb_changed < 192) {
+        DBG_PRINTF("Only %d mutations out of 256", nb_changed);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Check the stateless responses: only client Initials are answered, the
+ * responses are VN or Retry packets, and the same DCID gets the same response.
+ */
+int fuzi_q_stateless_test()
+{
+    int ret = 0;
+    fuzi_q_stateless_t stateless;
+    uint8_t initial[PICOQUIC_ENFORCED_INITIAL_MTU];
+    uint8_t response[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t previous[PICOQUIC_MAX_PACKET_SIZE];
+    uint8_t short_header[32];
+    size_t previous_length = 0;
+    uint64_t nb_vn = 0;
+    uint64_t nb_retry = 0;
+
+    memset(&stateless, 0, sizeof(stateless));
+    memset(initial, 0, sizeof(initial));
+    memset(short_header, 0x41, sizeof(short_header));
+    /* Initial, version 1, 8 bytes DCID, 5 bytes SCID, no token */
+    initial[0] = 0xc3;
+    initial[4] = 1;
+    initial[5] = 8;
+    initial[14] = 5;
+
+    if (fuzi_q_stateless_response(&stateless, initial, sizeof(initial), response, sizeof(response)) != 0) {
+        DBG_PRINTF("%s", "Initial answered with stateless responses disabled");
+        ret = -1;
+    }
+    stateless.ratio = 1;
+    if (ret == 0 && fuzi_q_stateless_response(&stateless, short_header, sizeof(short_header), response, sizeof(response)) != 0) {
+        DBG_PRINTF("%s", "Short header packet answered");
+        ret = -1;
+    }
+
+    for (int i = 0; ret == 0 && i < 64; i++) {
+        size_t length;
+
+        initial[6] = (uint8_t)i;
+        length = fuzi_q_stateless_response(&stateless, initial, sizeof(initial), response, sizeof(response));
+        if (length < 7 || length > sizeof(response) || (response[0] & 0x80) == 0) {
+            DBG_PRINTF("Initial %d, unexpected response length %zu", i, length);
+            ret = -1;
+        }
+        else if (PICOPARSE_32(response + 1) == 0) {
+            nb_vn++;
+        }
+        else if (PICOPARSE_32(response + 1) == 1) {
+            nb_retry++;
+        }
+        else {
+            DBG_PRINTF("Initial %d, unexpected response version", i);
+            ret = -1;
+        }
+        if (ret == 0 && i == 63) {
+            /* The retransmission of an Initial gets the same response */
+            memcpy(previous, response, length);
+            previous_length = length;
+            if (fuzi_q_stateless_response(&stateless, initial, sizeof(initial), response, sizeof(response)) != previous_length ||
+                memcmp(response, previous, previous_length) != 0) {
+                DBG_PRINTF("%s", "Different responses to the same Initial");
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0 && (nb_vn == 0 || nb_retry == 0 || stateless.nb_vn + stateless.nb_retry != 65)) {
+        DBG_PRINTF("Unexpected responses, %" PRIu64 " VN, %" PRIu64 " Retry", nb_vn, nb_retry);
+        ret = -1;
+    }
+    fuzi_q_stateless_release(&stateless);
+
+    return ret;
+}
+
+/* Check that the migration plan only depends on the ICID, and that
+ * all migration modes are planned.
+ */
+int fuzi_q_migration_plan_test()
+{
+    int ret = 0;
+    size_t nb_modes[fuzi_q_migration_done] = { 0 };
+    picoquic_connection_id_t icid = { { 0x4d, 0x49, 0x47, 0x52, 0, 0, 0, 0 }, 8 };
+
+    for (int i = 0; ret == 0 && i < 256; i++) {
+        fuzi_q_migration_enum mode;
+        fuzi_q_migration_enum mode_again;
+        uint64_t delay;
+        uint64_t delay_again;
+
+        icid.id[7] = (uint8_t)i;
+        fuzi_q_migration_plan(&icid, &mode, &delay);
+        fuzi_q_migration_plan(&icid, &mode_again, &delay_again);
+        if (mode != mode_again || delay != delay_again) {
+            DBG_PRINTF("ICID %d, different plans", i);
+            ret = -1;
+        }
+        else if (mode >= fuzi_q_migration_done || delay >= FUZI_Q_MIGRATION_DELAY_MAX) {
+            DBG_PRINTF("ICID %d, unexpected plan %d, %" PRIu64, i, mode, delay);
+            ret = -1;
+        }
+        else {
+            nb_modes[mode]++;
+        }
+    }
+    for (int m = 0; ret == 0 && m < fuzi_q_migration_done; m++) {
+        if (nb_modes[m] == 0) {
+            DBG_PRINTF("Migration mode %d never planned", m);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Check that the key update plan only depends on the ICID, and that
+ * all the key update modes are planned.
+ */
+int fuzi_q_key_update_plan_test()
+{
+    int ret = 0;
+    size_t nb_modes[fuzi_q_key_update_max] = { 0 };
+    picoquic_connection_id_t icid = { { 0x4b, 0x45, 0x59, 0x55, 0, 0, 0, 0 }, 8 };
+
+    for (int i = 0; ret == 0 && i < 256; i++) {
+        fuzi_q_key_update_enum mode;
+        fuzi_q_key_update_enum mode_again;
+        uint64_t delay;
+        uint64_t delay_again;
+
+        icid.id[7] = (uint8_t)i;
+        fuzi_q_key_update_plan(&icid, &mode, &delay);
+        fuzi_q_key_update_plan(&icid, &mode_again, &delay_again);
+        if (mode != mode_again || delay != delay_again) {
+            DBG_PRINTF("ICID %d, different plans", i);
+            ret = -1;
+        }
+        else if (mode >= fuzi_q_key_update_max || delay >= FUZI_Q_KEY_UPDATE_DELAY_MAX) {
+            DBG_PRINTF("ICID %d, unexpected plan %d, %" PRIu64, i, mode, delay);
+            ret = -1;
+        }
+        else {
+            nb_modes[mode]++;
+        }
+    }
+    for (int m = 0; ret == 0 && m < fuzi_q_key_update_max; m++) {
+        if (nb_modes[m] == 0) {
+            DBG_PRINTF("Key update mode %d never planned", m);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Check that the additional paths use the next loopback addresses with
+ * the same port, and that the memory picks the IDs of live paths.
+ */
+int fuzi_q_multipath_test()
+{
+    int ret = 0;
+    struct sockaddr_in first_local = { 0 };
+    struct sockaddr_storage local_addr;
+    struct sockaddr_in* local4 = (struct sockaddr_in*)&local_addr;
+    picoquic_cnx_t cnx;
+    picoquic_path_t paths[3];
+    picoquic_path_t* path_table[3] = { &paths[0], &paths[1], &paths[2] };
+    fuzzer_cnx_memory_t memory;
+    fuzzer_prng_t prng;
+    uint64_t path_id;
+
+    first_local.sin_family = AF_INET;
+    first_local.sin_port = htons(4433);
+    first_local.sin_addr.s_addr = htonl(0x7f000001);
+    if (fuzi_q_multipath_local_address((struct sockaddr*)&first_local, 2, &local_addr) != 0 ||
+        local4->sin_family != AF_INET || local4->sin_port != first_local.sin_port ||
+        local4->sin_addr.s_addr != htonl(0x7f000003)) {
+        DBG_PRINTF("%s", "Unexpected local address of path 2");
+        ret = -1;
+    }
+    if (ret == 0 && fuzi_q_multipath_local_address((struct sockaddr*)&first_local, 0, &local_addr) == 0) {
+        DBG_PRINTF("%s", "Local address of the first path replaced");
+        ret = -1;
+    }
+    first_local.sin_addr.s_addr = htonl(0x0a000001);
+    if (ret == 0 && fuzi_q_multipath_local_address((struct sockaddr*)&first_local, 1, &local_addr) == 0) {
+        DBG_PRINTF("%s", "Path opened from a non loopback address");
+        ret = -1;
+    }
+
+    memset(&cnx, 0, sizeof(cnx));
+    memset(paths, 0, sizeof(paths));
+    memset(&memory, 0, sizeof(memory));
+    fuzzer_prng_seed(&prng, 0x4d50);
+    for (int i = 0; i < 3; i++) {
+        paths[i].unique_path_id = 2 * i;
+    }
+    cnx.path = path_table;
+    cnx.nb_paths = 3;
+    if (ret == 0 && fuzzer_memory_pick_path_id(&memory, &prng, &path_id)) {
+        DBG_PRINTF("%s", "Path ID picked from an empty memory");
+        ret = -1;
+    }
+    if (ret == 0) {
+        fuzzer_memory_observe_paths(&memory, &cnx);
+        if (memory.nb_path_ids != 3 || !fuzzer_memory_get(&memory, fuzzer_memory_path_id, &path_id) || path_id != 4) {
+            DBG_PRINTF("Unexpected paths in memory: %zu", memory.nb_path_ids);
+            ret = -1;
+        }
+    }
+    for (int i = 0; ret == 0 && i < 32; i++) {
+        if (!fuzzer_memory_pick_path_id(&memory, &prng, &path_id) || (path_id != 0 && path_id != 2 && path_id != 4)) {
+            DBG_PRINTF("Picked a path ID that is not live: %" PRIu64, path_id);
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Check that the generated scenarios only depend on the ICID, that the
+ * streams are ordered and only depend on earlier streams, and that the
+ * scenarios vary across connections. The scenario storage is reused from
+ * one ICID to the next, as in the connection slots.
+ */
+int fuzi_q_scenario_test()
+{
+    int ret = 0;
+    picoquic_connection_id_t icid = { { 0x53, 0x43, 0x45, 0x4e, 0, 0, 0, 0 }, 8 };
+    fuzi_q_scenario_t* scenario = (fuzi_q_scenario_t*)malloc(sizeof(fuzi_q_scenario_t));
+    fuzi_q_scenario_t* scenario_again = (fuzi_q_scenario_t*)malloc(sizeof(fuzi_q_scenario_t));
+    size_t nb_posts = 0;
+    size_t nb_dependent = 0;
+    size_t nb_streams_min = SIZE_MAX;
+    size_t nb_streams_max = 0;
+
+    if (scenario == NULL || scenario_again == NULL) {
+        ret = -1;
+    }
+    for (int i = 0; ret == 0 && i < 64; i++) {
+        picoquic_demo_stream_desc_t* sc = scenario->streams;
+        picoquic_demo_stream_desc_t* sc_again = scenario_again->streams;
+
+        icid.id[7] = (uint8_t)i;
+        if (fuzi_q_scenario_generate(&icid, scenario) != 0 ||
+            fuzi_q_scenario_generate(&icid, scenario_again) != 0) {
+            DBG_PRINTF("ICID %d, cannot generate the scenario", i);
+            ret = -1;
+        }
+        else if (scenario->nb_streams == 0 || scenario->nb_streams > FUZI_Q_SCENARIO_STREAMS_MAX ||
+            scenario_again->nb_streams != scenario->nb_streams) {
+            DBG_PRINTF("ICID %d, unexpected number of streams %zu", i, scenario->nb_streams);
+            ret = -1;
+        }
+        for (size_t j = 0; ret == 0 && j < scenario->nb_streams; j++) {
+            if (sc[j].stream_id != sc_again[j].stream_id || sc[j].post_size != sc_again[j].post_size ||
+                strcmp(sc[j].doc_name, sc_again[j].doc_name) != 0 || sc[j].doc_name != scenario->doc_name[j]) {
+                DBG_PRINTF("ICID %d, stream %zu differs", i, j);
+                ret = -1;
+            }
+            else if ((sc[j].stream_id & 3) != 0 || (j > 0 && sc[j].stream_id <= sc[j - 1].stream_id) ||
+                (sc[j].previous_stream_id != PICOQUIC_DEMO_STREAM_ID_INITIAL && sc[j].previous_stream_id >= sc[j].stream_id)) {
+                DBG_PRINTF("ICID %d, stream %zu badly ordered", i, j);
+                ret = -1;
+            }
+            else {
+                nb_posts += (sc[j].post_size > 0);
+                nb_dependent += (sc[j].previous_stream_id != PICOQUIC_DEMO_STREAM_ID_INITIAL);
+            }
+        }
+        if (ret == 0 && scenario->nb_streams < nb_streams_min) {
+            nb_streams_min = scenario->nb_streams;
+        }
+        if (ret == 0 && scenario->nb_streams > nb_streams_max) {
+            nb_streams_max = scenario->nb_streams;
+        }
+    }
+    if (ret == 0 && (nb_posts == 0 || nb_dependent == 0 || nb_streams_min == nb_streams_max)) {
+        DBG_PRINTF("Scenarios do not vary: %zu posts, %zu dependent streams", nb_posts, nb_dependent);
+        ret = -1;
+    }
+    if (scenario != NULL) {
+        free(scenario);
+    }
+    if (scenario_again != NULL) {
+        free(scenario_again);
+    }
+
+    return ret;
+}
+
+/* Check the crash triage with a simulated target, which crashes when
+ * the replay includes one specific trial and fuzzes its packets 7 to 12.
+ */
+typedef struct st_fuzzer_triage_test_ctx_t {
+    picoquic_connection_id_t crash_icid;
+    uint64_t crash_trial;
+} fuzzer_triage_test_ctx_t;
+
+static int fuzzer_triage_test_oracle(void* oracle_ctx, fuzi_q_replay_t* replay)
+{
+    fuzzer_triage_test_ctx_t* test_ctx = (fuzzer_triage_test_ctx_t*)oracle_ctx;
+    int crashed = 0;
+
+    for (size_t i = 0; i < replay->nb_targets; i++) {
+        if (replay->targets[i].trial_rank == test_ctx->crash_trial &&
+            picoquic_compare_connection_id(&replay->targets[i].icid, &test_ctx->crash_icid) == 0) {
+            crashed = (replay->first_packet <= 7 && replay->last_packet >= 12);
+            break;
+        }
+    }
+    return crashed;
+}
+
+int fuzzer_triage_test()
+{
+    int ret = 0;
+    char const* suspects_file = "fuzi_q_triage_test.txt";
+    fuzzer_ctx_t ctx;
+    fuzzer_icid_ctx_t icid_ctx;
+    fuzzer_replay_target_t* targets = NULL;
+    fuzi_q_replay_t replay = { 0 };
+    fuzzer_triage_test_ctx_t test_ctx;
+    size_t nb_runs = 0;
+    FILE* F;
+
+    /* Create a suspects file from the fuzz log, with a duplicate entry and some noise */
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&icid_ctx, 0, sizeof(icid_ctx));
+    for (size_t i = 0; i < nb_test_icid; i++) {
+        for (uint64_t trial = 0; trial < 3; trial++) {
+            icid_ctx.icid = test_icid[i];
+            icid_ctx.trial_rank = trial;
+            icid_ctx.target_state = fuzzer_cnx_state_ready;
+            icid_ctx.target_wait = (int)(i + trial);
+            fuzzer_log_fuzzed(&ctx, &icid_ctx, fuzzer_cnx_state_ready, 1000 * (i + 1));
+        }
+    }
+    if ((F = picoquic_file_open(suspects_file, "w")) == NULL) {
+        ret = -1;
+    }
+    else {
+        fprintf(F, "Connections fuzzed since last probe response:\n");
+        (void)fuzzer_log_dump(&ctx, F, 0);
+        (void)fuzzer_log_dump(&ctx, F, 1000 * nb_test_icid);
+        (void)picoquic_file_close(F);
+    }
+
+    if (ret == 0 && (fuzi_q_triage_read_targets(suspects_file, &targets, &replay.nb_targets) != 0 ||
+        replay.nb_targets != 3 * (nb_test_icid - 1))) {
+        /* The empty ICID cannot be parsed, and is ignored */
+        DBG_PRINTF("Read %zu targets", replay.nb_targets);
+        ret = -1;
+    }
+    (void)remove(suspects_file);
+
+    if (ret == 0 && (targets[4].trial_rank != 1 || targets[4].target_state != fuzzer_cnx_state_ready ||
+        targets[4].target_wait != 3 || picoquic_compare_connection_id(&targets[4].icid, &test_icid[2]) != 0)) {
+        DBG_PRINTF("%s", "Target not parsed correctly");
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        test_ctx.crash_icid = test_icid[7];
+        test_ctx.crash_trial = 2;
+        replay.targets = targets;
+        replay.first_packet = 0;
+        replay.last_packet = UINT64_MAX;
+
+        if (fuzi_q_triage_bisect(fuzzer_triage_test_oracle, &test_ctx, &replay, &nb_runs) != 0 ||
+            replay.nb_targets != 1 || replay.targets[0].trial_rank != 2 ||
+            picoquic_compare_connection_id(&replay.targets[0].icid, &test_icid[7]) != 0) {
+            DBG_PRINTF("Bisection failed, %zu targets left", replay.nb_targets);
+            ret = -1;
+        }
+        else if (fuzi_q_triage_minimize(fuzzer_triage_test_oracle, &test_ctx, &replay, &nb_runs) != 0 ||
+            replay.first_packet != 7 || replay.last_packet != 12) {
+            DBG_PRINTF("Minimization found packets %llu to %llu", (unsigned long long)replay.first_packet,
+                (unsigned long long)replay.last_packet);
+            ret = -1;
+        }
+        else if (nb_runs > 40) {
+            DBG_PRINTF("Triage required %zu runs", nb_runs);
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        /* A crash that cannot be reproduced is reported as such */
+        test_ctx.crash_trial = 7;
+        replay.targets = targets;
+        replay.nb_targets = 3 * (nb_test_icid - 1);
+        if (fuzi_q_triage_bisect(fuzzer_triage_test_oracle, &test_ctx, &replay, &nb_runs) == 0) {
+            DBG_PRINTF("%s", "Reproduced a crash that does not happen");
+            ret = -1;
+        }
+    }
+
+    if (targets != NULL) {
+        free(targets);
+    }
+
+    return ret;
+}
+
+/* Check that the supervisor finds sanitizer reports in the target log,
+ * scanning only the lines appended since the previous scan.
+ */
+int fuzzer_supervisor_log_test()
+{
+    int ret = 0;
+    char const* log_file = "fuzi_q_supervisor_test.log";
+    char report[FUZI_Q_SUPERVISOR_REPORT_MAX];
+    long offset = 0;
+    FILE* F = picoquic_file_open(log_file, "w");
+
+    if (F == NULL) {
+        ret = -1;
+    }
+    else {
+        fprintf(F, "Server ready on port 4443\nAccepted connection\n");
+        (void)picoquic_file_close(F);
+        if (fuzi_q_supervisor_scan_log(log_file, &offset, report, sizeof(report)) != 0 || offset == 0) {
+            DBG_PRINTF("%s", "Sanitizer report found in a clean log");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        if ((F = picoquic_file_open(log_file, "a")) == NULL) {
+            ret = -1;
+        }
+        else {
+            fprintf(F, "lib/frames.c:123:5: runtime error: shift exponent 64 is too large\nNext line\nPartial");
+            (void)picoquic_file_close(F);
+            if (fuzi_q_supervisor_scan_log(log_file, &offset, report, sizeof(report)) != 1 ||
+                strcmp(report, "lib/frames.c:123:5: runtime error: shift exponent 64 is too large") != 0) {
+                DBG_PRINTF("%s", "Sanitizer report not found");
+                ret = -1;
+            }
+            else if (fuzi_q_supervisor_scan_log(log_file, &offset, report, sizeof(report)) != 0) {
+                DBG_PRINTF("%s", "Sanitizer report found twice");
+                ret = -1;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        if ((F = picoquic_file_open(log_file, "a")) == NULL) {
+            ret = -1;
+        }
+        else {
+            /* Complete the partial line with a report */
+            fprintf(F, " ==1234==ERROR: AddressSanitizer: heap-use-after-free\n");
+            (void)picoquic_file_close(F);
+            if (fuzi_q_supervisor_scan_log(log_file, &offset, report, sizeof(report)) != 1 ||
+                strstr(report, "Partial") != report) {
+                DBG_PRINTF("%s", "Report on partial line not found");
+                ret = -1;
+            }
+        }
+    }
+
+    (void)remove(log_file);
+
+    return ret;
+}
@@ -24,15 +24,45 @@
 #ifndef QUICRQ_TEST_H
 #define QUICRQ_TEST_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
     extern char const* fuzi_q_test_picoquic_solution_dir;
     extern char const* fuzi_q_test_solution_dir;
 
+    /* Check of the MRU and LRU chains of the ICID table, shared by the tests */
+    struct st_fuzzer_ctx_t;
+    int icid_table_check_chain(struct st_fuzzer_ctx_t* ctx, size_t nb_expected);
+
     int fuzi_q_basic_test();
     int fuzi_q_basic_client_test();
     int icid_table_test();
+    int fuzzer_prng_test();
+    int fuzzer_scheduler_test();
+    int fuzzer_profile_test();
+    int fuzzer_trial_test();
+    int fuzzer_rate_test();
+    int fuzzer_log_test();
+    int fuzzer_triage_test();
+    int fuzzer_supervisor_log_test();
+    int fuzzer_event_test();
+    int fuzzer_capture_test();
+    int fuzzer_memory_test();
+    int fuzzer_varint_test();
+    int fuzzer_schema_test();
+    int fuzzer_app_frame_test();
+    int fuzzer_h3_mutate_test();
+    int fuzi_q_blaster_test();
+    int fuzzer_tls_mutate_test();
+    int fuzi_q_stateless_test();
+    int fuzi_q_migration_plan_test();
+    int fuzi_q_key_update_plan_test();
+    int fuzi_q_multipath_test();
+    int fuzi_q_scenario_test();
+    int fuzi_q_many_clients_test();
+    int fuzi_q_wake_up_test();
 
 #ifdef __cplusplus
 }